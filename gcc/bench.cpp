@@ -0,0 +1,402 @@
+#include "../src/xtal/xtal.h"
+#include "../src/xtal/xtal_macro.h"
+
+#include "../src/xtal/xtal_lib/xtal_pthread.h"
+#include "../src/xtal/xtal_lib/xtal_cstdiostream.h"
+#include "../src/xtal/xtal_lib/xtal_posixfilesystem.h"
+#include "../src/xtal/xtal_lib/xtal_chcode.h"
+
+#include <dirent.h>
+
+#include <string>
+#include <vector>
+#include <map>
+#include <algorithm>
+
+using namespace xtal;
+
+// bench/*.xtalをそれぞれ新しい実行環境で複数回実行し、実行時間と統計を集計する。
+//
+// usage: bench.exe [options] [script...]
+//   -n N     各スクリプトの実行回数 (既定 5)
+//   -d DIR   scriptを省略したとき*.xtalを探すディレクトリ (既定 ../bench)
+//   -x NAME  NAME.xtalを実行しない (複数指定可)
+//   -o FILE  結果をタブ区切りでFILEに書き出す
+//   -b FILE  -oで書き出した結果を基準として比較し、悪化したものを報告する
+//   -t PCT   悪化とみなす割合 (既定 5)
+//   -v       スクリプトの標準出力を表示する
+//
+// 命令数はライブラリをXTAL_ENABLE_VM_STATSを定義してビルドした場合だけ数えられる。
+// 基準と比べて悪化したものがあれば終了コード1、スクリプトがエラーになれば2を返す。
+
+namespace{
+
+class BenchStdStreamLib : public CStdioStdStreamLib{
+public:
+	bool verbose;
+
+	BenchStdStreamLib():verbose(false){}
+
+	virtual uint_t write_stdout_stream(void* stdout_stream_object, const void* src, uint_t size){
+		if(!verbose){
+			return size;
+		}
+		return CStdioStdStreamLib::write_stdout_stream(stdout_stream_object, src, size);
+	}
+};
+
+struct Sample{
+	u64 compile_us;
+	u64 run_us;
+	EnvironmentStats stats;
+};
+
+struct Result{
+	std::string name;
+	int runs;
+	u64 compile_us;
+	u64 median_us;
+	u64 p90_us;
+	u64 min_us;
+	u64 max_us;
+	uint_t executed_inst_count;
+	uint_t alloc_count;
+	uint_t gc_count;
+	uint_t full_gc_count;
+	uint_t max_used_memory;
+};
+
+// 最近傍順位法でpercentパーセンタイルを求める。valuesはソート済みであること
+template<class T>
+T percentile(const std::vector<T>& values, int percent){
+	size_t rank = (values.size()*percent + 99)/100;
+	if(rank==0){
+		rank = 1;
+	}
+	return values[rank-1];
+}
+
+template<class T>
+T median(std::vector<T> values){
+	std::sort(values.begin(), values.end());
+	return percentile(values, 50);
+}
+
+std::string script_name(const std::string& path){
+	std::string::size_type slash = path.find_last_of('/');
+	std::string name = slash==std::string::npos ? path : path.substr(slash+1);
+	std::string::size_type dot = name.rfind(".xtal");
+	if(dot!=std::string::npos && dot+5==name.size()){
+		name.erase(dot);
+	}
+	return name;
+}
+
+std::vector<std::string> list_scripts(const std::string& dir){
+	std::vector<std::string> ret;
+	if(DIR* d = opendir(dir.c_str())){
+		while(dirent* e = readdir(d)){
+			std::string name = e->d_name;
+			if(name.size()>5 && name.compare(name.size()-5, 5, ".xtal")==0){
+				ret.push_back(dir + "/" + name);
+			}
+		}
+		closedir(d);
+	}
+	std::sort(ret.begin(), ret.end());
+	return ret;
+}
+
+bool run_once(const Setting& setting, ThreadLib& thread_lib, const std::string& path, Sample& sample){
+	initialize(setting);
+
+	bool ok = true;
+	{
+		u64 begin = thread_lib.clock();
+		CodePtr code = compile_file(path.c_str());
+		sample.compile_us = thread_lib.clock() - begin;
+
+		XTAL_CATCH_EXCEPT(e){
+			stderr_stream()->println(e);
+			ok = false;
+		}
+
+		if(ok){
+			reset_environment_stats();
+
+			begin = thread_lib.clock();
+			code->call();
+			sample.run_us = thread_lib.clock() - begin;
+
+			environment_stats(sample.stats);
+
+			XTAL_CATCH_EXCEPT(e){
+				stderr_stream()->println(e);
+				ok = false;
+			}
+		}
+	}
+
+	uninitialize();
+	return ok;
+}
+
+bool run_bench(const Setting& setting, ThreadLib& thread_lib, const std::string& path, int runs, Result& result){
+	std::vector<u64> compile_us, run_us;
+	std::vector<uint_t> insts, allocs, gcs, full_gcs, memories;
+
+	for(int i=0; i<runs; ++i){
+		Sample sample;
+		if(!run_once(setting, thread_lib, path, sample)){
+			return false;
+		}
+
+		compile_us.push_back(sample.compile_us);
+		run_us.push_back(sample.run_us);
+		insts.push_back(sample.stats.executed_inst_count);
+		allocs.push_back(sample.stats.alloc_count);
+		gcs.push_back(sample.stats.gc_count);
+		full_gcs.push_back(sample.stats.full_gc_count);
+		memories.push_back(sample.stats.max_used_memory);
+	}
+
+	std::sort(run_us.begin(), run_us.end());
+
+	result.name = script_name(path);
+	result.runs = runs;
+	result.compile_us = median(compile_us);
+	result.median_us = percentile(run_us, 50);
+	result.p90_us = percentile(run_us, 90);
+	result.min_us = run_us.front();
+	result.max_us = run_us.back();
+	result.executed_inst_count = median(insts);
+	result.alloc_count = median(allocs);
+	result.gc_count = median(gcs);
+	result.full_gc_count = median(full_gcs);
+	result.max_used_memory = median(memories);
+	return true;
+}
+
+const char* const header = "name\truns\tcompile_us\tmedian_us\tp90_us\tmin_us\tmax_us\tinsts\tallocs\tgc\tfull_gc\tpeak_bytes\n";
+
+bool write_results(const char* path, const std::vector<Result>& results){
+	FILE* fp = fopen(path, "w");
+	if(!fp){
+		fprintf(stderr, "bench: cannot open %s\n", path);
+		return false;
+	}
+
+	fputs(header, fp);
+	for(size_t i=0; i<results.size(); ++i){
+		const Result& r = results[i];
+		fprintf(fp, "%s\t%d\t%llu\t%llu\t%llu\t%llu\t%llu\t%lu\t%lu\t%lu\t%lu\t%lu\n",
+			r.name.c_str(), r.runs,
+			(unsigned long long)r.compile_us, (unsigned long long)r.median_us, (unsigned long long)r.p90_us,
+			(unsigned long long)r.min_us, (unsigned long long)r.max_us,
+			(unsigned long)r.executed_inst_count, (unsigned long)r.alloc_count,
+			(unsigned long)r.gc_count, (unsigned long)r.full_gc_count, (unsigned long)r.max_used_memory);
+	}
+
+	fclose(fp);
+	return true;
+}
+
+bool read_results(const char* path, std::map<std::string, Result>& results){
+	FILE* fp = fopen(path, "r");
+	if(!fp){
+		fprintf(stderr, "bench: cannot open %s\n", path);
+		return false;
+	}
+
+	char line[1024];
+	while(fgets(line, sizeof(line), fp)){
+		char name[256];
+		Result r;
+		unsigned long long compile_us, median_us, p90_us, min_us, max_us;
+		unsigned long insts, allocs, gcs, full_gcs, memory;
+		if(sscanf(line, "%255s %d %llu %llu %llu %llu %llu %lu %lu %lu %lu %lu",
+			name, &r.runs, &compile_us, &median_us, &p90_us, &min_us, &max_us,
+			&insts, &allocs, &gcs, &full_gcs, &memory)!=12){
+			continue; // ヘッダ行
+		}
+
+		r.name = name;
+		r.compile_us = compile_us;
+		r.median_us = median_us;
+		r.p90_us = p90_us;
+		r.min_us = min_us;
+		r.max_us = max_us;
+		r.executed_inst_count = insts;
+		r.alloc_count = allocs;
+		r.gc_count = gcs;
+		r.full_gc_count = full_gcs;
+		r.max_used_memory = memory;
+		results[r.name] = r;
+	}
+
+	fclose(fp);
+	return true;
+}
+
+// 基準より(1+threshold/100)倍を超えて増えていればtrue
+bool regressed(double current, double base, double threshold){
+	return base>0 && current > base*(1.0 + threshold/100.0);
+}
+
+double change(double current, double base){
+	return base>0 ? (current/base - 1.0)*100.0 : 0.0;
+}
+
+int compare_results(const std::vector<Result>& results, const std::map<std::string, Result>& baseline, double threshold){
+	int regressions = 0;
+
+	printf("\n%-14s %10s %10s %8s  %s\n", "name", "base_us", "median_us", "change", "");
+	for(size_t i=0; i<results.size(); ++i){
+		const Result& r = results[i];
+		std::map<std::string, Result>::const_iterator it = baseline.find(r.name);
+		if(it==baseline.end()){
+			printf("%-14s %10s %10llu %8s  new\n", r.name.c_str(), "-", (unsigned long long)r.median_us, "-");
+			continue;
+		}
+
+		const Result& b = it->second;
+		std::string notes;
+		if(regressed((double)r.median_us, (double)b.median_us, threshold)){ notes += " time"; }
+		if(regressed(r.executed_inst_count, b.executed_inst_count, threshold)){ notes += " insts"; }
+		if(regressed(r.alloc_count, b.alloc_count, threshold)){ notes += " allocs"; }
+		if(regressed(r.max_used_memory, b.max_used_memory, threshold)){ notes += " memory"; }
+
+		if(!notes.empty()){
+			regressions++;
+		}
+
+		printf("%-14s %10llu %10llu %+7.1f%%  %s\n", r.name.c_str(),
+			(unsigned long long)b.median_us, (unsigned long long)r.median_us,
+			change((double)r.median_us, (double)b.median_us),
+			notes.empty() ? "ok" : ("REGRESSION:" + notes).c_str());
+	}
+
+	return regressions;
+}
+
+void print_usage(){
+	fprintf(stderr,
+		"usage: bench [options] [script...]\n"
+		"  -n N     runs per script (default 5)\n"
+		"  -d DIR   directory searched for *.xtal when no script is given (default ../bench)\n"
+		"  -x NAME  skip NAME.xtal (may be repeated)\n"
+		"  -o FILE  write tab separated results to FILE\n"
+		"  -b FILE  compare with results written by -o and report regressions\n"
+		"  -t PCT   regression threshold in percent (default 5)\n"
+		"  -v       show the output of the scripts\n"
+		"instruction counts require a library built with XTAL_ENABLE_VM_STATS.\n"
+	);
+}
+
+}
+
+int main(int argc, char** argv){
+	BenchStdStreamLib stream_lib;
+	PThreadLib thread_lib;
+	PosixFilesystemLib filesystem_lib;
+	UTF8ChCodeLib ch_code_lib;
+
+	Setting setting;
+	setting.thread_lib = &thread_lib;
+	setting.std_stream_lib = &stream_lib;
+	setting.filesystem_lib = &filesystem_lib;
+	setting.ch_code_lib = &ch_code_lib;
+
+	int runs = 5;
+	double threshold = 5;
+	std::string dir = "../bench";
+	const char* output = 0;
+	const char* baseline = 0;
+	std::vector<std::string> excludes;
+	std::vector<std::string> scripts;
+
+	for(int i=1; i<argc; ++i){
+		std::string arg = argv[i];
+		if(arg.size()==2 && arg[0]=='-'){
+			if(arg[1]=='v'){
+				stream_lib.verbose = true;
+				continue;
+			}
+
+			if(i+1>=argc){
+				print_usage();
+				return 2;
+			}
+
+			const char* value = argv[++i];
+			switch(arg[1]){
+			case 'n': runs = atoi(value); break;
+			case 'd': dir = value; break;
+			case 'x': excludes.push_back(value); break;
+			case 'o': output = value; break;
+			case 'b': baseline = value; break;
+			case 't': threshold = atof(value); break;
+			default: print_usage(); return 2;
+			}
+		}
+		else{
+			scripts.push_back(arg);
+		}
+	}
+
+	if(runs<1){
+		print_usage();
+		return 2;
+	}
+
+	if(scripts.empty()){
+		scripts = list_scripts(dir);
+	}
+
+	printf("%-14s %5s %10s %10s %10s %12s %10s %5s %7s %10s\n",
+		"name", "runs", "compile_us", "median_us", "p90_us", "insts", "allocs", "gc", "full_gc", "peak_KB");
+
+	std::vector<Result> results;
+	bool failed = false;
+	for(size_t i=0; i<scripts.size(); ++i){
+		if(std::find(excludes.begin(), excludes.end(), script_name(scripts[i]))!=excludes.end()){
+			continue;
+		}
+
+		Result r;
+		if(!run_bench(setting, thread_lib, scripts[i], runs, r)){
+			fprintf(stderr, "bench: %s failed\n", scripts[i].c_str());
+			failed = true;
+			continue;
+		}
+
+		printf("%-14s %5d %10llu %10llu %10llu %12lu %10lu %5lu %7lu %10lu\n",
+			r.name.c_str(), r.runs, (unsigned long long)r.compile_us,
+			(unsigned long long)r.median_us, (unsigned long long)r.p90_us,
+			(unsigned long)r.executed_inst_count, (unsigned long)r.alloc_count,
+			(unsigned long)r.gc_count, (unsigned long)r.full_gc_count,
+			(unsigned long)(r.max_used_memory/1024));
+		fflush(stdout);
+
+		results.push_back(r);
+	}
+
+	if(output && !write_results(output, results)){
+		return 2;
+	}
+
+	int regressions = 0;
+	if(baseline){
+		std::map<std::string, Result> base;
+		if(!read_results(baseline, base)){
+			return 2;
+		}
+		regressions = compare_results(results, base, threshold);
+	}
+
+	if(failed){
+		return 2;
+	}
+
+	return regressions ? 1 : 0;
+}
@@ -42,6 +42,96 @@ XTAL_BIND(MyData){
 	it->def_var(Xid(a), &MyData::a);
 }
 
+// Schedulerのfd待ちを試すためのパイプ
+class TestPipe{
+public:
+	int fds[2];
+
+	TestPipe(){
+		if(pipe(fds)!=0){
+			fds[0] = fds[1] = -1;
+		}
+	}
+
+	~TestPipe(){
+		close(fds[0]);
+		close(fds[1]);
+	}
+
+	xtal::int_t reader(){ return fds[0]; }
+	xtal::int_t writer(){ return fds[1]; }
+
+	xtal::int_t write(const xtal::StringPtr& str){
+		return ::write(fds[1], str->data(), str->data_size()*sizeof(xtal::char_t));
+	}
+
+	xtal::StringPtr read(){
+		xtal::char_t buf[256];
+		ssize_t n = ::read(fds[0], buf, sizeof(buf));
+		return xtal::xnew<xtal::String>(buf, n>0 ? n/sizeof(xtal::char_t) : 0);
+	}
+};
+
+XTAL_PREBIND(TestPipe){
+	it->def_ctor(xtal::ctor<TestPipe>());
+}
+
+XTAL_BIND(TestPipe){
+	it->def_method(Xid(reader), &TestPipe::reader);
+	it->def_method(Xid(writer), &TestPipe::writer);
+	it->def_method(Xid(write), &TestPipe::write);
+	it->def_method(Xid(read), &TestPipe::read);
+}
+
+// 遅延参照カウントでの破棄とfinalizerの順番を試すためのクラス
+// finalizerが呼ばれるとlogにnameを積み、破棄されると破棄数を数える。
+// child_nameを渡すと、VMのレジスタを通さずに子を作って持つ。
+class TestFinalizer : public xtal::Base{
+public:
+	static xtal::int_t destroyed;
+
+	TestFinalizer(const xtal::AnyPtr& name, const xtal::ArrayPtr& log, const xtal::AnyPtr& child_name)
+		:name_(name), log_(log){
+		if(child_name){
+			child_ = xtal::xnew<TestFinalizer>(child_name, log, xtal::null);
+		}
+	}
+
+	~TestFinalizer(){
+		destroyed++;
+	}
+
+	void on_finalize(){
+		log_->push_back(name_);
+	}
+
+	void on_visit_members(xtal::Visitor& m){
+		xtal::Base::on_visit_members(m);
+		m & name_ & log_ & child_;
+	}
+
+	const xtal::AnyPtr& name(){ return name_; }
+
+	static xtal::int_t destroyed_count(){ return destroyed; }
+
+private:
+	xtal::AnyPtr name_;
+	xtal::ArrayPtr log_;
+	xtal::AnyPtr child_;
+};
+
+xtal::int_t TestFinalizer::destroyed = 0;
+
+XTAL_PREBIND(TestFinalizer){
+	Xdef_ctor3(const xtal::AnyPtr&, const xtal::ArrayPtr&, const xtal::AnyPtr&);
+		Xparam(child_name, xtal::null);
+}
+
+XTAL_BIND(TestFinalizer){
+	it->def_method(Xid(name), &TestFinalizer::name);
+	it->def_fun(Xid(destroyed_count), &TestFinalizer::destroyed_count);
+}
+
 using namespace xtal;
 
 void test(){
@@ -65,6 +155,155 @@ void test(){
 
 using namespace xtal;
 
+// 一つのCodeImageを二つの実行環境でinstantiateし、バイトコードが共有されることを確かめる
+// カレントの実行環境は一つしか持てないので、作成した実行環境を破棄してから次の実行環境を作る
+bool test_code_image(const Setting& setting){
+	bool ok = true;
+
+	initialize(setting);
+	CodeImage* image = 0;
+	{
+		CodePtr code = Xsrc((
+			return 10 + 20;
+		));
+		image = code->image();
+		image->inc_ref_count();
+		ok = ok && image->ref_count()==2;
+
+		CodePtr a = code->instantiate();
+		ok = ok && image->ref_count()==3;
+		ok = ok && a->bytecode_data()==code->bytecode_data();
+		ok = ok && a->call()->to_i()==30;
+	}
+	uninitialize();
+	ok = ok && image->ref_count()==1;
+
+	// 作成した実行環境を破棄した後も、他の実行環境で使える
+	initialize(setting);
+	{
+		CodePtr a = image->instantiate();
+		CodePtr b = image->instantiate();
+		ok = ok && image->ref_count()==3;
+
+		// デバッグコンパイルしていないコードは複製されず、イメージのバイトコードをそのまま実行する
+		ok = ok && a->bytecode_data()==image->bytecode_data();
+		ok = ok && b->bytecode_data()==image->bytecode_data();
+		ok = ok && a->call()->to_i()==30;
+		ok = ok && b->call()->to_i()==30;
+	}
+	uninitialize();
+	ok = ok && image->ref_count()==1;
+	image->dec_ref_count();
+
+	// 文の先頭を記録したコードだけがバイトコードを複製し、トラップ命令はその複製に埋め込まれる
+	initialize(setting);
+	debug::enable_debug_compile();
+	{
+		CodePtr code = Xsrc((
+			x: 10;
+			return x + 20;
+		));
+		CodeImage* debug_image = code->image();
+		PODArray<inst_t> original;
+		original.resize(debug_image->bytecode_size());
+		std::memcpy(original.data(), debug_image->bytecode_data(), sizeof(inst_t)*original.size());
+
+		CodePtr a = debug_image->instantiate();
+		CodePtr b = debug_image->instantiate();
+		ok = ok && debug_image->ref_count()==3;
+		ok = ok && a->bytecode_data()!=debug_image->bytecode_data();
+
+		// Xsrcのソースは全て1行目になる
+		a->add_breakpoint(1);
+		ok = ok && std::memcmp(original.data(), a->bytecode_data(), sizeof(inst_t)*original.size())!=0;
+		ok = ok && std::memcmp(original.data(), b->bytecode_data(), sizeof(inst_t)*original.size())==0;
+		ok = ok && std::memcmp(original.data(), debug_image->bytecode_data(), sizeof(inst_t)*original.size())==0;
+	}
+	debug::disable_debug_compile();
+	uninitialize();
+
+	return ok;
+}
+
+// LineNumberTableの復号と検索を、全ての行を並べた素朴な表と比べて確かめる
+// 行番号が戻る行、複数バイトの符号になる大きな差、ブロックの境目をまたぐ行を含める
+bool test_lineno_table(const Setting& setting){
+	bool ok = true;
+
+	initialize(setting);
+	{
+		const uint_t N = 40;
+		LineNumberTable::Entry entries[N];
+		LineNumberTableBuilder builder;
+		for(uint_t i=0; i<N; ++i){
+			entries[i].start_pc = i*4 + (i%3) + (i>=20 ? 1000 : 0);
+			entries[i].lineno = 100 + (i%7)*10 - i + (i==30 ? 5000 : 0);
+			builder.push_back(entries[i].start_pc, entries[i].lineno);
+		}
+
+		PODArray<u32> buf;
+		buf.resize((builder.byte_size()+3)/4);
+		LineNumberTable written = builder.write(buf.data());
+		LineNumberTable building = builder.table();
+
+		const LineNumberTable* tables[2] = {&written, &building};
+		for(uint_t t=0; t<2; ++t){
+			const LineNumberTable& table = *tables[t];
+			ok = ok && table.size()==N;
+			ok = ok && table.back().start_pc==entries[N-1].start_pc && table.back().lineno==entries[N-1].lineno;
+
+			LineNumberTable::Cursor c;
+			table.begin(c);
+			for(uint_t i=0; i<N; ++i){
+				LineNumberTable::Entry e = table.at(i);
+				ok = ok && e.start_pc==entries[i].start_pc && e.lineno==entries[i].lineno;
+				ok = ok && table.next(c) && c.index==i && c.entry.start_pc==entries[i].start_pc && c.entry.lineno==entries[i].lineno;
+			}
+			ok = ok && !table.next(c);
+
+			// 行の先頭、その次、次の行の直前。ブロックの境目15/16/17/32も含まれる
+			for(uint_t i=0; i<N; ++i){
+				uint_t pcs[3] = {entries[i].start_pc, entries[i].start_pc+1, i+1<N ? entries[i+1].start_pc-1 : entries[i].start_pc+100};
+				for(uint_t j=0; j<3; ++j){
+					LineNumberTable::Entry e;
+					ok = ok && table.find_pc(pcs[j], &e)==(int_t)i;
+					ok = ok && e.start_pc==entries[i].start_pc && e.lineno==entries[i].lineno;
+				}
+			}
+		}
+
+		// 索引を持つのは書き出した表だけ
+		ok = ok && building.find_lineno(0)==-1;
+		for(uint_t lineno=0; lineno<=5200; ++lineno){
+			int_t expected = -1;
+			for(uint_t i=0; i<N; ++i){
+				if(entries[i].lineno>=lineno && (expected<0 || entries[i].lineno<entries[expected].lineno)){
+					expected = i;
+				}
+			}
+			ok = ok && written.find_lineno(lineno)==expected;
+		}
+
+		// ブロックの先頭になった行を取り消して、別の行を足し直す
+		builder.clear();
+		for(uint_t i=0; i<=16; ++i){
+			builder.push_back(entries[i].start_pc, entries[i].lineno);
+		}
+		builder.pop_back();
+		ok = ok && builder.size()==16 && builder.back().start_pc==entries[15].start_pc;
+		builder.push_back(entries[17].start_pc, entries[17].lineno);
+		LineNumberTable table = builder.table();
+		ok = ok && table.size()==17;
+		ok = ok && table.at(15).start_pc==entries[15].start_pc && table.at(15).lineno==entries[15].lineno;
+		ok = ok && table.at(16).start_pc==entries[17].start_pc && table.at(16).lineno==entries[17].lineno;
+		ok = ok && table.find_pc(entries[16].start_pc)==15;
+		ok = ok && table.find_pc(entries[17].start_pc)==16;
+	}
+	uninitialize();
+
+	return ok;
+}
+
 int main2(int argc, char** argv){
 	
 	debug::enable_debug_compile();
@@ -82,6 +321,8 @@ int main2(int argc, char** argv){
 		return 1;
 	}
 
+	lib()->def(Xid(TestPipe), cpp_class<TestPipe>());
+	lib()->def(Xid(TestFinalizer), cpp_class<TestFinalizer>());
 	lib()->member("test")->send("run_dir", "../test");
 
 	XTAL_CATCH_EXCEPT(e){
@@ -112,6 +353,22 @@ int main(int argc, char** argv){
 	vmachine()->print_info();
 	uninitialize();
 
+	if(test_code_image(setting)){
+		std::cout << "code_image ok" << std::endl;
+	}
+	else{
+		std::cout << "code_image fail" << std::endl;
+		ret = 1;
+	}
+
+	if(test_lineno_table(setting)){
+		std::cout << "lineno_table ok" << std::endl;
+	}
+	else{
+		std::cout << "lineno_table fail" << std::endl;
+		ret = 1;
+	}
+
 	return ret;
 }
 
@@ -40,8 +40,10 @@
 #include "xtal_bind.h"
 #include "xtal_ch.h"
 #include "xtal_stream.h"
+#include "xtal_numericarray.h"
 #include "xtal_filesystem.h"
 #include "xtal_thread.h"
+#include "xtal_scheduler.h"
 #include "xtal_lib.h"
 #include "xtal_iterator.h"
 #include "xtal_except.h"
@@ -18,8 +18,10 @@
 #include "xtal_frame.cpp"
 #include "xtal_class.cpp"
 #include "xtal_array.cpp"
+#include "xtal_numericarray.cpp"
 #include "xtal_base.cpp"
 #include "xtal_objectspace.cpp"
+#include "xtal_statsspace.cpp"
 #include "xtal_vmachine2.cpp"
 #include "xtal_stack.cpp"
 #include "xtal_map.cpp"
@@ -45,6 +47,7 @@
 #include "xtal_serializer.cpp"
 #include "xtal_text.cpp"
 #include "xtal_thread.cpp"
+#include "xtal_scheduler.cpp"
 #include "xtal_xpeg.cpp"
 #include "xtal_inst.cpp"
 #include "xtal_bind.cpp"
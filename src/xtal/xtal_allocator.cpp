@@ -122,7 +122,7 @@ void MemoryPool::free(void* mem, Chunk* chunk){
 			free_chunk_ = chunk->next;
 		}
 
-		xfree_align(chunk->buf(), BLOCK_MEMORY_SIZE + sizeof(Chunk), BLOCK_SIZE);
+		xfree_pool(chunk->buf(), BLOCK_MEMORY_SIZE + sizeof(Chunk), BLOCK_SIZE);
 	}
 	else{
 		chunk->count++;
@@ -130,7 +130,7 @@ void MemoryPool::free(void* mem, Chunk* chunk){
 }
 
 void MemoryPool::add_chunk(){
-	u8* memory = (u8*)xmalloc_align(BLOCK_MEMORY_SIZE + sizeof(Chunk), BLOCK_SIZE);
+	u8* memory = (u8*)xmalloc_pool(BLOCK_MEMORY_SIZE + sizeof(Chunk), BLOCK_SIZE);
 	Chunk* chunk = (Chunk*)(memory + BLOCK_MEMORY_SIZE);
 	
 	chunk->next = 0;
@@ -155,13 +155,13 @@ void MemoryPool::add_chunk(){
 void MemoryPool::release(){
 	for(Chunk* p=free_chunk_; p; ){
 		Chunk* next = p->next;
-		xfree_align(p->buf(), BLOCK_MEMORY_SIZE + sizeof(Chunk), BLOCK_SIZE);
+		xfree_pool(p->buf(), BLOCK_MEMORY_SIZE + sizeof(Chunk), BLOCK_SIZE);
 		p = next;
 	}
 	
 	for(Chunk* p=full_chunk_; p; ){
 		Chunk* next = p->next;
-		xfree_align(p->buf(), BLOCK_MEMORY_SIZE + sizeof(Chunk), BLOCK_SIZE);
+		xfree_pool(p->buf(), BLOCK_MEMORY_SIZE + sizeof(Chunk), BLOCK_SIZE);
 		p = next;
 	}
 
@@ -200,6 +200,19 @@ void xfree(void*, size_t);
 void* xmalloc_align(size_t, size_t);
 void xfree_align(void*, size_t, size_t);
 
+/**
+* \internal
+* \brief 小さいオブジェクト用のメモリプールの領域を確保する
+* 確保した量は使用メモリ量ではなくプールの確保量として数えられ、メモリ使用量の上限の検査も行わない。
+*/
+void* xmalloc_pool(size_t, size_t);
+
+/**
+* \internal
+* \brief xmalloc_poolで確保した領域を解放する
+*/
+void xfree_pool(void*, size_t, size_t);
+
 enum{
 	ALIGN_MIN = 8
 };
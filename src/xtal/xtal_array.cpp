@@ -282,8 +282,15 @@ void Array::on_visit_members(Visitor& m){
 	m & values_;
 }
 
-Array::Array(uint_t size)
-:values_(size){}
+Array::Array(int_t size){
+	// 負の大きさや、確保するバイト数が溢れる大きさは受け付けない
+	if(size<0 || (uint_t)size>((uint_t)-1)/sizeof(AnyPtr)){
+		set_array_size_error(size);
+		return;
+	}
+
+	values_.resize(size);
+}
 
 Array::Array(const AnyPtr* first, const AnyPtr* end)
 :values_(first, end){}
@@ -316,6 +323,31 @@ void Array::insert(int_t i, const AnyPtr& v){
 	values_.insert(pos, v);
 }
 
+void Array::resize(uint_t sz){
+	if(sz>size() && !reserve_upsize(sz-size())){
+		return;
+	}
+	values_.resize(sz);
+}
+
+void Array::upsize(uint_t sz){
+	if(!reserve_upsize(sz)){
+		return;
+	}
+	values_.upsize(sz);
+}
+
+bool Array::reserve_upsize(uint_t sz){
+	uint_t size = values_.size();
+	uint_t capa = values_.capacity();
+	if(size+sz<=capa){
+		return true;
+	}
+
+	// xarray::upsizeが確保する大きさで調べる
+	return reserve_memory(sizeof(AnyPtr)*(size + sz + capa/2 + 2));
+}
+
 void Array::push_back(const AnyPtr& v){
 	insert(size(), v);
 }
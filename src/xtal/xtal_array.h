@@ -301,7 +301,7 @@ public:
 	* \xbind
 	* \brief sizeの長さの配列を生成する 
 	*/
-	Array(uint_t size = 0);
+	Array(int_t size = 0);
 
 	Array(const AnyPtr* first, const AnyPtr* end);
 
@@ -327,17 +327,13 @@ public:
 	* \xbind
 	* \brief 配列の長さを変更する
 	*/
-	void resize(uint_t sz){
-		values_.resize(sz);
-	}
+	void resize(uint_t sz);
 
 	/**
 	* \xbind
 	* \brief 配列をsz分長くする
 	*/
-	void upsize(uint_t sz){
-		values_.upsize(sz);
-	}
+	void upsize(uint_t sz);
 
 	/**
 	* \xbind
@@ -564,6 +560,9 @@ protected:
 
 	void throw_index_error();
 
+	// sz分長くしてもメモリ使用量の上限を超えないか調べる
+	bool reserve_upsize(uint_t sz);
+
 	xarray values_;
 
 private:
@@ -58,6 +58,14 @@ void RefCountingBase::object_destroy(){
 	}
 }
 
+void RefCountingBase::object_zero_count(){
+#ifdef XTAL_NO_DEFERRED_REF_COUNT
+	object_destroy();
+#else
+	environment_->object_space_.push_zero_count(this);
+#endif
+}
+
 void Base::special_initialize(){
 	value_.init_base(this);
 	class_ = nul<Class>().get();
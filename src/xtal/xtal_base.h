@@ -254,6 +254,9 @@ public:
 		HAVE_FINALIZER_FLAG_SHIFT = DESTROYED_FLAG_SHIFT+1,
 		HAVE_FINALIZER_FLAG_BIT = 1<<HAVE_FINALIZER_FLAG_SHIFT,
 
+		ZERO_COUNT_FLAG_SHIFT = HAVE_FINALIZER_FLAG_SHIFT+1,
+		ZERO_COUNT_FLAG_BIT = 1<<ZERO_COUNT_FLAG_SHIFT,
+
 		//REF_COUNT_SHIFT = HAVE_FINALIZER_FLAG_SHIFT+1,
 		//REF_COUNT_MASK = ~((1<<REF_COUNT_SHIFT)-1),
 		//REF_COUNT_NUMBER = 1<<REF_COUNT_SHIFT,
@@ -263,7 +266,11 @@ public:
 	int_t alive_ref_count() const{ return ref_count_; }
 	void add_ref_count(int_t n){ ref_count_ += n; }
 	void inc_ref_count(){ ++ref_count_; }
+#ifdef XTAL_NO_DEFERRED_REF_COUNT
 	void dec_ref_count(){ if(XTAL_UNLIKELY(!--ref_count_)){ object_destroy(); } }
+#else
+	void dec_ref_count(){ if(XTAL_UNLIKELY(!--ref_count_)){ object_zero_count(); } }
+#endif
 	//void dec_ref_count(){ --ref_count_; }
 
 	void atomic_inc_ref_count(){ ++ref_count_; }
@@ -276,7 +283,17 @@ public:
 	uint_t object_destroyed() const{ return (XTAL_detail_user_flags(*this) & DESTROYED_FLAG_BIT); }
 	void set_object_destroyed_flag(){ XTAL_detail_user_flags(*this) |= DESTROYED_FLAG_BIT; }
 
+	uint_t in_zero_count_table() const{ return (XTAL_detail_user_flags(*this) & ZERO_COUNT_FLAG_BIT); }
+	void set_zero_count_flag(){ XTAL_detail_user_flags(*this) |= ZERO_COUNT_FLAG_BIT; }
+	void unset_zero_count_flag(){ XTAL_detail_user_flags(*this) &= ~ZERO_COUNT_FLAG_BIT; }
+
 	void object_destroy();
+
+	/**
+	* \brief 参照カウンタが0になったときに呼ばれる。
+	* 遅延参照カウントが有効な場合はゼロカウント表に積み、そうでない場合はすぐに破棄する。
+	*/
+	void object_zero_count();
 	void object_free(){ virtual_members()->object_free(this); }
 
 public:
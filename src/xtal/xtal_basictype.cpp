@@ -66,63 +66,109 @@ void IntRangeIter::block_next(const VMachinePtr& vm){
 	}
 }
 
-Values::Values(const AnyPtr& head)
-	:head_(head), tail_(unchecked_ptr_cast<Values>(undefined)){
+Values::Values(const AnyPtr& head){
+	init(&head, 1, unchecked_ptr_cast<Values>(undefined));
 }
 
-Values::Values(const AnyPtr& head, const ValuesPtr& tail)
-	:head_(head), tail_(tail){
+Values::Values(const AnyPtr& head, const ValuesPtr& tail){
+	init(&head, 1, tail);
+}
+
+Values::Values(const AnyPtr* values, int_t size){
+	init(values, size, unchecked_ptr_cast<Values>(undefined));
+}
+
+Values::Values(const AnyPtr* values, int_t size, const ValuesPtr& tail){
+	init(values, size, tail);
+}
+
+Values::Values(const AnyPtr& owner, const AnyPtr* values, int_t size)
+	:owner_(owner){
+	values_ = const_cast<AnyPtr*>(values);
+	size_ = size;
 }
 
 Values::~Values(){
+	destroy();
 }
-	
-void Values::block_next(const VMachinePtr& vm){
-	if(!XTAL_detail_is_undefined(tail_)){
-		vm->return_result(tail_, head_);
+
+void Values::init(const AnyPtr* values, int_t size, const ValuesPtr& tail){
+	int_t tail_size = XTAL_detail_type(tail)==TYPE_VALUES ? tail->size() : 0;
+	size_ = size + tail_size;
+
+	if(size_<=INLINE_CAPACITY){
+		values_ = inline_values_;
 	}
 	else{
-		vm->return_result(0, head_);
+		values_ = (AnyPtr*)xmalloc(sizeof(AnyPtr)*size_);
+		for(int_t i=0; i<size_; ++i){
+			new(values_+i) AnyPtr();
+		}
+	}
+
+	for(int_t i=0; i<size; ++i){
+		values_[i] = values[i];
+	}
+
+	for(int_t i=0; i<tail_size; ++i){
+		values_[size+i] = tail->values_[i];
 	}
 }
 
-int_t Values::size(){
-	const ValuesPtr* cur = &to_smartptr(this);
-	int_t size = 1;
-	while(true){
-		if(XTAL_detail_is_undefined((*cur)->tail_)){
-			return size;
+void Values::destroy(){
+	if(owner_){
+		owner_ = null;
+	}
+	else if(values_!=inline_values_){
+		for(int_t i=0; i<size_; ++i){
+			values_[i].~AnyPtr();
 		}
-		cur = &(*cur)->tail_;
-		++size;
+		xfree(values_, sizeof(AnyPtr)*size_);
 	}
+	else{
+		for(int_t i=0; i<size_; ++i){
+			values_[i] = null;
+		}
+	}
+
+	values_ = inline_values_;
+	size_ = 0;
 }
 
-const AnyPtr& Values::at(int_t i){
-	const ValuesPtr* cur = &to_smartptr(this);
-	const AnyPtr* ret = &head_;
-	for(int_t n=0; n<i; ++n){
-		if(XTAL_detail_is_undefined((*cur)->tail_)){
-			ret = &(AnyPtr&)undefined;
-			break;
-		}
-		cur = &(*cur)->tail_;
-		ret = &(*cur)->head_;
+ValuesPtr Values::tail(){
+	return drop(1);
+}
+
+ValuesPtr Values::drop(int_t n){
+	if(n>=size_){
+		return unchecked_ptr_cast<Values>(undefined);
+	}
+
+	// 先頭から順にtailをたどってもO(n)で済むように、要素の領域は共有する
+	const AnyPtr& owner = owner_ ? owner_ : (const AnyPtr&)to_smartptr(this);
+	return XNew<Values>(owner, values_+n, size_-n);
+}
+	
+void Values::block_next(const VMachinePtr& vm){
+	if(size_>1){
+		vm->return_result(tail(), values_[0]);
+	}
+	else{
+		vm->return_result(0, values_[0]);
 	}
-	return *ret;
 }
 
 bool Values::op_eq(const ValuesPtr& other){
-	const VMachinePtr& vm = vmachine();
-
-	const ValuesPtr* cur1 = &to_smartptr(this);
-	const ValuesPtr* cur2 = &other;
+	if(size_!=other->size_){
+		return false;
+	}
 
-	while(true){
-		if(!XTAL_detail_raweq((*cur1)->head_, (*cur2)->head_)){
+	const VMachinePtr& vm = vmachine();
+	for(int_t i=0; i<size_; ++i){
+		if(!XTAL_detail_raweq(values_[i], other->values_[i])){
 			vm->setup_call(1);
-			vm->push_arg((*cur2)->head_);
-			(*cur1)->head_->rawsend(vm, Xid(op_eq), undefined, true, true);
+			vm->push_arg(other->values_[i]);
+			values_[i]->rawsend(vm, Xid(op_eq), undefined, true, true);
 
 			if(!vm->is_executed() || !vm->result()){
 				vm->cleanup_call();
@@ -130,22 +176,6 @@ bool Values::op_eq(const ValuesPtr& other){
 			}
 			vm->cleanup_call();
 		}
-
-		if(XTAL_detail_is_undefined((*cur1)->tail_)){
-			if(XTAL_detail_is_undefined((*cur2)->tail_)){
-				return true;
-			}
-			else{
-				return false;
-			}
-		}
-
-		if(!(*cur2)->tail_){
-			return false;
-		}
-
-		cur1 = &(*cur1)->tail_;
-		cur2 = &(*cur2)->tail_;
 	}
 
 	return true;
@@ -155,18 +185,12 @@ StringPtr Values::to_s(){
 	MemoryStreamPtr ms = xnew<MemoryStream>();
 	ms->put_s(XTAL_STRING("("));
 
-	const ValuesPtr* cur = &to_smartptr(this);
-	for(int_t n=0; ; ++n){
+	for(int_t n=0; n<size_; ++n){
 		if(n!=0){
 			ms->put_s(XTAL_STRING(", "));
 		}
 
-		ms->put_s((*cur)->head_);
-
-		if(XTAL_detail_is_undefined((*cur)->tail_)){
-			break;
-		}
-		cur = &(*cur)->tail_;
+		ms->put_s(values_[n]);
 	}
 
 	ms->put_s(XTAL_STRING(")"));
@@ -175,12 +199,15 @@ StringPtr Values::to_s(){
 }
 
 void Values::set(const AnyPtr& head, const ValuesPtr& tail){
-	head_ = head;
-	tail_ = tail;
+	ValuesPtr temp = tail;
+	AnyPtr h = head;
+	destroy();
+	init(&h, 1, temp);
 }
 
 ValuesPtr mv(const AnyPtr& v1, const AnyPtr& v2){
-	return xnew<Values>(v1, xnew<Values>(v2));
+	const AnyPtr values[2] = {v1, v2};
+	return xnew<Values>(values, 2);
 }
 
 ///////////////////////////////////
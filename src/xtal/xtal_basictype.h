@@ -338,35 +338,73 @@ public:
 
 /**
 * \brief 多値
+* 値は連続した領域に格納され、INLINE_CAPACITY個以下ならオブジェクト内に直接保持する。
 */
 class Values : public RefCountingBase{
 public:
 	enum{ TYPE = TYPE_VALUES };
 
+	enum{ INLINE_CAPACITY = 4 };
+
 	Values(const AnyPtr& head);
 
 	Values(const AnyPtr& head, const ValuesPtr& tail);
 
+	/**
+	* \brief values[0]からvalues[size-1]までを要素とする多値を生成する
+	*/
+	Values(const AnyPtr* values, int_t size);
+
+	/**
+	* \brief values[0]からvalues[size-1]までの後ろにtailの要素を続けた多値を生成する
+	*/
+	Values(const AnyPtr* values, int_t size, const ValuesPtr& tail);
+
+	/**
+	* \brief ownerが持つvalues[0]からvalues[size-1]までを、コピーせずに参照する多値を生成する
+	* ownerは要素を自分で保持している多値でなければならない。
+	*/
+	Values(const AnyPtr& owner, const AnyPtr* values, int_t size);
+
 	~Values();
 
 	const AnyPtr& head(){
-		return head_;
+		return values_[0];
 	}
 
-	const ValuesPtr& tail(){
-		return tail_;
-	}
+	/**
+	* \brief 先頭以外の要素からなる多値を返す
+	* 要素が一つしかない場合はundefinedを返す。
+	*/
+	ValuesPtr tail();
+
+	/**
+	* \brief 先頭からn個の要素を除いた多値を返す
+	* 要素はコピーせず、この多値の領域を参照する。残りの要素が無い場合はundefinedを返す。
+	*/
+	ValuesPtr drop(int_t n);
 
 	void block_next(const VMachinePtr& vm);
 
-	int_t size();
+	int_t size(){
+		return size_;
+	}
 
-	const AnyPtr& at(int_t i);
+	const AnyPtr& at(int_t i){
+		if((uint_t)i<(uint_t)size_){
+			return values_[i];
+		}
+		return undefined;
+	}
 
 	const AnyPtr& op_at(int_t i){
 		return at(i);
 	}
 
+	const AnyPtr* data(){
+		return values_;
+	}
+
 	/**
 	* \xbind
 	* \brief 値が等しいか調べる
@@ -376,16 +414,34 @@ public:
 	StringPtr to_s();
 
 	void on_visit_members(Visitor& m){
-		m & head_ & tail_;
+		// 他の多値の領域を参照している場合、要素を保持しているのはその多値
+		if(owner_){
+			m & owner_;
+			return;
+		}
+
+		for(int_t i=0; i<size_; ++i){
+			m & values_[i];
+		}
 	}
 
 public:
 
-	void set(const AnyPtr& head, const ValuesPtr& tail = null);
-	
+	/**
+	* \brief 要素を置き換える
+	* 生成直後の、まだ誰にも参照されていない多値にだけ使うこと。
+	*/
+	void set(const AnyPtr& head, const ValuesPtr& tail);
+
+private:
+	void init(const AnyPtr* values, int_t size, const ValuesPtr& tail);
+	void destroy();
+
 private:
-	AnyPtr head_;
-	ValuesPtr tail_;
+	AnyPtr* values_;
+	int_t size_;
+	AnyPtr owner_;
+	AnyPtr inline_values_[INLINE_CAPACITY];
 };
 
 ValuesPtr mv(const AnyPtr& v1, const AnyPtr& v2);
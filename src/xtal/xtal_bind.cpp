@@ -377,6 +377,112 @@ XTAL_BIND(Array){
 
 }
 
+XTAL_PREBIND(NumericArrayIter){
+	Xinherit(Iterator);
+}
+
+XTAL_BIND(NumericArrayIter){
+	Xdef_method(block_next);
+}
+
+XTAL_PREBIND(NumericArrayStream){
+	Xinherit(PointerStream);
+}
+
+XTAL_PREBIND(NumericArray){
+	Xregister(Builtin);
+	Xinherit(Iterable);
+}
+
+XTAL_BIND(NumericArray){
+	Xdef_method(size);
+	Xdef_method(length);
+	Xdef_method(empty);
+	Xdef_method(is_empty);
+	Xdef_method(element_size);
+	Xdef_method(byte_size);
+	Xdef_method(is_view);
+
+	Xdef_method(each);
+	Xdef_method(op_to_array);
+	Xdef_method(to_stream);
+	Xdef_method(read);
+	Xdef_method(write);
+	Xdef_method(assign);
+
+	Xdef_method(to_s);
+	Xdef_method(block_first);
+}
+
+// IntArray, FloatArray, ByteArrayで共通のメソッド
+#define XTAL_BIND_TYPED_ARRAY() \
+	Xdef_method_alias2(op_at, &Self::op_at, Int);\
+	Xdef_method_alias2(op_set_at, &Self::op_set_at, Int);\
+	Xdef_method_alias2(op_call, &Self::op_at, Int);\
+	Xdef_method(slice);\
+		Xparam(n, 1);\
+	Xdef_method(clone);\
+	Xdef_method(fill);\
+	Xdef_method(dot);\
+	Xdef_method(sum);\
+	Xdef_method_alias(min, &Self::min_value);\
+	Xdef_method_alias(max, &Self::max_value);\
+	Xdef_method(scale);\
+	Xdef_method(clamp);\
+	Xdef_method_alias2(op_add, &Self::op_add, Self);\
+	Xdef_method_alias2(op_mul, &Self::op_mul, Self);\
+	Xdef_method_alias2(op_add_assign, &Self::op_add_assign, Self);\
+	Xdef_method_alias2(op_mul_assign, &Self::op_mul_assign, Self);\
+	Xdef_method_alias2(op_add, &Self::op_add_scalar, Int);\
+	Xdef_method_alias2(op_mul, &Self::op_mul_scalar, Int);\
+	Xdef_method_alias2(op_add_assign, &Self::op_add_assign_scalar, Int);\
+	Xdef_method_alias2(op_mul_assign, &Self::op_mul_assign_scalar, Int)
+
+XTAL_PREBIND(IntArray){
+	Xregister(Builtin);
+	Xfinal();
+	Xinherit(NumericArray);
+
+	Xdef_ctor1(int_t);
+		Xparam(size, 0);
+}
+
+XTAL_BIND(IntArray){
+	XTAL_BIND_TYPED_ARRAY();
+}
+
+XTAL_PREBIND(FloatArray){
+	Xregister(Builtin);
+	Xfinal();
+	Xinherit(NumericArray);
+
+	Xdef_ctor1(int_t);
+		Xparam(size, 0);
+}
+
+XTAL_BIND(FloatArray){
+	XTAL_BIND_TYPED_ARRAY();
+	Xdef_method_alias2(op_add, &Self::op_add_scalar, Float);
+	Xdef_method_alias2(op_mul, &Self::op_mul_scalar, Float);
+	Xdef_method_alias2(op_add_assign, &Self::op_add_assign_scalar, Float);
+	Xdef_method_alias2(op_mul_assign, &Self::op_mul_assign_scalar, Float);
+}
+
+XTAL_PREBIND(ByteArray){
+	Xregister(Builtin);
+	Xfinal();
+	Xinherit(NumericArray);
+
+	Xdef_ctor1(int_t);
+		Xparam(size, 0);
+}
+
+XTAL_BIND(ByteArray){
+	XTAL_BIND_TYPED_ARRAY();
+}
+
+#undef XTAL_BIND_TYPED_ARRAY
+
 XTAL_PREBIND(MapIter){
 	Xinherit(Iterator);
 }
@@ -497,6 +603,10 @@ XTAL_PREBIND(Code){
 XTAL_BIND(Code){
 	Xdef_method(filelocal);
 	Xdef_method(inspect);
+	Xdef_method(instantiate);
+	Xdef_method(add_breakpoint);
+		Xparam(cond, undefined);
+	Xdef_method(remove_breakpoint);
 }
 
 XTAL_PREBIND(MembersIter){
@@ -583,6 +693,27 @@ XTAL_BIND(Mutex){
 
 #endif
 
+XTAL_PREBIND(Scheduler){
+	Xregister(Builtin);
+	Xdef_ctor0();
+}
+
+XTAL_BIND(Scheduler){
+	Xdef_method(spawn);
+	Xdef_method(sleep);
+	Xdef_method(wait_readable);
+	Xdef_method(wait_writable);
+	Xdef_method(run);
+	Xdef_method(run_once);
+		Xparam(timeout, -1);
+	Xdef_method(stop);
+	Xdef_method(task_count);
+	Xdef_method(now);
+	Xdef_method(current);
+	Xdef_const(READ);
+	Xdef_const(WRITE);
+}
+
 XTAL_PREBIND(Text){
 	Xregister(Builtin);
 	Xdef_serial_ctor();
@@ -763,6 +894,9 @@ XTAL_BIND(Debug){
 	Xdef_fun_alias(enable_force, &enable_force);	// バインド漏れ修正 by 星くず彼方に
 	Xdef_fun_alias(disable_force, &disable_force);	// バインド漏れ修正 by 星くず彼方に
 	Xdef_fun_alias(is_enabled, &is_enabled);
+	Xdef_fun_alias(enable_debug_compile, &enable_debug_compile);
+	Xdef_fun_alias(disable_debug_compile, &disable_debug_compile);
+	Xdef_fun_alias(is_debug_compile_enabled, &is_debug_compile_enabled);
 
 	Xdef_fun_alias(breakpoint_hook, &breakpoint_hook);
 	Xdef_fun_alias(call_hook, &call_hook);
@@ -770,11 +904,22 @@ XTAL_BIND(Debug){
 	Xdef_fun_alias(throw_hook, &throw_hook);
 	Xdef_fun_alias(assert_hook, &assert_hook);	// バインド漏れ修正 by 星くず彼方に
 
+	Xdef_fun_alias(hook, &hook);
+	Xdef_fun_alias(set_hook, &set_hook);
 	Xdef_fun_alias(set_breakpoint_hook, &set_breakpoint_hook);
 	Xdef_fun_alias(set_call_hook, &set_call_hook);
 	Xdef_fun_alias(set_return_hook, &set_return_hook);
 	Xdef_fun_alias(set_throw_hook, &set_throw_hook);
 	Xdef_fun_alias(set_assert_hook, &set_assert_hook);	// バインド漏れ修正 by 星くず彼方に
+
+	Xdef_fun_alias(start_profile, &start_profile);
+		Xparam(interval, 0.001f);
+		Xparam(capacity, 4096);
+	Xdef_fun_alias(stop_profile, &stop_profile);
+	Xdef_fun_alias(clear_profile, &clear_profile);
+	Xdef_fun_alias(is_profiling, &is_profiling);
+	Xdef_fun_alias(profile_sample_count, &profile_sample_count);
+	Xdef_fun_alias(profile_collapsed, &profile_collapsed);
 }
 
 }
@@ -901,6 +1046,18 @@ XTAL_PREBIND(CompileError){
 	Xinherit(StandardError);
 }
 
+XTAL_PREBIND(MemoryError){
+	Xregister(Builtin);
+	Xxtal_class();
+	Xinherit(StandardError);
+}
+
+XTAL_PREBIND(ExecutionLimitError){
+	Xregister(Builtin);
+	Xxtal_class();
+	Xinherit(StandardError);
+}
+
 namespace filesystem{
 
 XTAL_PREBIND(Filesystem){
@@ -911,6 +1068,9 @@ XTAL_BIND(Filesystem){
 	Xdef_fun_alias(open, &open);
 	Xdef_fun_alias(entries, &entries);
 	Xdef_fun_alias(is_directory, &is_directory);
+	Xdef_fun_alias(mtime, &mtime);
+	Xdef_fun_alias(rename, &rename);
+	Xdef_fun_alias(remove, &remove);
 }
 
 XTAL_PREBIND(Entries){
@@ -1124,6 +1284,7 @@ XTAL_PREBIND(Xpeg){
 
 XTAL_BIND(Xpeg){
 	Xdef_fun_alias(elem, &elem);
+	Xdef(cut, xnew<Element>(Element::TYPE_CUT));
 }
 
 XTAL_PREBIND(XpegOperator){
@@ -1175,6 +1336,7 @@ XTAL_BIND(Element){
 	Xdef_const(TYPE_EMPTY);
 	Xdef_const(TYPE_CAP);
 	Xdef_const(TYPE_DECL);
+	Xdef_const(TYPE_CUT);
 }
 
 XTAL_PREBIND(Executor){
@@ -1189,6 +1351,12 @@ XTAL_BIND(Executor){
 	Xdef_method(parse);
 	Xdef_method(match);
 
+	Xdef_method(enable_packrat);
+		Xparam(capacity, (int_t)Executor::PACKRAT_DEFAULT_CAPACITY);
+	Xdef_method(disable_packrat);
+	Xdef_method(is_packrat);
+	Xdef_method(memo_size);
+
 	Xdef_method(captures);
 	Xdef_method(captures_values);		
 	Xdef_method_alias2(op_at, &Executor::at, String);
@@ -1261,6 +1429,15 @@ XTAL_BIND(Builtin){
 	Xdef_fun_alias(disable_gc, &::xtal::disable_gc);
 	Xdef_fun_alias(enable_gc, &::xtal::enable_gc);
 	Xdef_fun_alias(set_gc_stress, &::xtal::set_gc_stress);
+	Xdef_fun_alias(set_memory_limit, &::xtal::set_memory_limit);
+	Xdef_fun_alias(soft_memory_limit, &::xtal::soft_memory_limit);
+	Xdef_fun_alias(hard_memory_limit, &::xtal::hard_memory_limit);
+	Xdef_fun_alias(set_execution_limit, &::xtal::set_execution_limit);
+	Xdef_fun_alias(clear_execution_limit, &::xtal::clear_execution_limit);
+	Xdef_fun_alias(execution_limit_exceeded, &::xtal::execution_limit_exceeded);
+	Xdef_fun_alias(remaining_execution_ticks, &::xtal::remaining_execution_ticks);
+	Xdef_fun_alias(environment_stats, &::xtal::environment_stats_map);
+	Xdef_fun_alias(reset_environment_stats, &::xtal::reset_environment_stats);
 	//Xdef_fun_alias(clock, &clock_);
 
 	Xdef_fun_alias(print, &builtin_print);
@@ -1272,6 +1449,10 @@ XTAL_BIND(Builtin){
 	
 	Xdef_fun_alias(load, &builtin_load);
 	Xdef_fun_alias(compile_file, &compile_file);
+	Xdef_fun_alias(enable_code_cache, &enable_code_cache);
+		Xparam(dir, XTAL_STRING(""));
+	Xdef_fun_alias(disable_code_cache, &disable_code_cache);
+	Xdef_fun_alias(is_code_cache_enabled, &is_code_cache_enabled);
 	Xdef_fun_alias(compile, &compile);
 		Xparam(source_name, XTAL_STRING(""));
 
@@ -10,6 +10,7 @@ namespace xtal{
 
 extern uint_t member_mutate_count_;
 extern uint_t is_mutate_count_;
+extern uint_t class_version_count_;
 extern uint_t cache_enable_;
 
 void enable_cashe(uint_t);
@@ -59,6 +60,7 @@ struct MemberCacheTable2{
 	struct Unit{
 		uint_t mutate_count;
 		uint_t accessibility;
+		Class* secondary_class;
 		AnyPtr target_class;
 		AnyPtr primary_key;
 		AnyPtr secondary_key;
@@ -94,29 +96,59 @@ struct MemberCacheTable2{
 			unit.primary_key = null;
 			unit.secondary_key = null;
 			unit.member = null;	
+			unit.secondary_class = 0;
 		}
 	}
 };
 
-struct IsCacheTable{
-	struct Unit{
-		uint_t mutate_count;
+/**
+* \internal
+* \brief 送信命令ごとの型フィードバックキャッシュ
+* 命令のアドレスで索引し、その送信で観測したレシーバのクラスと解決したメンバを最大ENTRY_MAX組まで覚える。
+* それより多くの種類のクラスが来た送信は多相過多として印を付け、以降はMemberCacheTableに任せる。
+* メンバが固定長引数のネイティブ関数なら、そのクラスのレシーバで型チェックを通ったことも覚えておき、
+* 次からは引数の型タグだけ確かめて直接呼び出す(VMachine::execute_native_send)。
+*/
+struct SendSiteCacheTable{
+	enum{ CACHE_MAX = 251, ENTRY_MAX = 4 };
+
+	struct Entry{
+		uint_t version;
+		uint_t accessibility;
 		AnyPtr target_class;
-		AnyPtr klass;
-		bool result;
-	};
+		AnyPtr member;
 
-	enum{ CACHE_MAX = 127, CACHE_MASK = CACHE_MAX };
+		// このレシーバのクラスでネイティブ関数の型チェックを通ったか
+		// 継承関係が変わるとやり直すので、確かめたときのis_mutate_count_も覚える
+		bool native_checked;
+		uint_t native_mutate_count;
+	};
 
+	struct Unit{
+		const inst_t* pc;
+		uint_t size;
+		bool megamorphic;
+		AnyPtr primary_key;
+		Entry entries[ENTRY_MAX];
+	};
 
 	Unit table_[CACHE_MAX];
 
 	int_t hit_;
 	int_t miss_;
+	int_t megamorphic_;
+	int_t native_fast_call_;
 
-	IsCacheTable(){
+	SendSiteCacheTable(){
 		hit_ = 0;
 		miss_ = 0;
+		megamorphic_ = 0;
+		native_fast_call_ = 0;
+		for(int_t i=0; i<CACHE_MAX; ++i){
+			table_[i].pc = 0;
+			table_[i].size = 0;
+			table_[i].megamorphic = false;
+		}
 	}
 
 	int_t hit_count(){
@@ -127,38 +159,73 @@ struct IsCacheTable{
 		return miss_;
 	}
 
-	bool cache(const AnyPtr& target_class, const AnyPtr& klass){
-		uint_t itarget_class = XTAL_detail_uvalue(target_class);
-		uint_t iklass = XTAL_detail_uvalue(klass);
+	int_t megamorphic_count(){
+		return megamorphic_;
+	}
+
+	int_t native_fast_call_count(){
+		return native_fast_call_;
+	}
 
-		uint_t hash = (itarget_class>>3) ^ (iklass>>2);
-		Unit& unit = table_[hash % CACHE_MASK];
-		
-		if(cache_enable_ && is_mutate_count_==unit.mutate_count && 
-			XTAL_detail_raweq(target_class, unit.target_class) && 
-			XTAL_detail_raweq(klass, unit.klass)){
+	/**
+	* \brief メンバを取得する
+	* siteを渡すと、メンバを覚えている項目を返す。キャッシュを使わなかったときは0
+	*/
+	const AnyPtr& cache(const inst_t* pc, const AnyPtr& target_class, const IDPtr& primary_key, int_t& accessibility, MemberCacheTable& fallback, Entry** site = 0);
 
-			hit_++;
-			return unit.result;
+	void clear(){
+		for(int_t i=0; i<CACHE_MAX; ++i){
+			reset(table_[i], 0, null);
 		}
-		else{
-			miss_++;
+	}
 
-			bool ret = unchecked_ptr_cast<Class>(target_class)->is_inherited(klass);
+private:
 
-			unit.target_class = target_class;
-			unit.klass = klass;
-			unit.mutate_count = is_mutate_count_;
-			unit.result = ret;
-			return ret;
+	void reset(Unit& unit, const inst_t* pc, const AnyPtr& primary_key){
+		for(uint_t i=0; i<unit.size; ++i){
+			unit.entries[i].target_class = null;
+			unit.entries[i].member = null;
 		}
+		unit.pc = pc;
+		unit.size = 0;
+		unit.megamorphic = false;
+		unit.primary_key = primary_key;
+	}
+};
+
+struct FormatCacheTable{
+	struct Unit{
+		AnyPtr source;
+		AnyPtr format;
+	};
+
+	enum{ CACHE_MAX = 509 };
+
+	Unit table_[CACHE_MAX];
+
+	int_t hit_;
+	int_t miss_;
+
+	FormatCacheTable(){
+		hit_ = 0;
+		miss_ = 0;
+	}
+
+	int_t hit_count(){
+		return hit_;
 	}
 
+	int_t miss_count(){
+		return miss_;
+	}
+
+	const FormatTemplatePtr& cache(const StringPtr& source);
+
 	void clear(){
 		for(int_t i=0; i<CACHE_MAX; ++i){
 			Unit& unit = table_[i];
-			unit.target_class = null;
-			unit.klass = null;
+			unit.source = null;
+			unit.format = null;
 		}
 	}
 };
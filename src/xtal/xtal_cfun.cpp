@@ -22,8 +22,14 @@ NativeMethod::NativeMethod(const param_types_holder_n& pth, const void* val){
 	min_param_count_ = pth.vm ? 0 : pth.param_n;
 	max_param_count_ = (pth.vm || pth.extendable) ? 255 : pth.param_n;
 
-	uint_t data_size = val_size_ + pth.param_n*sizeof(NamedParam);
-	data_ = data_size==0 ? 0 : xmalloc(data_size);
+	// thisと引数の分の型キャッシュ
+	type_cache_size_ = pth.vm ? 1 : pth.param_n+1;
+	if(type_cache_size_>FunctorParam::MAX_ARGS){
+		type_cache_size_ = FunctorParam::MAX_ARGS;
+	}
+
+	uint_t size = data_size();
+	data_ = size==0 ? 0 : xmalloc(size);
 
 	// 関数をコピー
 	std::memcpy(data_, val, val_size_);
@@ -34,6 +40,12 @@ NativeMethod::NativeMethod(const param_types_holder_n& pth, const void* val){
 			new(&params[i]) NamedParam();
 		}
 	}
+
+	TypeCache* caches = type_caches();
+	for(int_t i=0; i<type_cache_size_; ++i){
+		new(&caches[i]) TypeCache();
+		caches[i].mutate_count = 0;
+	}
 }
 
 NativeMethod::~NativeMethod(){
@@ -44,8 +56,20 @@ NativeMethod::~NativeMethod(){
 		params[i].~NamedParam();
 	}
 
-	uint_t data_size = val_size_ + pth.param_n*sizeof(NamedParam);
-	xfree(data_, data_size);
+	TypeCache* caches = type_caches();
+	for(int_t i=0; i<type_cache_size_; ++i){
+		caches[i].~TypeCache();
+	}
+
+	xfree(data_, data_size());
+}
+
+NativeMethod::TypeCache* NativeMethod::type_caches(){
+	return (TypeCache*)((u8*)data_ + val_size_ + pth_->param_n*sizeof(NamedParam));
+}
+
+uint_t NativeMethod::data_size(){
+	return val_size_ + pth_->param_n*sizeof(NamedParam) + type_cache_size_*sizeof(TypeCache);
 }
 
 const NativeFunPtr& NativeMethod::param(int_t i, const IDPtr& key, const AnyPtr& value){
@@ -104,6 +128,11 @@ void NativeMethod::on_visit_members(Visitor& m){
 	for(uint_t i=0; i<pth.param_n; ++i){
 		m & params[i].name & params[i].value;
 	}
+
+	TypeCache* caches = type_caches();
+	for(int_t i=0; i<type_cache_size_; ++i){
+		m & caches[i].klass;
+	}
 }
 
 NativeFun::NativeFun(const param_types_holder_n& pth, const void* val, const AnyPtr& this_)
@@ -120,25 +149,130 @@ void NativeFun::on_rawcall(const VMachinePtr& vm){
 	NativeMethod::on_rawcall(vm);
 }
 
+DoubleDispatchCache::DoubleDispatchCache(){
+	for(int_t i=0; i<CACHE_SIZE; ++i){
+		units_[i].version = 0;
+		units_[i].accessibility = 0;
+	}
+	next_ = 0;
+}
+
+uint_t DoubleDispatchCache::version(const AnyPtr& target_class, const AnyPtr& secondary_key){
+	// 結果は左辺のクラスと右辺のクラスの両方の祖先のメンバに依存するので、新しい方の番号を使う
+	uint_t ret = 0;
+	if(const ClassPtr& cls = ptr_cast<Class>(target_class)){
+		ret = cls->member_version();
+	}
+
+	if(const ClassPtr& cls = ptr_cast<Class>(secondary_key)){
+		uint_t v = cls->member_version();
+		if(ret<v){
+			ret = v;
+		}
+	}
+	return ret;
+}
+
+const AnyPtr& DoubleDispatchCache::cache(const AnyPtr& target_class, const IDPtr& primary_key, const AnyPtr& secondary_key, int_t& accessibility){
+	accessibility = 0;
+
+	if(cache_enable_){
+		for(int_t i=0; i<CACHE_SIZE; ++i){
+			Unit& unit = units_[i];
+			if((XTAL_detail_rawbitxor(target_class, unit.target_class) | 
+				XTAL_detail_rawbitxor(secondary_key, unit.secondary_key))==0){
+				if(unit.version==version(target_class, secondary_key)){
+					accessibility = unit.accessibility;
+					return unit.member;
+				}
+				break;
+			}
+		}
+	}
+
+	if(!XTAL_detail_is_pvalue(target_class)){
+		return undefined;
+	}
+
+	bool nocache = false;
+	const AnyPtr& ret = XTAL_detail_pvalue(target_class)->rawmember(primary_key, secondary_key, true, accessibility, nocache);
+
+	if(XTAL_detail_is_undefined(ret)){
+		return undefined;
+	}
+
+	if(!nocache){
+		// 同じ組の古い結果があればそれを、無ければ古いものから順に置き換える
+		uint_t n = next_;
+		for(uint_t i=0; i<CACHE_SIZE; ++i){
+			if((XTAL_detail_rawbitxor(target_class, units_[i].target_class) | 
+				XTAL_detail_rawbitxor(secondary_key, units_[i].secondary_key))==0){
+				n = i;
+				break;
+			}
+		}
+
+		if(n==next_){
+			next_ = (next_+1) % CACHE_SIZE;
+		}
+
+		// 探索中にメンバが束縛されている可能性があるので、番号は探索の後で取る
+		Unit& unit = units_[n];
+		unit.target_class = target_class;
+		unit.secondary_key = secondary_key;
+		unit.member = ret;
+		unit.version = version(target_class, secondary_key);
+		unit.accessibility = accessibility;
+		return unit.member;
+	}
+
+	return ret;
+}
+
+void DoubleDispatchCache::visit_members(Visitor& m){
+	for(int_t i=0; i<CACHE_SIZE; ++i){
+		m & units_[i].target_class & units_[i].secondary_key & units_[i].member;
+	}
+}
+
 DoubleDispatchMethod::DoubleDispatchMethod(const IDPtr& primary_key)
 	:primary_key_(primary_key){}
 
 void DoubleDispatchMethod::on_rawcall(const VMachinePtr& vm){
+	// 送信として呼ばれた場合はVMが可触性を確かめて直接呼び出すので、ここに来るのはrawsendと同じく可触性を問わない呼び出しだけ
 	if(vm->ordered_arg_count()>0){
-		vm->arg_this()->rawsend(vm, primary_key_, vm->arg(0)->get_class());
+		const AnyPtr& self = vm->arg_this();
+		const ClassPtr& cls = self->get_class();
+		const ClassPtr& secondary_key = vm->arg(0)->get_class();
+		int_t accessibility;
+		const AnyPtr& mem = dispatch(cls, secondary_key, accessibility);
+
+		if(XTAL_detail_is_undefined(mem)){
+			set_unsupported_error(cls, primary_key_, secondary_key, vm);
+			return;
+		}
+
+		mem->rawcall(vm);
 	}
 }
 
+void DoubleDispatchMethod::on_visit_members(Visitor& m){
+	Base::on_visit_members(m);
+	cache_.visit_members(m);
+}
+
 DoubleDispatchFun::DoubleDispatchFun(const ClassPtr& klass, const IDPtr& primary_key)
 	:klass_(klass), primary_key_(primary_key){}
 
 void DoubleDispatchFun::on_rawcall(const VMachinePtr& vm){
-	klass_->member(primary_key_, vm->arg(0)->get_class())->rawcall(vm);
+	int_t accessibility;
+	cache_.cache(klass_, primary_key_, vm->arg(0)->get_class(), accessibility)->rawcall(vm);
 }
 
 void DoubleDispatchFun::on_visit_members(Visitor& m){
 	Base::on_visit_members(m);
 	m & klass_;
+	cache_.visit_members(m);
 }
 
 DoubleDispatchMethodPtr double_dispatch_method(const IDPtr& primary_key){
@@ -121,6 +121,33 @@ public:
 
 	void on_rawcall(const VMachinePtr& vm);
 
+	/**
+	* \brief 引数の数が固定で、省略できる引数を持たないか
+	*/
+	bool is_fixed_arity(){
+		return !pth_->vm && !pth_->extendable && min_param_count_==max_param_count_;
+	}
+
+	const param_types_holder_n& pth(){
+		return *pth_;
+	}
+
+	const void* data(){
+		return data_;
+	}
+
+protected:
+
+	// 引数の型チェックに通ったクラスを覚えておき、次回以降のチェックを省略する
+	struct TypeCache{
+		AnyPtr klass;
+		uint_t mutate_count;
+	};
+
+	TypeCache* type_caches();
+
+	uint_t data_size();
+
 protected:
 	const param_types_holder_n* pth_;
 	void* data_;
@@ -128,6 +155,7 @@ protected:
 	u8 min_param_count_;
 	u8 max_param_count_;
 	u8 val_size_;
+	u8 type_cache_size_;
 };
 
 class NativeFun : public NativeMethod{
@@ -166,6 +194,45 @@ struct ctor : public NativeFunPtr{
 	}
 };
 	
+/**
+* @brief 2重ディスパッチで解決したメソッドを、(左辺のクラス, 右辺のクラス)の組で覚えておくキャッシュ
+*/
+class DoubleDispatchCache{
+public:
+
+	enum{
+		CACHE_SIZE = 4
+	};
+
+	DoubleDispatchCache();
+
+	/**
+	* @brief target_classのprimary_key#secondary_keyメンバを取得する
+	* 見つからない場合はundefinedを返す。accessibilityにはメンバの可触性が入る。
+	* 覚えた結果は、左辺か右辺のクラス、またはその祖先のメンバが変更されると使われなくなる。
+	*/
+	const AnyPtr& cache(const AnyPtr& target_class, const IDPtr& primary_key, const AnyPtr& secondary_key, int_t& accessibility);
+
+	void visit_members(Visitor& m);
+
+private:
+
+	static uint_t version(const AnyPtr& target_class, const AnyPtr& secondary_key);
+
+	struct Unit{
+		AnyPtr target_class;
+		AnyPtr secondary_key;
+		AnyPtr member;
+
+		// 覚えたときの、左辺と右辺のクラスのメンバの状態を表す番号の大きい方
+		uint_t version;
+		int_t accessibility;
+	};
+
+	Unit units_[CACHE_SIZE];
+	uint_t next_;
+};
+
 /**
 * @brief 2重ディスパッチメソッド
 */
@@ -176,8 +243,19 @@ public:
 
 	void on_rawcall(const VMachinePtr& vm);
 
+	void on_visit_members(Visitor& m);
+
+	/**
+	* @brief 左辺のクラスと右辺のクラスから、呼び出すメソッドを解決する
+	* 見つからない場合はundefinedを返す。可触性は調べないので、呼び出す側がaccessibilityを確かめる。
+	*/
+	const AnyPtr& dispatch(const AnyPtr& lhs_class, const AnyPtr& rhs_class, int_t& accessibility){
+		return cache_.cache(lhs_class, primary_key_, rhs_class, accessibility);
+	}
+
 private:
 	IDPtr primary_key_;
+	DoubleDispatchCache cache_;
 };
 
 /**
@@ -195,6 +273,7 @@ public:
 private:
 	AnyPtr klass_;
 	IDPtr primary_key_;
+	DoubleDispatchCache cache_;
 };
 
 /// \name ネイティブ関数をXtalで呼び出せるオブジェクトに変換するための関数群
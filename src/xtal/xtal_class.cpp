@@ -150,10 +150,31 @@ void Class::init(){
 	symbol_data_ = 0;
 	overwrite_now_ = false;
 	default_accessibility_ = KIND_PUBLIC;
+	flat_members_ = 0;
+	flat_members_capa_ = 0;
+	version_ = 0;
+	member_version_ = 0;
+	checked_mutate_count_ = member_mutate_count_-1;
+	ancestors_ = 0;
+	ancestors_capa_ = 0;
+	ancestors_size_ = 0;
+	inherit_version_ = 0;
+	ancestors_version_ = 0;
+	checked_is_count_ = is_mutate_count_-1;
+	flags_ |= FLAG_CLASS;
 	set_initialized_members();
 }
 
 Class::~Class(){
+	clear_flat_members();
+	if(flat_members_){
+		xfree(flat_members_, sizeof(FlatMember)*flat_members_capa_);
+	}
+
+	if(ancestors_){
+		xfree(ancestors_, sizeof(Class*)*ancestors_capa_);
+	}
+
 	int_t count = 0;
 	for(int_t i=0; inherited_classes_[i]; ++i){
 		inherited_classes_[i]->dec_ref_count();
@@ -176,15 +197,6 @@ Class::~Class(){
 
 void Class::overwrite(const ClassPtr& p){
 	overwrite_inner(p);
-
-	for(uint_t i=0; i<alive_object_count(); ++i){
-		AnyPtr obj = alive_object(i);
-		if(XTAL_detail_type(obj)==TYPE_BASE){
-			if(ClassPtr cp = ptr_cast<Class>(obj)){
-				cp->overwrite_now_ = false;
-			}
-		}
-	}
 }
 
 void Class::overwrite_inner(const ClassPtr& p){
@@ -193,7 +205,6 @@ void Class::overwrite_inner(const ClassPtr& p){
 	}
 
 	overwrite_now_ = true;
-	enable_cashe(0);
 
 	if(!is_native() && !p->is_native()){
 		
@@ -218,7 +229,13 @@ void Class::overwrite_inner(const ClassPtr& p){
 			}
 		}
 
-		for(uint_t i=0; i<alive_object_count(); ++i){
+		// インスタンス変数が無く、reloadedも定義されていなければ、インスタンスを探して回る必要はない
+		Node* reloaded = find_node(Xid(reloaded), undefined);
+		bool migrate = reloaded!=0 || 
+			(info() && info()->instance_variable_size!=0) || 
+			(p->info() && p->info()->instance_variable_size!=0);
+
+		for(uint_t i=0; migrate && i<alive_object_count(); ++i){
 			AnyPtr obj = alive_object(i);
 			if(XTAL_detail_type(obj)==TYPE_BASE){
 				if(obj->is(to_smartptr(this))){ // リロードされたクラスのインスタンスを発見した
@@ -232,10 +249,10 @@ void Class::overwrite_inner(const ClassPtr& p){
 					// インスタンスの状態を復帰する
 					obj->load_instance_variables(p, data);
 
-					if(Node* it = find_node(Xid(reloaded), undefined)){
+					if(reloaded){
 						const VMachinePtr& vm = setup_call(0);
 						vm->set_arg_this(obj);
-						member_direct(it->num)->rawcall(vm);
+						member_direct(reloaded->num)->rawcall(vm);
 						vm->cleanup_call();
 					}
 				}
@@ -248,7 +265,6 @@ void Class::overwrite_inner(const ClassPtr& p){
 	}
 
 	overwrite_now_ = false;
-	enable_cashe(1);
 }
 
 void Class::inherit(const ClassPtr& cls){
@@ -273,7 +289,15 @@ void Class::inherit(const ClassPtr& cls){
 
 	inherited_classes_ = classes;
 
+	// 自身の祖先の表には直接追加し、派生クラスには番号の変化で知らせる
+	ancestors_version();
+	insert_ancestors(cls.get());
+	inherit_version_ = ++class_version_count_;
+	ancestors_version_ = inherit_version_;
+
 	invalidate_cache_is();
+	checked_is_count_ = is_mutate_count_;
+	mutate_members();
 }
 
 void Class::inherit_first(const ClassPtr& cls){
@@ -490,7 +514,20 @@ void Class::overwrite_member(const IDPtr& primary_key, const AnyPtr& value, cons
 			if(const ClassPtr& src = ptr_cast<Class>(value)){
 				if(!dest->is_native() && !src->is_native()){
 					dest->overwrite_inner(src);
-					invalidate_cache_member();
+					return;
+				}
+			}
+		}
+
+		// 値が変わらないか、同じ形のメソッドの本体を差し替えられた場合は、キャッシュを無効化しない
+		const AnyPtr& old = member_direct(it->num);
+		if(XTAL_detail_raweq(old, value)){
+			return;
+		}
+
+		if(const MethodPtr& dest = ptr_cast<Method>(old)){
+			if(const MethodPtr& src = ptr_cast<Method>(value)){
+				if(dest->reload_body(src)){
 					return;
 				}
 			}
@@ -498,7 +535,7 @@ void Class::overwrite_member(const IDPtr& primary_key, const AnyPtr& value, cons
 		
 		Frame::set_member_direct(it->num, value);
 		value->set_object_parent(to_smartptr(this));
-		invalidate_cache_member();
+		mutate_members();
 	}
 	else{
 		def_inner(primary_key, value, secondary_key, accessibility);
@@ -518,7 +555,7 @@ void Class::on_def(const IDPtr& primary_key, const AnyPtr& value, const AnyPtr&
 			node->flags |= accessibility;
 			Frame::set_member_direct(node->num, value);
 			value->set_object_parent(to_smartptr(this));
-			invalidate_cache_member();
+			mutate_members();
 		}
 		else{
 			XTAL_SET_EXCEPT(cpp_class<RedefinedError>()->call(Xt2("XRE1011", object, this->object_name(), name, primary_key)));
@@ -529,7 +566,7 @@ void Class::on_def(const IDPtr& primary_key, const AnyPtr& value, const AnyPtr&
 		node->flags |= accessibility;
 		members_.push_back(value);
 		value->set_object_parent(to_smartptr(this));
-		invalidate_cache_member();
+		mutate_members();
 	}
 }
 
@@ -609,23 +646,177 @@ const AnyPtr& Class::find_member(const IDPtr& primary_key, const AnyPtr& seconda
 }
 
 const AnyPtr& Class::on_rawmember(const IDPtr& primary_key, const AnyPtr& secondary_key, bool inherited_too, int_t& accessibility, bool& nocache){
-	const AnyPtr& ret = find_member(primary_key, secondary_key, inherited_too, accessibility, nocache);
+	if(!inherited_too){
+		return find_member(primary_key, secondary_key, false, accessibility, nocache);
+	}
+
+	{
+		const AnyPtr& ret = find_flat_member(primary_key, secondary_key, accessibility);
+		if(!XTAL_detail_is_undefined(ret)){
+			return ret;
+		}
+	}
+
+	const AnyPtr& ret = find_member(primary_key, secondary_key, true, accessibility, nocache);
 	if(!XTAL_detail_is_undefined(ret)){
+		if(!nocache){
+			insert_flat_member(primary_key, secondary_key, ret, accessibility);
+		}
 		return ret;
 	}
 
-	if(inherited_too){
-		return cpp_class<Any>()->find_member(primary_key, secondary_key, false, accessibility, nocache);
+	const AnyPtr& ret2 = cpp_class<Any>()->find_member(primary_key, secondary_key, false, accessibility, nocache);
+	if(!XTAL_detail_is_undefined(ret2) && !nocache){
+		insert_flat_member(primary_key, secondary_key, ret2, accessibility);
+	}
+	return ret2;
+}
+
+void Class::on_visit_members(Visitor& m){
+	Frame::on_visit_members(m);
+	for(Class** pp=inherited_classes_; *pp; ++pp){
+		m & *pp;
+	}
+
+	for(uint_t i=0; i<flat_members_capa_; ++i){
+		FlatMember& fm = flat_members_[i];
+		m & fm.primary_key & fm.secondary_key & fm.member;
+	}
+}
+
+void Class::mutate_members(){
+	version_ = ++class_version_count_;
+	invalidate_cache_member();
+}
+
+void Class::update_member_version(){
+	// 継承が循環していても止まるよう、先に確認済みにしておく
+	checked_mutate_count_ = member_mutate_count_;
+
+	uint_t version = version_;
+	for(int_t i=0; inherited_classes_[i]; ++i){
+		uint_t v = inherited_classes_[i]->member_version();
+		if(version<v){
+			version = v;
+		}
+	}
+
+	const ClassPtr& any = cpp_class<Any>();
+	if(any.get()!=this){
+		uint_t v = any->member_version();
+		if(version<v){
+			version = v;
+		}
+	}
+
+	if(member_version_!=version){
+		member_version_ = version;
+		clear_flat_members();
+
+		// メンバが増えて表が小さくなっていれば、次に登録するときに作り直す
+		if(flat_members_ && flat_members_capa_<members_.size()*2 && flat_members_capa_<FLAT_MEMBERS_MAX){
+			xfree(flat_members_, sizeof(FlatMember)*flat_members_capa_);
+			flat_members_ = 0;
+			flat_members_capa_ = 0;
+		}
+	}
+}
+
+const AnyPtr& Class::find_flat_member(const IDPtr& primary_key, const AnyPtr& secondary_key, int_t& accessibility){
+	// 番号の確認で表が解放されることがあるので、先に確認する
+	uint_t version = member_version();
+	if(!flat_members_ || !cache_enable_){
+		return undefined;
+	}
+
+	uint_t iprimary_key = XTAL_detail_uvalue(primary_key);
+	uint_t hash = iprimary_key ^ (iprimary_key>>24) ^ XTAL_detail_uvalue(secondary_key);
+	for(uint_t i=0; i<FLAT_PROBE_MAX; ++i){
+		FlatMember& fm = flat_members_[(hash+i) & (flat_members_capa_-1)];
+		if((XTAL_detail_rawbitxor(primary_key, fm.primary_key) | XTAL_detail_rawbitxor(secondary_key, fm.secondary_key))==0){
+			// セカンダリキーがクラスの場合は、その祖先のクラスも結果に関わる
+			if(fm.secondary_class && fm.secondary_class->member_version()>fm.version){
+				return undefined;
+			}
+
+			if(fm.version<version){
+				return undefined;
+			}
+
+			accessibility = fm.accessibility;
+			return fm.member;
+		}
 	}
 
 	return undefined;
 }
 
+void Class::insert_flat_member(const IDPtr& primary_key, const AnyPtr& secondary_key, const AnyPtr& member, int_t accessibility){
+	if(!cache_enable_){
+		return;
+	}
+
+	// 探索中にメンバが束縛されている可能性があるので、ここで番号を確認し直す
+	uint_t version = member_version();
+
+	Class* secondary_class = 0;
+	if(!XTAL_detail_is_undefined(secondary_key)){
+		if(const ClassPtr& cls = ptr_cast<Class>(secondary_key)){
+			secondary_class = cls.get();
+			uint_t v = secondary_class->member_version();
+			if(version<v){
+				version = v;
+			}
+		}
+	}
+
+	if(!flat_members_){
+		uint_t capa = FLAT_MEMBERS_MIN;
+		while(capa<members_.size()*2 && capa<FLAT_MEMBERS_MAX){
+			capa *= 2;
+		}
+
+		flat_members_ = (FlatMember*)xmalloc(sizeof(FlatMember)*capa);
+		xmemset(flat_members_, 0, capa);
+		flat_members_capa_ = capa;
+	}
+
+	uint_t iprimary_key = XTAL_detail_uvalue(primary_key);
+	uint_t hash = iprimary_key ^ (iprimary_key>>24) ^ XTAL_detail_uvalue(secondary_key);
+	FlatMember* dest = &flat_members_[hash & (flat_members_capa_-1)];
+	for(uint_t i=0; i<FLAT_PROBE_MAX; ++i){
+		FlatMember& fm = flat_members_[(hash+i) & (flat_members_capa_-1)];
+		if(XTAL_detail_is_null(fm.primary_key) || 
+			(XTAL_detail_rawbitxor(primary_key, fm.primary_key) | XTAL_detail_rawbitxor(secondary_key, fm.secondary_key))==0){
+			dest = &fm;
+			break;
+		}
+	}
+
+	// 空きが見つからなければ、最初の位置を上書きする
+	dest->primary_key = primary_key;
+	dest->secondary_key = secondary_key;
+	dest->member = member;
+	dest->secondary_class = secondary_class;
+	dest->version = version;
+	dest->accessibility = accessibility;
+}
+
+void Class::clear_flat_members(){
+	for(uint_t i=0; i<flat_members_capa_; ++i){
+		FlatMember& fm = flat_members_[i];
+		fm.primary_key = null;
+		fm.secondary_key = null;
+		fm.member = null;
+		fm.secondary_class = 0;
+	}
+}
+
 bool Class::set_member(const IDPtr& primary_key, const AnyPtr& value, const AnyPtr& secondary_key){
 	if(Node* it = find_node(primary_key, secondary_key)){
 		Frame::set_member_direct(it->num, value);
 		value->set_object_parent(to_smartptr(this));
-		invalidate_cache_member();
+		mutate_members();
 		return true;
 	}
 	else{
@@ -640,7 +831,7 @@ void Class::set_member_direct(int_t i, const IDPtr& primary_key, const AnyPtr& v
 	Node* it = insert_node(primary_key, secondary_key, i);
 	it->flags |= accessibility;
 	value->set_object_parent(to_smartptr(this));
-	invalidate_cache_member();
+	mutate_members();
 }
 
 void Class::on_set_object_parent(const ClassPtr& parent){
@@ -763,23 +954,113 @@ void Class::set_option_ctor(uint_t n, const NativeFunPtr& fun){
 }
 
 bool Class::is_inherited(const AnyPtr& v){
-	if(this==XTAL_detail_pvalue(v)){
+	if(!XTAL_detail_is_pvalue(v)){
+		return false;
+	}
+
+	Class* cls = (Class*)XTAL_detail_pvalue(v);
+	if(this==cls){
 		return true;
 	}
 
-	if(XTAL_detail_raweq(v, cpp_class<Any>())){
+	ancestors_version();
+	if(find_ancestor(cls)){
 		return true;
 	}
 
+	return XTAL_detail_raweq(v, cpp_class<Any>());
+}
+
+void Class::update_ancestors_version(){
+	// 継承が循環していても止まるよう、先に確認済みにしておく
+	checked_is_count_ = is_mutate_count_;
+
+	uint_t version = inherit_version_;
 	for(int_t i=0; inherited_classes_[i]; ++i){
-		if(inherited_classes_[i]->is_inherited(v)){
-			return true;
+		uint_t v = inherited_classes_[i]->ancestors_version();
+		if(version<v){
+			version = v;
+		}
+	}
+
+	if(ancestors_version_!=version){
+		ancestors_version_ = version;
+
+		// 祖先の継承関係が変わったので、表を作り直す
+		clear_ancestors();
+		for(int_t i=0; inherited_classes_[i]; ++i){
+			insert_ancestors(inherited_classes_[i]);
 		}
 	}
+}
+
+bool Class::find_ancestor(Class* cls){
+	if(!ancestors_){
+		return false;
+	}
 
+	uint_t mask = ancestors_capa_-1;
+	for(uint_t i=((uint_t)cls>>4) & mask; ancestors_[i]; i=(i+1) & mask){
+		if(ancestors_[i]==cls){
+			return true;
+		}
+	}
 	return false;
 }
 
+void Class::insert_ancestor(Class* cls){
+	if(cls==this || find_ancestor(cls)){
+		return;
+	}
+
+	// 使用率が半分を超えないように広げる
+	if((ancestors_size_+1)*2>ancestors_capa_){
+		Class** old = ancestors_;
+		uint_t old_capa = ancestors_capa_;
+
+		ancestors_capa_ = old_capa==0 ? 8 : old_capa*2;
+		ancestors_ = (Class**)xmalloc(sizeof(Class*)*ancestors_capa_);
+		xmemset(ancestors_, 0, ancestors_capa_);
+		ancestors_size_ = 0;
+
+		for(uint_t i=0; i<old_capa; ++i){
+			if(old[i]){
+				insert_ancestor(old[i]);
+			}
+		}
+
+		if(old){
+			xfree(old, sizeof(Class*)*old_capa);
+		}
+	}
+
+	uint_t mask = ancestors_capa_-1;
+	uint_t i = ((uint_t)cls>>4) & mask;
+	while(ancestors_[i]){
+		i = (i+1) & mask;
+	}
+	ancestors_[i] = cls;
+	ancestors_size_++;
+}
+
+void Class::insert_ancestors(Class* cls){
+	insert_ancestor(cls);
+
+	cls->ancestors_version();
+	for(uint_t i=0; i<cls->ancestors_capa_; ++i){
+		if(cls->ancestors_[i]){
+			insert_ancestor(cls->ancestors_[i]);
+		}
+	}
+}
+
+void Class::clear_ancestors(){
+	if(ancestors_){
+		xmemset(ancestors_, 0, ancestors_capa_);
+	}
+	ancestors_size_ = 0;
+}
+
 bool Class::is_inherited_cpp_class(){
 	if(is_native()){
 		return true;
@@ -835,6 +1116,10 @@ void Class::on_rawcall(const VMachinePtr& vm){
 			XTAL_detail_pvalue(instance)->set_class(to_smartptr(this));
 		}
 
+#ifdef XTAL_ENABLE_VM_STATS
+		environment_->stats_space_.count_instance(to_smartptr(this));
+#endif
+
 		init_instance(instance, vm);
 
 		XTAL_CHECK_EXCEPT(e){ 
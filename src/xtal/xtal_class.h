@@ -9,6 +9,9 @@
 
 namespace xtal{
 
+extern uint_t member_mutate_count_;
+extern uint_t is_mutate_count_;
+
 struct param_types_holder_n;
 
 // インスタンス変数を保持するための型
@@ -480,8 +483,50 @@ public:
 
 	void set_accessibility(int_t accessiblity);
 
+	/**
+	* \brief 継承しているクラスも含めたメンバの状態を表す番号を返す
+	* 自身か祖先のクラスのメンバが変更されると、以前より大きな値に変わる。
+	* 祖先の番号の確認は、どこかのクラスのメンバが変更された後、最初に呼ばれたときだけ行われる。
+	*/
+	uint_t member_version(){
+		if(checked_mutate_count_!=member_mutate_count_){
+			update_member_version();
+		}
+		return member_version_;
+	}
+
+	/**
+	* \brief メンバが変更されたことを知らせ、このクラスと派生クラスのメンバの表を無効にする
+	*/
+	void mutate_members();
+
 private:
 
+	void update_member_version();
+
+	const AnyPtr& find_flat_member(const IDPtr& primary_key, const AnyPtr& secondary_key, int_t& accessibility);
+
+	void insert_flat_member(const IDPtr& primary_key, const AnyPtr& secondary_key, const AnyPtr& member, int_t accessibility);
+
+	void clear_flat_members();
+
+	uint_t ancestors_version(){
+		if(checked_is_count_!=is_mutate_count_){
+			update_ancestors_version();
+		}
+		return ancestors_version_;
+	}
+
+	void update_ancestors_version();
+
+	bool find_ancestor(Class* cls);
+
+	void insert_ancestor(Class* cls);
+
+	void insert_ancestors(Class* cls);
+
+	void clear_ancestors();
+
 	void def_inner(const IDPtr& primary_key, const AnyPtr& value, const AnyPtr& secondary_key, int_t accessibility);
 
 	void init();
@@ -503,12 +548,7 @@ public:
 
 public:
 
-	void on_visit_members(Visitor& m){
-		Frame::on_visit_members(m);
-		for(Class** pp=inherited_classes_; *pp; ++pp){
-			m & *pp;
-		}
-	}
+	void on_visit_members(Visitor& m);
 
 protected:
 	void overwrite_inner(const ClassPtr& p);
@@ -549,6 +589,49 @@ protected:
 
 	int_t default_accessibility_;
 
+	// 継承しているクラスのメンバも含めて、一度引いたメンバを覚えておく表
+	struct FlatMember{
+		AnyPtr primary_key;
+		AnyPtr secondary_key;
+		AnyPtr member;
+		Class* secondary_class;
+		uint_t version;
+		int_t accessibility;
+	};
+
+	enum{
+		FLAT_MEMBERS_MIN = 8,
+		FLAT_MEMBERS_MAX = 1024,
+		FLAT_PROBE_MAX = 4
+	};
+
+	FlatMember* flat_members_;
+	uint_t flat_members_capa_;
+
+	// 自身のメンバが最後に変更されたときの番号
+	uint_t version_;
+
+	// 自身と祖先のクラスのversion_の最大値
+	uint_t member_version_;
+
+	// member_version_を確認したときのmember_mutate_count_
+	uint_t checked_mutate_count_;
+
+	// Anyを除いた全ての祖先のクラスを入れたハッシュ表
+	// 継承関係の判定を、祖先の数によらず一度の探索で済ませるために使う
+	Class** ancestors_;
+	uint_t ancestors_capa_;
+	uint_t ancestors_size_;
+
+	// 自身の継承関係が最後に変更されたときの番号
+	uint_t inherit_version_;
+
+	// 自身と祖先のクラスのinherit_version_の最大値
+	uint_t ancestors_version_;
+
+	// ancestors_version_を確認したときのis_mutate_count_
+	uint_t checked_is_count_;
+
 	friend class InheritedClassesIter;
 };
 
@@ -2,6 +2,11 @@
 #include "xtal_bind.h"
 #include "xtal_macro.h"
 #include "xtal_stringspace.h"
+#include "xtal_details.h"
+
+#if !defined(XTAL_NO_THREAD) && defined(_MSC_VER)
+#	include <intrin.h>
+#endif
 
 namespace xtal{
 
@@ -17,10 +22,385 @@ void Class_inherit(const ClassPtr& cls, const ClassPtr cls2){
 	cls->inherit(cls2);
 }
 
+long atomic_add(volatile long& v, long n){
+#if defined(XTAL_NO_THREAD)
+	return v += n;
+#elif defined(_MSC_VER)
+	return _InterlockedExchangeAdd(&v, n) + n;
+#elif defined(__GNUC__)
+	return __sync_add_and_fetch(&v, n);
+#else
+	return v += n;
+#endif
+}
+
+// C[Ẅ̗̒ŁAe\8oCgEɑĕׂ
+uint_t image_align(uint_t size){
+	return (size+7) & ~(uint_t)7;
+}
+
+template<class T>
+T* image_copy(u8*& p, PODArray<T>& src){
+	T* dest = (T*)p;
+	if(!src.empty()){
+		std::memcpy(dest, src.data(), sizeof(T)*src.size());
+	}
+	p += image_align(sizeof(T)*src.size());
+	return dest;
+}
+
+}
+
+LineNumberTable::LineNumberTable(){
+	data_ = 0;
+	blocks_ = 0;
+	line_index_ = 0;
+	block_count_ = 0;
+	size_ = 0;
+	last_.start_pc = 0;
+	last_.lineno = 0;
+}
+
+uint_t LineNumberTable::decode(uint_t offset, Entry& e) const{
+	uint_t values[2];
+	for(int_t i=0; i<2; ++i){
+		uint_t v = 0;
+		uint_t shift = 0;
+		u8 b;
+		do{
+			b = data_[offset++];
+			v |= (uint_t)(b & 0x7f) << shift;
+			shift += 7;
+		}while(b & 0x80);
+		values[i] = v;
+	}
+
+	e.start_pc += (u32)values[0];
+	e.lineno = (u32)((int_t)e.lineno + (int_t)((values[1]>>1) ^ (0-(values[1]&1))));
+	return offset;
+}
+
+LineNumberTable::Entry LineNumberTable::at(uint_t i) const{
+	XTAL_ASSERT(i<size_);
+	const Block& block = blocks_[i>>BLOCK_SHIFT];
+	Entry e = {block.start_pc, block.lineno};
+	uint_t offset = block.offset;
+	for(uint_t j=0, n=i&BLOCK_MASK; j<n; ++j){
+		offset = decode(offset, e);
+	}
+	return e;
+}
+
+int_t LineNumberTable::find_pc(uint_t pc, Entry* entry) const{
+	if(size_==0){
+		return -1;
+	}
+
+	// pcȉ̈ʒun܂Ō̃ubNT
+	uint_t lo = 0, hi = block_count_;
+	while(hi-lo>1){
+		uint_t mid = (lo+hi)/2;
+		if(blocks_[mid].start_pc<=pc){
+			lo = mid;
+		}
+		else{
+			hi = mid;
+		}
+	}
+
+	const Block& block = blocks_[lo];
+	Entry e = {block.start_pc, block.lineno};
+	uint_t index = lo<<BLOCK_SHIFT;
+	uint_t offset = block.offset;
+	uint_t last = index+BLOCK_SIZE<size_ ? index+BLOCK_SIZE : size_;
+	while(index+1<last){
+		Entry n = e;
+		uint_t next_offset = decode(offset, n);
+		if(n.start_pc>pc){
+			break;
+		}
+		e = n;
+		offset = next_offset;
+		++index;
+	}
+
+	if(entry){
+		*entry = e;
+	}
+	return (int_t)index;
+}
+
+int_t LineNumberTable::find_lineno(uint_t lineno) const{
+	if(size_==0 || !line_index_){
+		return -1;
+	}
+
+	const LineIndex* begin = line_index_;
+	const LineIndex* end = begin+size_;
+	const LineIndex* it = std::lower_bound(begin, end, lineno, LineIndexCmp());
+	return it==end ? -1 : (int_t)it->index;
+}
+
+void LineNumberTable::begin(Cursor& c) const{
+	c.index = (uint_t)-1;
+	c.offset = 0;
+	c.entry.start_pc = 0;
+	c.entry.lineno = 0;
+}
+
+bool LineNumberTable::next(Cursor& c) const{
+	uint_t i = c.index+1;
+	if(i>=size_){
+		return false;
+	}
+
+	if((i&BLOCK_MASK)==0){
+		const Block& block = blocks_[i>>BLOCK_SHIFT];
+		c.entry.start_pc = block.start_pc;
+		c.entry.lineno = block.lineno;
+		c.offset = block.offset;
+	}
+	else{
+		c.offset = decode(c.offset, c.entry);
+	}
+
+	c.index = i;
+	return true;
+}
+
+LineNumberTableBuilder::LineNumberTableBuilder(){
+	size_ = 0;
+	last_.start_pc = 0;
+	last_.lineno = 0;
+	prev_ = last_;
+	prev_data_size_ = 0;
+}
+
+void LineNumberTableBuilder::push_back(uint_t start_pc, uint_t lineno){
+	prev_ = last_;
+	prev_data_size_ = data_.size();
+
+	if((size_&LineNumberTable::BLOCK_MASK)==0){
+		LineNumberTable::Block block = {(u32)start_pc, (u32)lineno, (u32)data_.size()};
+		blocks_.push_back(block);
+	}
+	else{
+		// ʒu̍͏ɐAsԍ̍zigzagĂA7bitϒŏ
+		int_t dline = (int_t)lineno - (int_t)last_.lineno;
+		uint_t values[2] = {start_pc - last_.start_pc, (uint_t)((dline<<1) ^ (dline>>(sizeof(int_t)*8-1)))};
+		for(int_t i=0; i<2; ++i){
+			uint_t v = values[i];
+			while(v>=0x80){
+				data_.push_back((u8)(v | 0x80));
+				v >>= 7;
+			}
+			data_.push_back((u8)v);
+		}
+	}
+
+	last_.start_pc = (u32)start_pc;
+	last_.lineno = (u32)lineno;
+	size_++;
+}
+
+void LineNumberTableBuilder::pop_back(){
+	XTAL_ASSERT(size_!=0);
+	size_--;
+	if((size_&LineNumberTable::BLOCK_MASK)==0){
+		blocks_.pop_back();
+	}
+	else{
+		data_.downsize(data_.size()-prev_data_size_);
+	}
+	last_ = prev_;
+}
+
+void LineNumberTableBuilder::clear(){
+	data_.destroy();
+	blocks_.destroy();
+	size_ = 0;
+	last_.start_pc = 0;
+	last_.lineno = 0;
+	prev_ = last_;
+	prev_data_size_ = 0;
+}
+
+LineNumberTable LineNumberTableBuilder::table(){
+	LineNumberTable ret;
+	ret.data_ = data_.data();
+	ret.blocks_ = blocks_.data();
+	ret.block_count_ = blocks_.size();
+	ret.size_ = size_;
+	ret.last_ = last_;
+	return ret;
+}
+
+uint_t LineNumberTableBuilder::byte_size() const{
+	return sizeof(LineNumberTable::Block)*blocks_.size() + sizeof(LineNumberTable::LineIndex)*size_ + data_.size();
+}
+
+LineNumberTable LineNumberTableBuilder::write(void* dest){
+	LineNumberTable::Block* blocks = (LineNumberTable::Block*)dest;
+	LineNumberTable::LineIndex* line_index = (LineNumberTable::LineIndex*)(blocks + blocks_.size());
+	u8* data = (u8*)(line_index + size_);
+
+	if(!blocks_.empty()){
+		std::memcpy(blocks, blocks_.data(), sizeof(LineNumberTable::Block)*blocks_.size());
+	}
+
+	if(!data_.empty()){
+		std::memcpy(data, data_.data(), data_.size());
+	}
+
+	LineNumberTable ret = table();
+	ret.data_ = data;
+	ret.blocks_ = blocks;
+
+	LineNumberTable::Cursor c;
+	ret.begin(c);
+	while(ret.next(c)){
+		line_index[c.index].lineno = c.entry.lineno;
+		line_index[c.index].index = (u32)c.index;
+	}
+
+	if(size_!=0){
+		std::sort(line_index, line_index+size_, LineNumberTable::LineIndexCmp());
+	}
+
+	ret.line_index_ = line_index;
+	return ret;
+}
+
+CodeImage* CodeImage::create(Code* code){
+	PODArray<FunRange> fun_ranges;
+	code->build_fun_range_table(fun_ranges);
+
+	uint_t size = image_align(sizeof(CodeImage));
+	size += image_align(sizeof(inst_t)*code->code_.size());
+	size += image_align(sizeof(ScopeInfo)*code->scope_info_table_.size());
+	size += image_align(sizeof(ClassInfo)*code->class_info_table_.size());
+	size += image_align(sizeof(FunInfo)*code->xfun_info_table_.size());
+	size += image_align(sizeof(ExceptInfo)*code->except_info_table_.size());
+	size += image_align(sizeof(FunRange)*fun_ranges.size());
+	size += image_align(sizeof(ImplcitInfo)*code->implicit_table_.size());
+	size += image_align(sizeof(u32)*code->statement_table_.size());
+	size += image_align(code->lineno_table_.byte_size());
+
+	// 쐬sɔjĂł悤AsAllocatorLib͎gȂ
+	u8* block = (u8*)std::malloc(size);
+	if(!block){
+		environment_->setting_.allocator_lib->out_of_memory();
+		return 0;
+	}
+
+	CodeImage* p = new(block) CodeImage();
+	p->byte_size_ = size;
+	p->ref_count_ = 1;
+
+	u8* it = block + image_align(sizeof(CodeImage));
+
+	p->code_size_ = code->code_.size();
+	p->code_ = image_copy(it, code->code_);
+
+	p->scope_info_size_ = code->scope_info_table_.size();
+	p->scope_infos_ = image_copy(it, code->scope_info_table_);
+
+	p->class_info_size_ = code->class_info_table_.size();
+	p->class_infos_ = image_copy(it, code->class_info_table_);
+
+	p->fun_info_size_ = code->xfun_info_table_.size();
+	p->fun_infos_ = image_copy(it, code->xfun_info_table_);
+
+	p->except_info_size_ = code->except_info_table_.size();
+	p->except_infos_ = image_copy(it, code->except_info_table_);
+
+	p->fun_range_size_ = fun_ranges.size();
+	p->fun_ranges_ = image_copy(it, fun_ranges);
+
+	p->implicit_size_ = code->implicit_table_.size();
+	p->implicits_ = image_copy(it, code->implicit_table_);
+
+	p->statement_size_ = code->statement_table_.size();
+	p->statements_ = image_copy(it, code->statement_table_);
+
+	p->lineno_table_ = code->lineno_table_.write(it);
+
+	p->once_size_ = code->once_table_.size();
+	p->constants_ = 0;
+	p->constants_size_ = 0;
+	return p;
+}
+
+void CodeImage::set_constants(const void* data, uint_t size){
+	constants_ = std::malloc(size);
+	if(!constants_){
+		environment_->setting_.allocator_lib->out_of_memory();
+		return;
+	}
+
+	std::memcpy(constants_, data, size);
+	constants_size_ = size;
+}
+
+void CodeImage::inc_ref_count(){
+	atomic_add(ref_count_, 1);
+}
+
+void CodeImage::dec_ref_count(){
+	if(atomic_add(ref_count_, -1)==0){
+		if(constants_){
+			std::free(constants_);
+		}
+
+		this->~CodeImage();
+		std::free(this);
+	}
+}
+
+CodePtr CodeImage::instantiate(){
+	if(!constants_){
+		set_runtime_error(Xt("XRE1009"));
+		return nul<Code>();
+	}
+
+	ArrayPtr constants = ptr_cast<Array>(xnew<PointerStream>(constants_, constants_size_)->deserialize());
+	XTAL_CHECK_EXCEPT(e){
+		return nul<Code>();
+	}
+
+	CodePtr p = xnew<Code>();
+	p->source_file_name_ = ptr_cast<String>(constants->at(0));
+
+	const ArrayPtr& identifiers = ptr_cast<Array>(constants->at(1));
+	p->identifier_table_.resize(identifiers->size());
+	for(uint_t i=0; i<identifiers->size(); ++i){
+		p->identifier_table_.set_at(i, identifiers->at(i));
+	}
+
+	const ArrayPtr& values = ptr_cast<Array>(constants->at(2));
+	p->value_table_.resize(values->size());
+	for(uint_t i=0; i<values->size(); ++i){
+		p->value_table_.set_at(i, values->at(i));
+	}
+
+	p->once_table_.resize(once_size_);
+	for(uint_t i=0; i<once_size_; ++i){
+		p->once_table_.set_at(i, undefined);
+	}
+
+	inc_ref_count();
+	p->image_ = this;
+	p->bytecode_ = code_;
+	p->generated();
+	return p;
 }
 
 Code::Code(){
+	image_ = 0;
+	bytecode_ = 0;
 	enable_redefine_ = false;
+	line_trap_ = false;
+	registered_ = false;
 
 	set_singleton();
 	set_object_temporary_name(XTAL_DEFINED_ID(filelocal));
@@ -28,7 +408,20 @@ Code::Code(){
 }
 
 Code::~Code(){
+	if(registered_){
+		PODArray<Code*>& codes = environment_->code_list_;
+		for(uint_t i=0, sz=codes.size(); i<sz; ++i){
+			if(codes[i]==this){
+				codes[i] = codes.back();
+				codes.pop_back();
+				break;
+			}
+		}
+	}
 
+	if(image_){
+		image_->dec_ref_count();
+	}
 }
 
 void Code::reload(const CodePtr& new_code){
@@ -41,36 +434,98 @@ void Code::reload(const CodePtr& new_code){
 
 	overwrite(new_code);
 
-	code_ = new_code->code_;
+	new_code->image_->inc_ref_count();
+	if(image_){
+		image_->dec_ref_count();
+	}
+	image_ = new_code->image_;
+	bytecode_ = new_code->bytecode_;
+	private_code_ = new_code->private_code_;
+	if(!private_code_.empty()){
+		bytecode_ = private_code_.data();
+	}
 
 	identifier_table_ = new_code->identifier_table_;
 	value_table_ = new_code->value_table_;
 	once_table_ = new_code->once_table_;
-	
+
 	source_file_name_ = new_code->source_file_name_;
 	first_fun_ = new_code->first_fun_;
 
 	breakpoint_cond_map_ = new_code->breakpoint_cond_map_;
 
-	xfun_info_table_ = new_code->xfun_info_table_;
-	scope_info_table_ = new_code->scope_info_table_;
-	class_info_table_ = new_code->class_info_table_;
-	except_info_table_ = new_code->except_info_table_;
+	trap_table_ = new_code->trap_table_;
+
+	set_line_trap(debug::is_line_trap_enabled());
+}
+
+CodeImage* Code::image(){
+	if(!image_->constants_){
+		ArrayPtr identifiers = XNew<Array>(identifier_table_.size());
+		for(uint_t i=0; i<identifier_table_.size(); ++i){
+			identifiers->set_at(i, identifier_table_.at(i));
+		}
+
+		ArrayPtr values = XNew<Array>(value_table_.size());
+		for(uint_t i=0; i<value_table_.size(); ++i){
+			values->set_at(i, value_table_.at(i));
+		}
+
+		ArrayPtr constants = XNew<Array>(3);
+		constants->set_at(0, source_file_name_);
+		constants->set_at(1, identifiers);
+		constants->set_at(2, values);
 
-	lineno_table_ = new_code->lineno_table_;
+		MemoryStreamPtr ms = xnew<MemoryStream>();
+		ms->serialize(constants);
+		XTAL_CHECK_EXCEPT(e){
+			return 0;
+		}
 
-	implicit_table_ = new_code->implicit_table_;
+		image_->set_constants(ms->data(), ms->size());
+	}
+	return image_;
+}
+
+CodePtr Code::instantiate(){
+	CodeImage* img = image();
+	if(!img){
+		return nul<Code>();
+	}
+	return img->instantiate();
 }
 
 void Code::generated(){
-	set_code(to_smartptr(this));
-	if(scope_info_table_.size()>1){
-		ClassInfo cinfo;
-		(ScopeInfo&)cinfo = scope_info_table_[1];
-		class_info_table_.push_back(cinfo);
+	if(!image_){
+		if(scope_info_table_.size()>1){
+			ClassInfo cinfo;
+			(ScopeInfo&)cinfo = scope_info_table_[1];
+			class_info_table_.push_back(cinfo);
+		}
+
+		image_ = CodeImage::create(this);
+		bytecode_ = image_->code_;
+
+		code_.destroy();
+		xfun_info_table_.destroy();
+		scope_info_table_.destroy();
+		class_info_table_.destroy();
+		except_info_table_.destroy();
+		lineno_table_.clear();
+		implicit_table_.destroy();
+		statement_table_.destroy();
+	}
+
+	// ̐擪L^Ă΁Agbv߂𖄂ߍ߂悤ɎsOɃoCgR[h𕡐Ă
+	if(image_->statement_size_!=0){
+		writable_bytecode();
+	}
 
-		set_info((ClassInfo*)&class_info_table_.back());
-		resize_member_direct(class_info_table_.back().variable_size);
+	set_code(to_smartptr(this));
+	if(image_->scope_info_size_>1){
+		ClassInfo* info = &image_->class_infos_[image_->class_info_size_-1];
+		set_info(info);
+		resize_member_direct(info->variable_size);
 
 		make_members_force(Frame::FLAG_NOCACHE);
 	}
@@ -83,14 +538,118 @@ void Code::generated(){
 		def(XTAL_DEFINED_ID(filelocal), to_smartptr(this));
 	}
 
-	first_fun_ = XNew<Method>(nul<Frame>(), to_smartptr(this), &xfun_info_table_[0]);
+	first_fun_ = XNew<Method>(nul<Frame>(), to_smartptr(this), &image_->fun_infos_[0]);
+
+	if(!registered_){
+		environment_->code_list_.push_back(this);
+		registered_ = true;
+	}
+
+	if(debug::is_line_trap_enabled()){
+		set_line_trap(true);
+	}
+}
+
+inst_t* Code::writable_bytecode(){
+	if(private_code_.empty()){
+		private_code_.resize(image_->code_size_);
+		std::memcpy(private_code_.data(), image_->code_, sizeof(inst_t)*image_->code_size_);
+		bytecode_ = private_code_.data();
+	}
+	return private_code_.data();
+}
+
+Code::TrapInfo& Code::trap_info(uint_t i){
+	uint_t size = trap_table_.size();
+	if(size<image_->statement_size_){
+		trap_table_.resize(image_->statement_size_);
+		for(uint_t j=size; j<trap_table_.size(); ++j){
+			trap_table_[j].inst = 0;
+			trap_table_[j].flags = 0;
+		}
+	}
+	return trap_table_[i];
+}
+
+int_t Code::trap_index(const inst_t* p){
+	if(image_->statement_size_==0 || p<bytecode_data() || p>=bytecode_data()+bytecode_size()){
+		return -1;
+	}
+
+	u32 pc = (u32)(p-bytecode_data());
+	const u32* first = image_->statements_;
+	const u32* last = first + image_->statement_size_;
+	const u32* it = std::lower_bound(first, last, pc);
+	if(it==last || *it!=pc){
+		return -1;
+	}
+	return (int_t)(it-first);
+}
+
+void Code::update_trap(uint_t i, uint_t start_pc){
+	if(start_pc>=image_->code_size_){
+		return;
+	}
+
+	TrapInfo& trap = trap_info(i);
+	if(trap.flags&(TRAP_BREAKPOINT|TRAP_LINE)){
+		if(!(trap.flags&TRAP_PATCHED)){
+			// ߃R[h̕uAIyh͂̂܂܎c
+			inst_t& inst = writable_bytecode()[start_pc];
+			trap.inst = inst;
+			trap.flags |= TRAP_PATCHED;
+			inst = (inst_t)((inst & ~0xff) | InstBreakPoint::NUMBER);
+		}
+	}
+	else if(trap.flags&TRAP_PATCHED){
+		writable_bytecode()[start_pc] = trap.inst;
+		trap.flags &= ~TRAP_PATCHED;
+	}
+}
+
+void Code::set_line_trap(bool b){
+	line_trap_ = b;
+	if(!b && trap_table_.empty()){
+		return;
+	}
+
+	for(uint_t i=0; i<image_->statement_size_; ++i){
+		TrapInfo& trap = trap_info(i);
+		if(b){
+			trap.flags |= TRAP_LINE;
+		}
+		else{
+			trap.flags &= ~TRAP_LINE;
+		}
+		update_trap(i, image_->statements_[i]);
+	}
+}
+
+inst_t Code::original_inst(const inst_t* pc){
+	if(XTAL_opc(pc)!=InstBreakPoint::NUMBER){
+		return *pc;
+	}
+
+	int_t i = trap_index(pc);
+	if(i>=0 && (uint_t)i<trap_table_.size() && (trap_table_[i].flags&TRAP_PATCHED)){
+		return trap_table_[i].inst;
+	}
+
+	// ȑÕoCgR[hɎcĂu[N|CǵAȂ߂ƂĈ
+	return InstLine::NUMBER;
+}
+
+bool Code::is_breakpoint(const inst_t* pc){
+	int_t i = trap_index(pc);
+	return i>=0 && (uint_t)i<trap_table_.size() && (trap_table_[i].flags&TRAP_BREAKPOINT);
 }
 
 void Code::add_breakpoint(int_t lineno, const AnyPtr& cond){
-	for(uint_t i=0, sz=lineno_table_.size(); i<sz; ++i){
-		LineNumberInfo& info = lineno_table_[i];
-		if(info.lineno==lineno && (code_[info.start_pc] == InstLine::NUMBER || code_[info.start_pc] == InstBreakPoint::NUMBER)){
-			code_[info.start_pc] = InstBreakPoint::NUMBER;
+	for(uint_t i=0; i<image_->statement_size_; ++i){
+		uint_t start_pc = image_->statements_[i];
+		if(compliant_lineno(bytecode_data()+start_pc)==lineno){
+			trap_info(i).flags |= TRAP_BREAKPOINT;
+			update_trap(i, start_pc);
 
 			if(cond){
 				if(!breakpoint_cond_map_){
@@ -103,10 +662,11 @@ void Code::add_breakpoint(int_t lineno, const AnyPtr& cond){
 }
 
 void Code::remove_breakpoint(int_t lineno){
-	for(uint_t i=0, sz=lineno_table_.size(); i<sz; ++i){
-		LineNumberInfo& info = lineno_table_[i];
-		if(info.lineno==lineno && code_[info.start_pc] == InstBreakPoint::NUMBER){
-			code_[info.start_pc] = InstLine::NUMBER;
+	for(uint_t i=0; i<trap_table_.size(); ++i){
+		uint_t start_pc = image_->statements_[i];
+		if((trap_table_[i].flags&TRAP_BREAKPOINT) && compliant_lineno(bytecode_data()+start_pc)==lineno){
+			trap_table_[i].flags &= ~TRAP_BREAKPOINT;
+			update_trap(i, start_pc);
 
 			if(breakpoint_cond_map_){
 				breakpoint_cond_map_->erase(lineno);
@@ -123,19 +683,38 @@ CodePtr Code::breakpoint_cond(int_t lineno){
 }
 
 bool Code::set_lineno_info(uint_t line){
-	if(lineno_table_.empty()){
-
-	}
-	else{
-		if(lineno_table_.back().lineno==line || lineno_table_.back().start_pc==(u32)code_.size()){
+	if(!lineno_table_.empty()){
+		if(lineno_table_.back().lineno==line){
 			return false;
 		}
+
+		// O̍s߂ĂȂ΁Äʒu͂̍ŝ̂Ƃ
+		if(lineno_table_.back().start_pc==(u32)code_.size()){
+			lineno_table_.pop_back();
+			if(!lineno_table_.empty() && lineno_table_.back().lineno==line){
+				// O̍s̑ɂȂ̂ŁÄʒu͕̐擪ł͂ȂȂ
+				if(!statement_table_.empty() && statement_table_.back()==(u32)code_.size()){
+					statement_table_.pop_back();
+				}
+				return false;
+			}
+		}
 	}
 
-	LineNumberInfo lnt = {(u32)code_.size(), (u16)line};
-	lineno_table_.push_back(lnt);
+	lineno_table_.push_back(code_.size(), line);
 	return true;
 }
+
+void Code::set_statement_start(){
+	u32 pc = (u32)code_.size();
+	if(lineno_table_.empty() || lineno_table_.back().start_pc!=pc){
+		return;
+	}
+
+	if(statement_table_.empty() || statement_table_.back()!=pc){
+		statement_table_.push_back(pc);
+	}
+}
 	
 int_t Code::final_lineno(){
 	if(lineno_table_.empty()){
@@ -145,48 +724,89 @@ int_t Code::final_lineno(){
 }
 
 int_t Code::compliant_lineno(const inst_t* p){
-	if(LineNumberInfo* lni = compliant_lineno_info(p)){
-		return lni->lineno;
+	LineNumberTable::Entry e;
+	if(image_->lineno_table_.find_pc((uint_t)(p-bytecode_data()), &e)>=0){
+		return e.lineno;
 	}
 	return 0;
 }
 
 const inst_t* Code::compliant_pc(int_t lineno){
-	int_t nearv = 0xffffff;
-	int_t neari = -1;
-	for(uint_t i=0; i<lineno_table_.size(); ++i){
-		int_t diff = lineno_table_[i].lineno - lineno;
-		if(diff>=0 && diff<nearv){
-			nearv = diff;
-			neari = i;
-		}
+	const LineNumberTable& lines = image_->lineno_table_;
+	int_t i = lines.find_lineno(lineno<0 ? 0 : lineno);
+	return i<0 ? 0 : bytecode_data() + lines.at(i).start_pc;
+}
+
+FunInfo* Code::compliant_fun_info(const inst_t* p){
+	if(image_->fun_range_size_==0 || p<bytecode_data() || p>=bytecode_data()+bytecode_size()){
+		return 0;
 	}
 
-	return neari<0 ? 0 : bytecode_data() + lineno_table_[neari].start_pc;
+	const CodeImage::FunRange* begin = image_->fun_ranges_;
+	const CodeImage::FunRange* end = begin+image_->fun_range_size_;
+	const CodeImage::FunRange* it = std::upper_bound(begin, end, (uint_t)(p-bytecode_data()), CodeImage::FunRangeCmp());
+	if(it==begin){
+		return 0;
+	}
+	--it;
+	return &image_->fun_infos_[it->fun_index];
 }
 
-Code::LineNumberInfo* Code::compliant_lineno_info(const inst_t* p){
-	if(!lineno_table_.empty()){
-		LineNumberInfo* begin = &lineno_table_[0];
-		LineNumberInfo* end = begin+lineno_table_.size();
-		LineNumberInfo* it=
-			std::upper_bound(
-				begin,
-				end,
-				static_cast<int_t>(p-bytecode_data()),
-				LineNumberCmp()
-			);
-
-		if(it!=end){
-			if(it==begin){
-				return &*it;
+StringPtr Code::fun_name(FunInfo* info, const MethodPtr& fun){
+	if(info && info!=fun->info() && info->name_number!=0){
+		return identifier(info->name_number);
+	}
+	return fun->object_name();
+}
+
+void Code::build_fun_range_table(PODArray<CodeImage::FunRange>& table){
+	table.clear();
+	if(xfun_info_table_.empty()){
+		return;
+	}
+
+	// ֐͈̔͂InstMakeFun̒ォ炻̔ѐ܂łŁAqɂȂĂB
+	// xfun_info_table_͊Jnʒȕɕł̂ŁA͂ł֐X^bNɐς݂ȂԂ؂o
+	PODArray<CodeImage::FunRange> stack;
+	CodeImage::FunRange top = {(u32)code_.size(), 0};
+	CodeImage::FunRange first = {0, 0};
+	table.push_back(first);
+
+	for(uint_t i=1, sz=xfun_info_table_.size(); i<=sz; ++i){
+		uint_t begin = i<sz ? xfun_info_table_[i].pc : (uint_t)code_.size();
+		while(!stack.empty() && top.start_pc<=begin){
+			uint_t end = top.start_pc;
+			top = stack.back();
+			stack.pop_back();
+
+			CodeImage::FunRange range = {(u32)end, top.fun_index};
+			if(table.back().start_pc==end){
+				table[table.size()-1] = range;
+			}
+			else{
+				table.push_back(range);
 			}
-			--it;
-			return &*it;
 		}
-	}
 
-	return 0;
+		if(i==sz){
+			break;
+		}
+
+		const inst_t* make_fun = code_.data() + begin - InstMakeFun::ISIZE;
+		uint_t end = (uint_t)(make_fun - code_.data()) + InstMakeFun::address(make_fun);
+		
+		stack.push_back(top);
+		top.start_pc = (u32)end;
+		top.fun_index = (u32)i;
+
+		CodeImage::FunRange range = {(u32)begin, (u32)i};
+		if(table.back().start_pc==begin){
+			table[table.size()-1] = range;
+		}
+		else{
+			table.push_back(range);
+		}
+	}
 }
 
 void Code::on_rawcall(const VMachinePtr& vm){
@@ -238,16 +858,16 @@ IDPtr Code::find_near_variable(const IDPtr& primary_key){
 		pick = klass->find_near_member2(primary_key, undefined, minv);
 	}
 
-	for(uint_t i=0; i<xfun_info_table_.size(); ++i){
-		find_near_variable_inner(primary_key, xfun_info_table_[i], pick, minv);
+	for(uint_t i=0; i<image_->fun_info_size_; ++i){
+		find_near_variable_inner(primary_key, image_->fun_infos_[i], pick, minv);
 	}
 
-	for(uint_t i=0; i<scope_info_table_.size(); ++i){
-		find_near_variable_inner(primary_key, scope_info_table_[i], pick, minv);
+	for(uint_t i=0; i<image_->scope_info_size_; ++i){
+		find_near_variable_inner(primary_key, image_->scope_infos_[i], pick, minv);
 	}
 
-	for(uint_t i=0; i<class_info_table_.size(); ++i){
-		find_near_variable_inner(primary_key, class_info_table_[i], pick, minv);
+	for(uint_t i=0; i<image_->class_info_size_; ++i){
+		find_near_variable_inner(primary_key, image_->class_infos_[i], pick, minv);
 	}
 
 	return pick;
@@ -255,15 +875,15 @@ IDPtr Code::find_near_variable(const IDPtr& primary_key){
 
 void Code::check_implicit_lookup(){
 	ArrayPtr ary;
-	for(uint_t i=0; i<implicit_table_.size(); ++i){
-		const IDPtr& id = unchecked_ptr_cast<ID>(identifier_table_.at(implicit_table_[i].id));
+	for(uint_t i=0; i<image_->implicit_size_; ++i){
+		const IDPtr& id = unchecked_ptr_cast<ID>(identifier_table_.at(image_->implicits_[i].id));
 		const AnyPtr& ret = member(id);
 		if(XTAL_detail_raweq(undefined, ret)){
 			if(!ary){
 				ary = XNew<Array>();
 			}
 
-			ary->push_back(Xf2("%s(%d)", 0, filelocal_unsupported_error(to_smartptr(this), id), 1, implicit_table_[i].lineno));
+			ary->push_back(Xf2("%s(%d)", 0, filelocal_unsupported_error(to_smartptr(this), id), 1, image_->implicits_[i].lineno));
 		}
 	}
 
@@ -9,12 +9,335 @@
 
 namespace xtal{
 
+class AllocatorLib;
+
+/**
+* \brief バイトコード位置と行番号の対応表
+* 各行の開始位置と行番号を、直前の行からの差分として可変長で符号化して保持する。
+* BLOCK_SIZE行ごとに置いたチェックポイントを二分探索し、その後はブロック内の差分だけを復号して引く。
+* 表の領域は持たず、LineNumberTableBuilderが書き出した領域を参照する。
+*/
+class LineNumberTable{
+public:
+
+	struct Entry{
+		u32 start_pc;
+		u32 lineno;
+	};
+
+	/**
+	* \brief 行を順番に復号するためのカーソル
+	* nextが成功した後、entryはindex番目の行を表す。
+	*/
+	struct Cursor{
+		uint_t index;
+		uint_t offset;
+		Entry entry;
+	};
+
+	enum{
+		BLOCK_SHIFT = 4,
+		BLOCK_SIZE = 1<<BLOCK_SHIFT,
+		BLOCK_MASK = BLOCK_SIZE-1
+	};
+
+	LineNumberTable();
+
+	uint_t size() const{
+		return size_;
+	}
+
+	bool empty() const{
+		return size_==0;
+	}
+
+	/**
+	* \brief 最後の行を返す
+	*/
+	const Entry& back() const{
+		return last_;
+	}
+
+	/**
+	* \brief i番目の行を返す
+	*/
+	Entry at(uint_t i) const;
+
+	/**
+	* \brief pcを含む行の番号を返す
+	* pcが最初の行より前にある場合は0を返す。表が空の場合は-1を返す。
+	*/
+	int_t find_pc(uint_t pc, Entry* entry = 0) const;
+
+	/**
+	* \brief lineno以上で最も近い行番号を持つ行の番号を返す
+	* 該当する行が複数ある場合は、最も前にあるものを返す。無い場合は-1を返す。
+	* 行番号順の索引を持たない表では常に-1を返す。
+	*/
+	int_t find_lineno(uint_t lineno) const;
+
+	/**
+	* \brief 先頭の行の手前を指すようにカーソルを初期化する
+	*/
+	void begin(Cursor& c) const;
+
+	/**
+	* \brief カーソルを次の行に進める
+	* \retval false もう行が無い
+	*/
+	bool next(Cursor& c) const;
+
+private:
+
+	friend class LineNumberTableBuilder;
+
+	uint_t decode(uint_t offset, Entry& e) const;
+
+	// ブロックの先頭の行と、その次の行の符号の位置
+	struct Block{
+		u32 start_pc;
+		u32 lineno;
+		u32 offset;
+	};
+
+	struct LineIndex{
+		u32 lineno;
+		u32 index;
+	};
+
+	struct LineIndexCmp{
+		bool operator ()(const LineIndex& a, const LineIndex& b) const{
+			return a.lineno!=b.lineno ? a.lineno<b.lineno : a.index<b.index;
+		}
+		bool operator ()(const LineIndex& a, uint_t lineno) const{
+			return a.lineno<lineno;
+		}
+	};
+
+	const u8* data_;
+	const Block* blocks_;
+	const LineIndex* line_index_;
+	uint_t block_count_;
+	uint_t size_;
+	Entry last_;
+};
+
+/**
+* \brief LineNumberTableを組み立てる
+*/
+class LineNumberTableBuilder{
+public:
+
+	LineNumberTableBuilder();
+
+	uint_t size() const{
+		return size_;
+	}
+
+	bool empty() const{
+		return size_==0;
+	}
+
+	/**
+	* \brief 最後に追加された行を返す
+	*/
+	const LineNumberTable::Entry& back() const{
+		return last_;
+	}
+
+	/**
+	* \brief 行を追加する
+	* start_pcは直前に追加した行のstart_pcより大きくなければならない。
+	*/
+	void push_back(uint_t start_pc, uint_t lineno);
+
+	/**
+	* \brief 最後に追加された行を取り除く
+	* 直前のpush_backを取り消すだけなので、続けて二回呼んではならない。
+	*/
+	void pop_back();
+
+	void clear();
+
+	/**
+	* \brief 組み立て中の表を参照するLineNumberTableを返す
+	* 行番号順の索引は作られない。行を追加すると無効になる。
+	*/
+	LineNumberTable table();
+
+	/**
+	* \brief 索引を含めて書き出すのに必要なバイト数を返す
+	*/
+	uint_t byte_size() const;
+
+	/**
+	* \brief destに索引を含めて表を書き出し、それを参照するLineNumberTableを返す
+	* destは4バイト境界に揃っていなければならない。
+	*/
+	LineNumberTable write(void* dest);
+
+private:
+	PODArray<u8> data_;
+	PODArray<LineNumberTable::Block> blocks_;
+	uint_t size_;
+	LineNumberTable::Entry last_;
+
+	// pop_backのために、最後の行を追加する前の状態を覚えておく
+	LineNumberTable::Entry prev_;
+	uint_t prev_data_size_;
+};
+
+/**
+* \brief コンパイルされたコードのうち、実行中に変更されない部分
+* バイトコード、スコープや関数の情報、例外の範囲、行番号表を一つの領域にまとめて持つ。
+* 実行環境に属するオブジェクトを含まないので、参照カウントを増やしておけば、
+* 複数の実行環境でinstantiateして同じ領域を読み取り専用で共有できる。
+* 領域は実行環境のAllocatorLibではなくstd::mallocで確保され、参照カウントが0になったときにstd::freeで解放される。
+* そのため、作成した実行環境をuninitializeした後も、他の実行環境で使い続けられる。
+*/
+class CodeImage{
+public:
+
+	// 関数の範囲の索引。start_pcから次の要素のstart_pcまでが、fun_index番目の関数の直接の範囲となる
+	struct FunRange{
+		u32 start_pc;
+		u32 fun_index;
+	};
+
+	struct FunRangeCmp{
+		bool operator ()(uint_t pc, const FunRange& r) const{
+			return pc<r.start_pc;
+		}
+	};
+
+	struct ImplcitInfo{
+		u16 id;
+		u16 lineno;
+	};
+
+	/**
+	* \brief 参照カウントを増やす
+	* 異なるスレッドで動く実行環境の間でも安全に呼び出せる。
+	*/
+	void inc_ref_count();
+
+	/**
+	* \brief 参照カウントを減らし、0になったら領域を解放する
+	*/
+	void dec_ref_count();
+
+	int_t ref_count() const{
+		return ref_count_;
+	}
+
+	/**
+	* \brief 現在の実行環境に、このイメージを参照するコードオブジェクトを生成する
+	* 識別子と値のテーブル、onceテーブル、filelocalのメンバは生成したコードオブジェクトごとに作られる。
+	*/
+	CodePtr instantiate();
+
+	/**
+	* \brief 確保している領域のバイト数を返す
+	*/
+	uint_t byte_size() const{
+		return byte_size_ + constants_size_;
+	}
+
+	const inst_t* bytecode_data() const{
+		return code_;
+	}
+
+	uint_t bytecode_size() const{
+		return code_size_;
+	}
+
+	uint_t scope_info_size() const{
+		return scope_info_size_;
+	}
+
+	uint_t class_info_size() const{
+		return class_info_size_;
+	}
+
+	uint_t fun_info_size() const{
+		return fun_info_size_;
+	}
+
+	uint_t except_info_size() const{
+		return except_info_size_;
+	}
+
+	const LineNumberTable& lineno_table() const{
+		return lineno_table_;
+	}
+
+	const u32* statement_data() const{
+		return statements_;
+	}
+
+	uint_t statement_size() const{
+		return statement_size_;
+	}
+
+private:
+
+	friend class Code;
+
+	CodeImage(){}
+
+	~CodeImage(){}
+
+	static CodeImage* create(Code* code);
+
+	void set_constants(const void* data, uint_t size);
+
+	uint_t byte_size_;
+	volatile long ref_count_;
+
+	inst_t* code_;
+	uint_t code_size_;
+
+	ScopeInfo* scope_infos_;
+	uint_t scope_info_size_;
+
+	ClassInfo* class_infos_;
+	uint_t class_info_size_;
+
+	FunInfo* fun_infos_;
+	uint_t fun_info_size_;
+
+	ExceptInfo* except_infos_;
+	uint_t except_info_size_;
+
+	FunRange* fun_ranges_;
+	uint_t fun_range_size_;
+
+	ImplcitInfo* implicits_;
+	uint_t implicit_size_;
+
+	// デバッグコンパイルされたコードの、文の先頭の位置。昇順に並ぶ
+	u32* statements_;
+	uint_t statement_size_;
+
+	LineNumberTable lineno_table_;
+
+	uint_t once_size_;
+
+	// ソースファイル名、識別子と値のテーブルを直列化したもの。最初にCode::imageが呼ばれたときに作られる
+	void* constants_;
+	uint_t constants_size_;
+
+	XTAL_DISALLOW_COPY_AND_ASSIGN(CodeImage);
+};
+
 /**
 * \brief コンパイルされたバイトコード
+* 変更されない部分はCodeImageが持ち、識別子や値のテーブル、onceテーブル、filelocalのメンバ、
+* ブレークポイントなどの実行環境ごとの状態をこのオブジェクトが持つ。
 */
 class Code : public Class{
 public:
-	
+
 	Code();
 
 	~Code();
@@ -35,23 +358,44 @@ public:
 	* \brief ソース行数に対応したコード位置を返す。
 	*/
 	const inst_t* compliant_pc(int_t p);
-		
+
 	bool set_lineno_info(uint_t line);
 
+	/**
+	* \brief 現在の位置を文の先頭として記録する
+	* 行フックやブレークポイントのトラップ命令は、ここで記録された位置にだけ埋め込まれる。
+	* 現在の位置から始まる行が行番号表に無い場合は、直前の文と同じ行の続きなので記録しない。
+	*/
+	void set_statement_start();
+
 	int_t final_lineno();
 
+	/**
+	* \brief 他の実行環境と共有できる、変更されない部分を返す
+	* 他の実行環境で使う場合は、参照カウントを増やしてから渡し、そちらでCodeImage::instantiateする。
+	* 初めて呼ばれたときに識別子と値のテーブルが直列化されるので、コードを生成した実行環境で一度呼んでおく必要がある。
+	*/
+	CodeImage* image();
+
+	/**
+	* \xbind
+	* \brief 同じイメージを共有する新しいコードオブジェクトを生成する
+	* バイトコードは共有されるが、onceの値やfilelocalのメンバは新しいコードオブジェクト側で別に持つ。
+	*/
+	CodePtr instantiate();
+
 	/**
 	* \brief バイトコードのデータを返す
 	*/
 	const inst_t* bytecode_data(){
-		return code_.data();
+		return bytecode_;
 	}
 
 	/**
 	* \brief バイトコードのサイズを返す
 	*/
 	int_t bytecode_size(){
-		return (int_t)code_.size();
+		return (int_t)image_->code_size_;
 	}
 
 	/**
@@ -101,36 +445,51 @@ public:
 		once_table_.set_at(i, v);
 	}
 
-	const StringPtr& source_file_name(){ 
-		return source_file_name_; 
+	const StringPtr& source_file_name(){
+		return source_file_name_;
 	}
 
 	void set_source_file_name(const StringPtr& file_name){
 		source_file_name_ = file_name;
 	}
 
-	const ClassPtr& filelocal(){ 
-		return to_smartptr(static_cast<Class*>(this)); 
+	const ClassPtr& filelocal(){
+		return to_smartptr(static_cast<Class*>(this));
 	}
 
 	ScopeInfo* scope_info(uint_t i){
-		XTAL_ASSERT(i<scope_info_table_.size());
-		return &scope_info_table_[i];
+		XTAL_ASSERT(i<image_->scope_info_size_);
+		return &image_->scope_infos_[i];
 	}
 
 	ClassInfo* class_info(uint_t i){
-		XTAL_ASSERT(i<class_info_table_.size());
-		return &class_info_table_[i];
+		XTAL_ASSERT(i<image_->class_info_size_);
+		return &image_->class_infos_[i];
 	}
 
 	FunInfo* fun_info(uint_t i){
-		XTAL_ASSERT(i<xfun_info_table_.size());
-		return &xfun_info_table_[i];
-	}	
+		XTAL_ASSERT(i<image_->fun_info_size_);
+		return &image_->fun_infos_[i];
+	}
+
+	uint_t fun_info_size(){
+		return image_->fun_info_size_;
+	}
+
+	/**
+	* \brief コード位置を含む最も内側の関数の情報を返す。
+	*/
+	FunInfo* compliant_fun_info(const inst_t* p);
+
+	/**
+	* \brief このコードのinfoの関数を実行しているfunの名前を返す。
+	* リロードでfunが別のコードに差し替えられていても、実行しているこのコードの関数情報から名前を求める。
+	*/
+	StringPtr fun_name(FunInfo* info, const MethodPtr& fun);
 
 	ExceptInfo* except_info(uint_t i){
-		XTAL_ASSERT(i<except_info_table_.size());
-		return &except_info_table_[i];
+		XTAL_ASSERT(i<image_->except_info_size_);
+		return &image_->except_infos_[i];
 	}
 
 	const MethodPtr& first_fun(){
@@ -153,6 +512,23 @@ public:
 
 	CodePtr breakpoint_cond(int_t lineno);
 
+	/**
+	* \brief 全ての文の先頭にトラップ命令を埋め込むか設定する
+	* 行フックが設定されている間だけ、文の先頭の命令をInstBreakPointで上書きする。
+	* 文の先頭はデバッグコンパイルしたときにだけ記録されるので、それ以外のコードでは何もしない。
+	*/
+	void set_line_trap(bool b);
+
+	/**
+	* \brief pcの位置にある、トラップ命令で上書きされる前の命令を返す
+	*/
+	inst_t original_inst(const inst_t* pc);
+
+	/**
+	* \brief pcの位置にブレークポイントが設定されているか返す
+	*/
+	bool is_breakpoint(const inst_t* pc);
+
 	void on_visit_members(Visitor& m){
 		Class::on_visit_members(m);
 		m & identifier_table_ & value_table_ & source_file_name_ & first_fun_ & once_table_;
@@ -169,14 +545,23 @@ private:
 	friend class CodeBuilder;
 	friend class VMachine;
 	friend class Serializer;
+	friend class CodeImage;
 
-	typedef PODArray<inst_t> code_t;
-	code_t code_;
+	CodeImage* image_;
+
+	// 実行するバイトコード。文の先頭が記録されている場合はprivate_code_を、そうでなければimage_のものを指す
+	const inst_t* bytecode_;
+
+	// トラップ命令を埋め込むために複製したバイトコード。イメージは他の実行環境と共有されることがあるので直接書き換えない
+	// 実行中のフレームが持つpcを無効にしないように、複製は実行される前のgeneratedで作る
+	PODArray<inst_t> private_code_;
+
+	inst_t* writable_bytecode();
 
 	xarray identifier_table_;
 	xarray value_table_;
 	xarray once_table_;
-	
+
 	StringPtr source_file_name_;
 	MethodPtr first_fun_;
 
@@ -186,38 +571,47 @@ private:
 
 private:
 
+	// 以下はコンパイル中や読み込み中にだけ使われ、generatedでimage_にまとめられた後は空になる
+
+	typedef PODArray<inst_t> code_t;
+	code_t code_;
+
 	PODArray<FunInfo> xfun_info_table_;
 	PODArray<ScopeInfo> scope_info_table_;
 	PODArray<ClassInfo> class_info_table_;
 	PODArray<ExceptInfo> except_info_table_;
 
-	struct LineNumberInfo{
-		u32 start_pc;
-		u16 lineno;
-	};
+	LineNumberTableBuilder lineno_table_;
 
-	struct LineNumberCmp{
-		bool operator ()(const LineNumberInfo& lnt, uint_t pc){
-			return lnt.start_pc<pc;
-		}
-		bool operator ()(uint_t pc, const LineNumberInfo& lnt){
-			return pc<lnt.start_pc;
-		}
-		bool operator ()(const LineNumberInfo& l, const LineNumberInfo& r){
-			return l.start_pc<r.start_pc;
-		}
-	};
+	typedef CodeImage::ImplcitInfo ImplcitInfo;
 
-	PODArray<LineNumberInfo> lineno_table_;
+	PODArray<ImplcitInfo> implicit_table_;
 
-	LineNumberInfo* compliant_lineno_info(const inst_t* p);
+	PODArray<u32> statement_table_;
 
-	struct ImplcitInfo{
-		u16 id;
-		u16 lineno;
+	void build_fun_range_table(PODArray<CodeImage::FunRange>& table);
+
+private:
+
+	enum{
+		TRAP_BREAKPOINT = 1<<0,
+		TRAP_LINE = 1<<1,
+		TRAP_PATCHED = 1<<2
 	};
 
-	PODArray<ImplcitInfo> implicit_table_;
+	// 文の先頭の位置と同じ並びで、その位置の命令のトラップ状態を保持する
+	struct TrapInfo{
+		inst_t inst;
+		u8 flags;
+	};
+
+	PODArray<TrapInfo> trap_table_;
+	bool line_trap_;
+	bool registered_;
+
+	TrapInfo& trap_info(uint_t i);
+	int_t trap_index(const inst_t* p);
+	void update_trap(uint_t i, uint_t start_pc);
 };
 
 }
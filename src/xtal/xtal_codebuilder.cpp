@@ -177,9 +177,16 @@ CodePtr CodeBuilder::compile_toplevel(const ExprPtr& ae, const StringPtr& source
 	eb_->tree_splice(EXPR_LVAR, 1);
 	eb_->tree_splice(0, 1);
 	eb_->tree_splice(EXPR_RETURN, 1);
-	compile_stmt(eb_->tree_pop_back());
+
+	// 自動で付け加えたreturn文はソースのどの行にも対応しないので、行情報を持たせない
+	ExprPtr ret = ep(eb_->tree_pop_back());
+	ret->set_lineno(0);
+	compile_stmt(ret);
 	
-	result_->set_lineno_info(result_->final_lineno()+1);
+	// 末尾の命令のための行。命令を生成していない行があるときに、それを置き換えてしまわないようにする
+	if(result_->lineno_table_.empty() || result_->lineno_table_.back().start_pc!=(u32)result_->code_.size()){
+		result_->set_lineno_info(result_->final_lineno()+1);
+	}
 
 	put_inst<InstThrow>();
 
@@ -209,6 +216,7 @@ CodePtr CodeBuilder::compile_toplevel(const ExprPtr& ae, const StringPtr& source
 
 	if(!parser_.executor_->errors()){
 		opt_jump();
+		opt_fuse();
 		result_->generated();
 		return result_;
 	}
@@ -252,9 +260,9 @@ address16 CodeBuilder::calc_address(const inst_t* pc, address16 address){
 }
 
 void CodeBuilder::opt_jump(){
-	const inst_t* begin = result_->bytecode_data();
+	const inst_t* begin = result_->code_.data();
 	inst_t* pc = (inst_t*)begin;
-	const inst_t* end = result_->bytecode_data() + result_->bytecode_size(); 
+	const inst_t* end = begin + result_->code_.size(); 
 
 	while(pc<end){
 		switch(XTAL_opc(pc)){
@@ -279,6 +287,99 @@ void CodeBuilder::opt_jump(){
 	}
 }
 
+void CodeBuilder::opt_fuse(){
+	inst_t* pc = result_->code_.data();
+	const inst_t* end = pc + result_->code_.size(); 
+
+	while(pc<end){
+		int_t size = inst_size(XTAL_opc(pc));
+		if(size==0){
+			break;
+		}
+
+		int_t fused_size = fuse_inst(pc, end);
+		pc += fused_size ? fused_size : size;
+	}
+}
+
+int_t CodeBuilder::fuse_inst(inst_t* pc, const inst_t* end){
+	const inst_t* pc2 = pc + inst_size(XTAL_opc(pc));
+	uint_t op = 0;
+
+	// 融合する命令列の並びを調べる
+	switch(XTAL_opc(pc)){
+		XTAL_DEFAULT{
+			return 0;
+		}
+
+		XTAL_CASE(InstInc::NUMBER){
+			if(pc2<end && (XTAL_opc(pc2)==InstLoadInt1Byte::NUMBER || XTAL_opc(pc2)==InstLoadConstant::NUMBER)){
+				pc2 += inst_size(XTAL_opc(pc2));
+			}
+
+			if(pc2>=end || XTAL_opc(pc2)!=InstIfLt::NUMBER){
+				return 0;
+			}
+
+			pc2 += InstIfLt::ISIZE;
+			op = InstIncIfLt::NUMBER;
+		}
+
+		XTAL_CASE(InstLoadInt1Byte::NUMBER){
+			if(pc2>=end){
+				return 0;
+			}
+
+			switch(XTAL_opc(pc2)){
+				XTAL_DEFAULT{ return 0; }
+				XTAL_CASE(InstAdd::NUMBER){ pc2 += InstAdd::ISIZE; op = InstLoadInt1ByteAdd::NUMBER; }
+				XTAL_CASE(InstSub::NUMBER){ pc2 += InstSub::ISIZE; op = InstLoadInt1ByteSub::NUMBER; }
+				XTAL_CASE(InstIfLt::NUMBER){ pc2 += InstIfLt::ISIZE; op = InstLoadInt1ByteIfLt::NUMBER; }
+			}
+		}
+
+		XTAL_CASE(InstInstanceVariable::NUMBER){
+			if(pc2<end && (XTAL_opc(pc2)==InstLoadInt1Byte::NUMBER || XTAL_opc(pc2)==InstLoadConstant::NUMBER)){
+				pc2 += inst_size(XTAL_opc(pc2));
+			}
+
+			if(pc2>=end || XTAL_opc(pc2)!=InstAdd::NUMBER){
+				return 0;
+			}
+
+			pc2 += InstAdd::ISIZE;
+			if(pc2>=end || XTAL_opc(pc2)!=InstSetInstanceVariable::NUMBER){
+				return 0;
+			}
+
+			pc2 += InstSetInstanceVariable::ISIZE;
+			op = InstInstanceVariableAddAssign::NUMBER;
+		}
+	}
+
+	// 比較命令の後には分岐先を持つInstIfが続く
+	if(op==InstIncIfLt::NUMBER || op==InstLoadInt1ByteIfLt::NUMBER){
+		if(pc2>=end || XTAL_opc(pc2)!=InstIf::NUMBER){
+			return 0;
+		}
+		pc2 += InstIf::ISIZE;
+	}
+
+	// 行の先頭の命令はトラップ命令で上書きされることがあるので、途中に行の境目を含む命令列は融合しない
+	LineNumberTable lines = result_->lineno_table_.table();
+	for(const inst_t* p = pc + inst_size(XTAL_opc(pc)); p<pc2; p += inst_size(XTAL_opc(p))){
+		uint_t offset = (uint_t)(p - result_->code_.data());
+		LineNumberTable::Entry e;
+		if(lines.find_pc(offset, &e)>=0 && e.start_pc==offset){
+			return 0;
+		}
+	}
+
+	// 先頭の命令番号だけを書き換え、オペランドと後続の命令は残しておく
+	*pc = (inst_t)((*pc & ~0xff) | op);
+	return (int_t)(pc2 - pc);
+}
+
 AnyPtr CodeBuilder::errors(){
 	return parser_.executor_->errors();
 }
@@ -34,6 +34,8 @@ private:
 	void adjust_values(int_t need_result_count, int_t result_count);
 	address16 calc_address(const inst_t* pc, address16 address);
 	void opt_jump();
+	void opt_fuse();
+	int_t fuse_inst(inst_t* pc, const inst_t* end);
 	int_t reserve_label();
 	void set_label(int_t lableno);
 	void set_jump(int_t offset, int_t labelno);
@@ -403,14 +403,11 @@ void CodeBuilder::compile_stmt(const AnyPtr& p){
 
 	linenos_.push(e->lineno());
 
-	if(debug::is_debug_compile_enabled() && e->lineno()!=0){
-		if(result_->set_lineno_info(e->lineno())){
-			put_inst<InstLine>();
-		}
-	}
-	else{
-		if(e->lineno()!=0){
-			result_->set_lineno_info(e->lineno());
+	// 行情報はlineno_table_にだけ記録する。行フックは文の先頭へのトラップ命令の埋め込みで実現する
+	// 直前と同じ行の文は、新しい行として扱わない
+	if(e->lineno()!=0){
+		if(result_->set_lineno_info(e->lineno()) && debug::is_debug_compile_enabled()){
+			result_->set_statement_start();
 		}
 	}
 
@@ -1,6 +1,7 @@
 #include "xtal.h"
 #include "xtal_macro.h"
 #include "xtal_stringspace.h"
+#include "xtal_details.h"
 
 namespace xtal{ namespace debug{
 
@@ -87,6 +88,7 @@ public:
 		saved_hook_setting_bit_ = 0;
 		breakpoint_state_ = BSTATE_GO;
 		debug_compile_count_ = 0;
+		line_trap_ = false;
 	}
 
 	uint_t redefine_count_;
@@ -100,10 +102,36 @@ public:
 	int_t breakpoint_call_stack_size_;
 
 	uint_t debug_compile_count_;
+
+	bool line_trap_;
+
+	SamplingProfilerPtr profiler_;
 };
 
 namespace{
 
+enum{
+	LINE_HOOK_BITS = 
+		(1<<BREAKPOINT_LINE) | 
+		(1<<BREAKPOINT_INNER_LINE) | 
+		(1<<BREAKPOINT_LINE_LIGHT_WEIGHT) | 
+		(1<<BREAKPOINT_LINE_PROFILE)
+};
+
+// 行フックの有無が変わったら、全てのコードの行の先頭にトラップ命令を埋め込む、または取り除く
+void update_line_trap(const SmartPtr<DebugData>& d){
+	bool b = (d->hook_setting_bit_&LINE_HOOK_BITS)!=0;
+	if(b==d->line_trap_){
+		return;
+	}
+
+	d->line_trap_ = b;
+	PODArray<Code*>& codes = environment_->code_list_;
+	for(uint_t i=0, sz=codes.size(); i<sz; ++i){
+		codes[i]->set_line_trap(b);
+	}
+}
+
 void bitchange(const SmartPtr<DebugData>& d, bool b, int_t type){
 	if(b){
 		d->hook_setting_bit_ |= 1<<type;
@@ -111,6 +139,7 @@ void bitchange(const SmartPtr<DebugData>& d, bool b, int_t type){
 	else{
 		d->hook_setting_bit_ &= ~(1<<type);
 	}
+	update_line_trap(d);
 }
 
 }
@@ -129,7 +158,9 @@ void disable(){
 
 	if(d->enable_count_<=0){
 		d->saved_hook_setting_bit_ = d->hook_setting_bit_;
-		d->hook_setting_bit_ = 0;
+		// サンプリングプロファイラはデバッグ機能の有効無効に関係なく動かす
+		d->hook_setting_bit_ &= 1<<BREAKPOINT_SAMPLE;
+		update_line_trap(d);
 	}
 }
 
@@ -142,6 +173,7 @@ void enable_force(uint_t count){
 	const SmartPtr<DebugData>& d = cpp_value<DebugData>();
 	if(d->enable_count_==0){
 		d->hook_setting_bit_ = d->saved_hook_setting_bit_;
+		update_line_trap(d);
 	}
 	d->enable_count_ = count;
 }
@@ -153,7 +185,10 @@ uint_t disable_force(){
 
 	if(d->enable_count_<=0){
 		d->saved_hook_setting_bit_ = d->hook_setting_bit_;
-		d->hook_setting_bit_ = 0;
+		// サンプリングプロファイラはデバッグ機能の有効無効に関係なく動かす
+		// フックの呼び出し中に一時的に無効にするためにも使われるので、トラップ命令は残しておく
+		// 残ったトラップ命令はフックを呼び出さずに元の命令を実行する
+		d->hook_setting_bit_ &= 1<<BREAKPOINT_SAMPLE;
 	}
 
 	return temp;
@@ -200,6 +235,11 @@ uint_t* hook_setting_bit_ptr(){
 	return &d->hook_setting_bit_;
 }
 
+bool is_line_trap_enabled(){
+	const SmartPtr<DebugData>& d = cpp_value<DebugData>();
+	return d->line_trap_;
+}
+
 void set_hook(int_t hooktype, const AnyPtr& hook){
 	const SmartPtr<DebugData>& d = cpp_value<DebugData>();
 	d->hooks_[hooktype] = hook;
@@ -251,6 +291,224 @@ const AnyPtr& assert_hook(){
 	return hook(BREAKPOINT_ASSERT);
 }
 
+const SamplingProfilerPtr& profiler(){
+	const SmartPtr<DebugData>& d = cpp_value<DebugData>();
+	if(!d->profiler_){
+		d->profiler_ = xnew<SamplingProfiler>();
+	}
+	return d->profiler_;
+}
+
+void start_profile(float_t interval, int_t capacity){
+	const SmartPtr<DebugData>& d = cpp_value<DebugData>();
+	profiler()->start(interval, capacity);
+	bitchange(d, true, BREAKPOINT_SAMPLE);
+}
+
+void stop_profile(){
+	const SmartPtr<DebugData>& d = cpp_value<DebugData>();
+	profiler()->stop();
+	bitchange(d, false, BREAKPOINT_SAMPLE);
+	d->saved_hook_setting_bit_ &= ~(1<<BREAKPOINT_SAMPLE);
+}
+
+void clear_profile(){
+	profiler()->clear();
+}
+
+bool is_profiling(){
+	return profiler()->is_running();
+}
+
+uint_t profile_sample_count(){
+	return profiler()->sample_count();
+}
+
+StringPtr profile_collapsed(){
+	return profiler()->collapsed();
+}
+
+//////////////////////////////////////////////////////////
+
+SamplingProfiler::SamplingProfiler(){
+	samples_ = 0;
+	capacity_ = 0;
+	head_ = 0;
+	size_ = 0;
+	writing_ = 0;
+	interval_ = 0;
+	next_clock_ = 0;
+	running_ = false;
+	fun_indices_ = xnew<Map>();
+}
+
+SamplingProfiler::~SamplingProfiler(){
+	free_samples();
+}
+
+void SamplingProfiler::free_samples(){
+	if(samples_){
+		xfree(samples_, sizeof(Sample)*capacity_);
+		samples_ = 0;
+	}
+	capacity_ = 0;
+	head_ = 0;
+	size_ = 0;
+	writing_ = 0;
+}
+
+void SamplingProfiler::start(float_t interval, int_t capacity){
+	if(capacity<1){
+		capacity = 1;
+	}
+
+	if((uint_t)capacity!=capacity_){
+		free_samples();
+		samples_ = (Sample*)xmalloc(sizeof(Sample)*capacity);
+		capacity_ = capacity;
+	}
+
+	interval_ = interval>0 ? (u64)(interval*1000*1000) : 0;
+	next_clock_ = thread_lib()->clock() + interval_;
+	running_ = true;
+}
+
+void SamplingProfiler::stop(){
+	running_ = false;
+	writing_ = 0;
+}
+
+void SamplingProfiler::clear(){
+	head_ = 0;
+	size_ = 0;
+	writing_ = 0;
+	funs_.clear();
+	fun_codes_.clear();
+	fun_infos_.clear();
+	fun_indices_->clear();
+}
+
+bool SamplingProfiler::is_due(){
+	if(!running_){
+		return false;
+	}
+
+	u64 clock = thread_lib()->clock();
+	if(clock<next_clock_){
+		return false;
+	}
+
+	next_clock_ = clock + interval_;
+	return true;
+}
+
+void SamplingProfiler::begin_sample(){
+	writing_ = &samples_[head_];
+	writing_->depth = 0;
+}
+
+void SamplingProfiler::push_frame(const MethodPtr& fun, Code* code, FunInfo* info, int_t lineno){
+	if(!writing_ || writing_->depth>=MAX_DEPTH){
+		return;
+	}
+
+	Frame& f = writing_->frames[writing_->depth++];
+	f.fun = (u32)fun_index(fun, code, info);
+	f.lineno = (u32)lineno;
+}
+
+void SamplingProfiler::end_sample(){
+	if(!writing_){
+		return;
+	}
+
+	writing_ = 0;
+	head_ = (head_+1) % capacity_;
+	if(size_<capacity_){
+		size_++;
+	}
+}
+
+uint_t SamplingProfiler::fun_index(const MethodPtr& fun, Code* code, FunInfo* info){
+	const CodePtr& cp = to_smartptr(code);
+	if(!info){
+		const AnyPtr& index = fun_indices_->at(fun);
+		if(XTAL_detail_type(index)==TYPE_INT){
+			return XTAL_detail_ivalue(index);
+		}
+
+		uint_t ret = funs_.size();
+		funs_.push_back(fun);
+		fun_codes_.push_back(cp);
+		fun_infos_.push_back(~(u32)0);
+		fun_indices_->set_at(fun, ret);
+		return ret;
+	}
+
+	// 同じ定義から作られたクロージャは関数オブジェクトが異なるので、関数情報の番号で引く
+	ArrayPtr indices = ptr_cast<Array>(fun_indices_->at(cp));
+	if(!indices){
+		indices = xnew<Array>(code->fun_info_size());
+		fun_indices_->set_at(cp, indices);
+	}
+
+	uint_t n = (uint_t)(info - code->fun_info(0));
+	const AnyPtr& index = indices->at(n);
+	if(XTAL_detail_type(index)==TYPE_INT){
+		return XTAL_detail_ivalue(index);
+	}
+
+	uint_t ret = funs_.size();
+	funs_.push_back(fun);
+	fun_codes_.push_back(cp);
+	fun_infos_.push_back((u32)n);
+	indices->set_at(n, ret);
+	return ret;
+}
+
+StringPtr SamplingProfiler::collapsed(){
+	// 同じ呼び出し履歴をまとめて数える
+	MapPtr counts = xnew<Map>();
+	uint_t oldest = (head_ + capacity_ - size_) % (capacity_ ? capacity_ : 1);
+
+	for(uint_t i=0; i<size_; ++i){
+		Sample& sample = samples_[(oldest+i) % capacity_];
+		if(sample.depth==0){
+			continue;
+		}
+
+		MemoryStreamPtr ms = xnew<MemoryStream>();
+		for(uint_t j=sample.depth; j>0; --j){
+			Frame& f = sample.frames[j-1];
+			const MethodPtr& fun = unchecked_ptr_cast<Method>(funs_.at(f.fun));
+			const CodePtr& code = unchecked_ptr_cast<Code>(fun_codes_.at(f.fun));
+			FunInfo* info = fun_infos_[f.fun]!=~(u32)0 ? code->fun_info(fun_infos_[f.fun]) : 0;
+			if(j!=sample.depth){
+				ms->put_s(XTAL_STRING(";"));
+			}
+			ms->put_s(Xf("%s (%s:%d)")->call(code->fun_name(info, fun), code->source_file_name(), (int_t)f.lineno)->to_s());
+		}
+
+		StringPtr key = ms->to_s();
+		const AnyPtr& count = counts->at(key);
+		counts->set_at(key, XTAL_detail_type(count)==TYPE_INT ? XTAL_detail_ivalue(count)+1 : 1);
+	}
+
+	MemoryStreamPtr ms = xnew<MemoryStream>();
+	for(Map::iterator it=counts->begin(); it!=counts->end(); ++it){
+		ms->put_s(it->first->to_s());
+		ms->put_s(XTAL_STRING(" "));
+		ms->put_s(it->second->to_s());
+		ms->put_s(XTAL_STRING("\n"));
+	}
+	return ms->to_s();
+}
+
+void SamplingProfiler::on_visit_members(Visitor& m){
+	Base::on_visit_members(m);
+	m & funs_ & fun_codes_ & fun_indices_;
+}
+
 void call_breakpoint_hook(int_t kind, HookInfoPtr info){
 	const SmartPtr<DebugData>& d = cpp_value<DebugData>();
 
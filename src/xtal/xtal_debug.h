@@ -153,6 +153,117 @@ private:
 
 typedef SmartPtr<HookInfo> HookInfoPtr;
 
+/**
+* \brief サンプリングプロファイラ
+* VMが関数呼び出し、リターン、ループの分岐で一定時間ごとに呼び出し履歴を採取し、リングバッファに記録する。
+* 採取の度にスクリプトを呼び出すことはないので、プロファイル用のフック関数に比べて実行速度への影響が小さい。
+*/
+class SamplingProfiler : public Base{
+public:
+
+	enum{
+		// 1回の採取で記録する呼び出しの最大の深さ
+		MAX_DEPTH = 64
+	};
+
+	SamplingProfiler();
+
+	~SamplingProfiler();
+
+	/**
+	* \brief 採取を開始する
+	* \param interval 採取する間隔(秒)
+	* \param capacity 記録しておく採取の最大数。これを超えると古いものから上書きされる
+	*/
+	void start(float_t interval, int_t capacity);
+
+	/**
+	* \brief 採取を終了する
+	*/
+	void stop();
+
+	/**
+	* \brief 記録した採取を破棄する
+	*/
+	void clear();
+
+	bool is_running(){
+		return running_;
+	}
+
+	/**
+	* \brief 記録されている採取の数を返す
+	*/
+	uint_t sample_count(){
+		return size_;
+	}
+
+	/**
+	* \brief 前回の採取からinterval秒経過したか調べる
+	*/
+	bool is_due();
+
+	/**
+	* \brief 採取を開始する
+	* push_frameで末端の呼び出しから順に積み、end_sampleで確定させる。
+	*/
+	void begin_sample();
+
+	/**
+	* \brief 呼び出しを一つ積む
+	* 同じ定義から作られた関数は、実行しているcodeとその関数情報infoでまとめて数える。
+	* infoが分からない場合はfunごとに数える。
+	*/
+	void push_frame(const MethodPtr& fun, Code* code, FunInfo* info, int_t lineno);
+
+	void end_sample();
+
+	/**
+	* \brief 記録した採取を、flame graphのツールが読み込めるcollapsed stack形式の文字列にする
+	* 1行に"呼び出し元;...;呼び出し先 回数"の形で出力される。
+	*/
+	StringPtr collapsed();
+
+	void on_visit_members(Visitor& m);
+
+private:
+
+	struct Frame{
+		u32 fun;
+		u32 lineno;
+	};
+
+	struct Sample{
+		uint_t depth;
+		Frame frames[MAX_DEPTH];
+	};
+
+	uint_t fun_index(const MethodPtr& fun, Code* code, FunInfo* info);
+
+	void free_samples();
+
+private:
+	Sample* samples_;
+	uint_t capacity_;
+	uint_t head_;
+	uint_t size_;
+	Sample* writing_;
+
+	u64 interval_;
+	u64 next_clock_;
+	bool running_;
+
+	// 採取した関数の一覧と、その関数から番号への対応表
+	// funs_とfun_codes_とfun_infos_は同じ番号で並ぶ。fun_infos_はコード内の関数情報の番号で、不明な場合は~0
+	// fun_indices_はコードから関数情報の番号ごとの配列を、関数情報が不明な場合は関数から番号を引く
+	xarray funs_;
+	xarray fun_codes_;
+	PODArray<u32> fun_infos_;
+	MapPtr fun_indices_;
+};
+
+typedef SmartPtr<SamplingProfiler> SamplingProfilerPtr;
+
 class Debug{};
 
 /**
@@ -209,6 +320,12 @@ uint_t hook_setting_bit();
 
 uint_t* hook_setting_bit_ptr();
 
+/**
+* \brief 行の先頭にトラップ命令を埋め込む必要があるか返す
+* 行フックのいずれかが有効な間だけtrueとなる。
+*/
+bool is_line_trap_enabled();
+
 void set_hook(int_t hooktype, const AnyPtr& hook);
 
 const AnyPtr& hook(int_t hooktype);
@@ -278,6 +395,47 @@ const AnyPtr& throw_hook();
 */
 const AnyPtr& assert_hook();
 
+/**
+* \xbind lib::builtin::debug
+* \brief サンプリングプロファイラを開始する
+* \param interval 採取する間隔(秒)
+* \param capacity 記録しておく採取の最大数
+*/
+void start_profile(float_t interval = 0.001f, int_t capacity = 4096);
+
+/**
+* \xbind lib::builtin::debug
+* \brief サンプリングプロファイラを終了する
+* 記録した採取は破棄されない。
+*/
+void stop_profile();
+
+/**
+* \xbind lib::builtin::debug
+* \brief サンプリングプロファイラが記録した採取を破棄する
+*/
+void clear_profile();
+
+/**
+* \xbind lib::builtin::debug
+* \brief サンプリングプロファイラが動作中かどうか
+*/
+bool is_profiling();
+
+/**
+* \xbind lib::builtin::debug
+* \brief サンプリングプロファイラが記録した採取の数を返す
+*/
+uint_t profile_sample_count();
+
+/**
+* \xbind lib::builtin::debug
+* \brief サンプリングプロファイラが記録した採取をcollapsed stack形式の文字列で返す
+*/
+StringPtr profile_collapsed();
+
+const SamplingProfilerPtr& profiler();
+
 /**
 * \xbind lib::builtin::debug
 * \brief 再定義が有効かどうか
@@ -11,6 +11,7 @@
 #include "xtal_stringspace.h"
 #include "xtal_threadspace.h"
 #include "xtal_cache.h"
+#include "xtal_statsspace.h"
 
 namespace xtal{
 
@@ -28,15 +29,20 @@ public:
 	ObjectSpace object_space_;	
 	StringSpace string_space_;
 	ThreadSpace thread_space_;
+#ifdef XTAL_ENABLE_VM_STATS
+	StatsSpace stats_space_;
+#endif
 	MemberCacheTable member_cache_table_;
 	MemberCacheTable2 member_cache_table2_;
-	IsCacheTable is_cache_table_;
+	SendSiteCacheTable send_site_cache_table_;
+	FormatCacheTable format_cache_table_;
 
 	ClassPtr builtin_;
 	ClassPtr global_;
 	LibPtr lib_;
 
 	ArrayPtr vm_list_;
+	PODArray<Code*> code_list_;
 	MapPtr text_map_;
 
 	StreamPtr stdin_;
@@ -48,6 +54,41 @@ public:
 	JmpBuf jmp_buf_;
 
 	uint_t used_memory_;
+	uint_t max_used_memory_;
+	uint_t alloc_count_;
+
+	// 小さいオブジェクト用アロケータから確保されているバイト数。used_memory_にも含まれる
+	uint_t small_object_memory_;
+
+	// 小さいオブジェクト用のメモリプールが確保しているバイト数。used_memory_には含まれない
+	uint_t pool_memory_;
+
+	// メモリ使用量の上限。0なら上限無し
+	uint_t soft_memory_limit_;
+	uint_t hard_memory_limit_;
+
+	// 使用メモリ量がこれを超えたらgcを実行する
+	uint_t gc_memory_line_;
+
+	// 使用メモリ量がこれを超えたらfull_gcを実行し、ハード上限を調べる
+	uint_t hard_memory_line_;
+
+	// xfreeで使用メモリ量がこれを下回ったら、hard_memory_line_をハード上限に戻す。0なら何もしない
+	uint_t memory_relax_line_;
+
+	// 使用メモリ量がこれを超えたらcheck_memory_limitで上限を調べる
+	uint_t memory_check_line_;
+	bool checking_memory_limit_;
+
+	// xmallocで使用メモリ量がmemory_check_line_を超えた。VMachineのcheck_yieldで上限を調べる
+	bool memory_check_requested_;
+
+	// 実行量の上限。execution_tick_limit_とexecution_deadline_は0なら上限無し
+	uint_t execution_tick_limit_;
+	uint_t execution_ticks_;
+	u64 execution_deadline_;
+	bool execution_limited_;
+	bool execution_limit_exceeded_;
 
 	bool gc_stress_;
 
@@ -4,8 +4,18 @@
 #include "xtal_details.h"
 #include "xtal_codebuilder.h"
 #include "xtal_filesystem.h"
+#include "xtal_serializer.h"
 #include "xtal_lib/xtal_chcode.h"
 
+#include <ctime>
+
+#if defined(_WIN32)
+#include <windows.h>
+#elif defined(__unix__) || defined(__APPLE__)
+#include <time.h>
+#include <errno.h>
+#endif
+
 //#define XTAL_DEBUG_ALLOC
 
 #ifdef XTAL_DEBUG_ALLOC
@@ -273,6 +283,7 @@ namespace xtal{
 Environment* last_environment_ = 0;
 uint_t member_mutate_count_ = 0;
 uint_t is_mutate_count_ = 0;
+uint_t class_version_count_ = 0;
 uint_t cache_enable_ = 1;
 
 void enable_cashe(uint_t v){
@@ -322,6 +333,44 @@ void AllocatorLib::free_align(void *mem, std::size_t size, std::size_t alignment
     free(p, size+alignment);
 }
 
+void ThreadLib::sleep(float_t sec){
+	if(sec<=0){
+		return;
+	}
+
+#if defined(_WIN32)
+	Sleep((DWORD)(1000*sec));
+#elif defined(__unix__) || defined(__APPLE__)
+	timespec ts;
+	ts.tv_sec = (time_t)sec;
+	ts.tv_nsec = (long)((sec - (float_t)ts.tv_sec)*1000*1000*1000);
+	// シグナルで起こされた場合は残りの時間を眠る
+	while(nanosleep(&ts, &ts)!=0 && errno==EINTR){}
+#else
+	// 眠る手段が無い環境では、時計が進むまで待つ
+	u64 until = clock() + (u64)(sec*1000*1000);
+	while(clock()<until){}
+#endif
+}
+
+u64 ThreadLib::clock(){
+	// std::clockはプロセスのCPU時間なので、待機中は進まない
+	// タイマーの期限に使うため、単調増加する壁時計を使う
+#if defined(_WIN32)
+	LARGE_INTEGER freq, count;
+	QueryPerformanceFrequency(&freq);
+	QueryPerformanceCounter(&count);
+	return (u64)(count.QuadPart/freq.QuadPart*1000*1000 + count.QuadPart%freq.QuadPart*1000*1000/freq.QuadPart);
+#elif (defined(__unix__) || defined(__APPLE__)) && defined(CLOCK_MONOTONIC)
+	timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (u64)ts.tv_sec*1000*1000 + ts.tv_nsec/1000;
+#else
+	// 単調な時計が無い環境では、暦時刻で代用する
+	return (u64)std::time(0)*1000*1000;
+#endif
+}
+
 
 Environment* environment(){
 	return environment_;
@@ -371,20 +420,148 @@ VMachinePtr set_vmachine(const VMachinePtr& vm){
 
 ////////////////////////////////////
 
+namespace{
+
+void update_memory_check_line(Environment* env){
+	uint_t line = ~(uint_t)0;
+	if(env->soft_memory_limit_){
+		line = env->gc_memory_line_;
+	}
+
+	if(env->hard_memory_limit_ && env->hard_memory_line_<line){
+		line = env->hard_memory_line_;
+	}
+
+	env->memory_check_line_ = line;
+}
+
+// 上限を超えて待たせていたfull_gcを、使用メモリ量が上限を下回ったら次の確保からまた行う
+inline void relax_memory_line(Environment* env){
+	if(env->used_memory_<env->memory_relax_line_){
+		env->hard_memory_line_ = env->hard_memory_limit_;
+		env->memory_relax_line_ = 0;
+		update_memory_check_line(env);
+	}
+}
+
+// sizeバイト確保すると使用メモリ量がハード上限を超える場合に呼ばれる。
+// hard_memory_line_を超えていればfull_gcを実行し、それでも上限を超えるならfalseを返す。
+bool check_hard_memory_limit(Environment* env, size_t size){
+	if(env->used_memory_+size>env->hard_memory_line_){
+		full_gc();
+
+		if(env->used_memory_+size<=env->hard_memory_limit_){
+			env->hard_memory_line_ = env->hard_memory_limit_;
+			env->memory_relax_line_ = 0;
+			return true;
+		}
+
+		// gcしても上限を超えたままなら、上限の1/8だけ使用量が増えるか、解放されて上限を下回るまで次のfull_gcを待つ
+		env->hard_memory_line_ = env->used_memory_ + size + (env->hard_memory_limit_>>3);
+		env->memory_relax_line_ = env->hard_memory_limit_;
+	}
+
+	return false;
+}
+
+// 使用メモリ量が上限を超えていればgcを実行し、ハード上限を超えたままならfalseを返す。
+bool check_memory_limit(Environment* env, size_t size){
+	if(env->checking_memory_limit_ || !env->object_space_.is_gc_enabled()){
+		return true;
+	}
+
+	env->checking_memory_limit_ = true;
+	bool ret = true;
+
+	if(env->soft_memory_limit_ && env->used_memory_+size>env->gc_memory_line_){
+		env->object_space_.gc();
+
+		// gcしても減らなかった分は、ソフト上限の1/8ずつ余裕を持たせて次のgcの位置とする
+		uint_t next = env->used_memory_ + (env->soft_memory_limit_>>3);
+		env->gc_memory_line_ = next<env->soft_memory_limit_ ? env->soft_memory_limit_ : next;
+	}
+
+	if(env->hard_memory_limit_ && env->used_memory_+size>env->hard_memory_line_){
+		ret = check_hard_memory_limit(env, size);
+	}
+
+	update_memory_check_line(env);
+	env->checking_memory_limit_ = false;
+	return ret;
+}
+
+// 確保の途中でgcを実行したり例外を作ったりすると、確保を呼んだコンテナなどが壊れた状態で触られる。
+// xmallocでは上限を超えたことを記録するだけにして、実行中のVMachineに次の分岐か関数呼び出しで調べてもらう。
+inline void request_memory_check(Environment* env){
+	if(!env->memory_check_requested_){
+		env->memory_check_requested_ = true;
+		if(vmachine_){
+			((VMachine*)vmachine_)->request_check_yield();
+		}
+	}
+}
+
+}
+
+bool check_requested_memory_limit(){
+	Environment* env = environment_;
+	if(!env->memory_check_requested_){
+		return true;
+	}
+
+	env->memory_check_requested_ = false;
+	return check_memory_limit(env, 0);
+}
+
+bool reserve_memory(uint_t size){
+	Environment* env = environment_;
+
+	if(!env->hard_memory_limit_ || env->used_memory_+size<=env->hard_memory_limit_ || 
+		env->checking_memory_limit_ || !env->object_space_.is_gc_enabled()){
+		return true;
+	}
+
+	env->checking_memory_limit_ = true;
+	bool ret = check_hard_memory_limit(env, size);
+	update_memory_check_line(env);
+	env->checking_memory_limit_ = false;
+
+	// 例外を送出済みで、まだ処理されていないなら重ねない
+	VMachine* vm = vmachine_;
+	if(!ret && vm && !vm->except()){
+		vm->set_except(cpp_class<MemoryError>()->call(Xt1("XRE1040", limit, env->hard_memory_limit_)));
+	}
+	return ret;
+}
+
 void* xmalloc(size_t size){
 	Environment* env = environment_;
+
+	env->alloc_count_++;
 		
 	if(env->gc_stress_){
 		env->object_space_.full_gc();
 	}
 
+	if(env->used_memory_+size>env->memory_check_line_){
+		request_memory_check(env);
+	}
+
 #if !defined(XTAL_NO_SMALL_ALLOCATOR) && !defined(XTAL_DEBUG_ALLOC)
 	if(XTAL_SMALL_ALLOCATOR_HANDLE_SIZE(size)){
+		env->used_memory_ += size;
+		env->small_object_memory_ += size;
+		if(env->max_used_memory_<env->used_memory_){
+			env->max_used_memory_ = env->used_memory_;
+		}
 		return env->so_alloc_.malloc(size);
 	}
 #endif
 
 	env->used_memory_ += size + 16;
+	if(env->max_used_memory_<env->used_memory_){
+		env->max_used_memory_ = env->used_memory_;
+	}
 
 	void* ret = env->setting_.allocator_lib->malloc(size);
 
@@ -423,12 +600,16 @@ void xfree(void* p, size_t size){
 
 #if !defined(XTAL_NO_SMALL_ALLOCATOR) && !defined(XTAL_DEBUG_ALLOC)
 	if(XTAL_SMALL_ALLOCATOR_HANDLE_SIZE(size)){	
+		env->used_memory_ -= size;
+		env->small_object_memory_ -= size;
+		relax_memory_line(env);
 		env->so_alloc_.free(p, size);
 		return;
 	}
 #endif
 
 	env->used_memory_ -= size + 16;
+	relax_memory_line(env);
 
 	env->setting_.allocator_lib->free(p, size);
 }
@@ -439,12 +620,21 @@ void* xmalloc_align(size_t size, size_t alignment){
 	}
 
 	Environment* env = environment_;
+
+	env->alloc_count_++;
 	
 	if(env->gc_stress_){
 		env->object_space_.full_gc();
 	}
 
+	if(env->used_memory_+size>env->memory_check_line_){
+		request_memory_check(env);
+	}
+
 	env->used_memory_ += size + 16;
+	if(env->max_used_memory_<env->used_memory_){
+		env->max_used_memory_ = env->used_memory_;
+	}
 
 	void* ret = env->setting_.allocator_lib->malloc_align(size, alignment);
 
@@ -485,9 +675,84 @@ void xfree_align(void* p, size_t size, size_t alignment){
 	}
 
 	env->used_memory_ -= size + 16;
+	relax_memory_line(env);
+	env->setting_.allocator_lib->free_align(p, size, alignment);
+}
+
+void* xmalloc_pool(size_t size, size_t alignment){
+	Environment* env = environment_;
+
+	env->pool_memory_ += size;
+
+	void* ret = env->setting_.allocator_lib->malloc_align(size, alignment);
+
+	if(!ret){
+		// プールの操作の途中なので、ここではgcせずにアロケータに任せる
+		env->setting_.allocator_lib->out_of_memory();
+		ret = env->setting_.allocator_lib->malloc_align(size, alignment);
+
+		if(!ret){
+			XTAL_ASSERT(env->set_jmp_buf_);
+
+			env->ignore_memory_assert_= true;
+			longjmp(env->jmp_buf_.buf, 1);
+		}
+	}
+
+	return ret;
+}
+
+void xfree_pool(void* p, size_t size, size_t alignment){
+	Environment* env = environment_;
+
+	env->pool_memory_ -= size;
 	env->setting_.allocator_lib->free_align(p, size, alignment);
 }
 
+void set_memory_limit(uint_t soft_limit, uint_t hard_limit){
+	Environment* env = environment_;
+	env->soft_memory_limit_ = soft_limit;
+	env->hard_memory_limit_ = hard_limit;
+	env->gc_memory_line_ = soft_limit;
+	env->hard_memory_line_ = hard_limit;
+	env->memory_relax_line_ = 0;
+	update_memory_check_line(env);
+}
+
+uint_t soft_memory_limit(){
+	return environment_->soft_memory_limit_;
+}
+
+uint_t hard_memory_limit(){
+	return environment_->hard_memory_limit_;
+}
+
+void set_execution_limit(uint_t ticks, uint_t usec){
+	Environment* env = environment_;
+	env->execution_tick_limit_ = ticks;
+	env->execution_ticks_ = ticks;
+	env->execution_deadline_ = usec ? thread_lib()->clock() + usec : 0;
+	env->execution_limited_ = ticks!=0 || usec!=0;
+	env->execution_limit_exceeded_ = false;
+
+	// 実行中のVMachineは次の分岐か呼び出しで残りの量を数え直す
+	if(vmachine_){
+		((VMachine*)vmachine_)->reset_execution_count();
+	}
+}
+
+void clear_execution_limit(){
+	set_execution_limit(0, 0);
+}
+
+bool execution_limit_exceeded(){
+	return environment_->execution_limit_exceeded_;
+}
+
+uint_t remaining_execution_ticks(){
+	return environment_->execution_ticks_;
+}
+
 JmpBuf& protect(){
 	// XTAL_PROTECTが入れ子になっている場合assertに引っかかる
 	XTAL_ASSERT(!environment_->set_jmp_buf_);
@@ -559,6 +824,25 @@ void Environment::initialize(const Setting& setting){
 	set_jmp_buf_ = false;
 	ignore_memory_assert_ = false;
 	used_memory_ = sizeof(Environment);
+	max_used_memory_ = used_memory_;
+	alloc_count_ = 0;
+	small_object_memory_ = 0;
+	pool_memory_ = 0;
+
+	soft_memory_limit_ = 0;
+	hard_memory_limit_ = 0;
+	gc_memory_line_ = 0;
+	hard_memory_line_ = 0;
+	memory_relax_line_ = 0;
+	memory_check_line_ = ~(uint_t)0;
+	checking_memory_limit_ = false;
+	memory_check_requested_ = false;
+
+	execution_tick_limit_ = 0;
+	execution_ticks_ = 0;
+	execution_deadline_ = 0;
+	execution_limited_ = false;
+	execution_limit_exceeded_ = false;
 	
 	string_space_.initialize();
 	object_space_.initialize();
@@ -572,6 +856,10 @@ void Environment::initialize(const Setting& setting){
 	vm_list_ = XNew<Array>();
 	text_map_ = XNew<Map>();
 
+#ifdef XTAL_ENABLE_VM_STATS
+	stats_space_.initialize();
+#endif
+
 	bind();
 
 	thread_space_.initialize(setting_.thread_lib);
@@ -598,6 +886,10 @@ void Environment::uninitialize(){
 
 	object_space_.halt_fibers(); // ファイバーを終わらせる
 
+#ifdef XTAL_ENABLE_VM_STATS
+	stats_space_.uninitialize();
+#endif
+
 	clear_cache();
 	full_gc();
 
@@ -614,6 +906,11 @@ void Environment::uninitialize(){
 	string_space_.uninitialize();
 	thread_space_.uninitialize();
 	object_space_.uninitialize();
+	code_list_.destroy();
+
+#ifdef XTAL_ENABLE_VM_STATS
+	stats_space_.destroy();
+#endif
 
 #ifndef XTAL_NO_SMALL_ALLOCATOR
 	so_alloc_.release();
@@ -683,6 +980,76 @@ AnyPtr alive_object(uint_t i){
 	}
 }
 
+void environment_stats(EnvironmentStats& stats){
+	Environment* env = environment_;
+
+	stats.used_memory = env->used_memory_;
+	stats.max_used_memory = env->max_used_memory_;
+	stats.alloc_count = env->alloc_count_;
+	stats.small_object_memory = env->small_object_memory_;
+	stats.pool_memory = env->pool_memory_;
+	stats.gc_count = env->object_space_.gc_count();
+	stats.full_gc_count = env->object_space_.full_gc_count();
+	stats.gc_pause_us = env->object_space_.gc_pause_time();
+	stats.max_gc_pause_us = env->object_space_.max_gc_pause_time();
+	stats.member_cache_hit_count = env->member_cache_table_.hit_count() + env->member_cache_table2_.hit_count();
+	stats.member_cache_miss_count = env->member_cache_table_.miss_count() + env->member_cache_table2_.miss_count();
+	stats.send_site_hit_count = env->send_site_cache_table_.hit_count();
+	stats.send_site_miss_count = env->send_site_cache_table_.miss_count();
+	stats.send_site_megamorphic_count = env->send_site_cache_table_.megamorphic_count();
+	stats.send_site_native_fast_call_count = env->send_site_cache_table_.native_fast_call_count();
+
+#ifdef XTAL_ENABLE_VM_STATS
+	stats.executed_inst_count = env->stats_space_.executed_inst_count();
+#else
+	stats.executed_inst_count = 0;
+#endif
+}
+
+MapPtr environment_stats_map(){
+	EnvironmentStats stats;
+	environment_stats(stats);
+
+	MapPtr ret = xnew<Map>();
+	ret->set_at(Xid(used_memory), stats.used_memory);
+	ret->set_at(Xid(max_used_memory), stats.max_used_memory);
+	ret->set_at(Xid(alloc_count), stats.alloc_count);
+	ret->set_at(Xid(small_object_memory), stats.small_object_memory);
+	ret->set_at(Xid(pool_memory), stats.pool_memory);
+	ret->set_at(Xid(gc_count), stats.gc_count);
+	ret->set_at(Xid(full_gc_count), stats.full_gc_count);
+	ret->set_at(Xid(gc_pause_us), stats.gc_pause_us);
+	ret->set_at(Xid(max_gc_pause_us), stats.max_gc_pause_us);
+	ret->set_at(Xid(member_cache_hit_count), stats.member_cache_hit_count);
+	ret->set_at(Xid(member_cache_miss_count), stats.member_cache_miss_count);
+	ret->set_at(Xid(send_site_hit_count), stats.send_site_hit_count);
+	ret->set_at(Xid(send_site_miss_count), stats.send_site_miss_count);
+	ret->set_at(Xid(send_site_megamorphic_count), stats.send_site_megamorphic_count);
+	ret->set_at(Xid(send_site_native_fast_call_count), stats.send_site_native_fast_call_count);
+	ret->set_at(Xid(executed_inst_count), stats.executed_inst_count);
+
+#ifdef XTAL_ENABLE_VM_STATS
+	environment_->stats_space_.store(ret);
+#endif
+
+	return ret;
+}
+
+void reset_environment_stats(){
+	Environment* env = environment_;
+
+	env->max_used_memory_ = env->used_memory_;
+	env->alloc_count_ = 0;
+	env->object_space_.reset_gc_stats();
+	env->member_cache_table_.hit_ = env->member_cache_table_.miss_ = 0;
+	env->member_cache_table2_.hit_ = env->member_cache_table2_.miss_ = 0;
+	env->send_site_cache_table_.hit_ = env->send_site_cache_table_.miss_ = env->send_site_cache_table_.megamorphic_ = env->send_site_cache_table_.native_fast_call_ = 0;
+
+#ifdef XTAL_ENABLE_VM_STATS
+	env->stats_space_.reset();
+#endif
+}
+
 const ClassPtr& cpp_class(CppClassSymbolData* key){
 	return environment_->object_space_.cpp_class(key);
 }
@@ -704,7 +1071,8 @@ void clear_cache(){
 	invalidate_cache_is();
 	environment_->member_cache_table_.clear();
 	environment_->member_cache_table2_.clear();
-	environment_->is_cache_table_.clear();
+	environment_->send_site_cache_table_.clear();
+	environment_->format_cache_table_.clear();
 }
 
 void invalidate_cache_member(){
@@ -878,9 +1246,12 @@ StreamPtr open(const StringPtr& file_name, const StringPtr& mode){
 }
 
 
-struct GCer{
-	GCer(int){}
-	~GCer(){ full_gc(); }
+// コンパイル中に作られたオブジェクトのうち、循環参照で残ったものを回収する
+// コンパイル前からあるオブジェクトは走査しないので、ヒープが大きくてもコンパイルのたびに止まらない
+struct CompileGCer{
+	uint_t first;
+	CompileGCer(){ first = environment_->object_space_.alive_object_count(); }
+	~CompileGCer(){ environment_->object_space_.collect_cycles_since(first); }
 };
 
 namespace{
@@ -898,7 +1269,7 @@ namespace{
 	
 	CodePtr compile_detail(const AnyPtr& source, const StringPtr& file_name){
 #ifndef XTAL_NO_PARSER
-		GCer gc(0);
+		CompileGCer gc;
 		CodeBuilder cb;
 		return cb.compile(create_xpeg(source, file_name), file_name);
 #else
@@ -933,10 +1304,204 @@ namespace{
 
 		return compile_detail(stream, file_name);
 	}
+
+	struct CodeCacheData : public Base{
+		CodeCacheData(){
+			enabled = false;
+			temp_count = 0;
+		}
+
+		bool enabled;
+		StringPtr dir;
+
+		// 一時ファイルの名前に付ける通し番号
+		uint_t temp_count;
+
+		void on_visit_members(Visitor& m){
+			Base::on_visit_members(m);
+			m & dir;
+		}
+	};
+
+	// キャッシュファイルの先頭に置く、コンパイラの種類を表す部分のバイト数
+	enum{
+		CODE_CACHE_STAMP_SIZE = 12,
+		CODE_CACHE_HEADER_SIZE = CODE_CACHE_STAMP_SIZE + 8*3
+	};
+
+	struct CodeCacheHeader{
+		u64 mtime;
+		u64 source_size;
+		u64 hash;
+	};
+
+	void code_cache_stamp(u8* stamp){
+		stamp[0] = 'x';
+		stamp[1] = 't';
+		stamp[2] = 'c';
+		stamp[3] = 'c';
+		stamp[4] = (u8)(Serializer::version()>>8);
+		stamp[5] = (u8)Serializer::version();
+		stamp[6] = (u8)InstMAX::NUMBER;
+		stamp[7] = (u8)sizeof(int_t);
+		stamp[8] = (u8)sizeof(float_t);
+		stamp[9] = (u8)sizeof(char_t);
+		stamp[10] = debug::is_debug_compile_enabled() ? 1 : 0;
+		stamp[11] = 0;
+	}
+
+	// FNV-1a
+	u64 code_cache_hash(const void* data, uint_t size){
+		const u8* p = (const u8*)data;
+		u64 h = ((u64)0xcbf29ce4<<32) | 0x84222325;
+		const u64 prime = ((u64)0x100<<32) | 0x1b3;
+		for(uint_t i=0; i<size; ++i){
+			h ^= p[i];
+			h *= prime;
+		}
+		return h;
+	}
+
+	StringPtr code_cache_name(const StringPtr& dir, const StringPtr& file_name){
+		if(dir->data_size()==0){
+			return Xf1("%s.cache", 0, file_name);
+		}
+
+		// 別のパスが同じ名前にならないよう、_自身も含めて2文字に置き換える
+		MemoryStreamPtr ms = xnew<MemoryStream>();
+		ms->put_s(dir);
+		ms->put_s(XTAL_STRING("/"));
+		const char_t* str = file_name->data();
+		for(uint_t i=0, sz=file_name->data_size(); i<sz; ++i){
+			char_t ch = str[i];
+			switch(ch){
+				XTAL_CASE('_'){ ms->put_s(XTAL_STRING("__")); }
+				XTAL_CASE('/'){ ms->put_s(XTAL_STRING("_s")); }
+				XTAL_CASE('\\'){ ms->put_s(XTAL_STRING("_b")); }
+				XTAL_CASE(':'){ ms->put_s(XTAL_STRING("_c")); }
+				XTAL_DEFAULT{ ms->put_s(&ch, 1); }
+			}
+		}
+		ms->put_s(XTAL_STRING(".cache"));
+		return ms->to_s();
+	}
+
+	MemoryStreamPtr read_code_cache(const StringPtr& cache_name, const u8* stamp, CodeCacheHeader& head){
+		SmartPtr<FileStream> fs = xnew<FileStream>(cache_name, XTAL_STRING("r"));
+		if(!fs->is_open()){
+			return nul<MemoryStream>();
+		}
+
+		MemoryStreamPtr ms = xnew<MemoryStream>();
+		ms->pour_all(fs);
+		fs->close();
+
+		if(ms->size()<CODE_CACHE_HEADER_SIZE || std::memcmp(ms->data(), stamp, CODE_CACHE_STAMP_SIZE)!=0){
+			return nul<MemoryStream>();
+		}
+
+		ms->seek(CODE_CACHE_STAMP_SIZE);
+		head.mtime = ms->get_u64be();
+		head.source_size = ms->get_u64be();
+		head.hash = ms->get_u64be();
+		return ms;
+	}
+
+	void write_code_cache(const StringPtr& cache_name, const u8* stamp, const CodeCacheHeader& head, const void* data, uint_t size){
+		MemoryStreamPtr out = xnew<MemoryStream>();
+		out->write(stamp, CODE_CACHE_STAMP_SIZE);
+		out->put_u64be(head.mtime);
+		out->put_u64be(head.source_size);
+		out->put_u64be(head.hash);
+		out->write(data, size);
+
+		// 書き込み途中のキャッシュが読まれないように、一時ファイルに書き出してから置き換える
+		// 一時ファイルの名前は、プロセスの番号と通し番号で他の書き込みと重ならないようにする
+		uint_t count = cpp_value<CodeCacheData>()->temp_count++;
+		StringPtr temp = Xf3("%s.%d.%d.tmp", 0, cache_name, 1, (int_t)filesystem_lib()->process_id(), 2, (int_t)count);
+		SmartPtr<FileStream> fs = xnew<FileStream>(temp, XTAL_STRING("w"));
+		if(!fs->is_open()){
+			return;
+		}
+
+		bool written = fs->write(out->data(), out->size())==out->size();
+		fs->close();
+
+		if(!written || !filesystem_lib()->rename(temp->c_str(), cache_name->c_str())){
+			filesystem_lib()->remove(temp->c_str());
+		}
+	}
+
+	CodePtr compile_file_with_cache(const StreamPtr& fs, const StringPtr& file_name, const StringPtr& dir){
+		StringPtr cache_name = code_cache_name(dir, file_name);
+		u8 stamp[CODE_CACHE_STAMP_SIZE];
+		code_cache_stamp(stamp);
+
+		CodeCacheHeader head;
+		head.mtime = filesystem_lib()->mtime(file_name->c_str());
+		head.source_size = fs->size();
+		head.hash = 0;
+
+		CodeCacheHeader cached = {0, 0, 0};
+		MemoryStreamPtr cache = read_code_cache(cache_name, stamp, cached);
+
+		// 更新時刻とサイズが記録と同じなら、ソースを読まずにキャッシュを使う
+		// キャッシュと同じ秒内にソースが書き換えられた可能性がある場合は、内容のハッシュで確かめる
+		if(cache && head.mtime!=0 && cached.mtime==head.mtime && cached.source_size==head.source_size &&
+			head.mtime<filesystem_lib()->mtime(cache_name->c_str())){
+			if(CodePtr code = ptr_cast<Code>(cache->deserialize())){
+				fs->close();
+				return code;
+			}
+
+			XTAL_CATCH_EXCEPT(e){}
+			cache = nul<MemoryStream>();
+		}
+
+		MemoryStreamPtr source = xnew<MemoryStream>();
+		source->pour_all(fs);
+		fs->close();
+		source->seek(0);
+		head.hash = code_cache_hash(source->data(), source->size());
+
+		// 内容が同じなら、キャッシュを使って記録された更新時刻だけを新しくする
+		if(cache && cached.hash==head.hash && cached.source_size==head.source_size){
+			if(CodePtr code = ptr_cast<Code>(cache->deserialize())){
+				write_code_cache(cache_name, stamp, head, (const u8*)cache->data()+CODE_CACHE_HEADER_SIZE, cache->size()-CODE_CACHE_HEADER_SIZE);
+				return code;
+			}
+
+			XTAL_CATCH_EXCEPT(e){}
+		}
+
+		CodePtr code = compile_or_deserialize(source, file_name);
+		if(!code){
+			return code;
+		}
+
+		// 既にバイトコードのファイルはキャッシュしない
+		if(source->size()>=4 && std::memcmp(source->data(), "xtal", 4)==0){
+			return code;
+		}
+
+		MemoryStreamPtr payload = xnew<MemoryStream>();
+		payload->serialize(code);
+		XTAL_CATCH_EXCEPT(e){
+			return code;
+		}
+
+		write_code_cache(cache_name, stamp, head, payload->data(), payload->size());
+		return code;
+	}
 }
 
 CodePtr compile_file(const StringPtr& file_name){
 	if(StreamPtr fs = open(file_name, XTAL_STRING("r"))){
+		const SmartPtr<CodeCacheData>& cache = cpp_value<CodeCacheData>();
+		if(cache->enabled){
+			return compile_file_with_cache(fs, file_name, cache->dir);
+		}
+
 		CodePtr ret = compile_or_deserialize(fs, file_name);
 		fs->close();
 		return ret;
@@ -944,6 +1509,20 @@ CodePtr compile_file(const StringPtr& file_name){
 	return nul<Code>();
 }
 
+void enable_code_cache(const StringPtr& dir){
+	const SmartPtr<CodeCacheData>& cache = cpp_value<CodeCacheData>();
+	cache->enabled = true;
+	cache->dir = dir;
+}
+
+void disable_code_cache(){
+	cpp_value<CodeCacheData>()->enabled = false;
+}
+
+bool is_code_cache_enabled(){
+	return cpp_value<CodeCacheData>()->enabled;
+}
+
 CodePtr compile(const AnyPtr& source, const StringPtr& source_name){
 	return compile_or_deserialize(source, source_name);
 }
@@ -1018,7 +1597,7 @@ CodePtr require_source(const StringPtr& name){
 	}
 
 	StringPtr temp = Xf1("%s.xtalc", 0, name);
-	if(StreamPtr fs = open(name, Xid(r))){
+	if(StreamPtr fs = open(temp, Xid(r))){
 		if(CodePtr code = ptr_cast<Code>(fs->deserialize())){
 			return code;
 		}
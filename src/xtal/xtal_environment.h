@@ -64,7 +64,16 @@ public:
 	virtual void signal_event(void* /*event_object*/){}
 
 	virtual void yield(){}
-	virtual void sleep(float_t /*sec*/){}
+	/**
+	* \brief sec秒の間実行を止める
+	*/
+	virtual void sleep(float_t sec);
+
+	/**
+	* \brief 単調増加する時刻をマイクロ秒単位で返す
+	* 既定の実装は壁時計の経過時間を返す。プロセスのCPU時間ではない。
+	*/
+	virtual u64 clock();
 };
 
 /**
@@ -87,6 +96,14 @@ public:
 	virtual uint_t write_stderr_stream(void* /*stderr_stream_object*/, const void* /*src*/, uint_t /*size*/){ return 0; }
 };
 
+/**
+* \brief ポーラーが返すファイルディスクリプタの準備状態
+*/
+struct PollEvent{
+	int_t fd;
+	int_t events;
+};
+
 /**
 * \brief ファイルシステムライブラリ
 */
@@ -97,6 +114,20 @@ public:
 	virtual bool is_directory(const char_t* /*path*/){ return false; }
 	virtual uint_t mtime(const char_t*){ return 0; }
 
+	/**
+	* \brief fromをtoに名前変更する
+	* toが既にある場合は置き換える。置き換えは途中の状態が見えないように行われなければならない。
+	*/
+	virtual bool rename(const char_t* /*from*/, const char_t* /*to*/){ return false; }
+
+	virtual bool remove(const char_t* /*path*/){ return false; }
+
+	/**
+	* \brief 実行中のプロセスを識別する番号を返す
+	* 一時ファイルの名前が他のプロセスと重ならないようにするために使う。
+	*/
+	virtual uint_t process_id(){ return 0; }
+
 	virtual void* new_file_stream(const char_t* /*path*/, const char_t* /*flags*/){ return 0; }
 	virtual void delete_file_stream(void* /*file_stream_object*/){}
 	virtual uint_t read_file_stream(void* /*file_stream_object*/, void* /*dest*/, uint_t /*size*/){ return 0; }
@@ -111,6 +142,30 @@ public:
 	virtual void delete_entries(void* /*entries_object*/){}
 	virtual const char_t* next_entries(void* /*entries_object*/){ return 0; }
 	virtual void break_entries(void* /*entries_object*/){}
+
+	enum{
+		POLL_READ = 1<<0,
+		POLL_WRITE = 1<<1
+	};
+
+	/**
+	* \brief ファイルディスクリプタの準備状態を待つポーラーを生成する
+	* サポートしない場合は0を返す。
+	*/
+	virtual void* new_poller(){ return 0; }
+	virtual void delete_poller(void* /*poller_object*/){}
+
+	/**
+	* \brief fdの監視するイベントをPOLL_READ、POLL_WRITEの組み合わせで設定する
+	* eventsが0の場合は監視を解除する。
+	*/
+	virtual bool watch_poller(void* /*poller_object*/, int_t /*fd*/, int_t /*events*/){ return false; }
+
+	/**
+	* \brief 準備ができたfdを最大capacity個eventsに格納し、その数を返す
+	* timeoutは秒単位で、負の場合は無期限に待つ。
+	*/
+	virtual int_t wait_poller(void* /*poller_object*/, float_t /*timeout*/, PollEvent* /*events*/, int_t /*capacity*/){ return 0; }
 };
 
 /**
@@ -290,10 +345,161 @@ void enable_gc();
 
 void set_gc_stress(bool b);
 
+/**
+* \xbind lib::builtin
+* \brief 実行環境のメモリ使用量の上限を設定する
+*
+* 使用メモリ量がsoft_limitを超えるとgcが実行される。
+* gcしてもsoft_limitを下回らなかった場合、次のgcはsoft_limitの1/8だけ使用量が増えたときに行われる。
+* 使用メモリ量がhard_limitを超えるとfull_gcが実行され、それでも超えている場合はMemoryErrorが送出される。
+* 上限を超えたかどうかは確保の際に調べるが、gcとMemoryErrorの送出は実行中のVMが次に分岐か関数呼び出しをするときに行われる。
+* Array::resize、Array::upsize、MemoryStream、数値配列はhard_limitを超えて大きくならない。
+* それ以外の確保は行われるので、例外を捕まえた後も実行は続けられる。
+* full_gcしても超えている場合、次のfull_gcはhard_limitの1/8だけ使用量が増えるか、上限を下回るまで行われない。
+* どちらも0を指定すると上限無しとなる。gcが無効化されている間は検査されない。
+*/
+void set_memory_limit(uint_t soft_limit, uint_t hard_limit);
+
+/**
+* \brief sizeバイト確保してもハード上限を超えないか調べる
+* 超える場合はfull_gcを実行し、それでも超えるならMemoryErrorを設定してfalseを返す。
+* コンテナを大きくする前に呼び、falseが返ったら大きくしないこと。
+*/
+bool reserve_memory(uint_t size);
+
+/**
+* \brief xmallocが上限を超えたことを記録していれば、gcを実行して上限を調べ直す
+* xmallocの中ではgcも例外の生成も行わないので、VMachineが分岐か関数呼び出しの際に呼ぶ。
+* gcしてもハード上限を超えている場合はfalseを返す。MemoryErrorは呼び出し側が送出すること。
+*/
+bool check_requested_memory_limit();
+
+/**
+* \xbind lib::builtin
+* \brief gcを実行するメモリ使用量の上限を返す
+*/
+uint_t soft_memory_limit();
+
+/**
+* \xbind lib::builtin
+* \brief MemoryErrorを送出するメモリ使用量の上限を返す
+*/
+uint_t hard_memory_limit();
+
+/**
+* \xbind lib::builtin
+* \brief 実行環境で実行できる量の上限を設定する
+*
+* ticksは後方への分岐と関数呼び出しの回数、usecはこの関数を呼んでからの経過時間(マイクロ秒)の上限である。
+* 上限の検査は分岐と呼び出しのおよそ1000回に1回しか行われないので、多少超えてから止まることがある。
+* 上限に達したとき、実行中の関数がFiberの中にあればそのFiberはyieldしたのと同じように中断され、再度呼び出すと続きから実行される。
+* そうでなければExecutionLimitErrorが送出される。
+* 上限に達した状態はset_execution_limitかclear_execution_limitを呼ぶまで続く。
+* どちらも0を指定すると上限無しとなる。
+*/
+void set_execution_limit(uint_t ticks, uint_t usec);
+
+/**
+* \xbind lib::builtin
+* \brief 実行できる量の上限を取り除く
+*/
+void clear_execution_limit();
+
+/**
+* \xbind lib::builtin
+* \brief 実行できる量の上限に達したか調べる
+*/
+bool execution_limit_exceeded();
+
+/**
+* \xbind lib::builtin
+* \brief 実行できる分岐と関数呼び出しの残り回数を返す
+*/
+uint_t remaining_execution_ticks();
+
 uint_t alive_object_count();
 
 AnyPtr alive_object(uint_t i);
 
+/**
+* \brief 実行環境の統計情報
+*/
+struct EnvironmentStats{
+	/// \brief 現在の使用メモリ量(バイト)
+	uint_t used_memory;
+
+	/// \brief reset_environment_statsを呼んでからの最大使用メモリ量(バイト)
+	uint_t max_used_memory;
+
+	/// \brief xmallocが呼ばれた回数
+	uint_t alloc_count;
+
+	/// \brief 現在の使用メモリ量のうち、小さいオブジェクト用アロケータから確保されている量(バイト)
+	uint_t small_object_memory;
+
+	/// \brief 小さいオブジェクト用のメモリプールが確保している量(バイト)。used_memoryには含まれない
+	uint_t pool_memory;
+
+	/// \brief gcが実行された回数
+	uint_t gc_count;
+
+	/// \brief full_gcが実行された回数
+	uint_t full_gc_count;
+
+	/// \brief gcとfull_gcにかかった時間の合計(マイクロ秒)
+	uint_t gc_pause_us;
+
+	/// \brief 一回のgcかfull_gcにかかった最大の時間(マイクロ秒)
+	uint_t max_gc_pause_us;
+
+	/// \brief メンバキャッシュに当たった回数
+	uint_t member_cache_hit_count;
+
+	/// \brief メンバキャッシュを外した回数
+	uint_t member_cache_miss_count;
+
+	/// \brief 送信命令ごとのキャッシュに当たった回数
+	uint_t send_site_hit_count;
+
+	/// \brief 送信命令ごとのキャッシュを外した回数
+	uint_t send_site_miss_count;
+
+	/// \brief レシーバのクラスの種類が多すぎて、送信命令ごとのキャッシュをやめた回数
+	uint_t send_site_megamorphic_count;
+
+	/// \brief 送信命令で型チェックを省略してネイティブ関数を呼び出した回数
+	uint_t send_site_native_fast_call_count;
+
+	/// \brief 実行された命令数。XTAL_ENABLE_VM_STATSが定義されていない場合は常に0
+	uint_t executed_inst_count;
+};
+
+/**
+* \brief 実行環境の統計情報を取得する
+*/
+void environment_stats(EnvironmentStats& stats);
+
+/**
+* \xbind lib::builtin
+* \brief 実行環境の統計情報を連想配列で返す
+*
+* EnvironmentStatsの各値に加えて、XTAL_ENABLE_VM_STATSが定義されている場合は次の値を含む。
+* insts: 命令ごとの実行回数
+* slow_paths: 算術演算や比較が数値以外のためにメソッド呼び出しになった回数を命令ごとに数えたもの
+* codes: コードごとの実行命令数
+* functions: 関数ごとのcode、name、lineno、calls(呼び出し回数)、insts(その関数自身が実行した命令数)の配列
+* allocations: C++のクラスごとのオブジェクト生成数
+* instances: スクリプトで定義されたクラスごとのインスタンス生成数
+*/
+MapPtr environment_stats_map();
+
+/**
+* \xbind lib::builtin
+* \brief 実行環境の統計情報を0に戻す
+* 最大使用メモリ量は現在の使用メモリ量に戻る。
+*/
+void reset_environment_stats();
+
 /////////////////////////////////////////////////////
 
 /**
@@ -615,6 +821,31 @@ CodePtr compile(const AnyPtr& source, const StringPtr& source_name = empty_strin
 */
 AnyPtr load(const StringPtr& file_name);
 
+/**
+* \xbind lib::builtin
+* \brief compile_file、load、requireでソースファイルをコンパイルした結果をファイルにキャッシュするようにする
+*
+* dirが空文字列の場合、キャッシュはソースファイルと同じ場所に「ソースファイル名.cache」として保存される。
+* そうでない場合は、ソースファイルのパスの_を__に、/を_sに、\\を_bに、:を_cに置き換えた名前でdirの中に保存される。
+* キャッシュにはソースの内容のハッシュ値、バイトコードの形式、デバッグコンパイルの有無、ソースの更新時刻とサイズが記録される。
+* 更新時刻とサイズが一致すればソースを読まずにキャッシュを使い、一致しなければソースのハッシュ値で照合する。
+* キャッシュは一時ファイルに書き出してから名前変更で置き換えるので、書き込み途中のものが読まれることはない。
+* FilesystemLib::renameをサポートしない環境では、キャッシュは書き込まれない。
+*/
+void enable_code_cache(const StringPtr& dir);
+
+/**
+* \xbind lib::builtin
+* \brief コンパイル結果のキャッシュを使わないようにする
+*/
+void disable_code_cache();
+
+/**
+* \xbind lib::builtin
+* \brief コンパイル結果のキャッシュが有効か調べる
+*/
+bool is_code_cache_enabled();
+
 //@}
 
 CodePtr source(const char_t* src, int_t size);
@@ -10,13 +10,44 @@ Exception::Exception(const AnyPtr& message){
 void Exception::initialize(const AnyPtr& message){
 	message_ = message->to_s();
 	backtrace_ = XNew<Array>();
+	frame_funs_.clear();
+	frame_codes_.clear();
+	frame_pcs_.clear();
 }
 
 void Exception::append_backtrace(const AnyPtr& file, int_t line, const AnyPtr& function_name){
+	flush_backtrace();
 	backtrace_->push_back(Xf3("\t%s:%d: in %s", 0, file, 1, line, 2, function_name));
 }
 
+void Exception::append_backtrace_frame(const MethodPtr& fun, const CodePtr& code, const inst_t* pc){
+	frame_funs_.push_back(fun);
+	frame_codes_.push_back(code);
+	frame_pcs_.push_back((u32)(pc - code->bytecode_data()));
+}
+
+void Exception::flush_backtrace(){
+	if(frame_funs_.empty()){
+		return;
+	}
+
+	for(uint_t i=0, sz=frame_funs_.size(); i<sz; ++i){
+		const MethodPtr& fun = unchecked_ptr_cast<Method>(frame_funs_.at(i));
+		const CodePtr& code = unchecked_ptr_cast<Code>(frame_codes_.at(i));
+		const inst_t* pc = code->bytecode_data() + frame_pcs_[i];
+		backtrace_->push_back(Xf3("\t%s:%d: in %s", 
+			0, code->source_file_name(), 
+			1, code->compliant_lineno(pc), 
+			2, code->fun_name(code->compliant_fun_info(pc), fun)));
+	}
+
+	frame_funs_.clear();
+	frame_codes_.clear();
+	frame_pcs_.clear();
+}
+
 StringPtr Exception::to_s(){
+	flush_backtrace();
 	MemoryStreamPtr mm = xnew<MemoryStream>();
 	mm->put_s(get_class()->object_name());
 	mm->put_s(Xs(": "));
@@ -93,6 +124,10 @@ void set_argument_type_error(const AnyPtr& object, int_t no, const ClassPtr& req
 			type, type->object_name())));
 }
 
+void set_array_size_error(int_t size, const VMachinePtr& vm){
+	vm->set_except(cpp_class<ArgumentError>()->call(Xt1("XRE1042", size, size)));
+}
+
 void set_argument_num_error(const AnyPtr& funtion_name, int_t n, int_t min_count, int_t max_count, const VMachinePtr& vm){
 	if(min_count==0 && max_count==0){
 		vm->set_except(cpp_class<ArgumentError>()->call(Xt2("XRE1007", object, funtion_name, value, n)));
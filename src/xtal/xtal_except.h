@@ -30,6 +30,13 @@ public:
 	*/
 	void append_backtrace(const AnyPtr& file, int_t line, const AnyPtr& function_name = empty_string);
 
+	/**
+	* \brief 関数と、実行していたコードとその実行位置をバックトレースに追加する
+	* 文字列への整形は、backtraceかto_sが呼ばれるまで行わない。
+	* 関数のコードはその後に差し替えられることがあるので、実行していたコードを別に持っておく。
+	*/
+	void append_backtrace_frame(const MethodPtr& fun, const CodePtr& code, const inst_t* pc);
+
 	/**
 	* \xbind
 	* \brief 文字列化する
@@ -49,17 +56,27 @@ public:
 	* \brief バックトレースの情報を要素とするIteratorを返す
 	*/
 	AnyPtr backtrace(){
+		flush_backtrace();
 		return backtrace_->each();
 	}
 
 	void on_visit_members(Visitor& m){
 		Base::on_visit_members(m);
-		m & message_ & backtrace_;
+		m & message_ & backtrace_ & frame_funs_ & frame_codes_;
 	}
 
+private:
+	void flush_backtrace();
+
 private:
 	StringPtr message_;
 	ArrayPtr backtrace_;
+
+	// まだ文字列にしていないバックトレース
+	// 関数と、実行していたコードと、そのコードの先頭からの命令位置を並べて持つ
+	xarray frame_funs_;
+	xarray frame_codes_;
+	PODArray<u32> frame_pcs_;
 };
 
 class StandardError{};
@@ -76,6 +93,8 @@ class RedefinedError{};
 class AccessibilityError{};
 class AssertionFailed{};
 class CompileError{};
+class MemoryError{};
+class ExecutionLimitError{};
 
 AnyPtr unsupported_error(const AnyPtr& target, const IDPtr& primary_key, const AnyPtr& secondary_key);
 AnyPtr filelocal_unsupported_error(const CodePtr& code, const IDPtr& primary_key);
@@ -84,6 +103,7 @@ void set_unsupported_error(const AnyPtr& target, const IDPtr& primary_key, const
 void set_runtime_error(const AnyPtr& arg, const VMachinePtr& vm = vmachine());
 void set_argument_type_error(const AnyPtr& object, int_t no, const ClassPtr& required, const ClassPtr& type, const VMachinePtr& vm = vmachine());
 void set_argument_num_error(const AnyPtr& funtion_name, int_t n, int_t min_count, int_t max_count, const VMachinePtr& vm = vmachine());
+void set_array_size_error(int_t size, const VMachinePtr& vm = vmachine());
 
 /**
 * \brief 例外を設定する
@@ -14,4 +14,16 @@ bool is_directory(const StringPtr& path){
 	return filesystem_lib()->is_directory(path->c_str());
 }
 
+uint_t mtime(const StringPtr& path){
+	return filesystem_lib()->mtime(path->c_str());
+}
+
+bool rename(const StringPtr& from, const StringPtr& to){
+	return filesystem_lib()->rename(from->c_str(), to->c_str());
+}
+
+bool remove(const StringPtr& path){
+	return filesystem_lib()->remove(path->c_str());
+}
+
 }}
@@ -29,6 +29,26 @@ StreamPtr open(const StringPtr& file_name, const StringPtr& flags);
 */
 bool is_directory(const StringPtr& path);
 
+/**
+* \xbind lib::builtin::filesystem
+* \brief ファイルの更新時刻を返す
+* ファイルが無い場合は0を返す。
+*/
+uint_t mtime(const StringPtr& path);
+
+/**
+* \xbind lib::builtin::filesystem
+* \brief ファイルの名前を変更する
+* toが既にある場合は置き換える。
+*/
+bool rename(const StringPtr& from, const StringPtr& to);
+
+/**
+* \xbind lib::builtin::filesystem
+* \brief ファイルを削除する
+*/
+bool remove(const StringPtr& path);
+
 /**
 * \xbind lib::builtin::filesystem
 * \brief path以下のエントリを列挙するIteratorを返す
@@ -82,6 +82,11 @@ Frame::~Frame(){
 		members_.detach();
 	}
 
+	clear_nodes();
+	xfree(buckets_, sizeof(Node*)*buckets_capa_);
+}
+
+void Frame::clear_nodes(){
 	for(uint_t i=0; i<buckets_capa_; ++i){
 		Node* node = buckets_[i];
 		while(node!=0){
@@ -94,8 +99,10 @@ Frame::~Frame(){
 			}
 			node = next;
 		}	
+		buckets_[i] = 0;
 	}
-	xfree(buckets_, sizeof(Node*)*buckets_capa_);
+
+	flags_ &= ~FLAG_INITIALIZED_MEMBERS;
 }
 
 void Frame::expand_buckets(){
@@ -260,10 +267,13 @@ bool Frame::replace_member(const IDPtr& primary_key, const AnyPtr& value){
 	make_members();
 
 	if(Node* node = find_node(primary_key, undefined)){
-		if(!node->nocache()){
+		set_member_direct(node->num, value);
+		if(flags_&FLAG_CLASS){
+			static_cast<Class*>(this)->mutate_members();
+		}
+		else if(!node->nocache()){
 			invalidate_cache_member();
 		}
-		set_member_direct(node->num, value);
 		return true;
 	}
 
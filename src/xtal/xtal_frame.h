@@ -76,6 +76,13 @@ public:
 	* \brief i番目のメンバーをダイレクトに設定。
 	*/
 	void set_member_direct(int_t i, const AnyPtr& value){
+#ifndef XTAL_NO_DEFERRED_REF_COUNT
+		if(flags_ & FLAG_ATTACHED){
+			// VMのレジスタを指しているので、参照カウンタは操作しない
+			XTAL_detail_copy((AnyPtr&)members_.at(i), value);
+			return;
+		}
+#endif
 		members_.set_at(i, value);
 	}
 
@@ -128,6 +135,8 @@ protected:
 
 	void expand_buckets();
 
+	void clear_nodes();
+
 	Node* find_node(const IDPtr& primary_key, const AnyPtr& secondary_key);
 
 	Node* insert_node(const IDPtr& primary_key, const AnyPtr& secondary_key, uint_t num);
@@ -148,7 +157,11 @@ protected:
 		FLAG_ORPHAN = 1<<9,
 		FLAG_INITIALIZED_MEMBERS = 1<<10,
 
-		FLAG_OPTIONS = 1<<11	
+		FLAG_OPTIONS = 1<<11,
+
+		FLAG_CLASS = 1<<12,
+
+		FLAG_ATTACHED = 1<<13
 	};
 
 	uint_t orphan(){
@@ -156,7 +169,7 @@ protected:
 	}
 
 	void set_orphan(){
-		flags_ |= FLAG_ORPHAN;
+		flags_ = (u16)((flags_ | FLAG_ORPHAN) & ~FLAG_ATTACHED);
 	}
 	
 	void unset_orphan(){
@@ -178,13 +191,20 @@ public:
 	void on_visit_members(Visitor& m);
 
 	void attach(ScopeInfo* info, Code* code, AnyPtr* values, uint_t size){
+		// 再利用されたフレームに前のスコープの名前表が残らないようにする
+		if(initialized_members()){
+			clear_nodes();
+		}
+
 		scope_info_ = info;
 		code_ = code;
 		members_.attach(values, size);
+		flags_ |= FLAG_ATTACHED;
 	}
 
 	void detach(){
 		members_.detach();
+		flags_ &= ~FLAG_ATTACHED;
 		//outer_ = null;
 		//code_ = null;
 	}
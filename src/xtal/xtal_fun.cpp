@@ -146,13 +146,29 @@ void InstanceVariableSetter::on_rawcall(const VMachinePtr& vm) const{
 }
 
 Method::Method(const FramePtr& outer, const CodePtr& code, FunInfo* info)
-	:outer_(outer), code_(code), info_(info), source_(code->bytecode_data()+info->pc){
+	:outer_(outer), code_(code), info_(info){
 }
 
 const IDPtr& Method::param_name_at(size_t i){ 
 	return code_->identifier(i+info_->variable_identifier_offset); 
 }
 
+bool Method::reload_body(const MethodPtr& m){
+	if(XTAL_detail_type(*this)!=XTAL_detail_type(*m) || XTAL_detail_type(*this)==TYPE_FIBER){
+		return false;
+	}
+
+	if(param_size()!=m->param_size() || extendable_param()!=m->extendable_param()){
+		return false;
+	}
+
+	// 差し替え前のコードを実行中のフレームは、そのコードをFunFrame::codeで保持している
+	outer_ = m->outer_;
+	code_ = m->code_;
+	info_ = m->info_;
+	return true;
+}
+
 int_t Method::param_size(){ 
 	return info_->variable_size-(int)extendable_param(); 
 }	
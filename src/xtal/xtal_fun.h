@@ -164,7 +164,7 @@ public:
 
 	int_t pc(){ return info_->pc; }
 
-	const inst_t* source(){ return source_; }
+	const inst_t* source(){ return code_->bytecode_data()+info_->pc; }
 
 	const IDPtr& param_name_at(size_t i);
 
@@ -176,6 +176,15 @@ public:
 
 	//void set_info(FunInfo* fc){ info_ = fc; }
 
+	/**
+	* \brief リロードで生成された同じ形のメソッドの本体に差し替える
+	* メソッドオブジェクト自体は維持されるので、このメソッドを保持しているメンバキャッシュはそのまま有効である。
+	* 種類や引数の形が異なる場合は差し替えない。
+	* \retval true 差し替えた
+	* \retval false 差し替えられなかった
+	*/
+	bool reload_body(const MethodPtr& m);
+
 	bool check_arg(const VMachinePtr& vm);
 
 	const IDPtr& object_temporary_name();
@@ -193,7 +202,6 @@ private:
 	BasePtr<Frame> outer_;
 	BasePtr<Code> code_;
 	FunInfo* info_;
-	const inst_t* source_;
 
 	friend class VMachine;
 };
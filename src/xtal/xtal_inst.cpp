@@ -156,6 +156,11 @@ StringPtr inspect_range(const CodePtr& code, const inst_t* start, const inst_t*
 		XTAL_INST_CASE(InstThrow);
 		XTAL_INST_CASE(InstAssert);
 		XTAL_INST_CASE(InstBreakPoint);
+		XTAL_INST_CASE(InstIncIfLt);
+		XTAL_INST_CASE(InstLoadInt1ByteAdd);
+		XTAL_INST_CASE(InstLoadInt1ByteSub);
+		XTAL_INST_CASE(InstLoadInt1ByteIfLt);
+		XTAL_INST_CASE(InstInstanceVariableAddAssign);
 		XTAL_INST_CASE(InstMAX);
 //}}INST_INSPECT}
 	} ms->put_s(Xf("%04d(%04d):%s\n")->call((int_t)(pc-start), code->compliant_lineno(pc), temp)->to_s()); pc += sz; }
@@ -259,6 +264,11 @@ int_t inst_size(uint_t no){
 	InstThrow::ISIZE,
 	InstAssert::ISIZE,
 	InstBreakPoint::ISIZE,
+	InstIncIfLt::ISIZE,
+	InstLoadInt1ByteAdd::ISIZE,
+	InstLoadInt1ByteSub::ISIZE,
+	InstLoadInt1ByteIfLt::ISIZE,
+	InstInstanceVariableAddAssign::ISIZE,
 	InstMAX::ISIZE,
 //}}INST_SIZE}
 	};
@@ -270,4 +280,107 @@ int_t inst_size(uint_t no){
 	return sizelist[no];
 }
 
+const char_t* inst_name(uint_t no){
+	static const char_t* namelist[] = {
+//{INST_NAME{{
+	XTAL_L("InstLine"),
+	XTAL_L("InstLoadValue"),
+	XTAL_L("InstLoadConstant"),
+	XTAL_L("InstLoadInt1Byte"),
+	XTAL_L("InstLoadFloat1Byte"),
+	XTAL_L("InstLoadCallee"),
+	XTAL_L("InstLoadThis"),
+	XTAL_L("InstCopy"),
+	XTAL_L("InstInc"),
+	XTAL_L("InstDec"),
+	XTAL_L("InstPos"),
+	XTAL_L("InstNeg"),
+	XTAL_L("InstCom"),
+	XTAL_L("InstAdd"),
+	XTAL_L("InstSub"),
+	XTAL_L("InstCat"),
+	XTAL_L("InstMul"),
+	XTAL_L("InstDiv"),
+	XTAL_L("InstMod"),
+	XTAL_L("InstAnd"),
+	XTAL_L("InstOr"),
+	XTAL_L("InstXor"),
+	XTAL_L("InstShl"),
+	XTAL_L("InstShr"),
+	XTAL_L("InstUshr"),
+	XTAL_L("InstAt"),
+	XTAL_L("InstSetAt"),
+	XTAL_L("InstGoto"),
+	XTAL_L("InstNot"),
+	XTAL_L("InstIf"),
+	XTAL_L("InstIfEq"),
+	XTAL_L("InstIfLt"),
+	XTAL_L("InstIfRawEq"),
+	XTAL_L("InstIfIs"),
+	XTAL_L("InstIfIn"),
+	XTAL_L("InstIfUndefined"),
+	XTAL_L("InstIfDebug"),
+	XTAL_L("InstPush"),
+	XTAL_L("InstPop"),
+	XTAL_L("InstAdjustValues"),
+	XTAL_L("InstLocalVariable"),
+	XTAL_L("InstSetLocalVariable"),
+	XTAL_L("InstInstanceVariable"),
+	XTAL_L("InstSetInstanceVariable"),
+	XTAL_L("InstInstanceVariableByName"),
+	XTAL_L("InstSetInstanceVariableByName"),
+	XTAL_L("InstFilelocalVariable"),
+	XTAL_L("InstSetFilelocalVariable"),
+	XTAL_L("InstFilelocalVariableByName"),
+	XTAL_L("InstSetFilelocalVariableByName"),
+	XTAL_L("InstMember"),
+	XTAL_L("InstMemberEx"),
+	XTAL_L("InstCall"),
+	XTAL_L("InstCallEx"),
+	XTAL_L("InstSend"),
+	XTAL_L("InstSendEx"),
+	XTAL_L("InstProperty"),
+	XTAL_L("InstSetProperty"),
+	XTAL_L("InstScopeBegin"),
+	XTAL_L("InstScopeEnd"),
+	XTAL_L("InstReturn"),
+	XTAL_L("InstYield"),
+	XTAL_L("InstExit"),
+	XTAL_L("InstRange"),
+	XTAL_L("InstOnce"),
+	XTAL_L("InstSetOnce"),
+	XTAL_L("InstMakeArray"),
+	XTAL_L("InstArrayAppend"),
+	XTAL_L("InstMakeMap"),
+	XTAL_L("InstMapInsert"),
+	XTAL_L("InstMapSetDefault"),
+	XTAL_L("InstClassBegin"),
+	XTAL_L("InstClassEnd"),
+	XTAL_L("InstDefineClassMember"),
+	XTAL_L("InstDefineMember"),
+	XTAL_L("InstMakeFun"),
+	XTAL_L("InstMakeInstanceVariableAccessor"),
+	XTAL_L("InstTryBegin"),
+	XTAL_L("InstTryEnd"),
+	XTAL_L("InstPushGoto"),
+	XTAL_L("InstPopGoto"),
+	XTAL_L("InstThrow"),
+	XTAL_L("InstAssert"),
+	XTAL_L("InstBreakPoint"),
+	XTAL_L("InstIncIfLt"),
+	XTAL_L("InstLoadInt1ByteAdd"),
+	XTAL_L("InstLoadInt1ByteSub"),
+	XTAL_L("InstLoadInt1ByteIfLt"),
+	XTAL_L("InstInstanceVariableAddAssign"),
+	XTAL_L("InstMAX"),
+//}}INST_NAME}
+	};
+
+	if(no>=InstMAX::NUMBER){
+		return XTAL_L("?");
+	}
+
+	return namelist[no];
+}
+
 }
@@ -43,6 +43,11 @@ StringPtr inspect_range(const CodePtr& code, const inst_t* start, const inst_t*
 
 int_t inst_size(uint_t no);
 
+/**
+* \brief 命令番号に対応する命令名を返す
+*/
+const char_t* inst_name(uint_t no);
+
 inline int_t inst_inspect_i8(int value, const inst_t*, const CodePtr&){ return (int_t)value; }
 inline int_t inst_inspect_u8(int value, const inst_t*, const CodePtr&){ return (int_t)value; }
 inline int_t inst_inspect_i16(int value, const inst_t*, const CodePtr&){ return (int_t)value; }
@@ -460,8 +465,8 @@ inline void XTAL_set_op_i8(int A, int B, inst_t* x, int value){
 
 /**
 * \internal
-* \brief 行が変わるごとに挟まれる命令
-*
+* \brief 何もしない命令
+* 以前は行が変わるごとに挟まれていた。行情報はCodeの行番号表から得るので、今は生成されない。
 */
 XTAL_DEF_INST_0(0, InstLine);
 
@@ -499,7 +504,7 @@ XTAL_DEF_INST_2(2, InstLoadConstant,
 */
 XTAL_DEF_INST_2(3, InstLoadInt1Byte,
 	i8, result,  // 値を代入するローカル変数番号
-    i8, value
+	i8, value
 );
 
 /**
@@ -509,7 +514,7 @@ XTAL_DEF_INST_2(3, InstLoadInt1Byte,
 */
 XTAL_DEF_INST_2(4, InstLoadFloat1Byte,
 	i8, result,  // 値を代入するローカル変数番号
-    i8, value
+	i8, value
 );
 
 /**
@@ -793,8 +798,8 @@ XTAL_DEF_INST_3(41, InstSetLocalVariable,
 */
 XTAL_DEF_INST_3(42, InstInstanceVariable,
 	i8, result,  // 値を代入するローカル変数番号
-    u16, info_number,
-    u8, number
+	u16, info_number,
+	u8, number
 );
 
 /**
@@ -804,8 +809,8 @@ XTAL_DEF_INST_3(42, InstInstanceVariable,
 */
 XTAL_DEF_INST_3(43, InstSetInstanceVariable,
 	i8, value,
-    u16, info_number,
-    u8, number
+	u16, info_number,
+	u8, number
 );
 
 /**
@@ -960,7 +965,7 @@ XTAL_DEF_INST_3(57, InstSetProperty,
 );
 
 XTAL_DEF_INST_1(58, InstScopeBegin,
-    u16, info_number
+	u16, info_number
 );
 
 XTAL_DEF_INST_0(59, InstScopeEnd);
@@ -1039,7 +1044,7 @@ XTAL_DEF_INST_2(70, InstMapSetDefault,
 
 XTAL_DEF_INST_2(71, InstClassBegin,
 	i8, mixin_base,
-    u16, info_number
+	u16, info_number
 );
 
 XTAL_DEF_INST_1(72, InstClassEnd,
@@ -1069,7 +1074,7 @@ XTAL_DEF_INST_5(74, InstDefineMember,
 
 XTAL_DEF_INST_3(75, InstMakeFun,
 	i8, result,  // 値を代入するローカル変数番号
-    u16, info_number,
+	u16, info_number,
 	address16, address
 );
 
@@ -1077,11 +1082,11 @@ XTAL_DEF_INST_4(76, InstMakeInstanceVariableAccessor,
 	i8, result,  // 値を代入するローカル変数番号
 	u8, type,
 	u8, number,
-    u16, info_number
+	u16, info_number
 );
 
 XTAL_DEF_INST_1(77, InstTryBegin,
-    u16, info_number
+	u16, info_number
 );
 
 XTAL_DEF_INST_0(78, InstTryEnd);
@@ -1097,9 +1102,65 @@ XTAL_DEF_INST_0(81, InstThrow);
 XTAL_DEF_INST_1(82, InstAssert,
 	i8, message);
 
+/**
+* \internal
+* \brief 行の先頭の命令を上書きするトラップ命令
+* フックを呼び出した後、上書きされる前の命令を同じ位置で実行する。
+*/
 XTAL_DEF_INST_0(83, InstBreakPoint);
 
-XTAL_DEF_INST_0(84, InstMAX);
+/**
+* \internal
+* \brief InstInc, InstIfLt, InstIfを融合したスーパー命令
+* InstIncとInstIfLtの間には、InstLoadInt1ByteかInstLoadConstantを一つ挟んでもよい。
+* 融合はCodeBuilderが先頭の命令の命令番号だけを書き換えて行うので、
+* オペランドはInstIncと同じ並びで、後続の命令はそのまま残る。
+*/
+XTAL_DEF_INST_3(84, InstIncIfLt,
+	i8, result,  // 値を代入するローカル変数番号
+	i8, target, // 値を取り出すローカル変数番号
+	i8, stack_base
+);
+
+/**
+* \internal
+* \brief InstLoadInt1ByteとInstAddを融合したスーパー命令
+*/
+XTAL_DEF_INST_2(85, InstLoadInt1ByteAdd,
+	i8, result,  // 値を代入するローカル変数番号
+	i8, value
+);
+
+/**
+* \internal
+* \brief InstLoadInt1ByteとInstSubを融合したスーパー命令
+*/
+XTAL_DEF_INST_2(86, InstLoadInt1ByteSub,
+	i8, result,  // 値を代入するローカル変数番号
+	i8, value
+);
+
+/**
+* \internal
+* \brief InstLoadInt1Byte, InstIfLt, InstIfを融合したスーパー命令
+*/
+XTAL_DEF_INST_2(87, InstLoadInt1ByteIfLt,
+	i8, result,  // 値を代入するローカル変数番号
+	i8, value
+);
+
+/**
+* \internal
+* \brief InstInstanceVariable, InstAdd, InstSetInstanceVariableを融合したスーパー命令
+* InstInstanceVariableとInstAddの間には、InstLoadInt1ByteかInstLoadConstantを一つ挟んでもよい。
+*/
+XTAL_DEF_INST_3(88, InstInstanceVariableAddAssign,
+	i8, result,  // 値を代入するローカル変数番号
+	u16, info_number,
+	u8, number
+);
+
+XTAL_DEF_INST_0(89, InstMAX);
 
 }
 
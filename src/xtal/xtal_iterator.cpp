@@ -13,25 +13,14 @@ ZipIter::ZipIter(const VMachinePtr& vm){
 
 void ZipIter::common(const VMachinePtr& vm, const IDPtr& id){
 	bool all = true;
-	ValuesPtr value;
+	int_t size = next_->size();
+	values_.resize(size);
 	
-	for(int_t i = next_->size()-1; i>=0; --i){
+	for(int_t i = size-1; i>=0; --i){
 		vm->setup_call(2);
 		next_->at(i)->rawsend(vm, id);
 		next_->set_at(i, vm->result(0));
-		
-		if(XTAL_detail_type(value)==TYPE_VALUES){
-			value = XNew<Values>(vm->result(1), value);
-		}
-		else{
-			AnyPtr ret = vm->result(1);
-			if(XTAL_detail_type(ret)==TYPE_VALUES){
-				value = unchecked_ptr_cast<Values>(ret);
-			}
-			else{
-				value = XNew<Values>(ret);
-			}
-		}
+		values_.set_at(i, vm->result(1));
 		vm->cleanup_call();
 		if(!next_->at(i)){
 			all = false;
@@ -39,6 +28,14 @@ void ZipIter::common(const VMachinePtr& vm, const IDPtr& id){
 	}
 	
 	if(all){
+		ValuesPtr value;
+		const AnyPtr& last = values_.at(size-1);
+		if(XTAL_detail_type(last)==TYPE_VALUES){
+			value = XNew<Values>(values_.data(), size-1, unchecked_ptr_cast<Values>(last));
+		}
+		else{
+			value = XNew<Values>(values_.data(), size);
+		}
 		vm->return_result(to_smartptr(this), value);
 	}
 	else{
@@ -69,7 +66,7 @@ void ZipIter::block_break(const VMachinePtr& vm){
 
 void ZipIter::on_visit_members(Visitor& m){
 	Base::on_visit_members(m);
-	m & next_;
+	m & next_ & values_;
 }
 
 void DelegateToIterator::on_rawcall(const VMachinePtr& vm){
@@ -232,6 +232,7 @@ public:
 	void on_visit_members(Visitor& m);
 
 	ArrayPtr next_;
+	xarray values_;
 };
 
 struct BlockValueHolder1{
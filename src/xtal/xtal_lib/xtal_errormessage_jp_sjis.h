@@ -69,6 +69,12 @@ inline void bind_error_message(){
 		XTAL_L("XRE1034"), XTAL_L("XRE1034:[v\xpegvfs悤Ƃ܂"),
 		XTAL_L("XRE1035"), XTAL_L("XRE1035:sŔyield̃t@Co[ɑ΂sȑł"),	
 		XTAL_L("XRE1036"), XTAL_L("XRE1036:'%(object)s' ֐Ăяö̖OsłB֐ŕKvƂĂȂOt'%(name)s'n܂"),	
+		XTAL_L("XRE1037"), XTAL_L("XRE1037:XPW[Ŏs̃t@Co[ȊOҋ@悤Ƃ܂"),
+		XTAL_L("XRE1038"), XTAL_L("XRE1038:̊ł̓t@CfBXNv^̏҂̓T|[gĂ܂"),
+		XTAL_L("XRE1039"), XTAL_L("XRE1039:vfقȂz񓯎mŉZ悤Ƃ܂B"),
+		XTAL_L("XRE1040"), XTAL_L("XRE1040:gpʂ%(limit)soCg𒴂܂B"),
+		XTAL_L("XRE1041"), XTAL_L("XRE1041:sʂɒB܂B"),
+		XTAL_L("XRE1042"), XTAL_L("XRE1042:z̑傫%(size)s͕słB"),
 	};
 	
 	for(unsigned int i=0; i<sizeof(messages)/sizeof(*messages)/2; ++i){
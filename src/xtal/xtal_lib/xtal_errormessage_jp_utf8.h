@@ -69,6 +69,12 @@ inline void bind_error_message(){
 		XTAL_L("XRE1034"), XTAL_L("XRE1034:無限ループが発生する可能性があるxpeg要素を実行しようとしました"),
 		XTAL_L("XRE1035"), XTAL_L("XRE1035:実行中で非yield中のファイバーに対する不正な操作です"),	
 		XTAL_L("XRE1036"), XTAL_L("XRE1036:'%(object)s' 関数呼び出しの引数の名前が不正です。関数側で必要とされていない名前付き引数'%(name)s'が渡されました"),	
+		XTAL_L("XRE1037"), XTAL_L("XRE1037:スケジューラで実行中のファイバー以外から待機しようとしました"),
+		XTAL_L("XRE1038"), XTAL_L("XRE1038:この環境ではファイルディスクリプタの準備待ちはサポートされていません"),
+		XTAL_L("XRE1039"), XTAL_L("XRE1039:要素数が異なる配列同士で演算しようとしました。"),
+		XTAL_L("XRE1040"), XTAL_L("XRE1040:メモリ使用量が上限の%(limit)sバイトを超えました。"),
+		XTAL_L("XRE1041"), XTAL_L("XRE1041:実行量が上限に達しました。"),
+		XTAL_L("XRE1042"), XTAL_L("XRE1042:配列の大きさ%(size)sは不正です。"),
 	};
 	
 	for(unsigned int i=0; i<sizeof(messages)/sizeof(*messages)/2; ++i){
@@ -4,8 +4,14 @@
 #include <dirent.h>
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <unistd.h>
 #include "xtal_cstdiostream.h"
 
+#ifdef __linux__
+#include <sys/epoll.h>
+#include <errno.h>
+#endif
+
 namespace xtal{
 
 class Dirent{
@@ -51,8 +57,22 @@ public:
 	
 	virtual uint_t mtime(const char_t* path){ 
 		struct stat sb;
-		stat(path, &sb);
-		return stat(path, &sb)!=-1 && sb.st_mtime;
+		if(stat(path, &sb)==-1){
+			return 0;
+		}
+		return sb.st_mtime;
+	}
+
+	virtual bool rename(const char_t* from, const char_t* to){
+		return std::rename(from, to)==0;
+	}
+
+	virtual bool remove(const char_t* path){
+		return std::remove(path)==0;
+	}
+
+	virtual uint_t process_id(){
+		return (uint_t)getpid();
 	}
 
 	virtual void* new_file_stream(const char_t* path, const char_t* flags){
@@ -118,6 +138,62 @@ public:
 		((Dirent*)entries_object)->stop();
 	}
 
+#ifdef __linux__
+
+	virtual void* new_poller(){
+		int fd = epoll_create(64);
+		if(fd<0){
+			return 0;
+		}
+
+		int* p = (int*)xmalloc(sizeof(int));
+		*p = fd;
+		return p;
+	}
+
+	virtual void delete_poller(void* poller_object){
+		close(*(int*)poller_object);
+		xfree(poller_object, sizeof(int));
+	}
+
+	virtual bool watch_poller(void* poller_object, int_t fd, int_t events){
+		int epfd = *(int*)poller_object;
+		if(events==0){
+			epoll_event ev = {0};
+			return epoll_ctl(epfd, EPOLL_CTL_DEL, fd, &ev)==0;
+		}
+
+		epoll_event ev = {0};
+		ev.events = ((events&POLL_READ) ? EPOLLIN : 0) | ((events&POLL_WRITE) ? EPOLLOUT : 0);
+		ev.data.fd = fd;
+		if(epoll_ctl(epfd, EPOLL_CTL_MOD, fd, &ev)==0){
+			return true;
+		}
+		return errno==ENOENT && epoll_ctl(epfd, EPOLL_CTL_ADD, fd, &ev)==0;
+	}
+
+	virtual int_t wait_poller(void* poller_object, float_t timeout, PollEvent* events, int_t capacity){
+		epoll_event evs[64];
+		if(capacity>64){
+			capacity = 64;
+		}
+
+		int n = epoll_wait(*(int*)poller_object, evs, capacity, timeout<0 ? -1 : (int)(timeout*1000+0.999));
+		if(n<0){
+			return 0;
+		}
+
+		for(int i=0; i<n; ++i){
+			events[i].fd = evs[i].data.fd;
+			events[i].events = 0;
+			if(evs[i].events & (EPOLLIN|EPOLLHUP|EPOLLERR)){ events[i].events |= POLL_READ; }
+			if(evs[i].events & (EPOLLOUT|EPOLLHUP|EPOLLERR)){ events[i].events |= POLL_WRITE; }
+		}
+		return n;
+	}
+
+#endif
+
 };
 
 }
@@ -4,6 +4,7 @@
 #include <pthread.h>
 #include <unistd.h>
 #include <sys/time.h>
+#include <time.h>
 
 namespace xtal{
 
@@ -176,6 +177,12 @@ public:
 	virtual void sleep(float_t sec){
 		usleep((useconds_t)(sec*1000*1000));
 	}
+
+	virtual u64 clock(){
+		timespec ts;
+		clock_gettime(CLOCK_MONOTONIC, &ts);
+		return (u64)ts.tv_sec*1000*1000 + ts.tv_nsec/1000;
+	}
 };
 
 }
@@ -88,6 +88,18 @@ public:
 		FindClose(h);
 		return ret;
 	}
+
+	virtual bool rename(const char_t* from, const char_t* to){
+		return XTAL_TC(MoveFileEx)(from, to, MOVEFILE_REPLACE_EXISTING)!=0;
+	}
+
+	virtual bool remove(const char_t* path){
+		return XTAL_TC(DeleteFile)(path)!=0;
+	}
+
+	virtual uint_t process_id(){
+		return (uint_t)GetCurrentProcessId();
+	}
 	
 
 	virtual void* new_file_stream(const char_t* path, const char_t* flags){
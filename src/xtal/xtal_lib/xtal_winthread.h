@@ -159,6 +159,13 @@ public:
 	virtual void sleep(float_t sec){
 		Sleep((DWORD)(1000*sec));
 	}
+
+	virtual u64 clock(){
+		LARGE_INTEGER freq, count;
+		QueryPerformanceFrequency(&freq);
+		QueryPerformanceCounter(&count);
+		return (u64)(count.QuadPart/freq.QuadPart*1000*1000 + count.QuadPart%freq.QuadPart*1000*1000/freq.QuadPart);
+	}
 };
 
 }
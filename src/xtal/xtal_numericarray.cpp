@@ -0,0 +1,673 @@
+#include "xtal.h"
+#include "xtal_macro.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP>=2)
+#	define XTAL_NUMERICARRAY_USE_SSE2
+#	include <emmintrin.h>
+#endif
+
+#if defined(__AVX2__)
+#	define XTAL_NUMERICARRAY_USE_AVX2
+#	include <immintrin.h>
+#endif
+
+namespace xtal{
+
+namespace{
+
+// 以下の関数は、連続した領域に対する単純なループとして書いてある。
+// 依存関係のない複数のアキュムレータに分けているのは、コンパイラが自動ベクトル化しやすくするためである。
+
+template<class T>
+void kernel_add(T* r, const T* a, const T* b, uint_t n){
+	for(uint_t i=0; i<n; ++i){
+		r[i] = (T)(a[i] + b[i]);
+	}
+}
+
+template<class T, class V>
+void kernel_add_scalar(T* r, const T* a, V v, uint_t n){
+	for(uint_t i=0; i<n; ++i){
+		r[i] = (T)(a[i] + v);
+	}
+}
+
+template<class T>
+void kernel_mul(T* r, const T* a, const T* b, uint_t n){
+	for(uint_t i=0; i<n; ++i){
+		r[i] = (T)(a[i] * b[i]);
+	}
+}
+
+template<class T, class V>
+void kernel_mul_scalar(T* r, const T* a, V v, uint_t n){
+	for(uint_t i=0; i<n; ++i){
+		r[i] = (T)(a[i] * v);
+	}
+}
+
+template<class T, class V>
+V kernel_dot(const T* a, const T* b, uint_t n){
+	V s0 = 0, s1 = 0, s2 = 0, s3 = 0;
+	uint_t i = 0;
+	for(; i+4<=n; i+=4){
+		s0 += (V)a[i+0] * b[i+0];
+		s1 += (V)a[i+1] * b[i+1];
+		s2 += (V)a[i+2] * b[i+2];
+		s3 += (V)a[i+3] * b[i+3];
+	}
+	for(; i<n; ++i){
+		s0 += (V)a[i] * b[i];
+	}
+	return (s0 + s1) + (s2 + s3);
+}
+
+template<class T, class V>
+V kernel_sum(const T* a, uint_t n){
+	V s0 = 0, s1 = 0, s2 = 0, s3 = 0;
+	uint_t i = 0;
+	for(; i+4<=n; i+=4){
+		s0 += a[i+0];
+		s1 += a[i+1];
+		s2 += a[i+2];
+		s3 += a[i+3];
+	}
+	for(; i<n; ++i){
+		s0 += a[i];
+	}
+	return (s0 + s1) + (s2 + s3);
+}
+
+template<class T>
+T kernel_min(const T* a, uint_t n){
+	T m = a[0];
+	for(uint_t i=1; i<n; ++i){
+		m = a[i]<m ? a[i] : m;
+	}
+	return m;
+}
+
+template<class T>
+T kernel_max(const T* a, uint_t n){
+	T m = a[0];
+	for(uint_t i=1; i<n; ++i){
+		m = m<a[i] ? a[i] : m;
+	}
+	return m;
+}
+
+template<class T>
+void kernel_clamp(T* a, T lo, T hi, uint_t n){
+	for(uint_t i=0; i<n; ++i){
+		T v = a[i]<lo ? lo : a[i];
+		a[i] = hi<v ? hi : v;
+	}
+}
+
+template<class T>
+void kernel_fill(T* a, T v, uint_t n){
+	for(uint_t i=0; i<n; ++i){
+		a[i] = v;
+	}
+}
+
+// 以下はf64とu8の四則演算の特殊化。
+// SIMD命令が使えるなら先頭からまとめて処理し、残りをスカラーで処理する。
+
+inline void kernel_add(f64* r, const f64* a, const f64* b, uint_t n){
+	uint_t i = 0;
+#ifdef XTAL_NUMERICARRAY_USE_AVX2
+	for(; i+4<=n; i+=4){
+		_mm256_storeu_pd(r+i, _mm256_add_pd(_mm256_loadu_pd(a+i), _mm256_loadu_pd(b+i)));
+	}
+#endif
+#ifdef XTAL_NUMERICARRAY_USE_SSE2
+	for(; i+2<=n; i+=2){
+		_mm_storeu_pd(r+i, _mm_add_pd(_mm_loadu_pd(a+i), _mm_loadu_pd(b+i)));
+	}
+#endif
+	for(; i<n; ++i){
+		r[i] = a[i] + b[i];
+	}
+}
+
+inline void kernel_add_scalar(f64* r, const f64* a, f64 v, uint_t n){
+	uint_t i = 0;
+#ifdef XTAL_NUMERICARRAY_USE_AVX2
+	__m256d v4 = _mm256_set1_pd(v);
+	for(; i+4<=n; i+=4){
+		_mm256_storeu_pd(r+i, _mm256_add_pd(_mm256_loadu_pd(a+i), v4));
+	}
+#endif
+#ifdef XTAL_NUMERICARRAY_USE_SSE2
+	__m128d v2 = _mm_set1_pd(v);
+	for(; i+2<=n; i+=2){
+		_mm_storeu_pd(r+i, _mm_add_pd(_mm_loadu_pd(a+i), v2));
+	}
+#endif
+	for(; i<n; ++i){
+		r[i] = a[i] + v;
+	}
+}
+
+inline void kernel_mul(f64* r, const f64* a, const f64* b, uint_t n){
+	uint_t i = 0;
+#ifdef XTAL_NUMERICARRAY_USE_AVX2
+	for(; i+4<=n; i+=4){
+		_mm256_storeu_pd(r+i, _mm256_mul_pd(_mm256_loadu_pd(a+i), _mm256_loadu_pd(b+i)));
+	}
+#endif
+#ifdef XTAL_NUMERICARRAY_USE_SSE2
+	for(; i+2<=n; i+=2){
+		_mm_storeu_pd(r+i, _mm_mul_pd(_mm_loadu_pd(a+i), _mm_loadu_pd(b+i)));
+	}
+#endif
+	for(; i<n; ++i){
+		r[i] = a[i] * b[i];
+	}
+}
+
+inline void kernel_mul_scalar(f64* r, const f64* a, f64 v, uint_t n){
+	uint_t i = 0;
+#ifdef XTAL_NUMERICARRAY_USE_AVX2
+	__m256d v4 = _mm256_set1_pd(v);
+	for(; i+4<=n; i+=4){
+		_mm256_storeu_pd(r+i, _mm256_mul_pd(_mm256_loadu_pd(a+i), v4));
+	}
+#endif
+#ifdef XTAL_NUMERICARRAY_USE_SSE2
+	__m128d v2 = _mm_set1_pd(v);
+	for(; i+2<=n; i+=2){
+		_mm_storeu_pd(r+i, _mm_mul_pd(_mm_loadu_pd(a+i), v2));
+	}
+#endif
+	for(; i<n; ++i){
+		r[i] = a[i] * v;
+	}
+}
+
+// ByteArrayの演算結果は、桁あふれさせずに0から255に飽和させる
+inline u8 saturate_u8(int_t v){
+	return (u8)(v<0 ? 0 : (255<v ? 255 : v));
+}
+
+// スカラー値はどの要素と演算しても結果が飽和する範囲に丸めておく
+inline int_t clamp_byte_operand(int_t v){
+	return v<-255 ? -255 : (255<v ? 255 : v);
+}
+
+#ifdef XTAL_NUMERICARRAY_USE_SSE2
+// 16ビットに広げて掛け、255を超えたものを255にしてから8ビットに詰め直す
+inline __m128i mul_sat_epu8(__m128i x, __m128i y){
+	__m128i zero = _mm_setzero_si128();
+	__m128i max = _mm_set1_epi16(255);
+	__m128i lo = _mm_mullo_epi16(_mm_unpacklo_epi8(x, zero), _mm_unpacklo_epi8(y, zero));
+	__m128i hi = _mm_mullo_epi16(_mm_unpackhi_epi8(x, zero), _mm_unpackhi_epi8(y, zero));
+	__m128i lo_ok = _mm_cmpeq_epi16(_mm_srli_epi16(lo, 8), zero);
+	__m128i hi_ok = _mm_cmpeq_epi16(_mm_srli_epi16(hi, 8), zero);
+	lo = _mm_or_si128(_mm_and_si128(lo_ok, lo), _mm_andnot_si128(lo_ok, max));
+	hi = _mm_or_si128(_mm_and_si128(hi_ok, hi), _mm_andnot_si128(hi_ok, max));
+	return _mm_packus_epi16(lo, hi);
+}
+#endif
+
+#ifdef XTAL_NUMERICARRAY_USE_AVX2
+inline __m256i mul_sat_epu8(__m256i x, __m256i y){
+	__m256i zero = _mm256_setzero_si256();
+	__m256i max = _mm256_set1_epi16(255);
+	__m256i lo = _mm256_mullo_epi16(_mm256_unpacklo_epi8(x, zero), _mm256_unpacklo_epi8(y, zero));
+	__m256i hi = _mm256_mullo_epi16(_mm256_unpackhi_epi8(x, zero), _mm256_unpackhi_epi8(y, zero));
+	return _mm256_packus_epi16(_mm256_min_epu16(lo, max), _mm256_min_epu16(hi, max));
+}
+#endif
+
+inline void kernel_add(u8* r, const u8* a, const u8* b, uint_t n){
+	uint_t i = 0;
+#ifdef XTAL_NUMERICARRAY_USE_AVX2
+	for(; i+32<=n; i+=32){
+		__m256i x = _mm256_loadu_si256((const __m256i*)(a+i));
+		__m256i y = _mm256_loadu_si256((const __m256i*)(b+i));
+		_mm256_storeu_si256((__m256i*)(r+i), _mm256_adds_epu8(x, y));
+	}
+#endif
+#ifdef XTAL_NUMERICARRAY_USE_SSE2
+	for(; i+16<=n; i+=16){
+		__m128i x = _mm_loadu_si128((const __m128i*)(a+i));
+		__m128i y = _mm_loadu_si128((const __m128i*)(b+i));
+		_mm_storeu_si128((__m128i*)(r+i), _mm_adds_epu8(x, y));
+	}
+#endif
+	for(; i<n; ++i){
+		r[i] = saturate_u8((int_t)a[i] + b[i]);
+	}
+}
+
+inline void kernel_add_scalar(u8* r, const u8* a, int_t v, uint_t n){
+	v = clamp_byte_operand(v);
+	uint_t i = 0;
+#ifdef XTAL_NUMERICARRAY_USE_AVX2
+	__m256i v32 = _mm256_set1_epi8((char)(v<0 ? -v : v));
+	for(; i+32<=n; i+=32){
+		__m256i x = _mm256_loadu_si256((const __m256i*)(a+i));
+		_mm256_storeu_si256((__m256i*)(r+i), v<0 ? _mm256_subs_epu8(x, v32) : _mm256_adds_epu8(x, v32));
+	}
+#endif
+#ifdef XTAL_NUMERICARRAY_USE_SSE2
+	__m128i v16 = _mm_set1_epi8((char)(v<0 ? -v : v));
+	for(; i+16<=n; i+=16){
+		__m128i x = _mm_loadu_si128((const __m128i*)(a+i));
+		_mm_storeu_si128((__m128i*)(r+i), v<0 ? _mm_subs_epu8(x, v16) : _mm_adds_epu8(x, v16));
+	}
+#endif
+	for(; i<n; ++i){
+		r[i] = saturate_u8(a[i] + v);
+	}
+}
+
+inline void kernel_mul(u8* r, const u8* a, const u8* b, uint_t n){
+	uint_t i = 0;
+#ifdef XTAL_NUMERICARRAY_USE_AVX2
+	for(; i+32<=n; i+=32){
+		__m256i x = _mm256_loadu_si256((const __m256i*)(a+i));
+		__m256i y = _mm256_loadu_si256((const __m256i*)(b+i));
+		_mm256_storeu_si256((__m256i*)(r+i), mul_sat_epu8(x, y));
+	}
+#endif
+#ifdef XTAL_NUMERICARRAY_USE_SSE2
+	for(; i+16<=n; i+=16){
+		__m128i x = _mm_loadu_si128((const __m128i*)(a+i));
+		__m128i y = _mm_loadu_si128((const __m128i*)(b+i));
+		_mm_storeu_si128((__m128i*)(r+i), mul_sat_epu8(x, y));
+	}
+#endif
+	for(; i<n; ++i){
+		r[i] = saturate_u8((int_t)a[i] * b[i]);
+	}
+}
+
+inline void kernel_mul_scalar(u8* r, const u8* a, int_t v, uint_t n){
+	// 負の数を掛けると全て0に飽和する
+	v = v<0 ? 0 : clamp_byte_operand(v);
+	uint_t i = 0;
+#ifdef XTAL_NUMERICARRAY_USE_AVX2
+	__m256i v32 = _mm256_set1_epi8((char)v);
+	for(; i+32<=n; i+=32){
+		__m256i x = _mm256_loadu_si256((const __m256i*)(a+i));
+		_mm256_storeu_si256((__m256i*)(r+i), mul_sat_epu8(x, v32));
+	}
+#endif
+#ifdef XTAL_NUMERICARRAY_USE_SSE2
+	__m128i v16 = _mm_set1_epi8((char)v);
+	for(; i+16<=n; i+=16){
+		__m128i x = _mm_loadu_si128((const __m128i*)(a+i));
+		_mm_storeu_si128((__m128i*)(r+i), mul_sat_epu8(x, v16));
+	}
+#endif
+	for(; i<n; ++i){
+		r[i] = saturate_u8(a[i] * v);
+	}
+}
+
+}
+
+//////////////////////////////////////////////////////////////
+
+NumericArray::NumericArray(uint_t element_size)
+	:data_(0), size_(0), element_size_(element_size), capacity_(0){}
+
+NumericArray::~NumericArray(){
+	if(capacity_){
+		xfree_align(data_, capacity_, ALIGNMENT);
+	}
+}
+
+void NumericArray::alloc(int_t size){
+	// 負の大きさや、バイト数が溢れる大きさは、Arrayと同じく引数のエラーにする
+	if(size<0 || (uint_t)size>((uint_t)-1)/element_size_){
+		set_array_size_error(size);
+		return;
+	}
+
+	// メモリ使用量の上限を超えるなら空のままにする
+	if(size && !reserve_memory(size*element_size_)){
+		size = 0;
+	}
+
+	size_ = size;
+	if(size){
+		capacity_ = size*element_size_;
+		data_ = xmalloc_align(capacity_, ALIGNMENT);
+		std::memset(data_, 0, capacity_);
+	}
+}
+
+void NumericArray::share(const NumericArrayPtr& a, uint_t offset, uint_t size){
+	data_ = (u8*)a->data_ + offset*element_size_;
+	size_ = size;
+	owner_ = a->is_view() ? a->owner_ : AnyPtr(a);
+}
+
+bool NumericArray::calc_offset(int_t& i){
+	if(i<0){
+		i = size_ + i;
+		if(i>=0){
+			return true;
+		}
+	}
+	else{
+		if((uint_t)i < size_){
+			return true;
+		}
+	}
+	throw_index_error();
+	return false;
+}
+
+bool NumericArray::calc_range(int_t& i, int_t n){
+	if(!calc_offset(i)){
+		return false;
+	}
+
+	if(n<0 || (uint_t)(n + i)>size_){
+		throw_index_error();
+		return false;
+	}
+	return true;
+}
+
+bool NumericArray::check_size(const NumericArrayPtr& a){
+	if(a->size_!=size_){
+		set_runtime_error(Xt("XRE1039"));
+		return false;
+	}
+	return true;
+}
+
+void NumericArray::throw_index_error(){
+	set_runtime_error(Xt("XRE1020"));
+}
+
+AnyPtr NumericArray::each(){
+	return xnew<NumericArrayIter>(to_smartptr(this));
+}
+
+void NumericArray::block_first(const VMachinePtr& vm){
+	SmartPtr<NumericArrayIter> it = xnew<NumericArrayIter>(to_smartptr(this));
+	it->block_next(vm);
+}
+
+ArrayPtr NumericArray::op_to_array(){
+	ArrayPtr ret = XNew<Array>(size_);
+	for(uint_t i=0; i<size_; ++i){
+		ret->set_at(i, element(i));
+	}
+	return ret;
+}
+
+StreamPtr NumericArray::to_stream(){
+	return xnew<NumericArrayStream>(to_smartptr(this));
+}
+
+void NumericArray::read(const StreamPtr& stream){
+	stream->read_strict(data_, byte_size());
+}
+
+void NumericArray::write(const StreamPtr& stream){
+	stream->write(data_, byte_size());
+}
+
+void NumericArray::assign(const AnyPtr& iterator){
+	uint_t i = 0;
+	Xfor(v, iterator){
+		if(i>=size_){
+			throw_index_error();
+			return;
+		}
+
+		set_element(i, v);
+		++i;
+	}
+}
+
+StringPtr NumericArray::to_s(){
+	return op_to_array()->to_s();
+}
+
+void NumericArray::on_visit_members(Visitor& m){
+	Base::on_visit_members(m);
+	m & owner_;
+}
+
+//////////////////////////////////////////////////////////////
+
+NumericArrayIter::NumericArrayIter(const NumericArrayPtr& a)
+	:array_(a), index_(0){}
+
+void NumericArrayIter::block_next(const VMachinePtr& vm){
+	if(index_<array_->size()){
+		vm->return_result(to_smartptr(this), array_->element(index_++));
+	}
+	else{
+		vm->return_result(null, null);
+	}
+}
+
+void NumericArrayIter::on_visit_members(Visitor& m){
+	Base::on_visit_members(m);
+	m & array_;
+}
+
+//////////////////////////////////////////////////////////////
+
+NumericArrayStream::NumericArrayStream(const NumericArrayPtr& a)
+	:PointerStream(a->raw_data(), a->byte_size()), array_(a){}
+
+void NumericArrayStream::on_visit_members(Visitor& m){
+	PointerStream::on_visit_members(m);
+	m & array_;
+}
+
+//////////////////////////////////////////////////////////////
+
+template<class T>
+TypedArray<T>::TypedArray(int_t size)
+	:NumericArray(sizeof(T)){
+	alloc(size);
+}
+
+template<class T>
+typename TypedArray<T>::value_t TypedArray<T>::to_value(const AnyPtr& v){
+	return (value_t)v->to_f();
+}
+
+template<>
+IntArray::value_t IntArray::to_value(const AnyPtr& v){
+	return v->to_i();
+}
+
+template<>
+ByteArray::value_t ByteArray::to_value(const AnyPtr& v){
+	return v->to_i();
+}
+
+template<class T>
+AnyPtr TypedArray<T>::element(uint_t i){
+	return (value_t)data()[i];
+}
+
+template<class T>
+void TypedArray<T>::set_element(uint_t i, const AnyPtr& v){
+	data()[i] = (T)to_value(v);
+}
+
+template<class T>
+typename TypedArray<T>::value_t TypedArray<T>::op_at(int_t i){
+	if(!calc_offset(i)){
+		return 0;
+	}
+	return data()[i];
+}
+
+template<class T>
+void TypedArray<T>::op_set_at(int_t i, const AnyPtr& v){
+	if(!calc_offset(i)){
+		return;
+	}
+	data()[i] = (T)to_value(v);
+}
+
+template<class T>
+typename TypedArray<T>::Ptr TypedArray<T>::slice(int_t i, int_t n){
+	if(n==0){
+		return xnew<TypedArray>(0);
+	}
+
+	if(!calc_range(i, n)){
+		return nul<TypedArray>();
+	}
+
+	Ptr ret = xnew<TypedArray>(0);
+	ret->share(to_smartptr(this), i, n);
+	return ret;
+}
+
+template<class T>
+typename TypedArray<T>::Ptr TypedArray<T>::clone(){
+	Ptr ret = xnew<TypedArray>(size_);
+	if(ret->size()!=size_){
+		// メモリ使用量の上限で確保できなかった
+		return nul<TypedArray>();
+	}
+	if(size_){
+		std::memcpy(ret->data(), data(), byte_size());
+	}
+	return ret;
+}
+
+template<class T>
+const typename TypedArray<T>::Ptr& TypedArray<T>::fill(const AnyPtr& v){
+	kernel_fill(data(), (T)to_value(v), size_);
+	return to_smartptr(this);
+}
+
+template<class T>
+typename TypedArray<T>::Ptr TypedArray<T>::op_add(const Ptr& a){
+	if(!check_size(a)){
+		return nul<TypedArray>();
+	}
+
+	Ptr ret = xnew<TypedArray>(size_);
+	if(ret->size()!=size_){
+		return nul<TypedArray>();
+	}
+	kernel_add(ret->data(), data(), a->data(), size_);
+	return ret;
+}
+
+template<class T>
+typename TypedArray<T>::Ptr TypedArray<T>::op_add_scalar(const AnyPtr& v){
+	Ptr ret = xnew<TypedArray>(size_);
+	if(ret->size()!=size_){
+		return nul<TypedArray>();
+	}
+	kernel_add_scalar(ret->data(), data(), to_value(v), size_);
+	return ret;
+}
+
+template<class T>
+typename TypedArray<T>::Ptr TypedArray<T>::op_mul(const Ptr& a){
+	if(!check_size(a)){
+		return nul<TypedArray>();
+	}
+
+	Ptr ret = xnew<TypedArray>(size_);
+	if(ret->size()!=size_){
+		return nul<TypedArray>();
+	}
+	kernel_mul(ret->data(), data(), a->data(), size_);
+	return ret;
+}
+
+template<class T>
+typename TypedArray<T>::Ptr TypedArray<T>::op_mul_scalar(const AnyPtr& v){
+	Ptr ret = xnew<TypedArray>(size_);
+	if(ret->size()!=size_){
+		return nul<TypedArray>();
+	}
+	kernel_mul_scalar(ret->data(), data(), to_value(v), size_);
+	return ret;
+}
+
+template<class T>
+const typename TypedArray<T>::Ptr& TypedArray<T>::op_add_assign(const Ptr& a){
+	if(check_size(a)){
+		kernel_add(data(), data(), a->data(), size_);
+	}
+	return to_smartptr(this);
+}
+
+template<class T>
+const typename TypedArray<T>::Ptr& TypedArray<T>::op_add_assign_scalar(const AnyPtr& v){
+	kernel_add_scalar(data(), data(), to_value(v), size_);
+	return to_smartptr(this);
+}
+
+template<class T>
+const typename TypedArray<T>::Ptr& TypedArray<T>::op_mul_assign(const Ptr& a){
+	if(check_size(a)){
+		kernel_mul(data(), data(), a->data(), size_);
+	}
+	return to_smartptr(this);
+}
+
+template<class T>
+const typename TypedArray<T>::Ptr& TypedArray<T>::op_mul_assign_scalar(const AnyPtr& v){
+	kernel_mul_scalar(data(), data(), to_value(v), size_);
+	return to_smartptr(this);
+}
+
+template<class T>
+typename TypedArray<T>::value_t TypedArray<T>::dot(const Ptr& a){
+	if(!check_size(a)){
+		return 0;
+	}
+	return kernel_dot<T, value_t>(data(), a->data(), size_);
+}
+
+template<class T>
+typename TypedArray<T>::value_t TypedArray<T>::sum(){
+	return kernel_sum<T, value_t>(data(), size_);
+}
+
+template<class T>
+AnyPtr TypedArray<T>::min_value(){
+	if(size_==0){
+		return null;
+	}
+	return (value_t)kernel_min(data(), size_);
+}
+
+template<class T>
+AnyPtr TypedArray<T>::max_value(){
+	if(size_==0){
+		return null;
+	}
+	return (value_t)kernel_max(data(), size_);
+}
+
+template<class T>
+const typename TypedArray<T>::Ptr& TypedArray<T>::scale(const AnyPtr& s){
+	return op_mul_assign_scalar(s);
+}
+
+template<class T>
+const typename TypedArray<T>::Ptr& TypedArray<T>::clamp(const AnyPtr& lo, const AnyPtr& hi){
+	kernel_clamp(data(), (T)to_value(lo), (T)to_value(hi), size_);
+	return to_smartptr(this);
+}
+
+template class TypedArray<int_t>;
+template class TypedArray<float_t>;
+template class TypedArray<u8>;
+
+}
@@ -0,0 +1,397 @@
+/** \file src/xtal/xtal_numericarray.h
+* \brief src/xtal/xtal_numericarray.h
+*/
+
+#ifndef XTAL_NUMERICARRAY_H_INCLUDE_GUARD
+#define XTAL_NUMERICARRAY_H_INCLUDE_GUARD
+
+#pragma once
+
+namespace xtal{
+
+class NumericArray;
+typedef SmartPtr<NumericArray> NumericArrayPtr;
+
+/**
+* \xbind lib::builtin
+* \xinherit lib::builtin::Iterable
+* \brief 数値をネイティブの型のまま連続した領域に格納する固定長配列の基底クラス
+* 要素はAnyPtrではなくC++の値として隙間なく並べられるので、raw_dataで得た領域をネイティブ側からそのまま読み書きできる。
+* sliceで作られるビューは元の配列と領域を共有する。
+*/
+class NumericArray : public Base{
+public:
+
+	NumericArray(uint_t element_size);
+
+	virtual ~NumericArray();
+
+	/**
+	* \xbind
+	* \brief 要素数を返す
+	*/
+	uint_t size(){
+		return size_;
+	}
+
+	/**
+	* \xbind
+	* \brief 要素数を返す
+	*/
+	uint_t length(){
+		return size_;
+	}
+
+	/**
+	* \xbind
+	* \brief 空か調べる
+	*/
+	bool empty(){
+		return size_==0;
+	}
+
+	/**
+	* \xbind
+	* \brief 空か調べる
+	*/
+	bool is_empty(){
+		return size_==0;
+	}
+
+	/**
+	* \xbind
+	* \brief 要素一つのバイト数を返す
+	*/
+	uint_t element_size(){
+		return element_size_;
+	}
+
+	/**
+	* \xbind
+	* \brief 全要素のバイト数を返す
+	*/
+	uint_t byte_size(){
+		return size_*element_size_;
+	}
+
+	/**
+	* \xbind
+	* \brief 他の配列の領域を共有するビューか調べる
+	*/
+	bool is_view(){
+		return !XTAL_detail_raweq(owner_, null);
+	}
+
+	/**
+	* \brief 要素が格納されている領域の先頭を返す
+	* 領域は配列かその所有者が生きている間有効で、要素数が変わることはない。
+	*/
+	void* raw_data(){
+		return data_;
+	}
+
+	/**
+	* \xbind
+	* \brief 要素を最初から反復できるIteratorを返す
+	*/
+	AnyPtr each();
+
+	/**
+	* \xbind
+	* \brief 要素をコピーした通常の配列を返す
+	*/
+	ArrayPtr op_to_array();
+
+	/**
+	* \xbind
+	* \brief 要素の領域をコピーせずに読み込むストリームを返す
+	* ストリームは配列を参照し続けるので、配列より長く生きていてもよい。
+	*/
+	StreamPtr to_stream();
+
+	/**
+	* \xbind
+	* \brief ストリームからbyte_sizeバイトを読み込んで、要素の領域を埋める
+	*/
+	void read(const StreamPtr& stream);
+
+	/**
+	* \xbind
+	* \brief 要素の領域をそのままストリームに書き込む
+	*/
+	void write(const StreamPtr& stream);
+
+	/**
+	* \xbind
+	* \brief iteratorで取得できる要素を先頭から順に設定する
+	* 要素数を超える値が得られた場合は範囲外アクセスの例外となる。
+	*/
+	void assign(const AnyPtr& iterator);
+
+	StringPtr to_s();
+
+	/**
+	* \brief i番目の要素をAnyPtrに変換して返す
+	*/
+	virtual AnyPtr element(uint_t i) = 0;
+
+	/**
+	* \brief i番目の要素にvを要素の型に変換して設定する
+	*/
+	virtual void set_element(uint_t i, const AnyPtr& v) = 0;
+
+public:
+
+	void block_first(const VMachinePtr& vm);
+
+	void on_visit_members(Visitor& m);
+
+protected:
+
+	void alloc(int_t size);
+
+	void share(const NumericArrayPtr& a, uint_t offset, uint_t size);
+
+	bool calc_offset(int_t& i);
+
+	bool calc_range(int_t& i, int_t n);
+
+	bool check_size(const NumericArrayPtr& a);
+
+	void throw_index_error();
+
+	enum{
+		ALIGNMENT = 16
+	};
+
+	void* data_;
+	uint_t size_;
+	uint_t element_size_;
+
+	// 自身で確保した領域のバイト数。ビューの場合は0
+	uint_t capacity_;
+
+	// ビューの場合、領域を所有している配列
+	AnyPtr owner_;
+
+private:
+	XTAL_DISALLOW_COPY_AND_ASSIGN(NumericArray);
+};
+
+class NumericArrayIter : public Base{
+public:
+
+	NumericArrayIter(const NumericArrayPtr& a);
+
+	void block_next(const VMachinePtr& vm);
+
+	void on_visit_members(Visitor& m);
+
+private:
+	NumericArrayPtr array_;
+	uint_t index_;
+};
+
+/**
+* \brief 数値配列の領域をコピーせずに読み込むストリーム
+*/
+class NumericArrayStream : public PointerStream{
+public:
+
+	NumericArrayStream(const NumericArrayPtr& a);
+
+	void on_visit_members(Visitor& m);
+
+private:
+	NumericArrayPtr array_;
+};
+
+template<class T>
+struct NumericArrayValue{
+	typedef int_t type;
+};
+
+template<>
+struct NumericArrayValue<float_t>{
+	typedef float_t type;
+};
+
+/**
+* \brief T型の要素を持つ数値配列
+* 要素同士の演算は連続した領域に対する単純なループで実装されており、コンパイラの自動ベクトル化が効く形にしてある。
+* 整数型の演算は要素の型の範囲で折り返す。
+*/
+template<class T>
+class TypedArray : public NumericArray{
+public:
+	typedef T element_t;
+
+	/// 集計やスクリプトとのやり取りに使う型
+	typedef typename NumericArrayValue<T>::type value_t;
+
+	typedef SmartPtr<TypedArray> Ptr;
+
+	/**
+	* \brief size個の0で埋められた配列を生成する
+	*/
+	TypedArray(int_t size = 0);
+
+	/**
+	* \brief 要素の領域の先頭を返す
+	*/
+	T* data(){
+		return (T*)data_;
+	}
+
+	/**
+	* \xbind
+	* \brief i番目の要素を返す
+	*/
+	value_t op_at(int_t i);
+
+	/**
+	* \xbind
+	* \brief i番目の要素を設定する
+	*/
+	void op_set_at(int_t i, const AnyPtr& v);
+
+	/**
+	* \xbind
+	* \brief i番目からn個の要素を、領域を共有したまま参照するビューを返す
+	*/
+	Ptr slice(int_t i, int_t n = 1);
+
+	/**
+	* \xbind
+	* \brief 領域をコピーした新しい配列を返す
+	*/
+	Ptr clone();
+
+	/**
+	* \xbind
+	* \brief 全ての要素をvにする
+	*/
+	const Ptr& fill(const AnyPtr& v);
+
+	/**
+	* \xbind
+	* \brief 要素ごとに足した新しい配列を返す
+	*/
+	Ptr op_add(const Ptr& a);
+
+	/**
+	* \xbind
+	* \brief 全ての要素にvを足した新しい配列を返す
+	*/
+	Ptr op_add_scalar(const AnyPtr& v);
+
+	/**
+	* \xbind
+	* \brief 要素ごとに掛けた新しい配列を返す
+	*/
+	Ptr op_mul(const Ptr& a);
+
+	/**
+	* \xbind
+	* \brief 全ての要素にvを掛けた新しい配列を返す
+	*/
+	Ptr op_mul_scalar(const AnyPtr& v);
+
+	/**
+	* \xbind
+	* \brief 要素ごとに足し込む
+	*/
+	const Ptr& op_add_assign(const Ptr& a);
+
+	/**
+	* \xbind
+	* \brief 全ての要素にvを足し込む
+	*/
+	const Ptr& op_add_assign_scalar(const AnyPtr& v);
+
+	/**
+	* \xbind
+	* \brief 要素ごとに掛け込む
+	*/
+	const Ptr& op_mul_assign(const Ptr& a);
+
+	/**
+	* \xbind
+	* \brief 全ての要素にvを掛け込む
+	*/
+	const Ptr& op_mul_assign_scalar(const AnyPtr& v);
+
+	/**
+	* \xbind
+	* \brief 内積を返す
+	*/
+	value_t dot(const Ptr& a);
+
+	/**
+	* \xbind
+	* \brief 要素の総和を返す
+	*/
+	value_t sum();
+
+	/**
+	* \xbind
+	* \brief 最小の要素を返す
+	* 空の場合はnullを返す。
+	*/
+	AnyPtr min_value();
+
+	/**
+	* \xbind
+	* \brief 最大の要素を返す
+	* 空の場合はnullを返す。
+	*/
+	AnyPtr max_value();
+
+	/**
+	* \xbind
+	* \brief 全ての要素をs倍する
+	*/
+	const Ptr& scale(const AnyPtr& s);
+
+	/**
+	* \xbind
+	* \brief 全ての要素をloからhiの範囲に収める
+	*/
+	const Ptr& clamp(const AnyPtr& lo, const AnyPtr& hi);
+
+	virtual AnyPtr element(uint_t i);
+
+	virtual void set_element(uint_t i, const AnyPtr& v);
+
+	static value_t to_value(const AnyPtr& v);
+};
+
+/**
+* \xbind lib::builtin
+* \xinherit lib::builtin::NumericArray
+* \brief int_tの要素を持つ数値配列
+*/
+typedef TypedArray<int_t> IntArray;
+
+/**
+* \xbind lib::builtin
+* \xinherit lib::builtin::NumericArray
+* \brief float_tの要素を持つ数値配列
+*/
+typedef TypedArray<float_t> FloatArray;
+
+/**
+* \xbind lib::builtin
+* \xinherit lib::builtin::NumericArray
+* \brief u8の要素を持つ数値配列
+* 足し算と掛け算の結果は桁あふれせず、0から255に飽和する。
+*/
+typedef TypedArray<u8> ByteArray;
+
+typedef SmartPtr<IntArray> IntArrayPtr;
+typedef SmartPtr<FloatArray> FloatArrayPtr;
+typedef SmartPtr<ByteArray> ByteArrayPtr;
+
+}
+
+#endif // XTAL_NUMERICARRAY_H_INCLUDE_GUARD
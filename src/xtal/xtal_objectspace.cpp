@@ -15,7 +15,11 @@ namespace xtal{
 enum{
 	OBJECTS_ALLOCATE_SHIFT = 9,
 	OBJECTS_ALLOCATE_SIZE = 1 << OBJECTS_ALLOCATE_SHIFT,
-	OBJECTS_ALLOCATE_MASK = OBJECTS_ALLOCATE_SIZE-1
+	OBJECTS_ALLOCATE_MASK = OBJECTS_ALLOCATE_SIZE-1,
+
+	ZERO_COUNT_LIMIT_MIN = 1 << 12,
+
+	PROMOTED_OBJECTS_LIMIT_MIN = 1 << 12
 };
 
 struct ScopeCounter{
@@ -236,11 +240,19 @@ void ObjectSpace::initialize(){
 	objects_max_ = 0;
 	processed_line_ = 0;
 	cycle_count_ = 0;
+	reset_gc_stats();
 	objects_generation_line_ = 0;
 	objects_destroyed_count_ = 0;
+	promoted_objects_count_ = 0;
 
 	disable_finalizer_ = false;
 
+#ifndef XTAL_NO_DEFERRED_REF_COUNT
+	zero_count_limit_ = ZERO_COUNT_LIMIT_MIN;
+	zero_count_lock_ = 0;
+	defer_zero_count_ = true;
+#endif
+
 	disable_gc();
 
 	cpps_map_.expand(5);
@@ -318,6 +330,12 @@ void ObjectSpace::uninitialize(){
 	clear_cache();
 	full_gc();
 
+#ifndef XTAL_NO_DEFERRED_REF_COUNT
+	// ここから先は、参照カウンタが0になったオブジェクトをすぐに破棄する
+	reconcile_zero_count();
+	defer_zero_count_ = false;
+#endif
+
 	if(objects_count_ != 0){
 		if(!ignore_memory_assert()){
 			//fprintf(stderr, "finished gc\n");
@@ -341,10 +359,29 @@ void ObjectSpace::uninitialize(){
 			ConnectedPointer begin(0, objects_list_begin_);
 
 			destroy_objects(begin, current);
+#ifndef XTAL_NO_DEFERRED_REF_COUNT
+			purge_zero_count_objects();
+#endif
 			free_objects(begin, current);
 		}
 	}
 
+#ifndef XTAL_NO_DEFERRED_REF_COUNT
+	// VMのレジスタからしか参照されていなかったオブジェクトを破棄する
+	while(!zero_count_objects_.empty()){
+		RefCountingBase* p = zero_count_objects_.pop();
+		p->unset_zero_count_flag();
+		if(!p->alive_ref_count()){
+			p->object_destroy();
+		}
+	}
+
+	{ PODStack<RefCountingBase*> temp; swap(temp, zero_count_objects_); }
+	{ PODStack<RefCountingBase*> temp; swap(temp, marked_objects_); }
+	{ PODStack<RefCountingBase*> temp; swap(temp, finalize_objects_); }
+	{ PODStack<VMachine*> temp; swap(temp, vmachines_); }
+#endif
+
 	for(RefCountingBase*** it=objects_list_current_; it!=objects_list_end_; ++it){
 		RefCountingBase** begin = *it;
 		RefCountingBase** current = *it;
@@ -473,7 +510,7 @@ uint_t ObjectSpace::alive_object_count(){
 
 RefCountingBase* ObjectSpace::alive_object(uint_t i){
 	ConnectedPointer current(i, objects_list_begin_);
-	if((*current)->ref_count()){
+	if((*current)->ref_count() || (*current)->in_zero_count_table()){
 		return *current;
 	}
 	else{
@@ -496,7 +533,8 @@ ConnectedPointer ObjectSpace::sweep_dead_objects(ConnectedPointer first, Connect
 		RefCountingBase* p = *pp;
 
 		if(!p->object_destroyed()){
-			if(!p->alive_ref_count()){
+			// ゼロカウント表に載っているものは、後で破棄されるか、レジスタから参照されている
+			if(!p->alive_ref_count() && !p->in_zero_count_table()){
 				p->object_destroy();
 			}
 			else{
@@ -571,15 +609,38 @@ void ObjectSpace::add_ref_count_objects(ConnectedPointer it, ConnectedPointer en
 void ObjectSpace::gc(){
 	if(cycle_count_!=0){ return; }
 
-	ScopeCounter cc(&cycle_count_);
+	gc_count_++;
+	u64 begin = thread_lib()->clock();
 
-	ConnectedPointer first(objects_generation_line_, objects_list_begin_);
-	ConnectedPointer last(objects_count_, objects_list_begin_);
-	ConnectedPointer end(objects_count_, objects_list_begin_);
-	
-	end = sweep_dead_objects(first, last, end);
+	{
+		ScopeCounter cc(&cycle_count_);
+
+#ifndef XTAL_NO_DEFERRED_REF_COUNT
+		// レジスタから参照されているオブジェクトを生存扱いにしてから掃除する
+		ScopeCounter zc(&zero_count_lock_);
+		mark_vmachine_registers();
+		destroy_zero_count_objects();
+#endif
+
+		ConnectedPointer first(objects_generation_line_, objects_list_begin_);
+		ConnectedPointer last(objects_count_, objects_list_begin_);
+		ConnectedPointer end(objects_count_, objects_list_begin_);
+		
+		end = sweep_dead_objects(first, last, end);
+
+		adjust_objects_list(end);
+
+#ifndef XTAL_NO_DEFERRED_REF_COUNT
+		destroy_zero_count_objects();
+		unmark_vmachine_registers();
+#endif
+	}
+
+#ifndef XTAL_NO_DEFERRED_REF_COUNT
+	finalize_zero_count_objects();
+#endif
 
-	adjust_objects_list(end);
+	add_gc_pause_time(begin);
 }
 
 ConnectedPointer ObjectSpace::find_alive_objects(ConnectedPointer alive, ConnectedPointer current){ 
@@ -607,24 +668,67 @@ void ObjectSpace::full_gc(){
 		return; 
 	}
 
+	full_gc_count_++;
+	collect_cycles(0);
+}
+
+void ObjectSpace::collect_cycles_since(uint_t first){
+	if(cycle_count_!=0){ 
+		return; 
+	}
+
+	gc_count_++;
+	if(first>objects_count_){
+		first = objects_count_;
+	}
+
+	collect_cycles(first);
+
+	// 生き残ったオブジェクトは、後で循環参照のゴミになってもfull_gcまで回収されない
+	// それらが全体の1/4を超えたら、全体を回収する
+	promoted_objects_count_ += objects_count_ - first;
+	if(promoted_objects_count_ > PROMOTED_OBJECTS_LIMIT_MIN + (objects_count_>>2)){
+		full_gc();
+	}
+}
+
+void ObjectSpace::collect_cycles(uint_t first){
+	u64 begin = thread_lib()->clock();
+
+#ifndef XTAL_NO_DEFERRED_REF_COUNT
+	zero_count_lock_++;
+	mark_vmachine_registers();
+	destroy_zero_count_objects();
+#endif
+
 	{
-		ConnectedPointer first(0, objects_list_begin_);
+		ConnectedPointer from(first, objects_list_begin_);
 		ConnectedPointer last(objects_count_, objects_list_begin_);
 
 		ConnectedPointer end(objects_count_, objects_list_begin_);
-		end = sweep_dead_objects(first, last, end);
+		end = sweep_dead_objects(from, last, end);
 		adjust_objects_list(end);
 	}
 
+#ifndef XTAL_NO_DEFERRED_REF_COUNT
+	destroy_zero_count_objects();
+	unmark_vmachine_registers();
+#endif
+
 	ScopeCounter cc(&cycle_count_);
 	
 	while(true){			
 		ConnectedPointer current(objects_count_, objects_list_begin_);
-		ConnectedPointer begin(0, objects_list_begin_);
+		ConnectedPointer begin(first, objects_list_begin_);
 		if(current==begin){
 			break;
 		}
 
+#ifndef XTAL_NO_DEFERRED_REF_COUNT
+		// VMachineのレジスタが辿る参照を、一時的に参照カウンタに反映させる
+		mark_vmachine_registers();
+#endif
+
 		// 参照カウンタを減らす
 		// これにより、ルートから示されている以外のオブジェクトは参照カウンタが0となる
 		add_ref_count_objects(begin, current, -1);
@@ -639,6 +743,10 @@ void ObjectSpace::full_gc(){
 		// 死者も、参照カウンタを元に戻す
 		add_ref_count_objects(alive, current, 1);
 
+#ifndef XTAL_NO_DEFERRED_REF_COUNT
+		unmark_vmachine_registers();
+#endif
+
 		if(!disable_finalizer_){
 			bool exists_have_finalizer = false;
 			
@@ -656,10 +764,14 @@ void ObjectSpace::full_gc(){
 			if(exists_have_finalizer){
 				// finalizerでオブジェクトが作られたかもしれないので、currentを反映する
 				current = ConnectedPointer(objects_count_, objects_list_begin_);
-				begin = ConnectedPointer(0, objects_list_begin_);
+				begin = ConnectedPointer(first, objects_list_begin_);
 
 				// 死者が生き返ったかも知れないのでチェックする
 
+#ifndef XTAL_NO_DEFERRED_REF_COUNT
+				mark_vmachine_registers();
+#endif
+
 				// 参照カウンタを減らす
 				add_ref_count_objects(alive, current, -1);
 				
@@ -670,10 +782,17 @@ void ObjectSpace::full_gc(){
 
 				// 死者も、参照カウンタを元に戻す
 				add_ref_count_objects(alive, current, 1);
+
+#ifndef XTAL_NO_DEFERRED_REF_COUNT
+				unmark_vmachine_registers();
+#endif
 			}
 		}
 
 		destroy_objects(alive, current);
+#ifndef XTAL_NO_DEFERRED_REF_COUNT
+		purge_zero_count_objects();
+#endif
 		free_objects(alive, current);
 		
 		adjust_objects_list(alive);
@@ -685,10 +804,149 @@ void ObjectSpace::full_gc(){
 		current = alive;
 	}
 
-	objects_generation_line_ = objects_count_;
-	objects_destroyed_count_ = 0;
+	if(first==0){
+		objects_generation_line_ = objects_count_;
+		objects_destroyed_count_ = 0;
+		promoted_objects_count_ = 0;
+	}
+	else if(objects_generation_line_>objects_count_){
+		objects_generation_line_ = objects_count_;
+	}
+
+#ifndef XTAL_NO_DEFERRED_REF_COUNT
+	// 破棄の連鎖で参照カウンタが0になったものを片付ける
+	zero_count_lock_--;
+	reconcile_zero_count();
+#endif
+
+	add_gc_pause_time(begin);
+}
+
+void ObjectSpace::add_gc_pause_time(u64 begin){
+	uint_t time = (uint_t)(thread_lib()->clock() - begin);
+	gc_pause_time_ += time;
+	if(max_gc_pause_time_<time){
+		max_gc_pause_time_ = time;
+	}
+}
+
+#ifndef XTAL_NO_DEFERRED_REF_COUNT
+
+void ObjectSpace::register_vmachine(VMachine* vm){
+	vmachines_.push(vm);
+}
+
+void ObjectSpace::unregister_vmachine(VMachine* vm){
+	for(uint_t i=0, size=vmachines_.size(); i<size; ++i){
+		if(vmachines_.reverse_at(i)==vm){
+			vmachines_.reverse_at(i) = vmachines_.top();
+			vmachines_.downsize(1);
+			return;
+		}
+	}
+}
+
+void ObjectSpace::push_zero_count(RefCountingBase* p){
+	if(p->object_destroyed() || p->in_zero_count_table()){
+		return;
+	}
+
+	if(!defer_zero_count_){
+		p->object_destroy();
+		return;
+	}
+
+	p->set_zero_count_flag();
+	zero_count_objects_.push(p);
+
+	if(zero_count_objects_.size()>=zero_count_limit_){
+		reconcile_zero_count();
+	}
+}
+
+void ObjectSpace::reconcile_zero_count(){
+	if(zero_count_lock_!=0){
+		return;
+	}
+
+	{
+		ScopeCounter zc(&zero_count_lock_);
+		mark_vmachine_registers();
+		destroy_zero_count_objects();
+		unmark_vmachine_registers();
+	}
+
+	finalize_zero_count_objects();
+}
+
+void ObjectSpace::mark_vmachine_registers(){
+	for(uint_t i=0, size=vmachines_.size(); i<size; ++i){
+		vmachines_.reverse_at(i)->mark_registers(marked_objects_);
+	}
+}
+
+void ObjectSpace::unmark_vmachine_registers(){
+	while(!marked_objects_.empty()){
+		RefCountingBase* p = marked_objects_.pop();
+		p->add_ref_count(-1);
+		if(!p->alive_ref_count()){
+			// レジスタからしか参照されていないので、次の走査まで表に残す
+			push_zero_count(p);
+		}
+	}
+
+	uint_t limit = zero_count_objects_.size()*2;
+	zero_count_limit_ = limit<ZERO_COUNT_LIMIT_MIN ? ZERO_COUNT_LIMIT_MIN : limit;
+}
+
+void ObjectSpace::destroy_zero_count_objects(){
+	// 破棄の連鎖で積まれたものも、このループで処理される
+	while(!zero_count_objects_.empty()){
+		RefCountingBase* p = zero_count_objects_.pop();
+		p->unset_zero_count_flag();
+
+		if(p->alive_ref_count() || p->object_destroyed()){
+			continue;
+		}
+
+		if(p->have_finalizer()){
+			// finalizerはVMのコードを走らせるので、レジスタの走査が終わってから呼ぶ
+			p->inc_ref_count();
+			finalize_objects_.push(p);
+			continue;
+		}
+
+		p->object_destroy();
+	}
+}
+
+void ObjectSpace::purge_zero_count_objects(){
+	uint_t n = 0;
+	for(uint_t i=0, size=zero_count_objects_.size(); i<size; ++i){
+		RefCountingBase* p = zero_count_objects_.reverse_at(i);
+		if(!p->object_destroyed()){
+			zero_count_objects_.reverse_at(n++) = p;
+		}
+	}
+	zero_count_objects_.downsize_n(n);
 }
 
+void ObjectSpace::finalize_zero_count_objects(){
+	while(!finalize_objects_.empty()){
+		RefCountingBase* p = finalize_objects_.pop();
+		p->finalize();
+		p->add_ref_count(-1);
+
+		if(!p->alive_ref_count()){
+			// 復活していなければ、次の走査で破棄する
+			p->unset_finalizer_flag();
+			push_zero_count(p);
+		}
+	}
+}
+
+#endif
+
 void ObjectSpace::set_cpp_class(CppClassSymbolData* key, const ClassPtr& cls){
 	if(cpp_map_iter_t it = cpps_map_.find(key->key())){
 		it->value() = cls;
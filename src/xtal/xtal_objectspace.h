@@ -32,7 +32,13 @@ public:
 public:
 
 	ObjectSpace()
-		:cpps_map_(cpp_map_t::no_use_memory_t()), values_map_(value_map_t::no_use_memory_t()){}
+		:cpps_map_(cpp_map_t::no_use_memory_t()), values_map_(value_map_t::no_use_memory_t()){
+#ifndef XTAL_NO_DEFERRED_REF_COUNT
+		zero_count_limit_ = 0;
+		zero_count_lock_ = 0;
+		defer_zero_count_ = false;
+#endif
+	}
 
 	void initialize();
 
@@ -46,12 +52,40 @@ public:
 
 	void disable_gc();
 
+	bool is_gc_enabled(){
+		return cycle_count_==0;
+	}
+
 	void gc();
 
 	void full_gc();
 
+	/**
+	* \brief first番目以降に登録されたオブジェクトだけを対象に、循環参照を回収する。
+	* それより前に登録されたオブジェクトからの参照は、すべてルートからの参照とみなす。
+	* 時間はヒープ全体ではなく、対象のオブジェクトの数に比例する。
+	*/
+	void collect_cycles_since(uint_t first);
+
 	void register_gc(RefCountingBase* p);
 
+#ifndef XTAL_NO_DEFERRED_REF_COUNT
+public:
+	void register_vmachine(VMachine* vm);
+
+	void unregister_vmachine(VMachine* vm);
+
+	/**
+	* \brief 参照カウンタが0になったオブジェクトをゼロカウント表に積む。
+	*/
+	void push_zero_count(RefCountingBase* p);
+
+	/**
+	* \brief 全VMachineのレジスタを走査して、ゼロカウント表のうちどこからも参照されていないオブジェクトを破棄する。
+	*/
+	void reconcile_zero_count();
+#endif
+
 public:
 	void set_cpp_class(CppClassSymbolData* key, const ClassPtr& cls);
 
@@ -72,6 +106,29 @@ public:
 
 	RefCountingBase* alive_object(uint_t i);
 
+	uint_t gc_count(){
+		return gc_count_;
+	}
+
+	uint_t full_gc_count(){
+		return full_gc_count_;
+	}
+
+	uint_t gc_pause_time(){
+		return gc_pause_time_;
+	}
+
+	uint_t max_gc_pause_time(){
+		return max_gc_pause_time_;
+	}
+
+	void reset_gc_stats(){
+		gc_count_ = 0;
+		full_gc_count_ = 0;
+		gc_pause_time_ = 0;
+		max_gc_pause_time_ = 0;
+	}
+
 public:
 
 	void shrink_to_fit();
@@ -98,6 +155,22 @@ private:
 
 	void expand_objects_list();
 
+	void add_gc_pause_time(u64 begin);
+
+	void collect_cycles(uint_t first);
+
+#ifndef XTAL_NO_DEFERRED_REF_COUNT
+	void mark_vmachine_registers();
+
+	void unmark_vmachine_registers();
+
+	void destroy_zero_count_objects();
+
+	void purge_zero_count_objects();
+
+	void finalize_zero_count_objects();
+#endif
+
 private:
 	RefCountingBase*** objects_list_begin_;
 	RefCountingBase*** objects_list_current_;
@@ -108,10 +181,26 @@ private:
 	uint_t objects_max_;
 	uint_t processed_line_;
 	int_t objects_destroyed_count_;
+	uint_t promoted_objects_count_;
 
 	bool disable_finalizer_;
 
 	uint_t cycle_count_;
+	uint_t gc_count_;
+	uint_t full_gc_count_;
+	uint_t gc_pause_time_;
+	uint_t max_gc_pause_time_;
+
+#ifndef XTAL_NO_DEFERRED_REF_COUNT
+	PODStack<RefCountingBase*> zero_count_objects_;
+	PODStack<RefCountingBase*> marked_objects_;
+	PODStack<RefCountingBase*> finalize_objects_;
+	PODStack<VMachine*> vmachines_;
+
+	uint_t zero_count_limit_;
+	uint_t zero_count_lock_;
+	bool defer_zero_count_;
+#endif
 
 private:
 	cpp_map_t cpps_map_;
@@ -0,0 +1,270 @@
+#include "xtal.h"
+#include "xtal_macro.h"
+
+namespace xtal{
+
+Scheduler::Scheduler(){
+	filesystem_lib_ = filesystem_lib();
+	poller_ = filesystem_lib_->new_poller();
+	base_clock_ = thread_lib()->clock();
+	timer_seq_ = 0;
+	waiting_io_count_ = 0;
+	readers_ = xnew<Map>();
+	writers_ = xnew<Map>();
+	parked_ = false;
+	stop_ = false;
+}
+
+Scheduler::~Scheduler(){
+	if(poller_){
+		filesystem_lib_->delete_poller(poller_);
+	}
+}
+
+const FiberPtr& Scheduler::spawn(const FiberPtr& fiber){
+	push_ready(fiber, undefined);
+	return fiber;
+}
+
+void Scheduler::push_ready(const AnyPtr& fiber, const AnyPtr& value){
+	ready_.push_back(fiber);
+	ready_.push_back(value);
+}
+
+void Scheduler::sleep(float_t sec){
+	if(!current_ || parked_){
+		XTAL_SET_EXCEPT(cpp_class<RuntimeError>()->call(Xt("XRE1037")));
+		return;
+	}
+
+	if(sec<0){
+		sec = 0;
+	}
+
+	parked_ = true;
+	push_timer(thread_lib()->clock() + (u64)(sec*1000*1000), current_);
+}
+
+void Scheduler::wait_readable(int_t fd){
+	wait_io(fd, FilesystemLib::POLL_READ);
+}
+
+void Scheduler::wait_writable(int_t fd){
+	wait_io(fd, FilesystemLib::POLL_WRITE);
+}
+
+void Scheduler::wait_io(int_t fd, int_t events){
+	if(!current_ || parked_){
+		XTAL_SET_EXCEPT(cpp_class<RuntimeError>()->call(Xt("XRE1037")));
+		return;
+	}
+
+	if(!poller_){
+		XTAL_SET_EXCEPT(cpp_class<UnsupportedError>()->call(Xt("XRE1038")));
+		return;
+	}
+
+	// 同じfdを複数のファイバーが待てるように、fdごとに待っているファイバーを並べておく
+	const MapPtr& waiters = events==FilesystemLib::POLL_READ ? readers_ : writers_;
+	ArrayPtr list = ptr_cast<Array>(waiters->at(fd));
+	if(!list){
+		list = xnew<Array>();
+		waiters->set_at(fd, list);
+	}
+
+	parked_ = true;
+	list->push_back(current_);
+	waiting_io_count_++;
+	update_watch(fd);
+}
+
+void Scheduler::update_watch(int_t fd){
+	int_t events = 0;
+	if(readers_->at(fd)){ events |= FilesystemLib::POLL_READ; }
+	if(writers_->at(fd)){ events |= FilesystemLib::POLL_WRITE; }
+	filesystem_lib_->watch_poller(poller_, fd, events);
+}
+
+float_t Scheduler::now(){
+	return (float_t)(thread_lib()->clock() - base_clock_)/(1000*1000);
+}
+
+void Scheduler::run(){
+	stop_ = false;
+	while(!stop_ && run_once()){
+		XTAL_CHECK_EXCEPT(e){ return; }
+
+		if(execution_limit_exceeded()){
+			return;
+		}
+	}
+}
+
+bool Scheduler::run_once(float_t timeout){
+	swap(ready_, running_);
+
+	for(uint_t i=0; i<running_.size(); i+=2){
+		resume(running_.at(i), running_.at(i+1));
+
+		// 例外が発生するか実行量の上限に達したら、まだ実行していないファイバーを実行待ちキューの先頭に戻す
+		// 上限に達して中断されたファイバーはresumeで実行待ちキューの末尾に戻されている
+		if(vmachine()->except() || execution_limit_exceeded()){
+			for(uint_t j=running_.size(); j>i+2; --j){
+				ready_.push_front(running_.at(j-1));
+			}
+			running_.clear();
+			return true;
+		}
+	}
+	running_.clear();
+
+	expire_timers();
+
+	if(!ready_.empty()){
+		// 実行待ちのファイバーがある場合は、準備ができているfdだけを拾う
+		if(waiting_io_count_!=0){
+			poll(0);
+		}
+	}
+	else if(!timers_.empty() || waiting_io_count_!=0){
+		float_t wait = timeout;
+		if(!timers_.empty()){
+			u64 clock = thread_lib()->clock();
+			float_t until = timers_[0].deadline>clock ? (float_t)(timers_[0].deadline - clock)/(1000*1000) : 0;
+			if(wait<0 || until<wait){
+				wait = until;
+			}
+		}
+
+		if(waiting_io_count_!=0){
+			poll(wait);
+		}
+		else if(wait>0){
+			XTAL_UNLOCK{
+				thread_lib()->sleep(wait);
+			}
+		}
+
+		expire_timers();
+	}
+
+	return task_count()!=0;
+}
+
+void Scheduler::resume(const AnyPtr& fiber, const AnyPtr& value){
+	current_ = fiber;
+	parked_ = false;
+
+	if(raweq(value, undefined)){
+		fiber->call();
+	}
+	else{
+		fiber->call(value);
+	}
+
+	if(!parked_ && unchecked_ptr_cast<Fiber>(fiber)->is_alive()){
+		push_ready(fiber, undefined);
+	}
+
+	current_ = null;
+	parked_ = false;
+}
+
+void Scheduler::expire_timers(){
+	u64 clock = thread_lib()->clock();
+	while(!timers_.empty() && timers_[0].deadline<=clock){
+		push_ready(timer_fibers_.at(0), undefined);
+		pop_timer();
+	}
+}
+
+void Scheduler::poll(float_t timeout){
+	PollEvent events[64];
+	int_t n = 0;
+	XTAL_UNLOCK{
+		n = filesystem_lib_->wait_poller(poller_, timeout, events, 64);
+	}
+
+	for(int_t i=0; i<n; ++i){
+		int_t fd = events[i].fd;
+		if(events[i].events & FilesystemLib::POLL_READ){
+			wake_io(readers_, fd, events[i].events);
+		}
+
+		if(events[i].events & FilesystemLib::POLL_WRITE){
+			wake_io(writers_, fd, events[i].events);
+		}
+
+		update_watch(fd);
+	}
+}
+
+void Scheduler::wake_io(const MapPtr& waiters, int_t fd, int_t events){
+	// 待っていたファイバーを登録された順に全て再開する
+	ArrayPtr list = ptr_cast<Array>(waiters->at(fd));
+	if(!list){
+		return;
+	}
+
+	waiters->erase(fd);
+	for(uint_t i=0; i<list->size(); ++i){
+		push_ready(list->at(i), events);
+	}
+	waiting_io_count_ -= list->size();
+}
+
+void Scheduler::push_timer(u64 deadline, const AnyPtr& fiber){
+	Timer t;
+	t.deadline = deadline;
+	t.seq = timer_seq_++;
+	timers_.push_back(t);
+	timer_fibers_.push_back(fiber);
+
+	uint_t i = timers_.size()-1;
+	while(i!=0){
+		uint_t parent = (i-1)/2;
+		if(!timer_less(i, parent)){
+			break;
+		}
+		swap_timer(i, parent);
+		i = parent;
+	}
+}
+
+void Scheduler::pop_timer(){
+	uint_t last = timers_.size()-1;
+	swap_timer(0, last);
+	timers_.pop_back();
+	timer_fibers_.pop_back();
+
+	uint_t size = timers_.size();
+	uint_t i = 0;
+	for(;;){
+		uint_t left = i*2+1;
+		uint_t right = left+1;
+		uint_t min = i;
+		if(left<size && timer_less(left, min)){ min = left; }
+		if(right<size && timer_less(right, min)){ min = right; }
+		if(min==i){
+			break;
+		}
+		swap_timer(i, min);
+		i = min;
+	}
+}
+
+bool Scheduler::timer_less(uint_t a, uint_t b){
+	if(timers_[a].deadline!=timers_[b].deadline){
+		return timers_[a].deadline<timers_[b].deadline;
+	}
+	return (int_t)(timers_[a].seq - timers_[b].seq)<0;
+}
+
+void Scheduler::swap_timer(uint_t a, uint_t b){
+	std::swap(timers_[a], timers_[b]);
+	AnyPtr temp = timer_fibers_.at(a);
+	timer_fibers_.set_at(a, timer_fibers_.at(b));
+	timer_fibers_.set_at(b, temp);
+}
+
+}
@@ -0,0 +1,154 @@
+/** \file src/xtal/xtal_scheduler.h
+* \brief src/xtal/xtal_scheduler.h
+*/
+
+#ifndef XTAL_SCHEDULER_H_INCLUDE_GUARD
+#define XTAL_SCHEDULER_H_INCLUDE_GUARD
+
+#pragma once
+
+namespace xtal{
+
+/**
+* \xbind lib::builtin
+* \xinherit lib::builtin::Any
+* \brief ファイバーを協調的に実行するスケジューラ
+* 実行待ちキュー、タイマー、ファイルディスクリプタの準備待ちを一つのVMachine上で多重化する。
+* ファイバーはsleepやwait_readableなどで待機条件を登録してからyieldする。
+* 待機条件を登録せずにyieldしたファイバーは実行待ちキューの末尾に戻される。
+*/
+class Scheduler : public Base{
+public:
+
+	enum{
+		READ = FilesystemLib::POLL_READ,
+		WRITE = FilesystemLib::POLL_WRITE
+	};
+
+	/**
+	* \brief スケジューラを生成する
+	*/
+	Scheduler();
+
+	~Scheduler();
+
+public:
+
+	/**
+	* \brief ファイバーを実行待ちキューに追加する
+	*/
+	const FiberPtr& spawn(const FiberPtr& fiber);
+
+	/**
+	* \brief 実行中のファイバーをsec秒後に再開するよう登録する
+	* 登録後、ファイバーはyieldしなければならない。
+	*/
+	void sleep(float_t sec);
+
+	/**
+	* \brief 実行中のファイバーをfdが読み込み可能になったときに再開するよう登録する
+	* 同じfdを複数のファイバーが待っている場合は、登録された順に全て再開される。
+	* 再開されたファイバーのyield式の値は、準備ができたイベントの組み合わせとなる。
+	*/
+	void wait_readable(int_t fd);
+
+	/**
+	* \brief 実行中のファイバーをfdが書き込み可能になったときに再開するよう登録する
+	* 再開されたファイバーのyield式の値は、準備ができたイベントの組み合わせとなる。
+	*/
+	void wait_writable(int_t fd);
+
+	/**
+	* \brief 実行待ち、待機中のファイバーが無くなるまで実行する
+	* set_execution_limitで設定した上限に達した場合も戻る。中断されたファイバーは実行待ちキューに残る。
+	*/
+	void run();
+
+	/**
+	* \brief 実行待ちのファイバーを一巡実行し、最大timeout秒の間タイマーやfdの準備を待つ
+	* timeoutが負の場合は次のタイマーまで待つ。
+	* \retval true まだ実行待ち、待機中のファイバーが残っている
+	* \retval false 全てのファイバーが終了した
+	*/
+	bool run_once(float_t timeout = -1);
+
+	/**
+	* \brief runを中断する
+	*/
+	void stop(){
+		stop_ = true;
+	}
+
+	/**
+	* \brief スケジューラが管理しているファイバーの数を返す
+	*/
+	uint_t task_count(){
+		return ready_.size()/2 + timers_.size() + waiting_io_count_;
+	}
+
+	/**
+	* \brief スケジューラ生成時からの経過秒数を返す
+	*/
+	float_t now();
+
+	/**
+	* \brief 現在実行中のファイバーを返す
+	*/
+	const AnyPtr& current(){
+		return current_;
+	}
+
+public:
+
+	void on_visit_members(Visitor& m){
+		Base::on_visit_members(m);
+		m & ready_ & running_ & timer_fibers_ & readers_ & writers_ & current_;
+	}
+
+private:
+
+	struct Timer{
+		u64 deadline;
+		uint_t seq;
+	};
+
+	void push_timer(u64 deadline, const AnyPtr& fiber);
+	void pop_timer();
+	bool timer_less(uint_t a, uint_t b);
+	void swap_timer(uint_t a, uint_t b);
+
+	void push_ready(const AnyPtr& fiber, const AnyPtr& value);
+	void wait_io(int_t fd, int_t events);
+	void update_watch(int_t fd);
+	void wake_io(const MapPtr& waiters, int_t fd, int_t events);
+	void resume(const AnyPtr& fiber, const AnyPtr& value);
+	void expire_timers();
+	void poll(float_t timeout);
+
+private:
+	FilesystemLib* filesystem_lib_;
+	void* poller_;
+
+	u64 base_clock_;
+	uint_t timer_seq_;
+	uint_t waiting_io_count_;
+
+	// ファイバーと再開時に渡す値を交互に並べた実行待ちキュー
+	xarray ready_;
+	xarray running_;
+
+	PODArray<Timer> timers_;
+	xarray timer_fibers_;
+
+	// fdから、そのfdを待っているファイバーの配列への写像
+	MapPtr readers_;
+	MapPtr writers_;
+
+	AnyPtr current_;
+	bool parked_;
+	bool stop_;
+};
+
+}
+
+#endif // XTAL_SCHEDULER_H_INCLUDE_GUARD
@@ -7,7 +7,7 @@ namespace xtal{
 	
 enum{
 	SERIALIZE_VERSION1 = 2,
-	SERIALIZE_VERSION2 = 0
+	SERIALIZE_VERSION2 = 1
 };
 
 Serializer::Serializer(const StreamPtr& s)
@@ -16,6 +16,10 @@ Serializer::Serializer(const StreamPtr& s)
 
 Serializer::~Serializer(){}
 
+uint_t Serializer::version(){
+	return (SERIALIZE_VERSION1<<8) | SERIALIZE_VERSION2;
+}
+
 void Serializer::serialize(const AnyPtr& v){
 	clear();
 	inner_serialize(v);
@@ -169,25 +173,27 @@ void Serializer::inner_serialize(const AnyPtr& v){
 		stream_->put_u8(0); 
 		stream_->put_u8(0);
 		
+		CodeImage* image = p->image_;
+
 		uint_t sz;
-		sz = p->code_.size();
+		sz = image->bytecode_size();
 		stream_->put_u32be(sz);
 		//if(sz!=0){ stream_->write(&p->code_[0], sz); }	
 		for(uint_t i=0; i<sz; ++i){
-			stream_->put_u16be(p->code_[i]);
+			stream_->put_u16be(image->bytecode_data()[i]);
 		}
 
-		sz = p->scope_info_table_.size();
+		sz = image->scope_info_size();
 		stream_->put_u16be((u16)sz);
 		for(uint_t i=0; i<sz; ++i){
-			ScopeInfo& info = p->scope_info_table_[i];
+			ScopeInfo& info = *p->scope_info(i);
 			inner_serialize_scope_info(info);
 		}
 		
-		sz = p->class_info_table_.size();
+		sz = image->class_info_size();
 		stream_->put_u16be((u16)sz);
 		for(uint_t i=0; i<sz; ++i){
-			ClassInfo& info = p->class_info_table_[i];
+			ClassInfo& info = *p->class_info(i);
 			inner_serialize_scope_info(info);
 
 			stream_->put_u16be(info.instance_variable_size);
@@ -196,10 +202,10 @@ void Serializer::inner_serialize(const AnyPtr& v){
 			stream_->put_u8(info.mixins);
 		}
 
-		sz = p->xfun_info_table_.size();
+		sz = image->fun_info_size();
 		stream_->put_u16be((u16)sz);
 		for(uint_t i=0; i<sz; ++i){
-			FunInfo& info = p->xfun_info_table_[i];
+			FunInfo& info = *p->fun_info(i);
 			inner_serialize_scope_info(info);
 			
 			stream_->put_u16be(info.max_stack);
@@ -209,21 +215,29 @@ void Serializer::inner_serialize(const AnyPtr& v){
 			stream_->put_u8(info.max_param_count);
 		}
 
-		sz = p->except_info_table_.size();
+		sz = image->except_info_size();
 		stream_->put_u16be((u16)sz);
 		for(uint_t i=0; i<sz; ++i){
-			ExceptInfo& info = p->except_info_table_[i];
+			ExceptInfo& info = *p->except_info(i);
 			stream_->put_u32be(info.catch_pc);
 			stream_->put_u32be(info.finally_pc);
 			stream_->put_u32be(info.end_pc);
 		}
 		
-		sz = p->lineno_table_.size();
+		const LineNumberTable& lines = image->lineno_table();
+		sz = lines.size();
+		stream_->put_u16be((u16)sz);
+		LineNumberTable::Cursor c;
+		lines.begin(c);
+		while(lines.next(c)){
+			stream_->put_u32be(c.entry.start_pc);
+			stream_->put_u16be((u16)c.entry.lineno);
+		}
+
+		sz = image->statement_size();
 		stream_->put_u16be((u16)sz);
 		for(uint_t i=0; i<sz; ++i){
-			Code::LineNumberInfo& info = p->lineno_table_[i];
-			stream_->put_u32be(info.start_pc);
-			stream_->put_u16be(info.lineno);
+			stream_->put_u32be(image->statement_data()[i]);
 		}
 			
 		sz = p->once_table_.size();
@@ -381,7 +395,8 @@ CodePtr Serializer::inner_deserialize_code(){
 		return null;
 	}
 
-	if(head[3]!=SERIALIZE_VERSION1 && head[4]!=SERIALIZE_VERSION2){
+	// 組み込みライブラリは版2.0で埋め込まれているので、文の先頭の表が無い版も読めるようにする
+	if(head[3]!=SERIALIZE_VERSION1 || head[4]>SERIALIZE_VERSION2){
 		set_runtime_error(Xt("XRE1009"));
 		return null;
 	}
@@ -436,11 +451,17 @@ CodePtr Serializer::inner_deserialize_code(){
 	}
 	
 	sz = stream_->get_u16be();
-	p->lineno_table_.resize(sz);
+	p->lineno_table_.clear();
 	for(uint_t i=0; i<sz; ++i){
-		Code::LineNumberInfo& info = p->lineno_table_[i];
-		info.start_pc = stream_->get_u32be();
-		info.lineno = stream_->get_u16be();
+		uint_t start_pc = stream_->get_u32be();
+		uint_t lineno = stream_->get_u16be();
+		p->lineno_table_.push_back(start_pc, lineno);
+	}
+
+	sz = head[4]>=1 ? stream_->get_u16be() : 0;
+	p->statement_table_.resize(sz);
+	for(uint_t i=0; i<sz; ++i){
+		p->statement_table_[i] = stream_->get_u32be();
 	}
 
 	sz = stream_->get_u16be();
@@ -449,8 +470,6 @@ CodePtr Serializer::inner_deserialize_code(){
 		p->once_table_.set_at(i, undefined);
 	}
 
-	p->first_fun_ = xnew<Method>(nul<Frame>(), p, &p->xfun_info_table_[0]);
-	
 	p->source_file_name_ = ptr_cast<String>(inner_deserialize());
 
 	sz = stream_->get_u16be();
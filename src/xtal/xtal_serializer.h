@@ -20,6 +20,11 @@ public:
 
 	AnyPtr deserialize();
 
+	/**
+	* \brief 直列化の形式のバージョンを返す
+	*/
+	static uint_t version();
+
 private:
 
 	void inner_serialize(const AnyPtr& v);
@@ -39,6 +39,22 @@
 */
 //#define XTAL_NO_SMALL_ALLOCATOR
 
+/**
+* \brief VMのレジスタの遅延参照カウントを使わない
+* 定義しない場合、VMachineのレジスタとFunFrameは参照カウンタを操作せず、
+* 参照カウンタが0になったオブジェクトはゼロカウント表に積まれ、
+* 全VMachineのレジスタを走査したあとでまとめて破棄される。
+* XTAL_USE_THREAD_MODEL2の場合は常に無効になる。
+*/
+//#define XTAL_NO_DEFERRED_REF_COUNT
+
+/**
+* \brief VMの実行統計を収集する
+* 定義すると、VMachineが実行した命令数を数える。
+* 命令ごとにカウンタを増やすため、少し遅くなる。
+*/
+//#define XTAL_ENABLE_VM_STATS
+
 
 //#define XTAL_CHECK_REF_COUNT
 
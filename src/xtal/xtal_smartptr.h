@@ -193,10 +193,17 @@ struct XXNew;
 template<class T>
 struct XXNew<T, XNEW_NONE> : public XXNew<T, XNewN<T>::value>{};
 
+#ifdef XTAL_ENABLE_VM_STATS
+void count_allocation(CppClassSymbolData* key);
+#endif
+
 template<class T>
 T* make_object(){
 	T* p = object_xmalloc<T>();
 	p->special_initialize(&VirtualMembersT<T>::value);
+#ifdef XTAL_ENABLE_VM_STATS
+	count_allocation(&CppClassSymbol<T>::value);
+#endif
 	return p;
 }
 
@@ -883,6 +890,13 @@ public:
 		return ptr_;
 	}
 
+	/**
+	* \brief 参照カウンタを操作せずにポインタを設定する。
+	*/
+	void set_direct(T* p){
+		ptr_ = p;
+	}
+
 	T* operator ->() const{
 		return ptr_;
 	}
@@ -0,0 +1,201 @@
+#include "xtal.h"
+#include "xtal_macro.h"
+
+#include "xtal_details.h"
+
+#ifdef XTAL_ENABLE_VM_STATS
+
+namespace xtal{
+
+namespace{
+
+void add_count(const MapPtr& map, const AnyPtr& key, uint_t n){
+	const AnyPtr& count = map->at(key);
+	map->set_at(key, XTAL_detail_type(count)==TYPE_INT ? XTAL_detail_ivalue(count)+n : n);
+}
+
+MapPtr inst_count_map(const uint_t* counts){
+	MapPtr ret = xnew<Map>();
+	for(uint_t i=0; i<InstMAX::NUMBER; ++i){
+		if(counts[i]!=0){
+			ret->set_at(intern(inst_name(i)), counts[i]);
+		}
+	}
+	return ret;
+}
+
+}
+
+void StatsSpace::initialize(){
+	allocation_counts_.expand(5);
+	code_refs_ = XNew<Array>();
+	instance_counts_ = XNew<Map>();
+	reset();
+	enabled_ = true;
+}
+
+void StatsSpace::uninitialize(){
+	enabled_ = false;
+	code_refs_ = null;
+	instance_counts_ = null;
+}
+
+void StatsSpace::destroy(){
+	for(uint_t i=0; i<codes_.size(); ++i){
+		delete_object_xfree<CodeStats>(codes_[i]);
+	}
+	codes_.destroy();
+	allocation_counts_.destroy();
+}
+
+void StatsSpace::reset(){
+	std::memset(inst_counts_, 0, sizeof(inst_counts_));
+	std::memset(slow_path_counts_, 0, sizeof(slow_path_counts_));
+
+	for(uint_t i=0; i<codes_.size(); ++i){
+		CodeStats* p = codes_[i];
+		std::memset(p->inst_counts.data(), 0, sizeof(uint_t)*p->inst_counts.size());
+		std::memset(p->call_counts.data(), 0, sizeof(uint_t)*p->call_counts.size());
+	}
+
+	allocation_counts_.clear();
+
+	if(instance_counts_){
+		instance_counts_->clear();
+	}
+}
+
+CodeStats* StatsSpace::code_stats(Code* code){
+	if(!code || !enabled_){
+		return 0;
+	}
+
+	for(uint_t i=0; i<codes_.size(); ++i){
+		if(codes_[i]->code==code){
+			return codes_[i];
+		}
+	}
+
+	CodeStats* p = new_object_xmalloc<CodeStats>();
+	p->code = code;
+	p->begin = code->bytecode_data();
+	p->size = code->bytecode_size();
+	p->inst_counts.resize(p->size);
+	p->call_counts.resize(code->fun_info_size());
+	std::memset(p->inst_counts.data(), 0, sizeof(uint_t)*p->inst_counts.size());
+	std::memset(p->call_counts.data(), 0, sizeof(uint_t)*p->call_counts.size());
+
+	codes_.push_back(p);
+	code_refs_->push_back(to_smartptr(code));
+	return p;
+}
+
+void StatsSpace::count_allocation(CppClassSymbolData* key){
+	if(!enabled_){
+		return;
+	}
+
+	uint_t k = key->key();
+	if(allocation_map_t::Node* node = allocation_counts_.find(k)){
+		node->value().count++;
+	}
+	else{
+		AllocationCount count = { key, 1 };
+		allocation_counts_.insert(k, count);
+	}
+}
+
+void StatsSpace::count_instance(const ClassPtr& cls){
+	if(!enabled_){
+		return;
+	}
+
+	add_count(instance_counts_, cls, 1);
+}
+
+uint_t StatsSpace::executed_inst_count(){
+	uint_t ret = 0;
+	for(uint_t i=0; i<InstMAX::NUMBER; ++i){
+		ret += inst_counts_[i];
+	}
+	return ret;
+}
+
+void StatsSpace::store(const MapPtr& ret){
+	ret->set_at(Xid(insts), inst_count_map(inst_counts_));
+	ret->set_at(Xid(slow_paths), inst_count_map(slow_path_counts_));
+
+	MapPtr codes = xnew<Map>();
+	ArrayPtr funs = xnew<Array>();
+	PODArray<uint_t> fun_counts;
+
+	for(uint_t i=0; i<codes_.size(); ++i){
+		CodeStats* p = codes_[i];
+		const CodePtr& code = to_smartptr(p->code);
+
+		// コード位置ごとの回数を、その位置を含む最も内側の関数にまとめる
+		fun_counts.resize(p->call_counts.size());
+		std::memset(fun_counts.data(), 0, sizeof(uint_t)*fun_counts.size());
+
+		FunInfo* first = fun_counts.empty() ? 0 : code->fun_info(0);
+		uint_t total = 0;
+		for(uint_t j=0; j<p->size; ++j){
+			if(uint_t n = p->inst_counts[j]){
+				total += n;
+				if(first){
+					uint_t index = (uint_t)(code->compliant_fun_info(p->begin+j) - first);
+					if(index<fun_counts.size()){
+						fun_counts[index] += n;
+					}
+				}
+			}
+		}
+
+		StringPtr source = code->source_file_name() ? code->source_file_name() : XTAL_STRING("?");
+		add_count(codes, source, total);
+
+		for(uint_t j=0; j<fun_counts.size(); ++j){
+			if(fun_counts[j]==0 && p->call_counts[j]==0){
+				continue;
+			}
+
+			FunInfo* info = code->fun_info(j);
+			MapPtr fun = xnew<Map>();
+			fun->set_at(Xid(code), source);
+			fun->set_at(Xid(name), info->name_number!=0 ? (AnyPtr)code->identifier(info->name_number) : (AnyPtr)XTAL_STRING("?"));
+			fun->set_at(Xid(lineno), code->compliant_lineno(p->begin+info->pc));
+			fun->set_at(Xid(calls), p->call_counts[j]);
+			fun->set_at(Xid(insts), fun_counts[j]);
+			funs->push_back(fun);
+		}
+	}
+
+	ret->set_at(Xid(codes), codes);
+	ret->set_at(Xid(functions), funs);
+
+	// 名前を引くときにクラスが作られて数が増えることがあるので、先に取り出しておく
+	PODArray<AllocationCount> allocations;
+	for(allocation_map_t::iterator it=allocation_counts_.begin(); it!=allocation_counts_.end(); ++it){
+		allocations.push_back(it->second);
+	}
+
+	MapPtr allocation_map = xnew<Map>();
+	for(uint_t i=0; i<allocations.size(); ++i){
+		add_count(allocation_map, cpp_class(allocations[i].key)->object_name(), allocations[i].count);
+	}
+	ret->set_at(Xid(allocations), allocation_map);
+
+	MapPtr instances = xnew<Map>();
+	for(Map::iterator it=instance_counts_->begin(); it!=instance_counts_->end(); ++it){
+		add_count(instances, it->first->object_name(), ivalue(it->second));
+	}
+	ret->set_at(Xid(instances), instances);
+}
+
+void count_allocation(CppClassSymbolData* key){
+	environment_->stats_space_.count_allocation(key);
+}
+
+}
+
+#endif
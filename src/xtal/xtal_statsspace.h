@@ -0,0 +1,107 @@
+/** \file src/xtal/xtal_statsspace.h
+* \brief src/xtal/xtal_statsspace.h
+*/
+
+#ifndef XTAL_STATSSPACE_H_INCLUDE_GUARD
+#define XTAL_STATSSPACE_H_INCLUDE_GUARD
+
+#pragma once
+
+#ifdef XTAL_ENABLE_VM_STATS
+
+namespace xtal{
+
+/**
+* \brief コードごとの実行回数
+*/
+struct CodeStats{
+	Code* code;
+	const inst_t* begin;
+	uint_t size;
+
+	// コード位置ごとの実行命令数
+	PODArray<uint_t> inst_counts;
+
+	// 関数ごとの呼び出し回数
+	PODArray<uint_t> call_counts;
+};
+
+/**
+* \brief C++のクラスごとの生成数
+*/
+struct AllocationCount{
+	CppClassSymbolData* key;
+	uint_t count;
+};
+
+/**
+* \brief VMの実行統計を集める
+*
+* XTAL_ENABLE_VM_STATSが定義されている場合だけ存在する。
+* 数えたコードは統計を取り出せるように、resetされても実行環境が破棄されるまで保持される。
+*/
+class StatsSpace{
+public:
+	typedef Hashtable<uint_t, AllocationCount, ObjectSpace::CppFun> allocation_map_t; 
+
+	StatsSpace()
+		:allocation_counts_(allocation_map_t::no_use_memory_t()){
+		enabled_ = false;
+	}
+
+	void initialize();
+
+	/**
+	* \brief 集めたオブジェクトへの参照を手放し、以降の集計をやめる
+	*/
+	void uninitialize();
+
+	/**
+	* \brief uninitializeの後、すべてのオブジェクトが破棄されてからメモリを解放する
+	*/
+	void destroy();
+
+	void reset();
+
+	void count_inst(uint_t opc){
+		inst_counts_[opc]++;
+	}
+
+	void count_slow_path(uint_t opc){
+		slow_path_counts_[opc]++;
+	}
+
+	/**
+	* \brief codeに対応する実行回数を返す。無ければ作る。
+	*/
+	CodeStats* code_stats(Code* code);
+
+	void count_allocation(CppClassSymbolData* key);
+
+	void count_instance(const ClassPtr& cls);
+
+	uint_t executed_inst_count();
+
+	/**
+	* \brief 集めた統計をretに格納する
+	*/
+	void store(const MapPtr& ret);
+
+private:
+	uint_t inst_counts_[InstMAX::NUMBER];
+	uint_t slow_path_counts_[InstMAX::NUMBER];
+
+	PODArray<CodeStats*> codes_;
+	ArrayPtr code_refs_;
+
+	allocation_map_t allocation_counts_;
+	MapPtr instance_counts_;
+
+	bool enabled_;
+};
+
+}
+
+#endif
+
+#endif // XTAL_STATSSPACE_H_INCLUDE_GUARD
@@ -299,13 +299,13 @@ u32 Stream::get_u32le(){
 u64 Stream::get_u64be(){
 	struct{ u8 data[8]; } data = {{0}};
 	read_strict(data.data, 8);
-	return (u64)(((u64)data.data[0]<<56) | ((u64)data.data[1]<<48) | ((u64)data.data[2]<<40) | ((u64)data.data[3]<<32) | (data.data[4]<<24) | (data.data[5]<<16) | (data.data[6]<<8) | data.data[7]);
+	return (u64)(((u64)data.data[0]<<56) | ((u64)data.data[1]<<48) | ((u64)data.data[2]<<40) | ((u64)data.data[3]<<32) | ((u64)data.data[4]<<24) | ((u64)data.data[5]<<16) | ((u64)data.data[6]<<8) | (u64)data.data[7]);
 }
 
 u64 Stream::get_u64le(){
 	struct{ u8 data[8]; } data = {{0}};
 	read_strict(data.data, 8);
-	return (u64)(((u64)data.data[7]<<56) | ((u64)data.data[6]<<48) | ((u64)data.data[5]<<40) | ((u64)data.data[4]<<32) | (data.data[3]<<24) | (data.data[2]<<16) | (data.data[1]<<8) | data.data[0]);
+	return (u64)(((u64)data.data[7]<<56) | ((u64)data.data[6]<<48) | ((u64)data.data[5]<<40) | ((u64)data.data[4]<<32) | ((u64)data.data[3]<<24) | ((u64)data.data[2]<<16) | ((u64)data.data[1]<<8) | (u64)data.data[0]);
 }
 
 /////////////////////////////////////////////////////////////////
@@ -393,7 +393,9 @@ MemoryStream::MemoryStream(const void* data, uint_t data_size){
 	pos_ = 0;
 	capa_ = 0;
 	resize(data_size);
-	std::memcpy((void*)data_, data, data_size);
+	if(size_==data_size){
+		std::memcpy((void*)data_, data, data_size);
+	}
 }
 
 MemoryStream::~MemoryStream(){
@@ -405,6 +407,9 @@ MemoryStream::~MemoryStream(){
 uint_t MemoryStream::on_write(const void* p, uint_t size){
 	if(pos_+size>capa_){
 		resize(pos_+size);
+		if(pos_+size>capa_){
+			return 0;
+		}
 	}
 	else{
 		size_ = pos_+size;
@@ -423,6 +428,9 @@ uint_t MemoryStream::on_pour(const StreamPtr& in_stream, uint_t size){
 	}
 
 	resize(pos_+size);
+	if(pos_+size>capa_){
+		return 0;
+	}
 
 	uint_t len = in_stream->read((void*)&data_[pos_], size);
 	resize(size_ - (size - len));
@@ -433,15 +441,15 @@ uint_t MemoryStream::on_pour(const StreamPtr& in_stream, uint_t size){
 uint_t MemoryStream::on_pour_all(const StreamPtr& in_stream){
 	uint_t size = 1024*10, len, sum = 0;
 	do{
-		if(size_ <= pos_ + size){
-			resize(pos_+size);
+		resize(pos_+size);
+		if(pos_+size>capa_){
+			break;
 		}
-
 		len = in_stream->read((void*)&data_[pos_], size);
+		pos_ += len;
 		sum += len;
 	}while(len==size);
-	resize(size_ - (size - len));
-	pos_ += sum;
+	resize(pos_);
 	return sum;
 }
 
@@ -457,7 +465,12 @@ void MemoryStream::clear(){
 
 void MemoryStream::resize(uint_t size){
 	if(size>capa_){
+		// メモリ使用量の上限を超えるなら大きくしない
 		uint_t newcapa = size + capa_*2;
+		if(!reserve_memory(newcapa)){
+			return;
+		}
+
 		void* newp = xmalloc(newcapa);
 		std::memcpy(newp, data_, size_);
 		if(capa_){
@@ -205,6 +205,27 @@ String::String(const char_t* str1, uint_t size1, const char_t* str2, uint_t size
 	}
 }
 
+String::String(const char_t* const* strs, const uint_t* sizes, uint_t count){
+	uint_t sz = 0;
+	for(uint_t i=0; i<count; ++i){
+		sz += sizes[i];
+	}
+
+	char_t* dest;
+	if(sz<SMALL_STRING_MAX){
+		value_.init_small_string(sz);
+		dest = XTAL_detail_svalue(*this);
+	}
+	else{
+		dest = new_string_data(sz)->buf();
+	}
+
+	for(uint_t i=0; i<count; ++i){
+		string_copy(dest, strs[i], sizes[i]);
+		dest += sizes[i];
+	}
+}
+
 String::String(const String& s)
 	:Any(s){
 }
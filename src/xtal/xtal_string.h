@@ -41,6 +41,11 @@ public:
 	*/
 	String(const char_t* str1, uint_t size1, const char_t* str2, uint_t size2);
 
+	/**
+	* \brief count個のC文字列を連結し、ちょうどの大きさのバッファで構築する
+	*/
+	String(const char_t* const* strs, const uint_t* sizes, uint_t count);
+
 
 	struct long_lived_t{};
 
@@ -1,6 +1,8 @@
 #include "xtal.h"
 #include "xtal_macro.h"
 
+#include "xtal_details.h"
+
 namespace xtal{
 
 void assign_text_map(const AnyPtr& map){
@@ -161,113 +163,215 @@ uint_t FormatSpecifier::parse_format_inner(const char_t* const str, uint_t i, ui
 	return i;
 }
 
-void String::on_rawcall(const VMachinePtr& vm){
-	MemoryStreamPtr ms = xnew<MemoryStream>();
-	enum{
-		LIMIT = 255
-	};
+FormatTemplate::FormatTemplate(const StringPtr& source)
+	:source_(source){
+	compile();
+}
 
-	char_t cbuf[LIMIT+1];
-	char_t spec[FormatSpecifier::FORMAT_SPECIFIER_MAX];
+void FormatTemplate::compile(){
+	const char_t* const str = source_->data();
+	uint_t begin = 0;
+	int_t n = 0;
 
-	const char_t* const str = data();
-	const char_t* begin = str;
-	int_t n = 0;		
-	
-	AnyPtr value;
 	FormatSpecifier fs;
 
 	uint_t i = 0;
-	uint_t sz = data_size();
+	uint_t sz = source_->data_size();
+
+	Slot slot;
 
 	while(true){
 		if(i==sz){
-			ms->put_s(begin, str+i);
 			break; 
 		}
 
 		if(str[i]=='%'){
-			ms->put_s(begin, str+i);
+			slot.literal_begin = begin;
+			slot.literal_size = i-begin;
+			slot.index = -1;
+			slot.kind = KIND_NONE;
+			slot.spec[0] = 0;
+
 			i++;
-			if(i==sz){ break; }
+			begin = i;
+			if(i==sz){ 
+				slots_.push_back(slot);
+				break; 
+			}
 			
 			if(str[i]=='%'){
-				begin = str+i;
+				// %%は次のリテラル部分の先頭の%として残す
+				slots_.push_back(slot);
 				i++;
+				continue;
 			}
-			else{
-				if(str[i]=='('){
-					i++;
-					if(i==sz){ break; }
-
-					begin = str+i;
-					
-					bool number = false;
-					if('0'<=str[i] && str[i]<='9'){
-						number = true;
-					}
-
-					while(str[i]!=')'){
-						i++;
-						if(i==sz){ break; }
-					}
-
-					const IDPtr& arg_id = xtal::intern(begin, (str+i)-begin);
-
-					if(number){
-						int_t arg_i = arg_id->to_i();
-
-						if(arg_i>0 && arg_i<=vm->ordered_arg_count()){
-							value = vm->arg(arg_i-1);
-						}
-						else{
-							value = vm->arg(arg_id);
-						}
-					}
-					else{
-						value = vm->arg(arg_id);
-					}
-
-					if(str[i]==')'){
-						i++;
-					}
-				}
-				else{
-
-					if(n<vm->ordered_arg_count()){
-						value = vm->arg(n);
-					}
-					else{
-						XTAL_SPRINTF(cbuf, LIMIT, XTAL_L("%d"), n);
-						value = vm->arg(xtal::intern(cbuf));
-					}
-					++n;
+
+			if(str[i]=='('){
+				i++;
+				if(i==sz){ 
+					begin = i;
+					slots_.push_back(slot);
+					break; 
 				}
 
-				i = fs.parse_format(str, i, sz);
-				begin = str + i;
+				uint_t name_begin = i;
+				
+				bool number = false;
+				if('0'<=str[i] && str[i]<='9'){
+					number = true;
+				}
 
-				if(fs.is_int_type()){
-					fs.make_format_specifier(spec, fs.change_int_type(), true);
-					XTAL_SPRINTF(cbuf, LIMIT, spec, value->to_i());
-					ms->put_s(cbuf);
+				while(i!=sz && str[i]!=')'){
+					i++;
 				}
-				else if(fs.is_float_type()){
-					fs.make_format_specifier(spec, fs.change_float_type());
-					XTAL_SPRINTF(cbuf, LIMIT, spec, value->to_f());
-					ms->put_s(cbuf);
+
+				const IDPtr& arg_id = xtal::intern(str+name_begin, i-name_begin);
+				names_.push_back(arg_id);
+
+				if(number){
+					int_t arg_i = arg_id->to_i();
+					slot.index = arg_i>0 ? arg_i-1 : -1;
 				}
-				else{
-					ms->put_s(value);
+
+				if(i!=sz){
+					i++;
 				}
 			}
+			else{
+				char_t cbuf[NUMBER_LIMIT+1];
+				XTAL_SPRINTF(cbuf, NUMBER_LIMIT, XTAL_L("%d"), (int)n);
+				names_.push_back(xtal::intern(cbuf));
+				slot.index = n;
+				++n;
+			}
+
+			i = fs.parse_format(str, i, sz);
+			begin = i;
+
+			if(fs.is_int_type()){
+				slot.kind = KIND_INT;
+				fs.make_format_specifier(slot.spec, fs.change_int_type(), true);
+			}
+			else if(fs.is_float_type()){
+				slot.kind = KIND_FLOAT;
+				fs.make_format_specifier(slot.spec, fs.change_float_type());
+			}
+			else{
+				slot.kind = KIND_STRING;
+			}
+
+			slots_.push_back(slot);
 		}
 		else{
 			i++;
 		}
 	}
 
-	vm->return_result(ms->to_s());
+	tail_begin_ = begin;
+	tail_size_ = sz - begin;
+}
+
+StringPtr FormatTemplate::format(const VMachinePtr& vm){
+	const char_t* const str = source_->data();
+	uint_t slot_count = slots_.size();
+	uint_t piece_count = slot_count*2 + 1;
+
+	// 引数が少ない書式はスタック上で組み立てる
+	const char_t* stack_strs[SLOT_MAX*2 + 1];
+	uint_t stack_sizes[SLOT_MAX*2 + 1];
+	StringPtr stack_holds[SLOT_MAX];
+
+	TArray<const char_t*> heap_strs;
+	TArray<uint_t> heap_sizes;
+	TArray<StringPtr> heap_holds;
+
+	const char_t** strs = stack_strs;
+	uint_t* sizes = stack_sizes;
+	StringPtr* holds = stack_holds;
+	if(slot_count>SLOT_MAX){
+		heap_strs.resize(piece_count);
+		heap_sizes.resize(piece_count);
+		heap_holds.resize(slot_count);
+		strs = &heap_strs[0];
+		sizes = &heap_sizes[0];
+		holds = &heap_holds[0];
+	}
+
+	char_t numbers[NUMBER_BUFFER_MAX];
+	uint_t numbers_size = 0;
+	char_t cbuf[NUMBER_LIMIT+1];
+
+	int_t ordered_arg_count = vm->ordered_arg_count();
+	uint_t name_index = 0;
+
+	for(uint_t i=0; i<slot_count; ++i){
+		const Slot& slot = slots_[i];
+		strs[i*2] = str + slot.literal_begin;
+		sizes[i*2] = slot.literal_size;
+		strs[i*2+1] = str;
+		sizes[i*2+1] = 0;
+
+		if(slot.kind==KIND_NONE){
+			continue;
+		}
+
+		const IDPtr& name = unchecked_ptr_cast<ID>(names_.at(name_index++));
+		AnyPtr value = (slot.index>=0 && slot.index<ordered_arg_count) ? vm->arg(slot.index) : vm->arg(name);
+
+		if(slot.kind==KIND_STRING){
+			// 小さな文字列はStringPtr自身が内容を持つので、保持先のdataを参照する
+			holds[i] = value->to_s();
+			strs[i*2+1] = holds[i]->data();
+			sizes[i*2+1] = holds[i]->data_size();
+			continue;
+		}
+
+		if(slot.kind==KIND_INT){
+			XTAL_SPRINTF(cbuf, NUMBER_LIMIT, slot.spec, value->to_i());
+		}
+		else{
+			XTAL_SPRINTF(cbuf, NUMBER_LIMIT, slot.spec, value->to_f());
+		}
+
+		uint_t size = string_data_size(cbuf);
+		if(numbers_size+size<=NUMBER_BUFFER_MAX){
+			string_copy(numbers+numbers_size, cbuf, size);
+			strs[i*2+1] = numbers+numbers_size;
+			sizes[i*2+1] = size;
+			numbers_size += size;
+		}
+		else{
+			holds[i] = xnew<String>(cbuf, size);
+			strs[i*2+1] = holds[i]->data();
+			sizes[i*2+1] = holds[i]->data_size();
+		}
+	}
+
+	strs[slot_count*2] = str + tail_begin_;
+	sizes[slot_count*2] = tail_size_;
+
+	return xnew<String>((const char_t* const*)strs, (const uint_t*)sizes, piece_count);
+}
+
+const FormatTemplatePtr& FormatCacheTable::cache(const StringPtr& source){
+	uint_t hash = (XTAL_detail_uvalue(source)>>2) ^ XTAL_detail_urawtype(source);
+	Unit& unit = table_[hash % CACHE_MAX];
+
+	if(cache_enable_ && XTAL_detail_raweq(source, unit.source)){
+		hit_++;
+		return unchecked_ptr_cast<FormatTemplate>(unit.format);
+	}
+	else{
+		miss_++;
+		unit.source = source;
+		unit.format = xnew<FormatTemplate>(source);
+		return unchecked_ptr_cast<FormatTemplate>(unit.format);
+	}
+}
+
+void String::on_rawcall(const VMachinePtr& vm){
+	FormatTemplatePtr fmt = environment_->format_cache_table_.cache(to_smartptr(this));
+	vm->return_result(fmt->format(vm));
 }
 
 Text::Text(const IDPtr& key)
@@ -46,6 +46,65 @@ private:
 	uint_t parse_format_digit(const char_t* str, uint_t i, uint_t sz, int_t& digit);
 };
 
+/**
+* \brief 一度だけ解析された書式文字列
+* リテラル部分の表と、引数の位置と名前、組み立て済みの書式指定子を保持する。
+* 呼び出しのたびに書式文字列を解析し直さず、結果はちょうどの大きさの文字列に書き出す。
+*/
+class FormatTemplate : public Base{
+public:
+
+	FormatTemplate(const StringPtr& source);
+
+	/**
+	* \brief vmの引数で書式を埋めた文字列を返す
+	*/
+	StringPtr format(const VMachinePtr& vm);
+
+	const StringPtr& source(){
+		return source_;
+	}
+
+	void on_visit_members(Visitor& m){
+		Base::on_visit_members(m);
+		m & source_ & names_;
+	}
+
+private:
+
+	enum{
+		SLOT_MAX = 16,
+		NUMBER_LIMIT = 255,
+		NUMBER_BUFFER_MAX = 1024
+	};
+
+	enum{
+		KIND_NONE,
+		KIND_STRING,
+		KIND_INT,
+		KIND_FLOAT
+	};
+
+	struct Slot{
+		// このスロットの前にあるリテラル部分
+		uint_t literal_begin;
+		uint_t literal_size;
+
+		// 引数の位置。位置引数の数を超えている場合はnames_[index]の名前付き引数を使う
+		int_t index;
+		u8 kind;
+		char_t spec[FormatSpecifier::FORMAT_SPECIFIER_MAX];
+	};
+
+	void compile();
+
+	StringPtr source_;
+	PODArray<Slot> slots_;
+	xarray names_;
+	uint_t tail_begin_;
+	uint_t tail_size_;
+};
+
 class Text : public Base{
 public:
 	Text(const IDPtr& key = empty_id);
@@ -126,6 +126,11 @@ private:
 
 #endif 
 
+// スレッドモデル2ではレジスタが複数スレッドから同時に書き換えられるので、遅延参照カウントは使えない
+#if !defined(XTAL_NO_THREAD) && defined(XTAL_USE_THREAD_MODEL2) && !defined(XTAL_NO_DEFERRED_REF_COUNT)
+#define XTAL_NO_DEFERRED_REF_COUNT
+#endif
+
 /////////////////////////////////////////////////////
 
 #ifdef XTAL_NO_PARSER
@@ -628,6 +633,7 @@ class Class;
 class Lib;
 class Thread;
 class Mutex;
+class Scheduler;
 class IntRange;
 class FloatRange;
 class ChRange;
@@ -636,6 +642,7 @@ class DoubleDispatchFun;
 class Values;
 class Exception;
 class Text;
+class FormatTemplate;
 class TreeNode;
 
 typedef SmartPtr<Null> NullPtr;
@@ -666,6 +673,7 @@ typedef SmartPtr<Class> ClassPtr;
 typedef SmartPtr<Lib> LibPtr;
 typedef SmartPtr<Thread> ThreadPtr;
 typedef SmartPtr<Mutex> MutexPtr;
+typedef SmartPtr<Scheduler> SchedulerPtr;
 typedef SmartPtr<IntRange> IntRangePtr;
 typedef SmartPtr<FloatRange> FloatRangePtr;
 typedef SmartPtr<ChRange> ChRangePtr;
@@ -674,6 +682,7 @@ typedef SmartPtr<DoubleDispatchFun> DoubleDispatchFunPtr;
 typedef SmartPtr<Values> ValuesPtr;
 typedef SmartPtr<Exception> ExceptionPtr;
 typedef SmartPtr<Text> TextPtr;
+typedef SmartPtr<FormatTemplate> FormatTemplatePtr;
 typedef SmartPtr<TreeNode> TreeNodePtr;
 
 class Base;
@@ -705,6 +714,9 @@ typedef SmartPtr<Trans> TransPtr;
 struct NFA;
 typedef SmartPtr<NFA> NFAPtr;
 
+struct DFA;
+typedef SmartPtr<DFA> DFAPtr;
+
 }
 
 struct CppClassSymbolData;
@@ -984,6 +996,12 @@ enum BreakPointKind{
 	*/
 	BREAKPOINT_CALL_PROFILE,
 
+	/**
+	* \brief サンプリングプロファイラによる採取
+	* フック関数は呼び出されない。
+	*/
+	BREAKPOINT_SAMPLE,
+
 	BREAKPOINT_MAX
 };
 
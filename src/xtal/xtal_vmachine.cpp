@@ -15,6 +15,14 @@ namespace xtal{
 #define XTAL_VM_THROW_EXCEPT(e) XTAL_VM_CONTINUE(push_except(pc, e))
 #define XTAL_VM_CHECK_EXCEPT if(except_[0]){ XTAL_VM_CONTINUE(push_except(pc)); }
 
+#ifdef XTAL_ENABLE_VM_STATS
+#	define XTAL_VM_COUNT_INST count_inst(pc);
+#	define XTAL_VM_COUNT_SLOW_PATH stats_->count_slow_path(XTAL_opc(pc))
+#else
+#	define XTAL_VM_COUNT_INST
+#	define XTAL_VM_COUNT_SLOW_PATH
+#endif
+
 #ifdef XTAL_USE_COMPUTED_GOTO
 #	define XTAL_COPY_LABEL_ADDRESS(key) &&Label##key
 #	define XTAL_VM_CASE_FIRST(key) Label##key: { XTAL_VM_DEF_INST(key);
@@ -23,23 +31,47 @@ namespace xtal{
 #	define XTAL_VM_LOOP_END }
 #	define XTAL_VM_CONTINUE(x) { pc = (x); goto *labels[XTAL_opc(pc)]; }
 #	define XTAL_VM_CONTINUE0 goto *labels[XTAL_opc(pc)]
+#	define XTAL_VM_FETCH
+#	define XTAL_VM_DISPATCH(op) goto *labels[(op)]
 #else
 #	define XTAL_VM_CASE_FIRST(key) case key::NUMBER: { XTAL_VM_DEF_INST(key);
 #	define XTAL_VM_CASE(key) } case key::NUMBER: { XTAL_VM_DEF_INST(key);
-#	define XTAL_VM_LOOP switch(XTAL_opc(pc)){
+#	define XTAL_VM_LOOP switch(vmopc){
 #	define XTAL_VM_LOOP_END } XTAL_NODEFAULT; }
 #	define XTAL_VM_CONTINUE(x) { pc = (x); goto vmloopbegin; }
 #	define XTAL_VM_CONTINUE0 goto vmloopbegin
+#	define XTAL_VM_FETCH vmopc = XTAL_opc(pc); vmdispatch:
+#	define XTAL_VM_DISPATCH(op) { vmopc = (op); goto vmdispatch; }
 #endif
 
-#if defined(XTAL_NO_THREAD) || defined(XTAL_USE_THREAD_MODEL2)
-#	define XTAL_CHECK_YIELD
-#else
-#	define XTAL_CHECK_YIELD if(--thread_yield_count_<0){ yield_thread(); thread_yield_count_ = 1000; }
-#endif
+// 分岐と関数呼び出しの度に数え、一定回数ごとにスレッドの切り替えや実行量の上限を調べる
+// check_yieldがpcを返したら中断、それ以外のアドレスを返したら例外を投げる
+#define XTAL_CHECK_YIELD if(--thread_yield_count_<0){ if(const inst_t* yield_pc = check_yield(pc)){ if(yield_pc==pc){ XTAL_VM_RETURN; } XTAL_VM_CONTINUE(yield_pc); } }
 
 #define XTAL_VM_FUN
 
+#ifdef XTAL_ENABLE_VM_STATS
+
+inline CodeStats* VMachine::code_stats(Code* code){
+	if(code!=stats_code_){
+		stats_code_ = code;
+		code_stats_ = stats_->code_stats(code);
+	}
+	return code_stats_;
+}
+
+inline void VMachine::count_inst(const inst_t* pc){
+	stats_->count_inst(XTAL_opc(pc));
+	if(CodeStats* p = code_stats(XTAL_VM_ff().code.get())){
+		uint_t i = (uint_t)(pc - p->begin);
+		if(i<p->size){
+			p->inst_counts[i]++;
+		}
+	}
+}
+
+#endif
+
 const ClassPtr& Any::get_class_except_base() const{
 	int_t t = XTAL_detail_type(*this);
 	//if(t==TYPE_BASE){ return XTAL_detail_pvalue(*this)->get_class(); }
@@ -160,7 +192,7 @@ void Any::rawcall(const VMachinePtr& vm) const{
 bool Any::is(const AnyPtr& klass) const{
 	const ClassPtr& my_class = get_class();
 	if(XTAL_detail_raweq(my_class, klass)) return true;
-	return environment_->is_cache_table_.cache(my_class, klass);
+	return unchecked_ptr_cast<Class>(my_class)->is_inherited(klass);
 }
 
 bool Any::is(CppClassSymbolData* key) const{
@@ -214,6 +246,13 @@ void StatelessNativeMethod::on_rawcall(const VMachinePtr& vm) const{
 				if(pth.param_types[i]==anycls){
 					continue;
 				}
+				else if(pth.param_types[i]==intcls && XTAL_detail_type(fp.args[i])==TYPE_INT){
+					// 既にintなので変換の必要がない
+					continue;
+				}
+				else if(pth.param_types[i]==floatcls && XTAL_detail_type(fp.args[i])==TYPE_FLOAT){
+					continue;
+				}
 				else{
 					const AnyPtr& arg = ap(fp.args[i]);
 					const ClassPtr& cls = cpp_class(pth.param_types[i]);
@@ -290,16 +329,34 @@ void NativeMethod::on_rawcall(const VMachinePtr& vm){
 			num = FunctorParam::MAX_ARGS;
 		}
 			
+		TypeCache* caches = type_caches();
+
 		for(int_t i=0; i<num; ++i){
 			if(pth.param_types[i]==anycls){
 				continue;
 			}
+			else if(pth.param_types[i]==intcls && XTAL_detail_type(fp.args[i])==TYPE_INT){
+				// 既にintなので変換の必要がない
+				continue;
+			}
+			else if(pth.param_types[i]==floatcls && XTAL_detail_type(fp.args[i])==TYPE_FLOAT){
+				continue;
+			}
 			else{
 				const AnyPtr& arg = ap(fp.args[i]);
-				const ClassPtr& cls = cpp_class(pth.param_types[i]);
-				if(!arg->is(cls)){ 
-					set_argument_type_error(object_name(), i, cls, arg->get_class(), vm);
-					return;
+				const ClassPtr& arg_class = arg->get_class();
+				TypeCache& tc = caches[i];
+
+				// 前回と同じクラスなら、継承関係を調べずに済ませる
+				if(!cache_enable_ || tc.mutate_count!=is_mutate_count_ || !XTAL_detail_raweq(tc.klass, arg_class)){
+					const ClassPtr& cls = cpp_class(pth.param_types[i]);
+					if(!arg->is(cls)){ 
+						set_argument_type_error(object_name(), i, cls, arg_class, vm);
+						return;
+					}
+
+					tc.klass = arg_class;
+					tc.mutate_count = is_mutate_count_;
 				}
 
 				if(pth.param_types[i]==intcls){
@@ -355,6 +412,8 @@ SmartPtr<Any>& SmartPtr<Any>::operator =(const SmartPtr<Any>& p){
 ////////////////////////////////////////////////
 
 void VMachine::carry_over(Method* fun, bool adjust_arguments){
+	--thread_yield_count_;
+
 	const inst_t* next_pc =  fun->source();
 	if(*hook_setting_bit_!=0){
 		check_breakpoint_hook(next_pc, to_smartptr(fun), BREAKPOINT_CALL_PROFILE);
@@ -365,10 +424,19 @@ void VMachine::carry_over(Method* fun, bool adjust_arguments){
 
 	FunFrame& f = XTAL_VM_ff();
 
-	f.fun = fun; 
-	f.outer = fun->outer_;
-	f.code = fun->code_.get();
+	XTAL_VM_set_register_ptr(f.fun, fun); 
+	XTAL_VM_set_register_ptr(f.outer, fun->outer_.get());
+	XTAL_VM_set_register_ptr(f.code, fun->code_.get());
 	f.identifiers = f.code->identifier_data(); 
+
+#ifdef XTAL_ENABLE_VM_STATS
+	if(CodeStats* p = code_stats(f.code.get())){
+		uint_t index = (uint_t)(fun->info() - f.code->fun_info(0));
+		if(index<p->call_counts.size()){
+			p->call_counts[index]++;
+		}
+	}
+#endif
 	f.values = f.code->value_data();
 
 	f.next_pc = next_pc;
@@ -402,6 +470,10 @@ void VMachine::carry_over(Method* fun, bool adjust_arguments){
 
 	upsize_variables(info->max_variable);
 	push_scope(info);
+
+	if(*hook_setting_bit_!=0){
+		check_sample(next_pc);
+	}
 }
 
 void VMachine::adjust_values2(int_t stack_base, int_t n, int_t need_result_count){
@@ -423,7 +495,7 @@ void VMachine::adjust_values3(AnyPtr* values, int_t src_count, int_t dest_count)
 	// 関数が返す戻り値が一つも無いのでundefinedで埋める
 	if(src_count==0){
 		for(int_t i = 0; i<dest_count; ++i){
-			values[i] = undefined;
+			XTAL_VM_set_register(values[i], undefined);
 		}
 		return;
 	}
@@ -433,22 +505,17 @@ void VMachine::adjust_values3(AnyPtr* values, int_t src_count, int_t dest_count)
 	// 要求している戻り値の数の方が、関数が返す戻り値より少ない
 	if(dest_count<src_count){
 
-		// 余った戻り値を多値に直す。
+		// 余った戻り値を一つの多値にまとめる。
 		int_t size = src_count-dest_count+1;
-		ValuesPtr ret;
-		AnyPtr top = values[src_count-1];
+		const AnyPtr& top = values[src_count-1];
+		ValuesPtr mv;
 		if(XTAL_detail_type(top)==TYPE_VALUES){
-			ret = unchecked_ptr_cast<Values>(top);
+			mv = XNew<Values>(&values[dest_count-1], size-1, unchecked_ptr_cast<Values>(top));
 		}
 		else{
-			ret = XNew<Values>(top);
-		}
-
-		for(int_t i=1; i<size; ++i){
-			ret = XNew<Values>(values[src_count-1-i], ret);
+			mv = XNew<Values>(&values[dest_count-1], size);
 		}
-
-		values[dest_count-1] = ret;
+		XTAL_VM_set_register(values[dest_count-1], mv);
 	}
 	else{
 		// 要求している戻り値の数の方が、関数が返す戻り値より多い
@@ -456,36 +523,32 @@ void VMachine::adjust_values3(AnyPtr* values, int_t src_count, int_t dest_count)
 		if(XTAL_detail_type(values[src_count-1])==TYPE_VALUES){
 			// 最後の要素の多値を展開し埋め込む
 			ValuesPtr mv = unchecked_ptr_cast<Values>(values[src_count-1]);
+			int_t mv_size = mv->size();
+			int_t space = dest_count-src_count+1;
 
-			const ValuesPtr* cur = &mv;
-			int_t size = 0;
-			while(true){
-				if((*cur)->tail()){
-					if(dest_count==src_count+size){
-						values[src_count-1+size] = *cur;
-						++size;
-						break;
-					}
+			if(mv_size<=space){
+				for(int_t i=0; i<mv_size; ++i){
+					XTAL_VM_set_register(values[src_count-1+i], mv->at(i));
+				}
 
-					values[src_count-1+size] = (*cur)->head();
-					++size;		
-					cur = &(*cur)->tail();
+				for(int_t i=mv_size; i<space; ++i){
+					XTAL_VM_set_register(values[src_count-1+i], undefined);
 				}
-				else{
-					values[src_count-1+size] = (*cur)->head();
-					++size;		
-					while(dest_count>=src_count+size){
-						values[src_count-1+size] = undefined;
-						++size;
-					}
-					break;
+			}
+			else{
+				// 入りきらない分は多値のまま最後に入れる
+				for(int_t i=0; i<space-1; ++i){
+					XTAL_VM_set_register(values[src_count-1+i], mv->at(i));
 				}
+
+				ValuesPtr rest = mv->drop(space-1);
+				XTAL_VM_set_register(values[dest_count-1], rest);
 			}
 		}
 		else{
 			// 最後の要素が多値ではないので、undefinedで埋めとく
 			for(int_t i = src_count; i<dest_count; ++i){
-				values[i] = undefined;
+				XTAL_VM_set_register(values[i], undefined);
 			}
 		}
 	}
@@ -514,9 +577,10 @@ const AnyPtr& MemberCacheTable::cache(const AnyPtr& target_class, const IDPtr& p
 	uint_t hash = itarget_class ^ (iprimary_key ^ (iprimary_key>>24));
 	Unit& unit = table_[hash % CACHE_MASK];
 
-	if(cache_enable_ && ((member_mutate_count_ ^ unit.mutate_count) | 
-		XTAL_detail_rawbitxor(primary_key, unit.primary_key) | 
-		XTAL_detail_rawbitxor(target_class, unit.target_class))==0){
+	// 登録されているのはクラスのメンバだけなので、一致すればtarget_classはクラスである
+	if(cache_enable_ && (XTAL_detail_rawbitxor(primary_key, unit.primary_key) | 
+		XTAL_detail_rawbitxor(target_class, unit.target_class))==0 &&
+		static_cast<Class*>(XTAL_detail_pvalue(target_class))->member_version()==unit.mutate_count){
 		hit_++;
 		accessibility = unit.accessibility;
 		return unit.member;
@@ -543,7 +607,7 @@ const AnyPtr& MemberCacheTable::cache(const AnyPtr& target_class, const IDPtr& p
 			unit.target_class = target_class;
 			unit.primary_key = primary_key;
 			unit.accessibility = accessibility;
-			unit.mutate_count = member_mutate_count_;
+			unit.mutate_count = static_cast<Class*>(XTAL_detail_pvalue(target_class))->member_version();
 		}
 		return ret;
 	}
@@ -557,10 +621,12 @@ const AnyPtr& MemberCacheTable2::cache(const AnyPtr& target_class, const IDPtr&
 	uint_t hash = itarget_class ^ (iprimary_key ^ (iprimary_key>>24)) ^ isecondary_key;
 	Unit& unit = table_[hash % CACHE_MASK];
 
-	if(cache_enable_ && ((member_mutate_count_ ^ unit.mutate_count) | 
-		XTAL_detail_rawbitxor(primary_key, unit.primary_key) | 
+	// 番号は単調に増えるので、target_classとsecondary_classのどちらも登録時の最大値を超えていなければ有効
+	if(cache_enable_ && (XTAL_detail_rawbitxor(primary_key, unit.primary_key) | 
 		XTAL_detail_rawbitxor(target_class, unit.target_class) | 
-		XTAL_detail_rawbitxor(secondary_key, unit.secondary_key))==0){
+		XTAL_detail_rawbitxor(secondary_key, unit.secondary_key))==0 &&
+		static_cast<Class*>(XTAL_detail_pvalue(target_class))->member_version()<=unit.mutate_count &&
+		(!unit.secondary_class || unit.secondary_class->member_version()<=unit.mutate_count)){
 
 		hit_++;
 		accessibility = unit.accessibility;
@@ -589,12 +655,94 @@ const AnyPtr& MemberCacheTable2::cache(const AnyPtr& target_class, const IDPtr&
 			unit.primary_key = primary_key;
 			unit.secondary_key = secondary_key;
 			unit.accessibility = accessibility;
-			unit.mutate_count = member_mutate_count_;
+			unit.mutate_count = static_cast<Class*>(XTAL_detail_pvalue(target_class))->member_version();
+			unit.secondary_class = 0;
+			if(!XTAL_detail_is_undefined(secondary_key)){
+				if(const ClassPtr& cls = ptr_cast<Class>(secondary_key)){
+					unit.secondary_class = cls.get();
+					if(unit.mutate_count<cls->member_version()){
+						unit.mutate_count = cls->member_version();
+					}
+				}
+			}
 		}
 		return ret;
 	}
 }
 
+const AnyPtr& SendSiteCacheTable::cache(const inst_t* pc, const AnyPtr& target_class, const IDPtr& primary_key, int_t& accessibility, MemberCacheTable& fallback, Entry** site){
+	if(site){
+		*site = 0;
+	}
+
+	Unit& unit = table_[((uint_t)(std::size_t)pc/sizeof(inst_t)) % CACHE_MAX];
+
+	// 別の送信命令が使っていた場所なら取り替える
+	// 項目はクラスとメンバ名だけで決まるので、解放されたコードの命令と番地が重なっても誤りにはならない
+	if(unit.pc!=pc || !XTAL_detail_raweq(unit.primary_key, primary_key)){
+		reset(unit, pc, primary_key);
+	}
+
+	if(!cache_enable_ || unit.megamorphic || !XTAL_detail_is_pvalue(target_class)){
+		return fallback.cache(target_class, primary_key, accessibility);
+	}
+
+	// 登録されるのはクラスのメンバだけなので、一致すればtarget_classはクラスである
+	uint_t version = static_cast<Class*>(XTAL_detail_pvalue(target_class))->member_version();
+	Entry* entry = 0;
+	for(uint_t i=0; i<unit.size; ++i){
+		Entry& e = unit.entries[i];
+		if(XTAL_detail_raweq(e.target_class, target_class)){
+			if(e.version==version){
+				hit_++;
+				accessibility = e.accessibility;
+				if(site){
+					*site = &e;
+				}
+				return e.member;
+			}
+
+			// メンバが変わったクラスの項目は探索し直して上書きする
+			entry = &e;
+			break;
+		}
+	}
+
+	if(!entry && unit.size==ENTRY_MAX){
+		// 種類が多すぎる送信は、以降このキャッシュを使わない
+		megamorphic_++;
+		reset(unit, pc, primary_key);
+		unit.megamorphic = true;
+		return fallback.cache(target_class, primary_key, accessibility);
+	}
+
+	miss_++;
+
+	bool nocache = false;
+	accessibility = 0;
+	const AnyPtr& ret = XTAL_detail_pvalue(target_class)->rawmember(primary_key, undefined, true, accessibility, nocache);
+
+	if(XTAL_detail_is_undefined(ret)){
+		accessibility = -1;
+		return undefined;
+	}
+
+	if(!nocache){
+		if(!entry){
+			entry = &unit.entries[unit.size++];
+		}
+		entry->member = ret;
+		entry->target_class = target_class;
+		entry->accessibility = accessibility;
+		entry->version = static_cast<Class*>(XTAL_detail_pvalue(target_class))->member_version();
+		entry->native_checked = false;
+		if(site){
+			*site = entry;
+		}
+	}
+	return ret;
+}
+
 void VMachine::push_ff(CallState& call_state){
 	FunFrame& f = *push_ff_simple();
 	f.need_result_count = call_state.need_result_count;
@@ -608,9 +756,10 @@ void VMachine::push_ff(CallState& call_state){
 	f.prev_stack_base = XTAL_VM_variables_top();
 	f.scope_lower = scopes_.size();
 
-	XTAL_VM_set(f.self, ap(call_state.aself));
-	f.fun = null;
-	f.outer = null;
+	XTAL_VM_set_register(f.self, ap(call_state.aself));
+	XTAL_VM_set_register_ptr(f.fun, (Method*)0);
+	XTAL_VM_set_register_ptr(f.outer, (Frame*)0);
+	XTAL_VM_set_register_ptr(f.code, (Code*)0);
 
 	result_base_ = f.result;
 
@@ -656,7 +805,7 @@ void VMachine::push_scope(ScopeInfo* info){
 	scope.size = info->variable_size;
 	scope.flags = Scope::NONE;
 
-	scope.frame->attach(info, XTAL_VM_ff().code, (AnyPtr*)variables_.data()+scope.pos, scope.size);
+	scope.frame->attach(info, XTAL_VM_ff().code.get(), (AnyPtr*)variables_.data()+scope.pos, scope.size);
 }
 
 void VMachine::pop_scope(){
@@ -726,6 +875,9 @@ void VMachine::execute_inner2(const inst_t* start, int_t XTAL_VM_eval_n, ExceptF
 	register const inst_t* pc = start;
 	int_t eval_base_n = fun_frame_stack_.size();
 
+	// トラップ命令から元の命令を実行するときは、pcを変えずに命令コードだけを差し替えて分岐する
+	int_t vmopc = 0;
+
 	XTAL_ASSERT((int)cur.stack_size>=0);
 
 /*		
@@ -746,13 +898,13 @@ void VMachine::execute_inner2(const inst_t* start, int_t XTAL_VM_eval_n, ExceptF
 
 		/*
 		if((atype|btype)==0){
-			XTAL_VM_DEC(result);
+			XTAL_VM_DEC_REGISTER(result);
 			result.value_.init_int(XTAL_detail_ivalue(a) + XTAL_detail_ivalue(b));
 			XTAL_VM_CONTINUE(pc + Inst::ISIZE);
 		}
 		else if((atype|btype)==1){
 			XTAL_VM_bin_to_f;
-			XTAL_VM_DEC(result);
+			XTAL_VM_DEC_REGISTER(result);
 			result.value_.init_float(fa + fb);
 			XTAL_VM_CONTINUE(pc + Inst::ISIZE);
 		}
@@ -846,6 +998,11 @@ void VMachine::execute_inner2(const inst_t* start, int_t XTAL_VM_eval_n, ExceptF
 		XTAL_COPY_LABEL_ADDRESS(InstThrow),
 		XTAL_COPY_LABEL_ADDRESS(InstAssert),
 		XTAL_COPY_LABEL_ADDRESS(InstBreakPoint),
+		XTAL_COPY_LABEL_ADDRESS(InstIncIfLt),
+		XTAL_COPY_LABEL_ADDRESS(InstLoadInt1ByteAdd),
+		XTAL_COPY_LABEL_ADDRESS(InstLoadInt1ByteSub),
+		XTAL_COPY_LABEL_ADDRESS(InstLoadInt1ByteIfLt),
+		XTAL_COPY_LABEL_ADDRESS(InstInstanceVariableAddAssign),
 		XTAL_COPY_LABEL_ADDRESS(InstMAX),
 //}}LABELS}
 		};
@@ -856,25 +1013,18 @@ void VMachine::execute_inner2(const inst_t* start, int_t XTAL_VM_eval_n, ExceptF
 XTAL_VM_CONTINUE0;
 
 vmloopbegin:
+XTAL_VM_COUNT_INST
+XTAL_VM_FETCH
 XTAL_VM_LOOP
 
 //{OPS{{
-	XTAL_VM_CASE_FIRST(InstLine){ XTAL_VM_CONTINUE(FunInstLine(pc)); /*
-		XTAL_VM_FUN;
-		if(*hook_setting_bit_!=0){
-			XTAL_VM_LOCK{
-				check_breakpoint_hook(pc, BREAKPOINT_LINE_PROFILE);
-				check_breakpoint_hook(pc, BREAKPOINT_LINE_LIGHT_WEIGHT);
-				check_breakpoint_hook(pc, BREAKPOINT_INNER_LINE);
-				check_breakpoint_hook(pc, BREAKPOINT_LINE);
-			}
-		}
+	XTAL_VM_CASE_FIRST(InstLine){ // 1
 		XTAL_VM_CONTINUE(pc + Inst::ISIZE); 
-	}*/ }
+	}
 
 	XTAL_VM_CASE(InstLoadValue){ // 5
 		AnyPtr& result = *(variables_top_ + Inst::result(pc));
-		XTAL_VM_DEC(result);
+		XTAL_VM_DEC_REGISTER(result);
 		XTAL_detail_copy(result, XTAL_VM_values[Inst::value(pc)]);
 		XTAL_VM_CONTINUE(pc + Inst::ISIZE); 
 	}
@@ -886,14 +1036,14 @@ XTAL_VM_LOOP
 
 	XTAL_VM_CASE(InstLoadInt1Byte){ // 5
 		AnyPtr& result = *(variables_top_ + Inst::result(pc));
-		XTAL_VM_DEC(result);
+		XTAL_VM_DEC_REGISTER(result);
 		result.value_.init_int(Inst::value(pc));
 		XTAL_VM_CONTINUE(pc + Inst::ISIZE); 
 	}
 
 	XTAL_VM_CASE(InstLoadFloat1Byte){ // 5
 		AnyPtr& result = *(variables_top_ + Inst::result(pc));
-		XTAL_VM_DEC(result);
+		XTAL_VM_DEC_REGISTER(result);
 		result.value_.init_float((float_t)Inst::value(pc));
 		XTAL_VM_CONTINUE(pc + Inst::ISIZE); 
 	}
@@ -919,7 +1069,7 @@ XTAL_VM_LOOP
 
 		// 型がintかfloatであるか？
 		if(XTAL_LIKELY(((atype)&(~1U))==0)){
-			XTAL_VM_DEC(result);
+			XTAL_VM_DEC_REGISTER(result);
 			if(atype==0){
 				result.value_.init_int(XTAL_detail_ivalue(a)+1);
 				XTAL_VM_CONTINUE(pc + Inst::ISIZE);
@@ -939,7 +1089,7 @@ XTAL_VM_LOOP
 
 		// 型がintかfloatであるか？
 		if(XTAL_LIKELY(((atype)&(~1U))==0)){
-			XTAL_VM_DEC(result);
+			XTAL_VM_DEC_REGISTER(result);
 			if(atype==0){
 				result.value_.init_int(XTAL_detail_ivalue(a)-1);
 				XTAL_VM_CONTINUE(pc + Inst::ISIZE);
@@ -959,7 +1109,7 @@ XTAL_VM_LOOP
 
 		// 型がintかfloatであるか？
 		if(XTAL_LIKELY(((atype)&(~1U))==0)){
-			XTAL_VM_DEC(result);
+			XTAL_VM_DEC_REGISTER(result);
 			XTAL_detail_copy(result, a);
 			XTAL_VM_CONTINUE(pc + Inst::ISIZE);
 		}
@@ -973,7 +1123,7 @@ XTAL_VM_LOOP
 
 		// 型がintかfloatであるか？
 		if(XTAL_LIKELY(((atype)&(~1U))==0)){
-			XTAL_VM_DEC(result);
+			XTAL_VM_DEC_REGISTER(result);
 			if(atype==0){
 				result.value_.init_int(-XTAL_detail_ivalue(a));
 				XTAL_VM_CONTINUE(pc + Inst::ISIZE);
@@ -992,7 +1142,7 @@ XTAL_VM_LOOP
 		AnyPtr& result = XTAL_VM_local_variable(Inst::result(pc));
 
 		if(XTAL_LIKELY(atype==TYPE_INT)){
-			XTAL_VM_DEC(result);
+			XTAL_VM_DEC_REGISTER(result);
 			result.value_.init_int(~XTAL_detail_ivalue(a));
 			XTAL_VM_CONTINUE(pc + Inst::ISIZE);
 		}
@@ -1007,7 +1157,7 @@ XTAL_VM_LOOP
 		
 		// 型がintかfloatであるか？
 		if(XTAL_LIKELY(((atype|btype)&(~1U))==0)){
-			XTAL_VM_DEC(result);
+			XTAL_VM_DEC_REGISTER(result);
 			switch((atype<<1) | (btype)){
 				XTAL_NODEFAULT;
 				XTAL_CASE((0<<1) | 0){ result.value_.init_int(XTAL_detail_ivalue(a) + XTAL_detail_ivalue(b)); XTAL_VM_CONTINUE(pc + Inst::ISIZE); } 
@@ -1027,7 +1177,7 @@ XTAL_VM_LOOP
 		
 		// 型がintかfloatであるか？
 		if(XTAL_LIKELY(((atype|btype)&(~1U))==0)){
-			XTAL_VM_DEC(result);
+			XTAL_VM_DEC_REGISTER(result);
 			switch((atype<<1) | (btype)){
 				XTAL_NODEFAULT;
 				XTAL_CASE((0<<1) | 0){ result.value_.init_int(XTAL_detail_ivalue(a) - XTAL_detail_ivalue(b)); XTAL_VM_CONTINUE(pc + Inst::ISIZE); } 
@@ -1051,7 +1201,7 @@ XTAL_VM_LOOP
 		
 		// 型がintかfloatであるか？
 		if(XTAL_LIKELY(((atype|btype)&(~1U))==0)){
-			XTAL_VM_DEC(result);
+			XTAL_VM_DEC_REGISTER(result);
 			switch((atype<<1) | (btype)){
 				XTAL_NODEFAULT;
 				XTAL_CASE((0<<1) | 0){ result.value_.init_int(XTAL_detail_ivalue(a) * XTAL_detail_ivalue(b)); XTAL_VM_CONTINUE(pc + Inst::ISIZE); } 
@@ -1072,7 +1222,7 @@ XTAL_VM_LOOP
 		
 		// 型がintかfloatであるか？
 		if(XTAL_LIKELY(((atype|btype)&(~1U))==0)){
-			XTAL_VM_DEC(result);
+			XTAL_VM_DEC_REGISTER(result);
 			if(btype==0){
 				if(XTAL_detail_ivalue(b)==0){
 					result.value_.init_null();
@@ -1116,7 +1266,7 @@ XTAL_VM_LOOP
 		
 		// 型がintかfloatであるか？
 		if(XTAL_LIKELY(((atype|btype)&(~1U))==0)){
-			XTAL_VM_DEC(result);
+			XTAL_VM_DEC_REGISTER(result);
 			if(btype==0){
 				if(XTAL_detail_ivalue(b)==0){
 					result.value_.init_null();
@@ -1159,7 +1309,7 @@ XTAL_VM_LOOP
 		
 		// 型がintであるか？
 		if(XTAL_LIKELY((atype|btype)==0)){
-			XTAL_VM_DEC(result);
+			XTAL_VM_DEC_REGISTER(result);
 			result.value_.init_int(XTAL_detail_ivalue(a) & XTAL_detail_ivalue(b));
 			XTAL_VM_CONTINUE(pc + Inst::ISIZE);
 		}
@@ -1174,7 +1324,7 @@ XTAL_VM_LOOP
 		
 		// 型がintであるか？
 		if(XTAL_LIKELY((atype|btype)==0)){
-			XTAL_VM_DEC(result);
+			XTAL_VM_DEC_REGISTER(result);
 			result.value_.init_int(XTAL_detail_ivalue(a) | XTAL_detail_ivalue(b));
 			XTAL_VM_CONTINUE(pc + Inst::ISIZE);
 		}
@@ -1189,7 +1339,7 @@ XTAL_VM_LOOP
 		
 		// 型がintであるか？
 		if(XTAL_LIKELY((atype|btype)==0)){
-			XTAL_VM_DEC(result);
+			XTAL_VM_DEC_REGISTER(result);
 			result.value_.init_int(XTAL_detail_ivalue(a) ^ XTAL_detail_ivalue(b));
 			XTAL_VM_CONTINUE(pc + Inst::ISIZE);
 		}
@@ -1204,7 +1354,7 @@ XTAL_VM_LOOP
 		
 		// 型がintであるか？
 		if(XTAL_LIKELY((atype|btype)==0)){
-			XTAL_VM_DEC(result);
+			XTAL_VM_DEC_REGISTER(result);
 			result.value_.init_int(XTAL_detail_ivalue(a) << XTAL_detail_ivalue(b));
 			XTAL_VM_CONTINUE(pc + Inst::ISIZE);
 		}
@@ -1219,7 +1369,7 @@ XTAL_VM_LOOP
 	
 		// 型がintであるか？
 		if(XTAL_LIKELY((atype|btype)==0)){
-			XTAL_VM_DEC(result);
+			XTAL_VM_DEC_REGISTER(result);
 			result.value_.init_int(XTAL_detail_ivalue(a) >> XTAL_detail_ivalue(b));
 			XTAL_VM_CONTINUE(pc + Inst::ISIZE);
 		}
@@ -1234,7 +1384,7 @@ XTAL_VM_LOOP
 		
 		// 型がintであるか？
 		if(XTAL_LIKELY((atype|btype)==0)){
-			XTAL_VM_DEC(result);
+			XTAL_VM_DEC_REGISTER(result);
 			result.value_.init_int((uint_t)XTAL_detail_ivalue(a) >> XTAL_detail_ivalue(b));
 			XTAL_VM_CONTINUE(pc + Inst::ISIZE);
 		}
@@ -1649,7 +1799,8 @@ XTAL_VM_LOOP
 
 		XTAL_VM_LOCK{
 			int_t accessibility;
-			call_state.amember = environment_->member_cache_table_.cache(ap(call_state.acls), (IDPtr&)call_state.aprimary, accessibility);
+			SendSiteCacheTable::Entry* site;
+			call_state.amember = environment_->send_site_cache_table_.cache(pc, ap(call_state.acls), (IDPtr&)call_state.aprimary, accessibility, environment_->member_cache_table_, &site);
 
 			if(accessibility){
 				if(accessibility<0){
@@ -1667,6 +1818,10 @@ XTAL_VM_LOOP
 			}
 
 			call_state.aself = call_state.atarget;
+
+			if(site && (XTAL_detail_type(call_state.amember)==TYPE_NATIVE_METHOD || XTAL_detail_type(call_state.amember)==TYPE_STATELESS_NATIVE_METHOD)){
+				XTAL_VM_CONTINUE(execute_native_send(pc, call_state, site));
+			}
 		}
 
 		XTAL_VM_CONTINUE(execute_callex(pc, call_state));
@@ -1683,7 +1838,8 @@ XTAL_VM_LOOP
 
 		XTAL_VM_LOCK{
 			int_t accessibility;
-			call_state.amember = environment_->member_cache_table_.cache(ap(call_state.acls), (IDPtr&)call_state.aprimary, accessibility);
+			SendSiteCacheTable::Entry* site;
+			call_state.amember = environment_->send_site_cache_table_.cache(pc, ap(call_state.acls), (IDPtr&)call_state.aprimary, accessibility, environment_->member_cache_table_, &site);
 
 			if(accessibility){
 				if(accessibility<0){
@@ -1700,7 +1856,15 @@ XTAL_VM_LOOP
 				XTAL_VM_CONTINUE(call_state.poped_pc);
 			}
 
+			if(const inst_t* epc = execute_double_dispatch(pc, call_state)){
+				XTAL_VM_CONTINUE(epc);
+			}
+
 			call_state.aself = call_state.atarget;
+
+			if(site && (XTAL_detail_type(call_state.amember)==TYPE_NATIVE_METHOD || XTAL_detail_type(call_state.amember)==TYPE_STATELESS_NATIVE_METHOD)){
+				XTAL_VM_CONTINUE(execute_native_send(pc, call_state, site));
+			}
 		}
 
 		XTAL_VM_CONTINUE(execute_callex(pc, call_state));
@@ -1727,6 +1891,7 @@ XTAL_VM_LOOP
 			check_breakpoint_hook(next_pc-1, fun, BREAKPOINT_RETURN_LIGHT_WEIGHT);
 			check_breakpoint_hook(next_pc-1, fun, BREAKPOINT_INNER_RETURN);
 			check_breakpoint_hook(pc, fun, BREAKPOINT_RETURN);
+			check_sample(next_pc-1);
 		}
 
 		XTAL_VM_CONTINUE(next_pc);
@@ -1855,10 +2020,10 @@ XTAL_VM_LOOP
 		call_state.named_arg_count = 0;
 		push_ff(call_state);
 
-		XTAL_VM_ff().fun = XTAL_VM_prev_ff().fun;
-		XTAL_VM_ff().outer = cp;
+		XTAL_VM_set_register_ptr(XTAL_VM_ff().fun, XTAL_VM_prev_ff().fun.get());
+		XTAL_VM_set_register_ptr(XTAL_VM_ff().outer, cp.get());
 		XTAL_VM_ff().identifiers = XTAL_VM_prev_ff().identifiers;
-		XTAL_VM_ff().code = XTAL_VM_prev_ff().code;
+		XTAL_VM_set_register_ptr(XTAL_VM_ff().code, XTAL_VM_prev_ff().code.get());
 		XTAL_VM_ff().values = XTAL_VM_prev_ff().values;
 
 		XTAL_VM_CONTINUE(pc + Inst::ISIZE);
@@ -2001,14 +2166,196 @@ XTAL_VM_LOOP
 		XTAL_VM_CONTINUE(pc + Inst::ISIZE);
 	}*/ }
 
-	XTAL_VM_CASE(InstBreakPoint){ XTAL_VM_CONTINUE(FunInstBreakPoint(pc)); /*
+	XTAL_VM_CASE(InstIncIfLt){ // 22
+		XTAL_CHECK_YIELD;
+		const AnyPtr& a = XTAL_VM_local_variable(Inst::target(pc)); uint_t atype = XTAL_detail_urawtype(a)-TYPE_INT;
+		AnyPtr& result = XTAL_VM_local_variable(Inst::result(pc));
+
+		// 型がintかfloatでなければ、後続の命令は融合前と同じように実行する
+		if(XTAL_UNLIKELY(((atype)&(~1U))!=0)){
+			XTAL_VM_CONTINUE(execute_send_una(pc, DefinedID::id_op_inc));
+		}
+
+		XTAL_VM_DEC_REGISTER(result);
+		if(atype==0){
+			result.value_.init_int(XTAL_detail_ivalue(a)+1);
+		}
+		else{
+			result.value_.init_float(XTAL_detail_fvalue(a)+1);
+		}
+
+		const inst_t* pc2 = pc + Inst::ISIZE;
+		switch(XTAL_opc(pc2)){
+			XTAL_DEFAULT{}
+
+			XTAL_CASE(InstLoadInt1Byte::NUMBER){
+				AnyPtr& value = XTAL_VM_local_variable(InstLoadInt1Byte::result(pc2));
+				XTAL_VM_DEC_REGISTER(value);
+				value.value_.init_int(InstLoadInt1Byte::value(pc2));
+				pc2 += InstLoadInt1Byte::ISIZE;
+			}
+
+			XTAL_CASE(InstLoadConstant::NUMBER){
+				set_local_variable(InstLoadConstant::result(pc2), XTAL_VM_ff().values[InstLoadConstant::value_number(pc2)]); 
+				pc2 += InstLoadConstant::ISIZE;
+			}
+		}
+
+		const inst_t* pc3 = pc2 + InstIfLt::ISIZE;
+		AnyPtr& lhs = XTAL_VM_local_variable(InstIfLt::lhs(pc2)); uint_t ltype = XTAL_detail_urawtype(lhs)-TYPE_INT;
+		AnyPtr& rhs = XTAL_VM_local_variable(InstIfLt::rhs(pc2)); uint_t rtype = XTAL_detail_urawtype(rhs)-TYPE_INT;
+
+		if(XTAL_LIKELY(((ltype|rtype)&(~1U))==0)){
+			switch((ltype<<1) | (rtype)){
+				XTAL_NODEFAULT;
+				XTAL_CASE((0<<1) | 0){ XTAL_VM_CONTINUE(pc3 + (XTAL_detail_ivalue(lhs)<XTAL_detail_ivalue(rhs) ? InstIf::address_true(pc3) : InstIf::address_false(pc3))); } 
+				XTAL_CASE((1<<1) | 0){ XTAL_VM_CONTINUE(pc3 + (XTAL_detail_fvalue(lhs)<XTAL_detail_ivalue(rhs) ? InstIf::address_true(pc3) : InstIf::address_false(pc3))); } 
+				XTAL_CASE((0<<1) | 1){ XTAL_VM_CONTINUE(pc3 + (XTAL_detail_ivalue(lhs)<XTAL_detail_fvalue(rhs) ? InstIf::address_true(pc3) : InstIf::address_false(pc3))); } 
+				XTAL_CASE((1<<1) | 1){ XTAL_VM_CONTINUE(pc3 + (XTAL_detail_fvalue(lhs)<XTAL_detail_fvalue(rhs) ? InstIf::address_true(pc3) : InstIf::address_false(pc3))); } 
+			}
+		}
+
+		XTAL_VM_CONTINUE(execute_send_comp(pc2, DefinedID::id_op_lt));
+	}
+
+	XTAL_VM_CASE(InstLoadInt1ByteAdd){ // 19
+		AnyPtr& value = XTAL_VM_local_variable(Inst::result(pc));
+		XTAL_VM_DEC_REGISTER(value);
+		value.value_.init_int(Inst::value(pc));
+
+		const inst_t* pc2 = pc + Inst::ISIZE;
+		AnyPtr& a = XTAL_VM_local_variable(InstAdd::lhs(pc2)); uint_t atype = XTAL_detail_urawtype(a) - TYPE_INT;
+		AnyPtr& b = XTAL_VM_local_variable(InstAdd::rhs(pc2)); uint_t btype = XTAL_detail_urawtype(b) - TYPE_INT;
+		AnyPtr& result = XTAL_VM_local_variable(InstAdd::result(pc2));
+		
+		// 型がintかfloatであるか？
+		if(XTAL_LIKELY(((atype|btype)&(~1U))==0)){
+			XTAL_VM_DEC_REGISTER(result);
+			switch((atype<<1) | (btype)){
+				XTAL_NODEFAULT;
+				XTAL_CASE((0<<1) | 0){ result.value_.init_int(XTAL_detail_ivalue(a) + XTAL_detail_ivalue(b)); XTAL_VM_CONTINUE(pc2 + InstAdd::ISIZE); } 
+				XTAL_CASE((1<<1) | 0){ result.value_.init_float(XTAL_detail_fvalue(a) + XTAL_detail_ivalue(b)); XTAL_VM_CONTINUE(pc2 + InstAdd::ISIZE); } 
+				XTAL_CASE((0<<1) | 1){ result.value_.init_float(XTAL_detail_ivalue(a) + XTAL_detail_fvalue(b)); XTAL_VM_CONTINUE(pc2 + InstAdd::ISIZE); } 
+				XTAL_CASE((1<<1) | 1){ result.value_.init_float(XTAL_detail_fvalue(a) + XTAL_detail_fvalue(b)); XTAL_VM_CONTINUE(pc2 + InstAdd::ISIZE); } 
+			}
+		}
+
+		XTAL_VM_CONTINUE(execute_send_bin(pc2, InstAdd::assign(pc2) ? DefinedID::id_op_add_assign : DefinedID::id_op_add));
+	}
+
+	XTAL_VM_CASE(InstLoadInt1ByteSub){ // 19
+		AnyPtr& value = XTAL_VM_local_variable(Inst::result(pc));
+		XTAL_VM_DEC_REGISTER(value);
+		value.value_.init_int(Inst::value(pc));
+
+		const inst_t* pc2 = pc + Inst::ISIZE;
+		AnyPtr& a = XTAL_VM_local_variable(InstSub::lhs(pc2)); uint_t atype = XTAL_detail_urawtype(a) - TYPE_INT;
+		AnyPtr& b = XTAL_VM_local_variable(InstSub::rhs(pc2)); uint_t btype = XTAL_detail_urawtype(b) - TYPE_INT;
+		AnyPtr& result = XTAL_VM_local_variable(InstSub::result(pc2));
+		
+		// 型がintかfloatであるか？
+		if(XTAL_LIKELY(((atype|btype)&(~1U))==0)){
+			XTAL_VM_DEC_REGISTER(result);
+			switch((atype<<1) | (btype)){
+				XTAL_NODEFAULT;
+				XTAL_CASE((0<<1) | 0){ result.value_.init_int(XTAL_detail_ivalue(a) - XTAL_detail_ivalue(b)); XTAL_VM_CONTINUE(pc2 + InstSub::ISIZE); } 
+				XTAL_CASE((1<<1) | 0){ result.value_.init_float(XTAL_detail_fvalue(a) - XTAL_detail_ivalue(b)); XTAL_VM_CONTINUE(pc2 + InstSub::ISIZE); } 
+				XTAL_CASE((0<<1) | 1){ result.value_.init_float(XTAL_detail_ivalue(a) - XTAL_detail_fvalue(b)); XTAL_VM_CONTINUE(pc2 + InstSub::ISIZE); } 
+				XTAL_CASE((1<<1) | 1){ result.value_.init_float(XTAL_detail_fvalue(a) - XTAL_detail_fvalue(b)); XTAL_VM_CONTINUE(pc2 + InstSub::ISIZE); } 
+			}
+		}
+
+		XTAL_VM_CONTINUE(execute_send_bin(pc2, InstSub::assign(pc2) ? DefinedID::id_op_sub_assign : DefinedID::id_op_sub));
+	}
+
+	XTAL_VM_CASE(InstLoadInt1ByteIfLt){ // 17
+		XTAL_CHECK_YIELD;
+		AnyPtr& value = XTAL_VM_local_variable(Inst::result(pc));
+		XTAL_VM_DEC_REGISTER(value);
+		value.value_.init_int(Inst::value(pc));
+
+		const inst_t* pc2 = pc + Inst::ISIZE;
+		const inst_t* pc3 = pc2 + InstIfLt::ISIZE;
+		AnyPtr& a = XTAL_VM_local_variable(InstIfLt::lhs(pc2)); uint_t atype = XTAL_detail_urawtype(a)-TYPE_INT;
+		AnyPtr& b = XTAL_VM_local_variable(InstIfLt::rhs(pc2)); uint_t btype = XTAL_detail_urawtype(b)-TYPE_INT;
+
+		// 型がintかfloatであるか？
+		if(XTAL_LIKELY(((atype|btype)&(~1U))==0)){
+			switch((atype<<1) | (btype)){
+				XTAL_NODEFAULT;
+				XTAL_CASE((0<<1) | 0){ XTAL_VM_CONTINUE(pc3 + (XTAL_detail_ivalue(a)<XTAL_detail_ivalue(b) ? InstIf::address_true(pc3) : InstIf::address_false(pc3))); } 
+				XTAL_CASE((1<<1) | 0){ XTAL_VM_CONTINUE(pc3 + (XTAL_detail_fvalue(a)<XTAL_detail_ivalue(b) ? InstIf::address_true(pc3) : InstIf::address_false(pc3))); } 
+				XTAL_CASE((0<<1) | 1){ XTAL_VM_CONTINUE(pc3 + (XTAL_detail_ivalue(a)<XTAL_detail_fvalue(b) ? InstIf::address_true(pc3) : InstIf::address_false(pc3))); } 
+				XTAL_CASE((1<<1) | 1){ XTAL_VM_CONTINUE(pc3 + (XTAL_detail_fvalue(a)<XTAL_detail_fvalue(b) ? InstIf::address_true(pc3) : InstIf::address_false(pc3))); } 
+			}
+		}
+
+		XTAL_VM_CONTINUE(execute_send_comp(pc2, DefinedID::id_op_lt));
+	}
+
+	XTAL_VM_CASE(InstInstanceVariableAddAssign){ // 24
+		set_local_variable(Inst::result(pc), XTAL_VM_ff().self->instance_variables()->variable(Inst::number(pc), XTAL_VM_ff().code->class_info(Inst::info_number(pc))));
+
+		const inst_t* pc2 = pc + Inst::ISIZE;
+		switch(XTAL_opc(pc2)){
+			XTAL_DEFAULT{}
+
+			XTAL_CASE(InstLoadInt1Byte::NUMBER){
+				AnyPtr& value = XTAL_VM_local_variable(InstLoadInt1Byte::result(pc2));
+				XTAL_VM_DEC_REGISTER(value);
+				value.value_.init_int(InstLoadInt1Byte::value(pc2));
+				pc2 += InstLoadInt1Byte::ISIZE;
+			}
+
+			XTAL_CASE(InstLoadConstant::NUMBER){
+				set_local_variable(InstLoadConstant::result(pc2), XTAL_VM_ff().values[InstLoadConstant::value_number(pc2)]); 
+				pc2 += InstLoadConstant::ISIZE;
+			}
+		}
+
+		const inst_t* pc3 = pc2 + InstAdd::ISIZE;
+		AnyPtr& a = XTAL_VM_local_variable(InstAdd::lhs(pc2)); uint_t atype = XTAL_detail_urawtype(a) - TYPE_INT;
+		AnyPtr& b = XTAL_VM_local_variable(InstAdd::rhs(pc2)); uint_t btype = XTAL_detail_urawtype(b) - TYPE_INT;
+		AnyPtr& result = XTAL_VM_local_variable(InstAdd::result(pc2));
+
+		// 型がintかfloatでなければ、op_add_assignを呼び出した後InstSetInstanceVariableから実行を続ける
+		if(XTAL_UNLIKELY(((atype|btype)&(~1U))!=0)){
+			XTAL_VM_CONTINUE(execute_send_bin(pc2, InstAdd::assign(pc2) ? DefinedID::id_op_add_assign : DefinedID::id_op_add));
+		}
+
+		XTAL_VM_DEC_REGISTER(result);
+		switch((atype<<1) | (btype)){
+			XTAL_NODEFAULT;
+			XTAL_CASE((0<<1) | 0){ result.value_.init_int(XTAL_detail_ivalue(a) + XTAL_detail_ivalue(b)); } 
+			XTAL_CASE((1<<1) | 0){ result.value_.init_float(XTAL_detail_fvalue(a) + XTAL_detail_ivalue(b)); } 
+			XTAL_CASE((0<<1) | 1){ result.value_.init_float(XTAL_detail_ivalue(a) + XTAL_detail_fvalue(b)); } 
+			XTAL_CASE((1<<1) | 1){ result.value_.init_float(XTAL_detail_fvalue(a) + XTAL_detail_fvalue(b)); } 
+		}
+
+		XTAL_VM_ff().self->instance_variables()->set_variable(InstSetInstanceVariable::number(pc3), XTAL_VM_ff().code->class_info(InstSetInstanceVariable::info_number(pc3)), XTAL_VM_local_variable(InstSetInstanceVariable::value(pc3)));
+		XTAL_VM_CONTINUE(pc3 + InstSetInstanceVariable::ISIZE);
+	}
+
+	XTAL_VM_CASE(InstBreakPoint){ XTAL_VM_DISPATCH(FunInstBreakPoint(pc)); /*
 		XTAL_VM_FUN;
-		check_breakpoint_hook(pc, BREAKPOINT_LINE_LIGHT_WEIGHT);
-		check_breakpoint_hook(pc, BREAKPOINT);
-		//check_breakpoint_hook(pc, BREAKPOINT2);
-		check_breakpoint_hook(pc, BREAKPOINT_LINE);
+		Code* code = XTAL_VM_ff().code;
+		XTAL_VM_LOCK{
+			if(code->is_breakpoint(pc)){
+				check_breakpoint_hook(pc, BREAKPOINT_LINE_LIGHT_WEIGHT);
+				check_breakpoint_hook(pc, BREAKPOINT);
+				check_breakpoint_hook(pc, BREAKPOINT_LINE);
+			}
+			else{
+				check_breakpoint_hook(pc, BREAKPOINT_LINE_PROFILE);
+				check_breakpoint_hook(pc, BREAKPOINT_LINE_LIGHT_WEIGHT);
+				check_breakpoint_hook(pc, BREAKPOINT_INNER_LINE);
+				check_breakpoint_hook(pc, BREAKPOINT_LINE);
+			}
+		}
 
-		XTAL_VM_CONTINUE(pc + Inst::ISIZE); 
+		// フックの中でトラップが取り除かれていることもあるので、元の命令はフックの後で調べる
+		inst_t inst = code->original_inst(pc);
+		XTAL_VM_DISPATCH(XTAL_opc(&inst)); 
 	}*/ }
 
 	XTAL_VM_CASE(InstMAX){ // 2
@@ -2036,7 +2383,8 @@ XTAL_VM_LOOP_END
 const inst_t* VMachine::execute_send(const inst_t* pc, CallState& call_state){
 	XTAL_VM_LOCK{
 		int_t accessibility;
-		call_state.amember = environment_->member_cache_table_.cache(ap(call_state.acls), (IDPtr&)call_state.aprimary, accessibility);
+		SendSiteCacheTable::Entry* site;
+		call_state.amember = environment_->send_site_cache_table_.cache(pc, ap(call_state.acls), (IDPtr&)call_state.aprimary, accessibility, environment_->member_cache_table_, &site);
 
 		if(accessibility){
 			if(accessibility<0){
@@ -2047,12 +2395,128 @@ const inst_t* VMachine::execute_send(const inst_t* pc, CallState& call_state){
 			}
 		}
 
+		if(const inst_t* epc = execute_double_dispatch(pc, call_state)){
+			XTAL_VM_CONTINUE(epc);
+		}
+
 		call_state.aself = call_state.atarget;
+
+		if(site && (XTAL_detail_type(call_state.amember)==TYPE_NATIVE_METHOD || XTAL_detail_type(call_state.amember)==TYPE_STATELESS_NATIVE_METHOD)){
+			XTAL_VM_CONTINUE(execute_native_send(pc, call_state, site));
+		}
 	}
 
 	XTAL_VM_CONTINUE(execute_call(pc, call_state));
 }
 
+const inst_t* VMachine::execute_native_send(const inst_t* pc, CallState& call_state, SendSiteCacheTable::Entry* site){
+	XTAL_VM_LOCK{
+		// 2重ディスパッチで別のメンバに置き換わった
+		if(!XTAL_detail_raweq(site->member, call_state.amember)){
+			XTAL_VM_CONTINUE(execute_call(pc, call_state));
+		}
+
+		const param_types_holder_n* pth;
+		const void* fun;
+		if(XTAL_detail_type(call_state.amember)==TYPE_NATIVE_METHOD){
+			NativeMethod* p = unchecked_cast<NativeMethod*>(ap(call_state.amember));
+			if(!p->is_fixed_arity()){
+				XTAL_VM_CONTINUE(execute_call(pc, call_state));
+			}
+			pth = &p->pth();
+			fun = p->data();
+		}
+		else{
+			pth = XTAL_detail_pthvalue(call_state.amember);
+			fun = 0;
+			if(pth->vm || pth->extendable){
+				XTAL_VM_CONTINUE(execute_call(pc, call_state));
+			}
+		}
+
+		int_t param_n = pth->param_n;
+		if(call_state.ordered_arg_count!=param_n || call_state.named_arg_count!=0 || 
+			(call_state.flags&CALL_FLAG_ARGS_BIT)!=0 || param_n+1>FunctorParam::MAX_ARGS){
+			XTAL_VM_CONTINUE(execute_call(pc, call_state));
+		}
+
+		// Int, Float, Any以外の型の引数は、クラスの継承関係まで調べないと渡せるか分からないので対象にしない
+		const CppClassSymbolData* anycls = &CppClassSymbol<Any>::value;
+		const CppClassSymbolData* intcls = &CppClassSymbol<Int>::value;
+		const CppClassSymbolData* floatcls = &CppClassSymbol<Float>::value;
+		for(int_t i=0; i<param_n; ++i){
+			const CppClassSymbolData* cls = pth->param_types[i+1];
+			int_t type = XTAL_detail_type(XTAL_VM_local_variable(call_state.stack_base+i));
+			if(cls!=anycls && !(cls==intcls && type==TYPE_INT) && !(cls==floatcls && type==TYPE_FLOAT)){
+				XTAL_VM_CONTINUE(execute_call(pc, call_state));
+			}
+		}
+
+		if(!cache_enable_ || !site->native_checked || site->native_mutate_count!=is_mutate_count_){
+			// 一度普通に呼び出して、thisの型チェックを通るか確かめる
+			// 呼び出し中にキャッシュが書き換えられてもよいように、メンバとクラスを保持しておく
+			AnyPtr member = ap(call_state.amember);
+			AnyPtr cls = ap(call_state.acls);
+			const inst_t* next_pc = execute_call(pc, call_state);
+			if(!except_[0] && XTAL_detail_raweq(site->member, member) && XTAL_detail_raweq(site->target_class, cls)){
+				site->native_checked = true;
+				site->native_mutate_count = is_mutate_count_;
+			}
+			XTAL_VM_CONTINUE(next_pc);
+		}
+
+		// 引数の数と型は確かめ済みなので、レジスタの値をそのまま渡す
+		environment_->send_site_cache_table_.native_fast_call_++;
+		push_ff(call_state);
+
+		FunctorParam fp;
+		fp.vm = this;
+		fp.fun = fun;
+		fp.result = undefined;
+		fp.args[0] = call_state.aself;
+		for(int_t i=0; i<param_n; ++i){
+			fp.args[i+1] = (Any&)XTAL_VM_local_variable(i);
+		}
+
+		pth->fun(fp);
+
+		if(!is_executed()){
+			return_result(ap(fp.result));
+		}
+
+		if(except_[0]){
+			XTAL_VM_CONTINUE(push_except(XTAL_VM_ff().next_pc));
+		}
+		else{
+			XTAL_VM_CONTINUE(XTAL_VM_ff().next_pc);
+		}
+	}
+}
+
+const inst_t* VMachine::execute_double_dispatch(const inst_t* pc, CallState& call_state){
+	// 引数が一つで2重ディスパッチメソッドなら、引数のクラスで解決したメソッドを直接呼び出す
+	if(call_state.ordered_arg_count==1 && call_state.named_arg_count==0 && 
+		(call_state.flags&CALL_FLAG_ARGS_BIT)==0 &&
+		XTAL_detail_type(call_state.amember)==TYPE_BASE && 
+		XTAL_detail_raweq(ap(call_state.amember)->get_class(), cpp_class<DoubleDispatchMethod>())){
+		int_t accessibility;
+		call_state.asecondary = XTAL_VM_local_variable(call_state.stack_base)->get_class();
+		const AnyPtr& mem = unchecked_ptr_cast<DoubleDispatchMethod>(ap(call_state.amember))->dispatch(
+			ap(call_state.acls), ap(call_state.asecondary), accessibility);
+
+		if(!XTAL_detail_is_undefined(mem)){
+			if(accessibility){
+				if(const inst_t* epc = check_accessibility(call_state, accessibility)){
+					return epc;
+				}
+			}
+			call_state.amember = mem;
+		}
+		call_state.asecondary = undefined;
+	}
+	return 0;
+}
+
 const inst_t* VMachine::execute_sendex(const inst_t* pc, CallState& call_state){
 	XTAL_VM_LOCK{
 		int_t accessibility;
@@ -2067,6 +2531,10 @@ const inst_t* VMachine::execute_sendex(const inst_t* pc, CallState& call_state){
 			}
 		}
 
+		if(const inst_t* epc = execute_double_dispatch(pc, call_state)){
+			XTAL_VM_CONTINUE(epc);
+		}
+
 		call_state.aself = call_state.atarget;
 	}
 
@@ -2131,6 +2599,7 @@ const inst_t* VMachine::execute_send_comp(const inst_t* pc, int_t iprimary){
 	typedef InstIfEq Inst;
 	typedef InstIf Inst2;
 	const inst_t* pc2 = pc+Inst::ISIZE;
+	XTAL_VM_COUNT_SLOW_PATH;
 
 	set_local_variable(Inst::stack_base(pc), XTAL_VM_local_variable(Inst::rhs(pc)));
 	CallState call_state;
@@ -2142,16 +2611,19 @@ const inst_t* VMachine::execute_send_comp(const inst_t* pc, int_t iprimary){
 
 const inst_t* VMachine::execute_send_bin(const inst_t* pc, int_t iprimary){
 	typedef InstAdd Inst;
+	XTAL_VM_COUNT_SLOW_PATH;
 	set_local_variable(Inst::stack_base(pc), XTAL_VM_local_variable(Inst::rhs(pc)));
 	CallState call_state;
 	call_state.set(pc, pc+Inst::ISIZE, Inst::result(pc), 1, Inst::stack_base(pc), 1, 0, 0);
 	call_state.atarget = XTAL_VM_local_variable(Inst::lhs(pc));
 
+	// 2重ディスパッチメソッドは、execute_sendで右辺のクラスから解決して直接呼び出す
 	XTAL_VM_CONTINUE(execute_send_iprimary_nosecondary(pc, iprimary, call_state));
 }
 
 const inst_t* VMachine::execute_send_una(const inst_t* pc, int_t iprimary){
 	typedef InstInc Inst;
+	XTAL_VM_COUNT_SLOW_PATH;
 	CallState call_state;
 	call_state.set(pc, pc+Inst::ISIZE, Inst::result(pc), 1, Inst::stack_base(pc), 0, 0, 0);
 	call_state.atarget = XTAL_VM_local_variable(Inst::target(pc));
@@ -2170,20 +2642,6 @@ const inst_t* VMachine::execute_divzero(const inst_t* pc){
 ////////////////////////////////////////////////////////////////
 
 //{FUNS{{
-const inst_t* VMachine::FunInstLine(const inst_t* pc){
-		XTAL_VM_DEF_INST(InstLine);
-		XTAL_VM_FUN;
-		if(*hook_setting_bit_!=0){
-			XTAL_VM_LOCK{
-				check_breakpoint_hook(pc, BREAKPOINT_LINE_PROFILE);
-				check_breakpoint_hook(pc, BREAKPOINT_LINE_LIGHT_WEIGHT);
-				check_breakpoint_hook(pc, BREAKPOINT_INNER_LINE);
-				check_breakpoint_hook(pc, BREAKPOINT_LINE);
-			}
-		}
-		XTAL_VM_CONTINUE(pc + Inst::ISIZE); 
-}
-
 const inst_t* VMachine::FunInstClassBegin(const inst_t* pc){
 		XTAL_VM_DEF_INST(InstClassBegin);
 		XTAL_VM_FUN;
@@ -2232,10 +2690,10 @@ const inst_t* VMachine::FunInstClassBegin(const inst_t* pc){
 		call_state.named_arg_count = 0;
 		push_ff(call_state);
 
-		XTAL_VM_ff().fun = XTAL_VM_prev_ff().fun;
-		XTAL_VM_ff().outer = cp;
+		XTAL_VM_set_register_ptr(XTAL_VM_ff().fun, XTAL_VM_prev_ff().fun.get());
+		XTAL_VM_set_register_ptr(XTAL_VM_ff().outer, cp.get());
 		XTAL_VM_ff().identifiers = XTAL_VM_prev_ff().identifiers;
-		XTAL_VM_ff().code = XTAL_VM_prev_ff().code;
+		XTAL_VM_set_register_ptr(XTAL_VM_ff().code, XTAL_VM_prev_ff().code.get());
 		XTAL_VM_ff().values = XTAL_VM_prev_ff().values;
 
 		XTAL_VM_CONTINUE(pc + Inst::ISIZE);
@@ -2334,15 +2792,27 @@ const inst_t* VMachine::FunInstAssert(const inst_t* pc){
 		XTAL_VM_CONTINUE(pc + Inst::ISIZE);
 }
 
-const inst_t* VMachine::FunInstBreakPoint(const inst_t* pc){
+int_t VMachine::FunInstBreakPoint(const inst_t* pc){
 		XTAL_VM_DEF_INST(InstBreakPoint);
 		XTAL_VM_FUN;
-		check_breakpoint_hook(pc, BREAKPOINT_LINE_LIGHT_WEIGHT);
-		check_breakpoint_hook(pc, BREAKPOINT);
-		//check_breakpoint_hook(pc, BREAKPOINT2);
-		check_breakpoint_hook(pc, BREAKPOINT_LINE);
+		Code* code = XTAL_VM_ff().code.get();
+		XTAL_VM_LOCK{
+			if(code->is_breakpoint(pc)){
+				check_breakpoint_hook(pc, BREAKPOINT_LINE_LIGHT_WEIGHT);
+				check_breakpoint_hook(pc, BREAKPOINT);
+				check_breakpoint_hook(pc, BREAKPOINT_LINE);
+			}
+			else{
+				check_breakpoint_hook(pc, BREAKPOINT_LINE_PROFILE);
+				check_breakpoint_hook(pc, BREAKPOINT_LINE_LIGHT_WEIGHT);
+				check_breakpoint_hook(pc, BREAKPOINT_INNER_LINE);
+				check_breakpoint_hook(pc, BREAKPOINT_LINE);
+			}
+		}
 
-		XTAL_VM_CONTINUE(pc + Inst::ISIZE); 
+		// フックの中でトラップが取り除かれていることもあるので、元の命令はフックの後で調べる
+		inst_t inst = code->original_inst(pc);
+		return XTAL_opc(&inst);
 }
 
 //}}FUNS}
@@ -69,15 +69,36 @@ struct FastStackDefaultValue<AnyPtr>{
 
 #define XTAL_VM_set(dest, src) (XTAL_VM_INC(src), XTAL_VM_DEC(dest), XTAL_detail_copy(dest, src))
 
+#ifdef XTAL_NO_DEFERRED_REF_COUNT
+
+#define XTAL_VM_set_register(dest, src) XTAL_VM_set(dest, src)
+#define XTAL_VM_set_register_ptr(dest, p) ((dest) = (p))
+#define XTAL_VM_DEC_REGISTER(v) XTAL_VM_DEC(v)
+
+#else
+
+// レジスタとFunFrameの値は参照カウンタを持たない。
+// 参照カウンタが0になったオブジェクトは、ObjectSpaceがレジスタを走査してから破棄する
+#define XTAL_VM_set_register(dest, src) XTAL_detail_copy(dest, src)
+#define XTAL_VM_set_register_ptr(dest, p) ((dest).set_direct(p))
+#define XTAL_VM_DEC_REGISTER(v) ((void)0)
+
+#endif
+
 #define XTAL_VM_variables_top() (variables_top_ - variables_.data())
 #define XTAL_VM_set_variables_top(top) (variables_top_ = variables_.data() + (top))
 #define XTAL_VM_local_variable(pos) (*(variables_top_ + (pos)))
-#define XTAL_VM_set_local_variable(pos, value) (XTAL_VM_INC(value), XTAL_VM_DEC(XTAL_VM_local_variable(pos)), XTAL_detail_copy(XTAL_VM_local_variable(pos), value))
+#define XTAL_VM_set_local_variable(pos, value) XTAL_VM_set_register(XTAL_VM_local_variable(pos), value)
 
 #define XTAL_VM_ff() (*current_fun_frame_)
 #define XTAL_VM_prev_ff() (**(fun_frame_stack_.current_-1))
 #define XTAL_VM_identifier(n) (identifier_[n])
 
+#ifdef XTAL_ENABLE_VM_STATS
+class StatsSpace;
+struct CodeStats;
+#endif
+
 // XTAL仮想マシン
 class VMachine : public Base{
 public:
@@ -143,7 +164,7 @@ public:
 	*
 	*/	
 	void set_arg_this(const AnyPtr& self){ 
-		XTAL_VM_ff().self = self;
+		XTAL_VM_set_register(XTAL_VM_ff().self, self);
 	}
 
 	void insert_arg(int_t index, const AnyPtr& value);
@@ -494,7 +515,9 @@ public:
 
 		const IDPtr* identifiers;
 		const AnyPtr* values;
-		Code* code;
+
+		// 実行中のコード。関数のコードがリロードで差し替えられても、このフレームが残っている間は破棄されない
+		BasePtr<Code> code;
 
 		// 関数の外側のフレームオブジェクト
 		BasePtr<Frame> outer;
@@ -538,6 +561,10 @@ private:
 
 	void upsize_variables_detail(uint_t upsize);
 
+	void move_variables_direct(int_t dest, int_t src, int_t n);
+
+	void clear_registers();
+
 public:
 	ArgumentsPtr inner_make_arguments(Method* fun);
 	ArgumentsPtr inner_make_arguments(const NamedParam* params, int_t num);
@@ -573,6 +600,46 @@ private: // ブレークポイント系
 		breakpoint_hook(pc, XTAL_VM_ff().fun, kind);
 	}
 
+private: // サンプリングプロファイラ系
+	enum{
+		// この回数ごとに、サンプリングの時刻に達したか調べる
+		SAMPLE_CHECK_INTERVAL = 64
+	};
+
+	void check_sample(const inst_t* pc){
+		if((*hook_setting_bit_&(1<<BREAKPOINT_SAMPLE))==0){ return; }
+		if(--sample_count_>0){ return; }
+		sample(pc);
+	}
+
+	void sample(const inst_t* pc);
+
+public: // 実行量の上限系
+
+	/**
+	* \brief 次の分岐か関数呼び出しで、実行量の上限を調べ直すようにする
+	*/
+	void reset_execution_count(){
+		thread_yield_count_ = 0;
+		thread_yield_interval_ = 0;
+	}
+
+	/**
+	* \brief 数えた実行量を保ったまま、次の分岐か関数呼び出しでcheck_yieldが呼ばれるようにする
+	*/
+	void request_check_yield(){
+		thread_yield_interval_ -= thread_yield_count_;
+		thread_yield_count_ = 0;
+	}
+
+private:
+	enum{
+		// この回数ごとに、スレッドの切り替えや実行量の上限を調べる
+		YIELD_CHECK_INTERVAL = 1000
+	};
+
+	const inst_t* check_yield(const inst_t* pc);
+
 public:
 	const inst_t* execute_divzero(const inst_t* pc);
 	const inst_t* execute_member2q(const inst_t* pc, CallState& call_state);
@@ -580,13 +647,14 @@ public:
 	const inst_t* execute_callex(const inst_t* pc, CallState& call_state);
 	const inst_t* execute_send(const inst_t* pc, CallState& call_state);
 	const inst_t* execute_sendex(const inst_t* pc, CallState& call_state);
+	const inst_t* execute_double_dispatch(const inst_t* pc, CallState& call_state);
+	const inst_t* execute_native_send(const inst_t* pc, CallState& call_state, SendSiteCacheTable::Entry* site);
 	const inst_t* execute_send_iprimary_nosecondary(const inst_t* pc, int_t iprimary, CallState& call_state);
 	const inst_t* execute_send_comp(const inst_t* pc, int_t iprimary);
 	const inst_t* execute_send_bin(const inst_t* pc, int_t iprimary);
 	const inst_t* execute_send_una(const inst_t* pc, int_t iprimary);
 
 //{DECLS{{
-	const inst_t* FunInstLine(const inst_t* pc);
 	const inst_t* FunInstLoadValue(const inst_t* pc);
 	const inst_t* FunInstLoadConstant(const inst_t* pc);
 	const inst_t* FunInstLoadInt1Byte(const inst_t* pc);
@@ -669,7 +737,12 @@ public:
 	const inst_t* FunInstPopGoto(const inst_t* pc);
 	const inst_t* FunInstThrow(const inst_t* pc);
 	const inst_t* FunInstAssert(const inst_t* pc);
-	const inst_t* FunInstBreakPoint(const inst_t* pc);
+	int_t FunInstBreakPoint(const inst_t* pc);
+	const inst_t* FunInstIncIfLt(const inst_t* pc);
+	const inst_t* FunInstLoadInt1ByteAdd(const inst_t* pc);
+	const inst_t* FunInstLoadInt1ByteSub(const inst_t* pc);
+	const inst_t* FunInstLoadInt1ByteIfLt(const inst_t* pc);
+	const inst_t* FunInstInstanceVariableAddAssign(const inst_t* pc);
 	const inst_t* FunInstMAX(const inst_t* pc);
 //}}DECLS}
 
@@ -746,6 +819,20 @@ private:
 	uint_t* hook_setting_bit_;
 
 	int_t thread_yield_count_;
+	int_t thread_yield_interval_;
+	int_t sample_count_;
+
+#ifdef XTAL_ENABLE_VM_STATS
+	StatsSpace* stats_;
+
+	// 直前に実行したコードとその実行回数
+	Code* stats_code_;
+	CodeStats* code_stats_;
+
+	CodeStats* code_stats(Code* code);
+
+	void count_inst(const inst_t* pc);
+#endif
 
 	//MemberCacheTable member_cache_table_;
 	//MemberCacheTable2 member_cache_table2_;
@@ -762,6 +849,14 @@ public:
 
 	void on_visit_members(Visitor& m);
 
+#ifndef XTAL_NO_DEFERRED_REF_COUNT
+	/**
+	* \brief レジスタとFunFrameが指しているオブジェクトの参照カウンタを一時的に増やし、marksに積む。
+	*/
+	void mark_registers(PODStack<RefCountingBase*>& marks);
+#endif
+
+
 protected:
 
 	void add_ref_count_members(int_t i);
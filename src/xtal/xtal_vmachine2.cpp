@@ -1,5 +1,8 @@
 #include "xtal.h"
 #include "xtal_macro.h"
+#include "xtal_stringspace.h"
+#include "xtal_objectspace.h"
+#include "xtal_details.h"
 
 namespace xtal{
 
@@ -17,13 +20,40 @@ VMachine::VMachine(){
 
 	parent_vm_ = 0;
 
-	thread_yield_count_ = 1000;
+	thread_yield_count_ = YIELD_CHECK_INTERVAL;
+	thread_yield_interval_ = YIELD_CHECK_INTERVAL;
+	sample_count_ = SAMPLE_CHECK_INTERVAL;
 
 	static uint_t dummy = 0;
 	hook_setting_bit_ = &dummy;
+
+#ifdef XTAL_ENABLE_VM_STATS
+	stats_ = &environment_->stats_space_;
+	stats_code_ = 0;
+	code_stats_ = 0;
+#endif
+
+#ifndef XTAL_NO_DEFERRED_REF_COUNT
+	environment_->object_space_.register_vmachine(this);
+#endif
 }
 
 VMachine::~VMachine(){
+#ifndef XTAL_NO_DEFERRED_REF_COUNT
+	environment_->object_space_.unregister_vmachine(this);
+
+	// レジスタは参照カウンタを持っていないので、減らさずに捨てる
+	clear_registers();
+	for(int_t i=0, size=fun_frame_stack_.capacity(); i<size; ++i){
+		if(FunFrame* p = fun_frame_stack_.reverse_at_unchecked(i)){
+			p->fun.set_direct(0);
+			p->outer.set_direct(0);
+			p->code.set_direct(0);
+			XTAL_detail_copy(p->self, null);
+		}
+	}
+#endif
+
 	variables_.clear();
 	for(int_t i=0, size=fun_frame_stack_.capacity(); i<size; ++i){
 		if(FunFrame* p = fun_frame_stack_.reverse_at_unchecked(i)){
@@ -57,11 +87,26 @@ void VMachine::reset(){
 
 	parent_vm_ = 0;
 
+	clear_registers();
+}
+
+void VMachine::clear_registers(){
+	AnyPtr* values = variables_.data();
 	for(int_t i=0, size=(int)variables_.size(); i<size; ++i){
-		variables_.set_at(i, null);
+		XTAL_VM_set_register(values[i], null);
 	}
 }
 
+void VMachine::move_variables_direct(int_t dest, int_t src, int_t n){
+#ifdef XTAL_NO_DEFERRED_REF_COUNT
+	variables_.move(dest, src, n);
+#else
+	if(n!=0 && dest!=src){
+		xmemmove(variables_.data()+dest, variables_.data()+src, n);
+	}
+#endif
+}
+
 void VMachine::push_arg(const AnyPtr& value){
 	XTAL_ASSERT(XTAL_VM_ff().named_arg_count==0); //順番指定引数は 名前指定引数の前だけ
 
@@ -134,9 +179,9 @@ void VMachine::ready(){
 	f.result = 0;
 	f.prev_stack_base = 0;
 	f.scope_lower = scopes_.size();
-	f.self = undefined;
-	f.fun = null;
-	f.outer = null;
+	XTAL_VM_set_register(f.self, undefined);
+	XTAL_VM_set_register_ptr(f.fun, (Method*)0);
+	XTAL_VM_set_register_ptr(f.outer, (Frame*)0);
 
 	result_base_ = f.result;
 }
@@ -308,7 +353,7 @@ bool VMachine::adjust_args(const NamedParam* params, int_t num){
 	}
 
 	int_t top = XTAL_VM_variables_top();
-	variables_.move(top + f.ordered_arg_count, base + top, offset-base);
+	move_variables_direct(top + f.ordered_arg_count, base + top, offset-base);
 	return true;
 }
 
@@ -352,7 +397,7 @@ bool VMachine::adjust_args(Method* names){
 	}
 
 	int_t top = XTAL_VM_variables_top();
-	variables_.move(top + f.ordered_arg_count, base + top, offset-base);
+	move_variables_direct(top + f.ordered_arg_count, base + top, offset-base);
 	return true;
 }
 
@@ -646,13 +691,13 @@ AnyPtr VMachine::append_backtrace(const inst_t* pc, const AnyPtr& e){
 		}
 
 		if(MethodPtr fun = XTAL_VM_ff().fun){
-			if(CodePtr code = fun->code()){
+			// reload等でfun->code()が差し替えられていても、実行中のコードで位置を求める
+			if(Code* cp = XTAL_VM_ff().code.get()){
+				const CodePtr& code = to_smartptr(cp);
 				//if((pc !=  code->bytecode_data() + code->bytecode_size()-1)){
 				if((code->bytecode_data() <= pc && pc < code->bytecode_data()+code->bytecode_size()-1)){
-					unchecked_ptr_cast<Exception>(ep)->append_backtrace(
-						code->source_file_name(),
-						code->compliant_lineno(pc),
-						fun->object_name());
+					// ファイル名や行番号の文字列化は、バックトレースが参照されるまで遅らせる
+					unchecked_ptr_cast<Exception>(ep)->append_backtrace_frame(fun, code, pc);
 				}
 			}
 		}
@@ -866,12 +911,112 @@ void VMachine::breakpoint_hook(const inst_t* pc, const MethodPtr& fun, int_t kin
 	vmachine_take_back(set_vmachine(oldvm));
 }
 
+void VMachine::sample(const inst_t* pc){
+	sample_count_ = SAMPLE_CHECK_INTERVAL;
+
+	const debug::SamplingProfilerPtr& profiler = debug::profiler();
+	if(!profiler->is_due()){
+		return;
+	}
+
+	// 実行中の関数から呼び出し元へ向かって記録する
+	profiler->begin_sample();
+	for(uint_t i=0, size=fun_frame_stack_.size(); i<size; ++i){
+		FunFrame& f = *fun_frame_stack_[i];
+		if(!f.fun || !f.code){
+			continue;
+		}
+
+		const inst_t* p = i==0 ? pc : fun_frame_stack_[i-1]->poped_pc-1;
+		Code* code = f.code.get();
+		int_t lineno = 0;
+		FunInfo* info = 0;
+		if(code->bytecode_data()<=p && p<code->bytecode_data()+code->bytecode_size()){
+			lineno = code->compliant_lineno(p);
+			info = code->compliant_fun_info(p);
+		}
+
+		profiler->push_frame(f.fun, code, info, lineno);
+	}
+	profiler->end_sample();
+}
+
+const inst_t* VMachine::check_yield(const inst_t* pc){
+#if !defined(XTAL_NO_THREAD) && !defined(XTAL_USE_THREAD_MODEL2)
+	yield_thread();
+#endif
+
+	if(*hook_setting_bit_&(1<<BREAKPOINT_SAMPLE)){
+		sample(pc);
+	}
+
+	Environment* env = environment_;
+	if(env->memory_check_requested_ && !check_requested_memory_limit()){
+		// 実行量はまだ数えていないので、次の分岐か呼び出しでもう一度ここに来る
+		XTAL_VM_LOCK{
+			return push_except(pc, cpp_class<MemoryError>()->call(Xt1("XRE1040", limit, env->hard_memory_limit_)));
+		}
+		return pc;
+	}
+
+	if(!env->execution_limited_){
+		thread_yield_count_ = YIELD_CHECK_INTERVAL;
+		thread_yield_interval_ = YIELD_CHECK_INTERVAL;
+		return 0;
+	}
+
+	// 前回調べてから数えた回数を残りから引く
+	uint_t used = (uint_t)(thread_yield_interval_ - thread_yield_count_);
+	if(env->execution_tick_limit_){
+		if(env->execution_ticks_<=used){
+			env->execution_ticks_ = 0;
+			env->execution_limit_exceeded_ = true;
+		}
+		else{
+			env->execution_ticks_ -= used;
+		}
+	}
+
+	if(env->execution_deadline_ && env->execution_deadline_<=thread_lib()->clock()){
+		env->execution_limit_exceeded_ = true;
+	}
+
+	if(!env->execution_limit_exceeded_){
+		uint_t interval = YIELD_CHECK_INTERVAL;
+		if(env->execution_tick_limit_ && env->execution_ticks_<interval){
+			interval = env->execution_ticks_;
+		}
+		thread_yield_count_ = interval;
+		thread_yield_interval_ = interval;
+		return 0;
+	}
+
+	// 上限に達している間は、分岐や呼び出しの度に調べる
+	thread_yield_count_ = 0;
+	thread_yield_interval_ = 0;
+
+	if(XTAL_VM_ff().yieldable){
+		// 値を返さないyieldと同じように中断し、再開時はpcの命令から実行し直す
+		yield_base_ = 0;
+		yield_result_count_ = 0;
+		yield_result_ = 0;
+		yield_need_result_count_ = 0;
+		resume_pc_ = pc;
+		return pc;
+	}
+
+	XTAL_VM_LOCK{
+		return push_except(pc, cpp_class<ExecutionLimitError>()->call(Xt("XRE1041")));
+	}
+	return pc;
+}
+
 void VMachine::pop_ff_non(){
 	FunFrame& f = *fun_frame_stack_.top();
 
-	f.fun = null;
-	f.outer = null;
-	f.self = null;
+	XTAL_VM_set_register_ptr(f.fun, (Method*)0);
+	XTAL_VM_set_register_ptr(f.outer, (Frame*)0);
+	XTAL_VM_set_register(f.self, null);
 
 	pop_ff_simple();
 	current_fun_frame_->is_executed = 2;
@@ -898,7 +1043,9 @@ const inst_t* VMachine::catch_body(const inst_t* pc, const ExceptFrame& nef){
 		check_breakpoint_hook(pc, BREAKPOINT_RETURN);
 		pop_ff_non();
 		pc = XTAL_VM_ff().next_pc;
-		e = append_backtrace(pc, e);
+
+		// 戻り先は呼び出し命令の次を指しているので、その一つ前で呼び出した行を引く
+		e = append_backtrace(pc-1, e);
 
 		// Cの関数にぶつかった
 		if(pc==&end_code_){
@@ -999,6 +1146,7 @@ void VMachine::on_visit_members(Visitor& m){
 			m & f->fun;
 			m & f->self;
 			m & f->outer;
+			m & f->code;
 		}
 	}
 
@@ -1011,6 +1159,37 @@ void VMachine::on_visit_members(Visitor& m){
 	}
 }
 
+#ifndef XTAL_NO_DEFERRED_REF_COUNT
+
+namespace{
+	void mark_register(PODStack<RefCountingBase*>& marks, const Any& v){
+		if(XTAL_detail_is_rcpvalue(v)){
+			RefCountingBase* p = XTAL_detail_rcpvalue(v);
+			p->inc_ref_count();
+			marks.push(p);
+		}
+	}
+}
+
+void VMachine::mark_registers(PODStack<RefCountingBase*>& marks){
+	// on_visit_membersが辿るレジスタと同じ範囲を走査すること
+	for(int_t i=0, size=fun_frame_stack_.size(); i<size; ++i){
+		if(FunFrame* f = fun_frame_stack_[i]){
+			mark_register(marks, f->fun);
+			mark_register(marks, f->self);
+			mark_register(marks, f->outer);
+			mark_register(marks, f->code);
+		}
+	}
+
+	const AnyPtr* values = variables_.data();
+	for(int_t i=0, size=variables_.size(); i<size; ++i){
+		mark_register(marks, values[i]);
+	}
+}
+
+#endif
+
 void VMachine::print_info(){
 #ifdef XTAL_DEBUG_PRINT
 	std::printf("stack size %d\n", stack_.size());
@@ -3,6 +3,16 @@
 #include "xtal_macro.h"
 #include "xtal_stringspace.h"
 
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP>=2)
+#	define XTAL_XPEG_USE_SSE2
+#	include <emmintrin.h>
+#endif
+
+#if defined(__AVX2__)
+#	define XTAL_XPEG_USE_AVX2
+#	include <immintrin.h>
+#endif
+
 namespace xtal{ namespace xpeg{
 
 enum{ NFA_STATE_START = 0, NFA_STATE_FINAL = 1 };
@@ -11,6 +21,7 @@ Executor::Executor(const StringPtr& source_name){
 	source_name_ = source_name;
 
 	cap_ = XNew<Map>();
+	cap_log_ = XNew<Array>();
 	tree_ = XNew<TreeNode>();
 	errors_ = null;
 	pos_begin_ = 0;
@@ -32,6 +43,16 @@ Executor::Executor(const StringPtr& source_name){
 
 	lineno_ = 1;
 
+	packrat_capacity_ = 0;
+	cap_log_depth_ = 0;
+	cap_log_generation_ = 0;
+	cap_change_count_ = 0;
+	tree_floor_ = 0;
+
+	bytes_ = 0;
+	bytes_size_ = 0;
+	bytes_pos_ = 0;
+
 	expand();
 }
 
@@ -209,6 +230,35 @@ void Executor::error(const AnyPtr& message, int_t line){
 bool Executor::match_inner(const ElementPtr& e){
 	if(!e->nfa){
 		e->nfa = XNew<NFA>(e);
+		e->dfa_status = DFA::is_regular(e) ? Element::DFA_STATUS_CANDIDATE : Element::DFA_STATUS_NONE;
+	}
+	else if(e->dfa_status==Element::DFA_STATUS_CANDIDATE){
+		// 一度きりしか使われないパターンで変換の手間がかからないよう、二度目の実行でDFAに変換する
+		e->dfa = XNew<DFA>(e->nfa);
+		if(e->dfa->is_valid()){
+			e->dfa_status = Element::DFA_STATUS_READY;
+		}
+		else{
+			e->dfa = null;
+			e->dfa_status = Element::DFA_STATUS_NONE;
+		}
+	}
+
+	if(e->dfa_status==Element::DFA_STATUS_READY){
+		State first_pos = save();
+		int_t ret = e->dfa->match(this);
+		if(ret==DFA::RESULT_MATCH){
+			return true;
+		}
+
+		load(first_pos);
+		if(ret==DFA::RESULT_UNMATCH){
+			return false;
+		}
+
+		// 状態数が上限を超えたので、以降はNFAで実行する
+		e->dfa = null;
+		e->dfa_status = Element::DFA_STATUS_NONE;
 	}
 
 	const NFAPtr& nfa = e->nfa;
@@ -221,16 +271,29 @@ bool Executor::match_inner(const ElementPtr& e){
 
 	// すでにメモ化してないかチェック
 	if(memotable_t::Node* it=memotable_.find(key)){
-		load(it->value().state);
-		tree_->op_cat_assign(it->value().tree);
+		Value& value = it->value();
+		load(value.state);
+		tree_->op_cat_assign(value.tree);
+		if(value.caps){
+			replay_captures(value.caps);
+		}
 		return true;
 	}
 
 	int_t nodenum = tree_->size();
 	uint_t mins = stack_.size();
+	uint_t capnum = cap_log_->size();
+	uint_t generation = cap_log_generation_;
+
+	// キャプチャの変化を名前で記録するのはパックラット構文解析モードのときだけ
+	bool logging = packrat_capacity_!=0;
+	if(logging){
+		cap_log_depth_++;
+	}
+	uint_t capchange = cap_change_count_;
 
 	for(uint_t i=0, sz=nfa->cap_list_->size(); i<sz; ++i){
-		cap_->set_at(nfa->cap_list_->at(i), xnew<Cap>());
+		set_capture(nfa->cap_list_->at(i), NFA::CAPTURE_NONE, 0);
 	}
 
 	bool match = false;
@@ -273,31 +336,32 @@ bool Executor::match_inner(const ElementPtr& e){
 			}
 		}
 		else{
-			switch(state.capture_kind){
-				XTAL_NODEFAULT;
-				XTAL_CASE(NFA::CAPTURE_NONE){}
-
-				XTAL_CASE(NFA::CAPTURE_BEGIN){
-					const SmartPtr<Cap>& temp = unchecked_ptr_cast<Cap>(cap_->at(state.capture_name));
-					temp->begin = pos.pos;
-					temp->end = -1;
-				}
-
-				XTAL_CASE(NFA::CAPTURE_END){
-					const SmartPtr<Cap>& temp = unchecked_ptr_cast<Cap>(cap_->at(state.capture_name));
-					temp->end = pos.pos;
-				}
+			if(state.capture_kind!=NFA::CAPTURE_NONE){
+				set_capture(state.capture_name, state.capture_kind, pos.pos);
 			}
 		}
 	}
 
 	stack_.downsize_n(mins);
 
-	if(match){
+	if(logging){
+		cap_log_depth_--;
+	}
+
+	// 再利用した時にもキャプチャが同じように変化するよう、変化したキャプチャの最後の状態を共に記録する
+	if(match && generation==cap_log_generation_){
 		Value value;
 		value.state = match_pos;
 		value.tree = tree_->slice(nodenum, tree_->size()-nodenum);
+		value.caps = logging ? capture_states(capnum) : capture_states_since(capchange);
 		memotable_.insert(key, value);
+	}
+
+	if(logging && cap_log_depth_==0){
+		cap_log_->clear();
+	}
+
+	if(match){
 		load(match_pos);
 		return true;
 	}
@@ -308,6 +372,207 @@ bool Executor::match_inner(const ElementPtr& e){
 	return false;
 }
 
+void Executor::set_capture(const AnyPtr& name, int_t kind, int_t pos){
+	switch(kind){
+		XTAL_NODEFAULT;
+
+		XTAL_CASE(NFA::CAPTURE_NONE){
+			SmartPtr<Cap> temp = xnew<Cap>();
+			temp->stamp = cap_change_count_;
+			cap_->set_at(name, temp);
+		}
+
+		XTAL_CASE(NFA::CAPTURE_BEGIN){
+			const SmartPtr<Cap>& temp = unchecked_ptr_cast<Cap>(cap_->at(name));
+			temp->begin = pos;
+			temp->end = -1;
+			temp->stamp = cap_change_count_;
+		}
+
+		XTAL_CASE(NFA::CAPTURE_END){
+			const SmartPtr<Cap>& temp = unchecked_ptr_cast<Cap>(cap_->at(name));
+			temp->end = pos;
+			temp->stamp = cap_change_count_;
+		}
+	}
+
+	cap_change_count_++;
+	if(cap_log_depth_!=0){
+		cap_log_->push_back(name);
+	}
+}
+
+ArrayPtr Executor::capture_states(uint_t from){
+	if(cap_log_->size()<=from){
+		return null;
+	}
+
+	// 同じキャプチャが何度変化しても、最後の状態だけを (名前、開始位置、終了位置) の順に並べる
+	ArrayPtr ret = XNew<Array>();
+	for(uint_t i=from, sz=cap_log_->size(); i<sz; ++i){
+		const AnyPtr& name = cap_log_->at(i);
+
+		bool found = false;
+		for(uint_t j=0, jsz=ret->size(); j<jsz; j+=3){
+			if(XTAL_detail_raweq(ret->at(j), name)){
+				found = true;
+				break;
+			}
+		}
+
+		if(!found){
+			const SmartPtr<Cap>& temp = unchecked_ptr_cast<Cap>(cap_->at(name));
+			ret->push_back(name);
+			ret->push_back(temp->begin);
+			ret->push_back(temp->end);
+		}
+	}
+	return ret;
+}
+
+ArrayPtr Executor::capture_states_since(uint_t count){
+	uint_t changes = cap_change_count_ - count;
+	if(changes==0){
+		return null;
+	}
+
+	// cap_change_count_がcountだった時点より後に変化したキャプチャを、capture_statesと同じ形で並べる
+	ArrayPtr ret = XNew<Array>();
+	for(Map::iterator it=cap_->begin(); it!=cap_->end(); ++it){
+		const SmartPtr<Cap>& temp = unchecked_ptr_cast<Cap>(it->second);
+		if(temp->stamp - count < changes){
+			ret->push_back(it->first);
+			ret->push_back(temp->begin);
+			ret->push_back(temp->end);
+		}
+	}
+	return ret;
+}
+
+void Executor::replay_captures(const ArrayPtr& caps){
+	for(uint_t i=0, sz=caps->size(); i<sz; i+=3){
+		const AnyPtr& name = caps->at(i);
+		SmartPtr<Cap> temp = xnew<Cap>();
+		temp->begin = ivalue(caps->at(i+1));
+		temp->end = ivalue(caps->at(i+2));
+		temp->stamp = cap_change_count_;
+		cap_->set_at(name, temp);
+
+		cap_change_count_++;
+		if(cap_log_depth_!=0){
+			cap_log_->push_back(name);
+		}
+	}
+}
+
+void Executor::enable_packrat(uint_t capacity){
+	packrat_capacity_ = capacity==0 ? 1 : capacity;
+}
+
+void Executor::disable_packrat(){
+	packrat_capacity_ = 0;
+	packrat_memo_.clear();
+	cap_log_->clear();
+	cap_log_generation_++;
+}
+
+void Executor::release_memo(uint_t pos){
+	PODArray<Key> keys;
+	for(packrat_memo_t::iterator it=packrat_memo_.begin(), last=packrat_memo_.end(); it!=last; ++it){
+		if(it->first.pos<pos){
+			keys.push_back(it->first);
+		}
+	}
+
+	for(uint_t i=0; i<keys.size(); ++i){
+		packrat_memo_.erase(keys[i]);
+	}
+}
+
+void Executor::evict_memo(){
+	// 記録されている最も前方の位置から現在位置までの、前半の記録を捨てる
+	uint_t min = pos_;
+	for(packrat_memo_t::iterator it=packrat_memo_.begin(), last=packrat_memo_.end(); it!=last; ++it){
+		if(it->first.pos<min){
+			min = it->first.pos;
+		}
+	}
+
+	release_memo(min + (pos_-min)/2 + 1);
+
+	if(packrat_memo_.size()>=packrat_capacity_){
+		packrat_memo_.clear();
+	}
+}
+
+bool Executor::packrat_test(const ElementPtr& e){
+	Key key;
+	key.pos = pos_;
+	key.ptr = e.get();
+
+	if(packrat_memo_t::Node* it=packrat_memo_.find(key)){
+		PackratValue& value = it->value();
+		if(value.caps){
+			replay_captures(value.caps);
+		}
+
+		if(!value.match){
+			return false;
+		}
+
+		load(value.state);
+
+		if(value.tree){
+			tree_->op_cat_assign(value.tree);
+		}
+		return true;
+	}
+
+	int_t nodenum = tree_->size();
+	int_t floor = tree_floor_;
+	uint_t capnum = cap_log_->size();
+	uint_t generation = cap_log_generation_;
+	tree_floor_ = nodenum;
+
+	cap_log_depth_++;
+	bool match = e->type==Element::TYPE_DECL ? match_inner(unchecked_ptr_cast<Element>(e->param1)) : test_call(e);
+	cap_log_depth_--;
+
+	// 規則の開始時点より前の構文木を書き換えた場合や、実行中にパックラット構文解析モードが無効にされた場合は、
+	// 結果を再利用できないので記録しない
+	if(tree_floor_>=nodenum && generation==cap_log_generation_){
+		PackratValue value;
+		value.match = match;
+		value.state = save();
+
+		// 失敗した場合も、キャプチャの変化はそのまま残るので記録する
+		value.caps = capture_states(capnum);
+
+		if(match && (int_t)tree_->size()>nodenum){
+			value.tree = tree_->slice(nodenum, tree_->size()-nodenum);
+		}
+
+		if(packrat_memo_.size()>=packrat_capacity_){
+			evict_memo();
+		}
+
+		packrat_memo_.insert(key, value);
+	}
+
+	touch_tree(floor);
+
+	if(cap_log_depth_==0){
+		cap_log_->clear();
+	}
+
+	return match;
+}
+
+bool Executor::test_call(const ElementPtr& e){
+	AnyPtr ret = e->param1->call(to_smartptr(this));
+	return ret || XTAL_detail_is_undefined(ret);
+}
+
 bool Executor::test(const ElementPtr& e){
 	switch(e->type){
 		XTAL_NODEFAULT;
@@ -398,8 +663,8 @@ bool Executor::test(const ElementPtr& e){
 
 		XTAL_CASE(Element::TYPE_CALL){
 			if(eos()){ return false; }
-			AnyPtr ret = e->param1->call(to_smartptr(this));
-			return (ret || XTAL_detail_is_undefined(ret))!=e->inv;
+			if(packrat_capacity_!=0){ return packrat_test(e)!=e->inv; }
+			return test_call(e)!=e->inv;
 		}
 
 		XTAL_CASE(Element::TYPE_GREED){
@@ -443,6 +708,7 @@ bool Executor::test(const ElementPtr& e){
 			if(tree_){
 				int_t nodenum = tree_->size() - e->param3;
 				if(nodenum<0){ nodenum = 0; }
+				touch_tree(nodenum);
 
 				if(match_inner(unchecked_ptr_cast<Element>(e->param1))){
 					TreeNodePtr node = xnew<TreeNode>();
@@ -477,8 +743,14 @@ bool Executor::test(const ElementPtr& e){
 		}
 
 		XTAL_CASE(Element::TYPE_DECL){
+			if(packrat_capacity_!=0){ return packrat_test(e)!=e->inv; }
 			return match_inner(unchecked_ptr_cast<Element>(e->param1))!=e->inv;
 		}
+
+		XTAL_CASE(Element::TYPE_CUT){
+			if(packrat_capacity_!=0){ release_memo(pos_); }
+			return !e->inv;
+		}
 	}
 
 	return false;
@@ -592,6 +864,12 @@ ArrayPtr Executor::capture_values(int_t begin){
 }
 	
 StringPtr Executor::capture(int_t begin, int_t end){
+	// バイト列から読み込んでいる場合は、その範囲をそのまま文字列にする
+	if(bytes_ && begin<=end && end<=(int_t)read_){
+		uint_t offset = offsets_[begin];
+		return xnew<String>((const char_t*)&bytes_[offset], offsets_[end]-offset);
+	}
+
 	mm_->clear();
 	for(int_t i=begin; i<end; ++i){
 		mm_->put_s(access(i));
@@ -600,6 +878,11 @@ StringPtr Executor::capture(int_t begin, int_t end){
 }
 
 StringPtr Executor::capture(int_t begin){
+	if(bytes_ && begin<=(int_t)read_){
+		uint_t offset = offsets_[begin];
+		return xnew<String>((const char_t*)&bytes_[offset], bytes_size_-offset);
+	}
+
 	mm_->clear();
 	int_t saved = pos_;
 	pos_ = begin;
@@ -620,6 +903,68 @@ bool Executor::eat_capture(int_t begin, int_t end){
 	return true;
 }
 
+void Executor::set_bytes(const void* data, uint_t size, uint_t pos){
+	if(sizeof(char_t)!=1 || read_!=0){
+		return;
+	}
+
+	bytes_ = (const u8*)data;
+	bytes_size_ = size;
+	bytes_pos_ = pos;
+	offsets_.clear();
+	offsets_.push_back((u32)pos);
+}
+
+int_t Executor::read_bytes(AnyPtr* buf, int_t size){
+	const char_t* data = (const char_t*)bytes_;
+	int_t i = 0;
+	while(i<size && bytes_pos_<bytes_size_){
+		if(bytes_[bytes_pos_]<0x80){
+			buf[i] = ID(&data[bytes_pos_], 1, ID::small_intern_t());
+			bytes_pos_++;
+		}
+		else{
+			ChMaker chm;
+			while(!chm.is_completed() && bytes_pos_<bytes_size_){
+				chm.add(data[bytes_pos_++]);
+			}
+			buf[i] = chm.to_s();
+		}
+
+		offsets_.push_back((u32)bytes_pos_);
+		++i;
+	}
+	return i;
+}
+
+uint_t Executor::skip_bytes(const ByteSet& set){
+	if(!bytes_ || pos_>=read_){
+		return 0;
+	}
+
+	const u8* begin = &bytes_[offsets_[pos_]];
+	const u8* end = set.scan(begin, bytes_+bytes_size_);
+	uint_t n = end - begin;
+	if(n==0){
+		return 0;
+	}
+
+	if(set.has('\n')){
+		for(const u8* p=begin; p!=end; ++p){
+			if(*p=='\n'){
+				lineno_++;
+			}
+		}
+	}
+
+	pos_ += n;
+	last_ = intern((const char_t*)end-1, 1);
+
+	// 読み飛ばした位置までの文字を読み込んでおく
+	peek();
+	return n;
+}
+
 void Executor::begin_record(){
 	record_pos_ = pos_;
 }
@@ -702,6 +1047,8 @@ void Executor::tree_splice(const AnyPtr& tag, int_t num, int_t lineno){
 		tree_->resize(num);
 	}
 
+	touch_tree(tree_->size()-num);
+
 	for(uint_t i=tree_->size()-num; i<tree_->size(); ++i){
 		ret->push_back(tree_->at(i));
 	}
@@ -722,7 +1069,7 @@ NFA::NFA(const ElementPtr& node){
 	gen_state(); // NFA_STATE_START
 	gen_state(); // NFA_STATE_FINAL
 
-	gen_nfa(NFA_STATE_START, node, NFA_STATE_FINAL, 0);
+	gen_nfa(NFA_STATE_START, node, NFA_STATE_FINAL, 0, true);
 }
 
 int NFA::gen_state(){
@@ -741,7 +1088,7 @@ void NFA::add_transition(int from, const AnyPtr& ch, int to){
 	states_[from].trans = x;
 }
 
-void NFA::gen_nfa(int entry, const AnyPtr& a, int exit, int depth){
+void NFA::gen_nfa(int entry, const AnyPtr& a, int exit, int depth, bool tail){
 	const ElementPtr& t = unchecked_ptr_cast<Element>(a);
 
 	switch(t->type){
@@ -755,8 +1102,8 @@ void NFA::gen_nfa(int entry, const AnyPtr& a, int exit, int depth){
 			//         left         right
 			//  entry ------> step -------> exit
 			int step = gen_state();
-			gen_nfa(entry, t->param1, step, depth+1);
-			gen_nfa(step, t->param2, exit, depth+1);
+			gen_nfa(entry, t->param1, step, depth+1, false);
+			gen_nfa(step, t->param2, exit, depth+1, tail);
 		}
 
 		XTAL_CASE(Element::TYPE_OR){
@@ -765,9 +1112,9 @@ void NFA::gen_nfa(int entry, const AnyPtr& a, int exit, int depth){
 			//  entry -----> step -----> exit
 			//          e         right
 			int step = gen_state();
-			gen_nfa(entry, t->param1, exit, depth+1);
+			gen_nfa(entry, t->param1, exit, depth+1, tail);
 			add_transition(entry, e_, step);
-			gen_nfa(step, t->param2, exit, depth+1);
+			gen_nfa(step, t->param2, exit, depth+1, tail);
 		}
 
 		XTAL_CASE2(Element::TYPE_MORE0, Element::TYPE_MORE1){
@@ -805,7 +1152,7 @@ void NFA::gen_nfa(int entry, const AnyPtr& a, int exit, int depth){
 			}
 
 			// beforeからafterへの遷移 
-			gen_nfa(before, t->param1, after, depth+1);
+			gen_nfa(before, t->param1, after, depth+1, false);
 		}
 
 		XTAL_CASE(Element::TYPE_01){
@@ -816,11 +1163,11 @@ void NFA::gen_nfa(int entry, const AnyPtr& a, int exit, int depth){
 			if(t->param3==1){
 				// eを経由する方が優先
 				add_transition(entry, e_, exit);
-				gen_nfa(entry, t->param1, exit, depth+1);
+				gen_nfa(entry, t->param1, exit, depth+1, tail);
 			}
 			else{
 				// leftを経由する方が優先
-				gen_nfa(entry, t->param1, exit, depth+1);
+				gen_nfa(entry, t->param1, exit, depth+1, tail);
 				add_transition(entry, e_, exit);
 			}
 		}
@@ -831,6 +1178,17 @@ void NFA::gen_nfa(int entry, const AnyPtr& a, int exit, int depth){
 			add_transition(entry, e_, exit);
 		}
 
+		XTAL_CASE(Element::TYPE_GREED){
+			// 後に続くものがなければ、中で後戻りしても一致する位置は変わらないので展開する
+			// そうでなければ、中だけ別に一致させる
+			if(tail && !t->inv){
+				gen_nfa(entry, t->param1, exit, depth+1, true);
+			}
+			else{
+				add_transition(entry, t, exit);
+			}
+		}
+
 		XTAL_CASE(Element::TYPE_CAP){
 			int before = gen_state();
 			int after = gen_state();
@@ -843,7 +1201,7 @@ void NFA::gen_nfa(int entry, const AnyPtr& a, int exit, int depth){
 			cap_max_++;
 
 			add_transition(entry, e_, before);
-			gen_nfa(before, t->param1, after, depth+1);
+			gen_nfa(before, t->param1, after, depth+1, tail);
 			add_transition(after, e_, exit);
 		}
 	}
@@ -851,6 +1209,460 @@ void NFA::gen_nfa(int entry, const AnyPtr& a, int exit, int depth){
 
 ////////////////////////////////////////////////////////////////////////////////
 
+bool DFA::is_regular(const ElementPtr& e, bool tail){
+	switch(e->type){
+		XTAL_DEFAULT{
+			return false;
+		}
+
+		XTAL_CASE5(Element::TYPE_ANY, Element::TYPE_EQL, Element::TYPE_CH_RANGE, Element::TYPE_CH_SET, Element::TYPE_EMPTY){
+			return true;
+		}
+
+		XTAL_CASE(Element::TYPE_CONCAT){
+			return is_regular(unchecked_ptr_cast<Element>(e->param1), false) && is_regular(unchecked_ptr_cast<Element>(e->param2), tail);
+		}
+
+		XTAL_CASE(Element::TYPE_OR){
+			return is_regular(unchecked_ptr_cast<Element>(e->param1), tail) && is_regular(unchecked_ptr_cast<Element>(e->param2), tail);
+		}
+
+		XTAL_CASE2(Element::TYPE_MORE0, Element::TYPE_MORE1){
+			return is_regular(unchecked_ptr_cast<Element>(e->param1), false);
+		}
+
+		XTAL_CASE(Element::TYPE_01){
+			return is_regular(unchecked_ptr_cast<Element>(e->param1), tail);
+		}
+
+		XTAL_CASE(Element::TYPE_GREED){
+			return tail && !e->inv && is_regular(unchecked_ptr_cast<Element>(e->param1), true);
+		}
+	}
+
+	return false;
+}
+
+DFA::DFA(const NFAPtr& nfa){
+	valid_ = false;
+	generation_ = 0;
+	start_ = -1;
+	leaves_ = XNew<Array>();
+
+	for(int i=0; i<256; ++i){
+		byte_class_[i] = -1;
+	}
+
+	uint_t state_count = nfa->states_.size();
+	visited_.resize(state_count);
+	for(uint_t i=0; i<state_count; ++i){
+		visited_[i] = 0;
+	}
+
+	PODArray<Edge> temp;
+	for(uint_t i=0; i<state_count; ++i){
+		edge_begin_.push_back(edges_.size());
+
+		temp.clear();
+		for(const TransPtr* tr=&nfa->states_[i].trans; *tr; tr=&(*tr)->next){
+			Edge edge;
+			edge.to = (*tr)->to;
+			edge.leaf = -1;
+
+			const ElementPtr& ch = (*tr)->ch;
+			if(ch->type!=Element::TYPE_INVALID){
+				for(uint_t j=0, sz=leaves_->size(); j<sz; ++j){
+					if(XTAL_detail_raweq(leaves_->at(j), ch)){
+						edge.leaf = j;
+						break;
+					}
+				}
+
+				if(edge.leaf<0){
+					if(leaves_->size()>=MAX_LEAVES){
+						return;
+					}
+
+					edge.leaf = leaves_->size();
+					leaves_->push_back(ch);
+				}
+			}
+
+			temp.push_back(edge);
+		}
+
+		// 遷移リストは後から追加したものが先頭に来るので、逆順に並べると優先度順になる
+		for(uint_t j=temp.size(); j>0; --j){
+			edges_.push_back(temp[j-1]);
+		}
+	}
+	edge_begin_.push_back(edges_.size());
+
+	generation_++;
+	work_.clear();
+	start_ = find_or_add_state(closure(NFA_STATE_START));
+	valid_ = true;
+}
+
+int_t DFA::match(Executor* exec){
+	int cur = start_;
+	bool found = states_[cur].match;
+	Executor::State match_pos = exec->save();
+
+	while(states_[cur].size!=0){
+		// 自分自身に留まるASCII文字の並びは、バイト列上でまとめて読み飛ばす
+		if(exec->has_bytes()){
+			int run = run_of(cur);
+			if(run>=0 && exec->skip_bytes(runs_[run])!=0 && states_[cur].match){
+				found = true;
+				match_pos = exec->save();
+			}
+		}
+
+		const AnyPtr& ch = exec->peek();
+		if(XTAL_detail_is_undefined(ch)){
+			break;
+		}
+
+		cur = transition(cur, ch);
+		if(cur<0){
+			return RESULT_GIVE_UP;
+		}
+
+		exec->read();
+
+		if(states_[cur].match){
+			found = true;
+			match_pos = exec->save();
+		}
+	}
+
+	if(found){
+		exec->load(match_pos);
+		return RESULT_MATCH;
+	}
+
+	return RESULT_UNMATCH;
+}
+
+int DFA::run_of(int state){
+	int run = states_[state].run;
+	if(run!=RUN_UNKNOWN){
+		return run;
+	}
+
+	ByteSet set;
+	set.clear();
+	for(uint_t i=0; i<128; ++i){
+		char_t ch = (char_t)i;
+		if(transition(state, intern(&ch, 1))==state){
+			set.add(i);
+		}
+	}
+
+	if(set.empty()){
+		run = RUN_NONE;
+	}
+	else{
+		set.build_ranges();
+		run = runs_.size();
+		runs_.push_back(set);
+	}
+
+	states_[state].run = run;
+	return run;
+}
+
+bool DFA::test_leaf(const Element* e, const AnyPtr& ch){
+	switch(e->type){
+		XTAL_NODEFAULT;
+
+		XTAL_CASE(Element::TYPE_ANY){
+			return !e->inv;
+		}
+
+		XTAL_CASE(Element::TYPE_EQL){
+			if(XTAL_detail_raweq(ch, e->param1)){ return !e->inv; }
+			return e->inv;
+		}
+
+		XTAL_CASE(Element::TYPE_CH_RANGE){
+			if(XTAL_detail_type(ch)==TYPE_SMALL_STRING){
+				return unchecked_ptr_cast<String>(ch)->op_in(unchecked_ptr_cast<ChRange>(e->param1))!=e->inv;
+			}
+			return e->inv;
+		}
+
+		XTAL_CASE(Element::TYPE_CH_SET){
+			if(unchecked_ptr_cast<Map>(e->param1)->at(ch)){ return !e->inv; }
+			return e->inv;
+		}
+	}
+
+	return false;
+}
+
+u32 DFA::signature(const AnyPtr& ch){
+	u32 sig = 0;
+	for(uint_t i=0, sz=leaves_->size(); i<sz; ++i){
+		if(test_leaf(unchecked_ptr_cast<Element>(leaves_->at(i)).get(), ch)){
+			sig |= 1u<<i;
+		}
+	}
+	return sig;
+}
+
+int DFA::class_of(const AnyPtr& ch){
+	// 1バイトの文字は、判定結果を表に記録しておく
+	int byte = -1;
+	if(XTAL_detail_rawtype(ch)==(TYPE_SMALL_STRING | (1<<Any::STRING_SIZE_SHIFT))){
+		uint_t c = (uchar_t)XTAL_detail_chvalue(ch);
+		if(c<256){
+			if(byte_class_[c]>=0){
+				return byte_class_[c];
+			}
+			byte = c;
+		}
+	}
+
+	u32 sig = signature(ch);
+	int ret = -1;
+	for(uint_t i=0, sz=class_sigs_.size(); i<sz; ++i){
+		if(class_sigs_[i]==sig){
+			ret = i;
+			break;
+		}
+	}
+
+	if(ret<0){
+		if(class_sigs_.size()>=MAX_CLASSES){
+			return -1;
+		}
+
+		ret = class_sigs_.size();
+		class_sigs_.push_back(sig);
+	}
+
+	if(byte>=0){
+		byte_class_[byte] = ret;
+	}
+
+	return ret;
+}
+
+int DFA::transition(int state, const AnyPtr& ch){
+	int cls = class_of(ch);
+	if(cls<0){
+		// 文字クラスが多すぎる場合は、遷移表を使わずに次の状態を求める
+		return step(state, signature(ch));
+	}
+
+	uint_t index = state*MAX_CLASSES + cls;
+	int next = trans_[index];
+	if(next<0){
+		next = step(state, class_sigs_[cls]);
+		if(next>=0){
+			trans_[index] = next;
+		}
+	}
+	return next;
+}
+
+int DFA::step(int state, u32 sig){
+	generation_++;
+	work_.clear();
+
+	bool match = false;
+	uint_t begin = states_[state].begin;
+	uint_t size = states_[state].size;
+	for(uint_t i=0; i<size; ++i){
+		const Edge& edge = edges_[pool_[begin+i]];
+		if(sig & (1u<<edge.leaf)){
+			// 受理状態に達したら、それより優先度の低い経路は捨てる
+			if(closure(edge.to)){
+				match = true;
+				break;
+			}
+		}
+	}
+
+	return find_or_add_state(match);
+}
+
+bool DFA::closure(int nfa_state){
+	if(visited_[nfa_state]==generation_){
+		return false;
+	}
+	visited_[nfa_state] = generation_;
+
+	if(nfa_state==NFA_STATE_FINAL){
+		return true;
+	}
+
+	for(uint_t i=edge_begin_[nfa_state], end=edge_begin_[nfa_state+1]; i<end; ++i){
+		const Edge& edge = edges_[i];
+		if(edge.leaf<0){
+			if(closure(edge.to)){
+				return true;
+			}
+		}
+		else{
+			work_.push_back(i);
+		}
+	}
+
+	return false;
+}
+
+int DFA::find_or_add_state(bool match){
+	uint_t size = work_.size();
+	uint_t hash = match ? 1 : 0;
+	for(uint_t i=0; i<size; ++i){
+		hash = hash*31 + work_[i];
+	}
+
+	for(uint_t i=0, sz=states_.size(); i<sz; ++i){
+		const DState& ds = states_[i];
+		if(ds.hash==hash && ds.match==match && ds.size==size){
+			uint_t j = 0;
+			while(j<size && pool_[ds.begin+j]==work_[j]){
+				++j;
+			}
+
+			if(j==size){
+				return i;
+			}
+		}
+	}
+
+	if(states_.size()>=MAX_STATES){
+		return -1;
+	}
+
+	DState ds;
+	ds.begin = pool_.size();
+	ds.size = size;
+	ds.hash = hash;
+	ds.run = RUN_UNKNOWN;
+	ds.match = match;
+	for(uint_t i=0; i<size; ++i){
+		pool_.push_back(work_[i]);
+	}
+	states_.push_back(ds);
+
+	uint_t n = trans_.size();
+	trans_.resize(n + MAX_CLASSES);
+	for(uint_t i=n; i<n+MAX_CLASSES; ++i){
+		trans_[i] = -1;
+	}
+
+	return states_.size()-1;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+StreamExecutor::StreamExecutor(const StreamPtr& stream, const StringPtr& source_name)
+	:Executor(source_name), stream_(stream){
+	// 文字列ストリームは内容が変わらないので、そのバイト列から直接読み込む
+	if(const SmartPtr<StringStream>& ss = ptr_cast<StringStream>(stream)){
+		set_bytes(ss->data(), ss->size(), ss->tell());
+	}
+}
+
+int_t StreamExecutor::on_read(AnyPtr* buf, int_t size){
+	if(bytes_){
+		int_t ret = read_bytes(buf, size);
+		stream_->seek(bytes_pos_);
+		return ret;
+	}
+
+	return stream_->read_charactors(buf, size);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void ByteSet::clear(){
+	bits[0] = bits[1] = bits[2] = bits[3] = 0;
+	range_count = 0;
+}
+
+void ByteSet::build_ranges(){
+	range_count = 0;
+	for(uint_t ch=0; ch<128; ++ch){
+		if(!has(ch)){
+			continue;
+		}
+
+		uint_t last = ch;
+		while(last+1<128 && has(last+1)){
+			++last;
+		}
+
+		if(range_count==MAX_RANGES){
+			range_count = -1;
+			return;
+		}
+
+		ranges[range_count][0] = (u8)ch;
+		ranges[range_count][1] = (u8)last;
+		range_count++;
+		ch = last;
+	}
+}
+
+const u8* ByteSet::scan(const u8* begin, const u8* end) const{
+	const u8* p = begin;
+
+	// 各範囲について (文字-下限) を符号なしで (上限-下限) と飽和減算し、0になるものが範囲内
+	// 0x80以上のバイトはどの範囲にも入らないので、マルチバイト文字の手前で止まる
+#ifdef XTAL_XPEG_USE_AVX2
+	if(range_count>0){
+		const __m256i zero = _mm256_setzero_si256();
+		while(end-p>=32){
+			__m256i v = _mm256_loadu_si256((const __m256i*)p);
+			__m256i in = zero;
+			for(int_t i=0; i<range_count; ++i){
+				__m256i d = _mm256_sub_epi8(v, _mm256_set1_epi8((char)ranges[i][0]));
+				__m256i over = _mm256_subs_epu8(d, _mm256_set1_epi8((char)(ranges[i][1]-ranges[i][0])));
+				in = _mm256_or_si256(in, _mm256_cmpeq_epi8(over, zero));
+			}
+
+			if((u32)_mm256_movemask_epi8(in)!=0xffffffffu){
+				break;
+			}
+			p += 32;
+		}
+	}
+#endif
+
+#ifdef XTAL_XPEG_USE_SSE2
+	if(range_count>0){
+		const __m128i zero = _mm_setzero_si128();
+		while(end-p>=16){
+			__m128i v = _mm_loadu_si128((const __m128i*)p);
+			__m128i in = zero;
+			for(int_t i=0; i<range_count; ++i){
+				__m128i d = _mm_sub_epi8(v, _mm_set1_epi8((char)ranges[i][0]));
+				__m128i over = _mm_subs_epu8(d, _mm_set1_epi8((char)(ranges[i][1]-ranges[i][0])));
+				in = _mm_or_si128(in, _mm_cmpeq_epi8(over, zero));
+			}
+
+			if(_mm_movemask_epi8(in)!=0xffff){
+				break;
+			}
+			p += 16;
+		}
+	}
+#endif
+
+	while(p<end && has(*p)){
+		++p;
+	}
+	return p;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
 int_t IteratorExecutor::on_read(AnyPtr* buf, int_t size){
 	if(iterator_){
 		return 0;
@@ -875,7 +1687,7 @@ int_t IteratorExecutor::on_read(AnyPtr* buf, int_t size){
 ////////////////////////////////////////////////////////////////////////////////
 
 Element::Element(int_t type, const AnyPtr& param1, const AnyPtr& param2, int_t param3)
-	:type((u8)type), inv(false), param1(param1), param2(param2), param3(param3){
+	:type((u8)type), inv(false), param1(param1), param2(param2), param3(param3), dfa_status(DFA_STATUS_NONE){
 
 }
 	
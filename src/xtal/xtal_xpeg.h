@@ -14,6 +14,44 @@ namespace xtal{
 */
 namespace xpeg{
 
+/**
+* \brief ASCII文字の集合
+* 連続したバイト列から、集合に含まれる文字の並びを高速に読み飛ばすために使う。
+*/
+struct ByteSet{
+	enum{
+		MAX_RANGES = 8
+	};
+
+	u32 bits[4];
+	u8 ranges[MAX_RANGES][2];
+	int_t range_count; // 範囲の数がMAX_RANGESを超える場合は-1
+
+	void clear();
+
+	void add(uint_t ch){
+		bits[ch>>5] |= 1u<<(ch&31);
+	}
+
+	bool has(uint_t ch) const{
+		return ch<128 && (bits[ch>>5] & (1u<<(ch&31)))!=0;
+	}
+
+	bool empty() const{
+		return (bits[0] | bits[1] | bits[2] | bits[3])==0;
+	}
+
+	/**
+	* \brief 文字の集合を、SIMD命令で比較するための範囲の並びに変換する
+	*/
+	void build_ranges();
+
+	/**
+	* \brief [begin, end)のうち、集合に含まれない最初のバイトの位置を返す
+	*/
+	const u8* scan(const u8* begin, const u8* end) const;
+};
+
 /**
 * \xbind lib::builtin::xpeg
 * \xinherit lib::builtin::Any
@@ -36,6 +74,45 @@ public:
 	*/
 	bool parse(const AnyPtr& pattern);
 
+public:
+
+	enum{
+		PACKRAT_DEFAULT_CAPACITY = 1024*64
+	};
+
+	/**
+	* \brief パックラット構文解析モードを有効にする
+	* decl()で宣言した規則とcall()で呼び出す関数の結果を、(規則、位置)ごとに
+	* 位置、構文木、キャプチャの変化と共に記録し、バックトラックで同じ位置から再び試す際に再利用する。
+	* 記録する結果の数がcapacityを超えた場合は、前方の位置の記録から捨てる。
+	*/
+	void enable_packrat(uint_t capacity = PACKRAT_DEFAULT_CAPACITY);
+
+	/**
+	* \brief パックラット構文解析モードを無効にし、記録を捨てる
+	*/
+	void disable_packrat();
+
+	/**
+	* \brief パックラット構文解析モードか調べる
+	*/
+	bool is_packrat(){
+		return packrat_capacity_!=0;
+	}
+
+	/**
+	* \brief posより前の位置で記録した規則の結果を捨てる
+	* xpeg::cutにマッチした際に呼ばれる。
+	*/
+	void release_memo(uint_t pos);
+
+	/**
+	* \brief 記録している規則の結果の数を返す
+	*/
+	uint_t memo_size(){
+		return packrat_memo_.size();
+	}
+
 public:
 
 	/**
@@ -115,6 +192,7 @@ public:
 	AnyPtr tree_pop_back(){
 		AnyPtr ret = tree_->back();
 		tree_->pop_back();
+		touch_tree(tree_->size());
 		return ret;
 	}
 
@@ -127,6 +205,7 @@ public:
 	}
 
 	void tree_insert(int_t n, const AnyPtr& v){
+		touch_tree(tree_->size()-n);
 		tree_->insert(tree_->size()-n, v);
 	}
 
@@ -248,7 +327,29 @@ public:
 
 	bool eat_ascii(int_t ch);
 
+	/**
+	* \brief 連続したバイト列から読み込んでいるか調べる
+	*/
+	bool has_bytes(){
+		return bytes_!=0;
+	}
+
+	/**
+	* \brief 連続したバイト列から読み込んでいる場合、現在位置から続く、setに含まれるASCII文字の並びを読み飛ばす
+	* \return 読み飛ばした文字数
+	*/
+	uint_t skip_bytes(const ByteSet& set);
+
 protected:
+
+	/**
+	* \brief dataからsizeバイトの連続したバイト列を、posバイト目から文字に分解して読み込むよう設定する
+	* 以降はon_readの代わりにread_bytesを使う。
+	*/
+	void set_bytes(const void* data, uint_t size, uint_t pos);
+
+	int_t read_bytes(AnyPtr* buf, int_t size);
+
 	virtual int_t on_read(AnyPtr* buf, int_t size){ 
 		XTAL_UNUSED_VAR(buf);
 		XTAL_UNUSED_VAR(size);
@@ -261,6 +362,27 @@ private:
 
 	bool test(const ElementPtr& elem);
 
+	bool test_call(const ElementPtr& elem);
+
+	bool packrat_test(const ElementPtr& elem);
+
+	void set_capture(const AnyPtr& name, int_t kind, int_t pos);
+
+	ArrayPtr capture_states(uint_t from);
+
+	ArrayPtr capture_states_since(uint_t count);
+
+	void replay_captures(const ArrayPtr& caps);
+
+	void evict_memo();
+
+	// 構文木のこの位置より前が書き換えられたことを記録する
+	void touch_tree(int_t n){
+		if(n<tree_floor_){
+			tree_floor_ = n;
+		}
+	}
+
 	struct StackInfo{ 
 		uint_t state;
 		uint_t nodes;
@@ -277,6 +399,12 @@ private:
 
 	struct Cap : public Base{
 		int_t begin, end;
+
+		// 最後に変化したときのcap_change_count_
+		uint_t stamp;
+
+		Cap()
+			:begin(0), end(-1), stamp(0){}
 	};
 
 	MapPtr cap_;
@@ -308,12 +436,32 @@ public:
 	struct Value{
 		State state;
 		ArrayPtr tree;
+		ArrayPtr caps;
+	};
+
+	struct PackratValue{
+		bool match;
+		State state;
+		ArrayPtr tree;
+		ArrayPtr caps;
 	};
 
 	void on_visit_members(Visitor& m){
 		Base::on_visit_members(m);
-		m & tree_ & errors_ & cap_ & last_;
+		m & tree_ & errors_ & cap_ & last_ & cap_log_;
 		m & mm_;
+		for(memotable_t::iterator it=memotable_.begin(), last=memotable_.end(); it!=last; ++it){
+			m & it->second.state.ch & it->second.tree & it->second.caps;
+		}
+		for(packrat_memo_t::iterator it=packrat_memo_.begin(), last=packrat_memo_.end(); it!=last; ++it){
+			m & it->second.state.ch & it->second.tree & it->second.caps;
+		}
+
+		// バイト列から読み込んだ文字は、すべて参照カウントを持たない短い文字列
+		if(bytes_){
+			return;
+		}
+
 		for(uint_t i=base_, sz=num_; i<sz; ++i){
 			for(int j=0; j<ONE_BLOCK_SIZE; ++j){
 				m & begin_[i-base_][j];
@@ -326,6 +474,24 @@ private:
 	typedef Hashtable<Key, Value, Fun> memotable_t;
 	memotable_t memotable_;
 
+	typedef Hashtable<Key, PackratValue, Fun> packrat_memo_t;
+	packrat_memo_t packrat_memo_;
+	uint_t packrat_capacity_;
+	int_t tree_floor_;
+
+	// パックラット構文解析モードで、NFAの実行中や規則の実行中に変化したキャプチャの名前を並べたもの
+	// 記録した結果を再利用する際に、キャプチャも再現するために使う
+	ArrayPtr cap_log_;
+	uint_t cap_log_depth_;
+
+	// キャプチャが変化した回数
+	// パックラット構文解析モードでないときは、各キャプチャに記録したこの値から、NFAの実行中に変化したキャプチャを調べる
+	uint_t cap_change_count_;
+
+	// disable_packratで記録を捨てるたびに増える
+	// 実行中に記録が捨てられた規則の結果は、キャプチャを再現できないので記録しない
+	uint_t cap_log_generation_;
+
 private:
 	enum{
 		ONE_BLOCK_SHIFT = 5,
@@ -391,17 +557,20 @@ protected:
 	uint_t lineno_;
 	int_t record_pos_;
 	AnyPtr last_;
+
+	// 連続したバイト列と、読み込んだ各文字の先頭のバイト位置
+	const u8* bytes_;
+	uint_t bytes_size_;
+	uint_t bytes_pos_;
+	PODArray<u32> offsets_;
 };
 
 class StreamExecutor : public Executor{
 public:
-	StreamExecutor(const StreamPtr& stream, const StringPtr& source_name)
-		:Executor(source_name), stream_(stream){}
+	StreamExecutor(const StreamPtr& stream, const StringPtr& source_name);
 
 protected:
-	virtual int_t on_read(AnyPtr* buf, int_t size){
-		return stream_->read_charactors(buf, size);
-	}
+	virtual int_t on_read(AnyPtr* buf, int_t size);
 
 public:
 	void on_visit_members(Visitor& m){
@@ -472,7 +641,8 @@ struct Element : public Base{
 		TYPE_01,  // *-1
 		TYPE_EMPTY, // 空
 		TYPE_CAP, // キャプチャ
-		TYPE_DECL // 宣言
+		TYPE_DECL, // 宣言
+		TYPE_CUT // これより前の位置へはバックトラックしない
 	};
 
 	u8 type;
@@ -483,6 +653,15 @@ struct Element : public Base{
 
 	NFAPtr nfa;
 
+	DFAPtr dfa;
+	u8 dfa_status;
+
+	enum{
+		DFA_STATUS_NONE, // DFAに変換できない
+		DFA_STATUS_CANDIDATE, // DFAに変換できるが、まだ変換していない
+		DFA_STATUS_READY // DFAに変換済み
+	};
+
 	Element(int_t type, const AnyPtr& param1 = null, const AnyPtr& param2 = null, int_t param3 = 0);
 
 	~Element();
@@ -491,7 +670,7 @@ struct Element : public Base{
 
 	void on_visit_members(Visitor& m){
 		Base::on_visit_members(m);
-		m & param1 & param2 & nfa;
+		m & param1 & param2 & nfa & dfa;
 	}
 };
 
@@ -516,7 +695,8 @@ struct NFA : public Base{
 
 	void add_transition(int from, const AnyPtr& ch, int to);
 
-	void gen_nfa(int entry, const AnyPtr& t, int exit, int depth);
+	// tailは、パターンの中でtの後に続くものが何もないかどうか
+	void gen_nfa(int entry, const AnyPtr& t, int exit, int depth, bool tail);
 	
 	struct State{
 		TransPtr trans;
@@ -545,6 +725,113 @@ struct NFA : public Base{
 	};
 };
 
+////////////////////////////////////////////////////////////////////////
+
+/**
+* \brief キャプチャや後方参照、述語などを含まない正規なパターンから変換したDFA
+* NFAを実行した場合と同じく、優先度の高い経路が最初に受理状態に達した位置でマッチを確定する。
+* DFAの状態は、NFAの状態を優先度順に並べたもので、実際に必要になった時点で生成する。
+* 文字は、パターン中の各文字判定の結果の組み合わせが同じもの同士を一つのクラスにまとめて扱う。
+*/
+struct DFA : public Base{
+
+	enum{
+		MAX_LEAVES = 32,
+		MAX_CLASSES = 64,
+		MAX_STATES = 1024
+	};
+
+	enum{
+		RESULT_UNMATCH,
+		RESULT_MATCH,
+		RESULT_GIVE_UP
+	};
+
+	/**
+	* \brief DFAに変換できるパターンか調べる
+	* *で作る繰り返し(TYPE_GREED)は、一度一致したら後戻りして短く一致し直すことがない。
+	* この性質は状態の集合では表せないので、パターンの末尾にあって後に続くものがない場合だけ、
+	* 後戻りしても結果が変わらないので普通の繰り返しとして扱う。tailはeの後に続くものがないかどうか。
+	*/
+	static bool is_regular(const ElementPtr& e, bool tail = true);
+
+	DFA(const NFAPtr& nfa);
+
+	/**
+	* \brief 変換に成功したか
+	*/
+	bool is_valid(){
+		return valid_;
+	}
+
+	/**
+	* \brief 現在位置からマッチを試み、マッチした場合はその終端まで読み進める
+	* 状態数が上限を超えた場合はRESULT_GIVE_UPを返す。その場合読み進めた位置は呼び出し側で戻すこと。
+	*/
+	int_t match(Executor* exec);
+
+	void on_visit_members(Visitor& m){
+		Base::on_visit_members(m);
+		m & leaves_;
+	}
+
+private:
+
+	struct Edge{
+		int leaf; // 文字判定の番号。-1の場合は空遷移
+		int to;
+	};
+
+	struct DState{
+		uint_t begin;
+		uint_t size;
+		uint_t hash;
+		int run; // 自分自身に遷移するASCII文字の集合の番号
+		bool match;
+	};
+
+	enum{
+		RUN_UNKNOWN = -1,
+		RUN_NONE = -2
+	};
+
+	int run_of(int state);
+
+	u32 signature(const AnyPtr& ch);
+	bool test_leaf(const Element* e, const AnyPtr& ch);
+	int class_of(const AnyPtr& ch);
+	int transition(int state, const AnyPtr& ch);
+	int step(int state, u32 sig);
+	bool closure(int nfa_state);
+	int find_or_add_state(bool match);
+
+private:
+	ArrayPtr leaves_;
+
+	// NFAの各状態から出る遷移を優先度順に並べたもの
+	PODArray<Edge> edges_;
+	PODArray<uint_t> edge_begin_;
+
+	// DFAの状態と、その状態が持つ消費遷移の番号列
+	PODArray<DState> states_;
+	PODArray<int> pool_;
+
+	// 状態×文字クラスの遷移表。-1は未計算
+	PODArray<int> trans_;
+
+	PODArray<u32> class_sigs_;
+	int byte_class_[256];
+
+	PODArray<ByteSet> runs_;
+
+	PODArray<int> work_;
+	PODArray<uint_t> visited_;
+	uint_t generation_;
+
+	int start_;
+	bool valid_;
+};
+
 ElementPtr elem(const AnyPtr& a);
 
 }